@@ -1,7 +1,20 @@
 #include "client_commandline.h"
 #include <iostream>
+#include <thread>
+#include <vector>
+#include <fstream>
+#include <iomanip>
+#include <cstring>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <memory>
+#include <cmath>
 #include <openvr.h>
 #include <vrinputemulator.h>
+#include <vrinputemulator_trace.h>
+#include <vrinputemulator_percentile.h>
 #include <openvr_math.h>
 
 
@@ -635,10 +648,66 @@ void deviceModes(int argc, const char * argv[]) {
 
 
 
+// Measures one-way throughput and round-trip latency of the given transport
+static void _benchmarkTransport(bool useDataRing, unsigned loopCounterMax) {
+	vrinputemulator::VRInputEmulator inputEmulator;
+	inputEmulator.connect(useDataRing);
+	if (useDataRing && !inputEmulator.isDataRingEnabled()) {
+		std::cout << "Data ring: not available, skipping" << std::endl;
+		return;
+	}
+	auto startTime = std::chrono::high_resolution_clock::now();
+	for (unsigned i = 0; i < loopCounterMax; ++i) {
+		inputEmulator.ping(false, false);
+	}
+	inputEmulator.ping(); // wait till queue is empty
+	double oneWayMillis = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	startTime = std::chrono::high_resolution_clock::now();
+	for (unsigned i = 0; i < loopCounterMax; ++i) {
+		inputEmulator.ping();
+	}
+	double roundTripMillis = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	std::cout << (useDataRing ? "Data ring:     " : "Message queue: ")
+		<< 1000.0 * (double)loopCounterMax / oneWayMillis << " one-way msg/s, "
+		<< 1000.0 * roundTripMillis / (double)loopCounterMax << " us avg. round-trip" << std::endl;
+}
+
+// Measures the turnaround time of modal requests when several threads share one connection
+static void _benchmarkConcurrentRequests(bool useDataRing, unsigned threadCount, unsigned loopCounterMax) {
+	vrinputemulator::VRInputEmulator inputEmulator;
+	inputEmulator.connect(useDataRing);
+	std::vector<std::thread> threads;
+	std::vector<double> threadMillis(threadCount, 0.0);
+	auto startTime = std::chrono::high_resolution_clock::now();
+	for (unsigned t = 0; t < threadCount; ++t) {
+		threads.emplace_back([&inputEmulator, &threadMillis, t, loopCounterMax]() {
+			auto threadStartTime = std::chrono::high_resolution_clock::now();
+			for (unsigned i = 0; i < loopCounterMax; ++i) {
+				inputEmulator.ping();
+			}
+			threadMillis[t] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - threadStartTime).count();
+		});
+	}
+	for (auto& t : threads) {
+		t.join();
+	}
+	double totalMillis = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+	double turnaroundMillis = 0.0;
+	for (auto m : threadMillis) {
+		turnaroundMillis += m;
+	}
+	std::cout << "Concurrent requests (" << threadCount << " threads): "
+		<< 1000.0 * turnaroundMillis / (double)(threadCount * loopCounterMax) << " us avg. turnaround, "
+		<< 1000.0 * (double)(threadCount * loopCounterMax) / totalMillis << " requests/s" << std::endl;
+	inputEmulator.disconnect();
+}
+
 void benchmarkIPC(int argc, const char* argv[]) {
 	if (argc > 2 && std::strcmp(argv[2], "help") == 0) {
 		std::stringstream ss;
-		ss << "Usage: client_commandline.exe benchmarkipc [all|roundtrip|throughput1|throughput2|throughput]";
+		ss << "Usage: client_commandline.exe benchmarkipc [all|roundtrip|throughput1|throughput2|throughput|transport|concurrent] [<count>] [queue|ring] [<threads>]" << std::endl
+			<< "  transport\tCompares the message queue with the shared memory data ring" << std::endl
+			<< "  concurrent\tModal requests from several threads at once (default: 1, 2, 4 and 8 threads)";
 		throw std::runtime_error(ss.str());
 	} else if (argc < 3) {
 		throw std::runtime_error("Error: Too few arguments.");
@@ -654,6 +723,10 @@ void benchmarkIPC(int argc, const char* argv[]) {
 		benchmarkMask = 1 << 2;
 	} else if (std::strcmp(argv[2], "throughput") == 0) {
 		benchmarkMask = (1 << 2) | (1 << 1);
+	} else if (std::strcmp(argv[2], "transport") == 0) {
+		benchmarkMask = 1 << 3;
+	} else if (std::strcmp(argv[2], "concurrent") == 0) {
+		benchmarkMask = 1 << 4;
 	} else {
 		throw std::runtime_error("Error: Unknown benchmark");
 	}
@@ -661,9 +734,22 @@ void benchmarkIPC(int argc, const char* argv[]) {
 	if (argc > 3) {
 		loopCounterMax = std::atoi(argv[3]);
 	}
+	bool useDataRing = false;
+	if (argc > 4) {
+		if (std::strcmp(argv[4], "ring") == 0) {
+			useDataRing = true;
+		} else if (std::strcmp(argv[4], "queue") != 0) {
+			throw std::runtime_error("Error: Unknown transport");
+		}
+	}
+	unsigned threadCount = 0;
+	if (argc > 5) {
+		threadCount = std::atoi(argv[5]);
+	}
 	std::cout << "Message count: " << loopCounterMax << std::endl;
 	vrinputemulator::VRInputEmulator inputEmulator;
-	inputEmulator.connect();
+	inputEmulator.connect(useDataRing);
+	std::cout << "Transport: " << (inputEmulator.isDataRingEnabled() ? "data ring" : "message queue") << std::endl;
 	if (benchmarkMask & 1) {
 		auto startTime = std::chrono::system_clock::now();
 		for (unsigned i = 0; i < loopCounterMax; ++i) {
@@ -697,6 +783,931 @@ void benchmarkIPC(int argc, const char* argv[]) {
 		double timeMillis = (double)std::chrono::duration_cast <std::chrono::milliseconds>(timeDiff).count();
 		std::cout << "Average IPC one-way messages/s: " << 1000.0 * (double)loopCounterMax / timeMillis << " msg/s (total time: " << timeMillis << " ms)" << std::endl;
 	}
-	std::cout << "IPC request size: " << sizeof(vrinputemulator::ipc::Request) << " bytes" << std::endl;
-	std::cout << "IPC reply size: " << sizeof(vrinputemulator::ipc::Reply) << " bytes" << std::endl;
+	inputEmulator.disconnect();
+	if (benchmarkMask & (1 << 3)) {
+		_benchmarkTransport(false, loopCounterMax);
+		_benchmarkTransport(true, loopCounterMax);
+	}
+	if (benchmarkMask & (1 << 4)) {
+		if (threadCount > 0) {
+			_benchmarkConcurrentRequests(useDataRing, threadCount, loopCounterMax);
+		} else {
+			for (unsigned t = 1; t <= 8; t *= 2) {
+				_benchmarkConcurrentRequests(useDataRing, t, loopCounterMax);
+			}
+		}
+	}
+	vrinputemulator::ipc::Request pingRequest(vrinputemulator::ipc::RequestType::IPC_Ping);
+	std::cout << "IPC request size: " << sizeof(vrinputemulator::ipc::Request) << " bytes max. (header: " << vrinputemulator::ipc::Request::headerSize()
+		<< " bytes, ping: " << pingRequest.updateFrameLength() << " bytes)" << std::endl;
+	std::cout << "IPC reply size: " << sizeof(vrinputemulator::ipc::Reply) << " bytes max. (header: " << vrinputemulator::ipc::Reply::headerSize()
+		<< " bytes, ping: " << vrinputemulator::ipc::Reply(vrinputemulator::ipc::ReplyType::IPC_Ping).frameSize() << " bytes)" << std::endl;
+}
+
+
+struct BenchmarkSamples {
+	std::vector<uint32_t> latenciesNs; // one per measured operation
+	uint64_t ops = 0;
+	uint64_t items = 0; // ops times payload items (batch size), equals ops otherwise
+	double seconds = 0.0;
+};
+
+struct BenchmarkResult {
+	std::string scenario;
+	std::string transport;
+	unsigned clients;
+	unsigned threads;
+	unsigned payload;
+	unsigned repetition; // 0 = all repetitions
+	BenchmarkSamples samples;
+};
+
+// Runs op count times on every thread of every client, after warmup unmeasured calls. All threads start measuring
+// at once and the elapsed time ends when the last thread is done. With flush each thread ends with a modal ping,
+// so non-modal operations are only counted once the driver has worked them off.
+static BenchmarkSamples _runBenchmark(std::vector<std::unique_ptr<vrinputemulator::VRInputEmulator>>& clients, unsigned threadsPerClient,
+		unsigned warmup, unsigned count, bool flush, const std::function<void(vrinputemulator::VRInputEmulator&, unsigned)>& op) {
+	unsigned threadCount = (unsigned)clients.size() * threadsPerClient;
+	std::vector<std::vector<uint32_t>> latencies(threadCount);
+	std::vector<std::chrono::steady_clock::time_point> stopTimes(threadCount);
+	std::vector<std::exception_ptr> errors(threadCount);
+	std::atomic<unsigned> readyCount(0);
+	std::atomic<bool> started(false);
+	std::vector<std::thread> threads;
+	for (unsigned t = 0; t < threadCount; ++t) {
+		threads.emplace_back([&, t]() {
+			bool ready = false;
+			try {
+				auto& inputEmulator = *clients[t / threadsPerClient];
+				for (unsigned i = 0; i < warmup; ++i) {
+					op(inputEmulator, i);
+				}
+				if (flush) {
+					inputEmulator.ping();
+				}
+				auto& threadLatencies = latencies[t];
+				threadLatencies.reserve(count);
+				ready = true;
+				readyCount.fetch_add(1);
+				while (!started.load()) {
+					std::this_thread::yield();
+				}
+				for (unsigned i = 0; i < count; ++i) {
+					auto opStartTime = std::chrono::steady_clock::now();
+					op(inputEmulator, warmup + i);
+					auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - opStartTime).count();
+					threadLatencies.push_back((uint32_t)std::min<long long>(ns, UINT32_MAX));
+				}
+				if (flush) {
+					inputEmulator.ping();
+				}
+			} catch (...) {
+				errors[t] = std::current_exception();
+				if (!ready) {
+					readyCount.fetch_add(1);
+				}
+			}
+			stopTimes[t] = std::chrono::steady_clock::now();
+		});
+	}
+	while (readyCount.load() < threadCount) {
+		std::this_thread::yield();
+	}
+	auto startTime = std::chrono::steady_clock::now();
+	started.store(true);
+	for (auto& t : threads) {
+		t.join();
+	}
+	for (auto& e : errors) {
+		if (e) {
+			std::rethrow_exception(e);
+		}
+	}
+	BenchmarkSamples samples;
+	auto stopTime = *std::max_element(stopTimes.begin(), stopTimes.end());
+	samples.seconds = std::chrono::duration<double>(stopTime - startTime).count();
+	for (auto& l : latencies) {
+		samples.latenciesNs.insert(samples.latenciesNs.end(), l.begin(), l.end());
+	}
+	samples.ops = samples.latenciesNs.size();
+	samples.items = samples.ops;
+	return samples;
+}
+
+static void _writeBenchmarkResults(std::ostream& out, std::vector<BenchmarkResult>& results, bool json) {
+	static const char* columns[] = { "scenario", "transport", "clients", "threads", "payload", "repetition", "ops", "items", "seconds",
+		"ops_per_s", "items_per_s", "mean_us", "p50_us", "p90_us", "p99_us", "p999_us", "max_us" };
+	out.setf(std::ios::fixed);
+	out.precision(6);
+	if (json) {
+		out << "{\"ipcProtocolVersion\":" << IPC_PROTOCOL_VERSION << ",\"results\":[";
+	} else {
+		for (size_t c = 0; c < sizeof(columns) / sizeof(columns[0]); ++c) {
+			out << (c > 0 ? "," : "") << columns[c];
+		}
+		out << std::endl;
+	}
+	for (size_t r = 0; r < results.size(); ++r) {
+		auto& result = results[r];
+		auto& s = result.samples;
+		std::sort(s.latenciesNs.begin(), s.latenciesNs.end());
+		double totalNs = 0.0;
+		for (auto l : s.latenciesNs) {
+			totalNs += (double)l;
+		}
+		std::string repetition = result.repetition > 0 ? std::to_string(result.repetition) : "all";
+		std::vector<std::string> values = { result.scenario, result.transport, std::to_string(result.clients), std::to_string(result.threads),
+			std::to_string(result.payload), repetition, std::to_string(s.ops), std::to_string(s.items) };
+		std::vector<double> numbers = { s.seconds, s.seconds > 0.0 ? (double)s.ops / s.seconds : 0.0, s.seconds > 0.0 ? (double)s.items / s.seconds : 0.0,
+			s.ops > 0 ? totalNs / (double)s.ops / 1000.0 : 0.0, vrinputemulator::percentileMicros(s.latenciesNs, 0.5), vrinputemulator::percentileMicros(s.latenciesNs, 0.9),
+			vrinputemulator::percentileMicros(s.latenciesNs, 0.99), vrinputemulator::percentileMicros(s.latenciesNs, 0.999), s.latenciesNs.empty() ? 0.0 : (double)s.latenciesNs.back() / 1000.0 };
+		if (json) {
+			out << (r > 0 ? ",\n" : "\n") << "{";
+			for (size_t c = 0; c < values.size(); ++c) {
+				// scenario, transport and repetition are strings
+				bool quoted = c < 2 || c == 5;
+				out << (c > 0 ? "," : "") << "\"" << columns[c] << "\":" << (quoted ? "\"" : "") << values[c] << (quoted ? "\"" : "");
+			}
+			for (size_t c = 0; c < numbers.size(); ++c) {
+				out << ",\"" << columns[values.size() + c] << "\":" << numbers[c];
+			}
+			out << "}";
+		} else {
+			for (size_t c = 0; c < values.size(); ++c) {
+				out << (c > 0 ? "," : "") << values[c];
+			}
+			for (auto n : numbers) {
+				out << "," << n;
+			}
+			out << std::endl;
+		}
+	}
+	if (json) {
+		out << "\n]}" << std::endl;
+	}
+}
+
+static std::vector<unsigned> _parseUnsignedList(const char* arg) {
+	std::vector<unsigned> values;
+	std::stringstream ss(arg);
+	std::string item;
+	while (std::getline(ss, item, ',')) {
+		values.push_back(std::stoul(item));
+	}
+	if (values.empty()) {
+		throw std::runtime_error(std::string("Error: Empty list ") + arg);
+	}
+	return values;
+}
+
+void benchmarkSuite(int argc, const char* argv[]) {
+	if (argc > 2 && std::strcmp(argv[2], "help") == 0) {
+		std::stringstream ss;
+		ss << "Usage: client_commandline.exe benchmark [<option> <value>]..." << std::endl
+			<< "  --scenarios <list>\tComma separated, default: ping,oneway,pose,batch,property" << std::endl
+			<< "    ping\t\tModal ping round trip" << std::endl
+			<< "    oneway\t\tNon-modal pings" << std::endl
+			<< "    pose\t\tNon-modal virtual device poses (pose table with ring transport)" << std::endl
+			<< "    batch\t\tBatches of <payload> non-modal virtual controller states (one thread per client only)" << std::endl
+			<< "    property\t\tModal vendor specific string property of <payload> characters" << std::endl
+			<< "  --device <virtualId>\tVirtual device for pose, batch and property (skipped without one)" << std::endl
+			<< "  --transport <list>\tqueue, ring or both (default: queue)" << std::endl
+			<< "  --clients <list>\tConcurrent connections (default: 1)" << std::endl
+			<< "  --threads <list>\tThreads per connection (default: 1)" << std::endl
+			<< "  --count <n>\t\tMeasured operations per thread and repetition (default: 10000)" << std::endl
+			<< "  --warmup <n>\t\tUnmeasured operations per thread before each repetition (default: 1000)" << std::endl
+			<< "  --repeat <n>\t\tRepetitions (default: 5)" << std::endl
+			<< "  --batch-sizes <list>\tPayload sweep of batch (default: 1,4,16,64)" << std::endl
+			<< "  --property-sizes <list>\tPayload sweep of property (default: 4,64,255)" << std::endl
+			<< "  --format csv|json\tOutput format (default: csv)" << std::endl
+			<< "  --out <file>\t\tOutput file (default: stdout)" << std::endl
+			<< "  Every combination of transport, clients, threads and payload is run. Each repetition gets a result row, plus" << std::endl
+			<< "  one over all repetitions. Latencies are per call on the calling thread, for non-modal calls that is the cost" << std::endl
+			<< "  of sending. Throughput includes the driver working off all non-modal calls.";
+		throw std::runtime_error(ss.str());
+	}
+	std::vector<std::string> scenarios = { "ping", "oneway", "pose", "batch", "property" };
+	std::vector<std::string> transports = { "queue" };
+	std::vector<unsigned> clientCounts = { 1 };
+	std::vector<unsigned> threadCounts = { 1 };
+	std::vector<unsigned> batchSizes = { 1, 4, 16, 64 };
+	std::vector<unsigned> propertySizes = { 4, 64, 255 };
+	unsigned count = 10000;
+	unsigned warmup = 1000;
+	unsigned repetitions = 5;
+	bool hasDevice = false;
+	uint32_t deviceId = 0;
+	bool json = false;
+	std::string outFile;
+	for (int i = 2; i < argc; i += 2) {
+		if (i + 1 >= argc) {
+			throw std::runtime_error(std::string("Error: Missing value for ") + argv[i]);
+		}
+		std::string option = argv[i];
+		const char* value = argv[i + 1];
+		if (option == "--scenarios") {
+			scenarios.clear();
+			std::stringstream ss(value);
+			std::string item;
+			while (std::getline(ss, item, ',')) {
+				if (item != "ping" && item != "oneway" && item != "pose" && item != "batch" && item != "property") {
+					throw std::runtime_error("Error: Unknown scenario " + item);
+				}
+				scenarios.push_back(item);
+			}
+		} else if (option == "--device") {
+			hasDevice = true;
+			deviceId = std::stoul(value);
+		} else if (option == "--transport") {
+			if (std::strcmp(value, "queue") == 0 || std::strcmp(value, "ring") == 0) {
+				transports = { value };
+			} else if (std::strcmp(value, "both") == 0) {
+				transports = { "queue", "ring" };
+			} else {
+				throw std::runtime_error("Error: Unknown transport");
+			}
+		} else if (option == "--clients") {
+			clientCounts = _parseUnsignedList(value);
+		} else if (option == "--threads") {
+			threadCounts = _parseUnsignedList(value);
+		} else if (option == "--count") {
+			count = std::stoul(value);
+		} else if (option == "--warmup") {
+			warmup = std::stoul(value);
+		} else if (option == "--repeat") {
+			repetitions = std::stoul(value);
+		} else if (option == "--batch-sizes") {
+			batchSizes = _parseUnsignedList(value);
+		} else if (option == "--property-sizes") {
+			propertySizes = _parseUnsignedList(value);
+		} else if (option == "--format") {
+			if (std::strcmp(value, "json") == 0) {
+				json = true;
+			} else if (std::strcmp(value, "csv") != 0) {
+				throw std::runtime_error("Error: Unknown output format.");
+			}
+		} else if (option == "--out") {
+			outFile = value;
+		} else {
+			throw std::runtime_error("Error: Unknown option " + option);
+		}
+	}
+	if (count == 0 || repetitions == 0) {
+		throw std::runtime_error("Error: Count and repetitions must be greater than 0.");
+	}
+	for (auto n : clientCounts) {
+		if (n == 0) {
+			throw std::runtime_error("Error: Client count must be greater than 0.");
+		}
+	}
+	for (auto n : threadCounts) {
+		if (n == 0) {
+			throw std::runtime_error("Error: Thread count must be greater than 0.");
+		}
+	}
+	for (auto n : propertySizes) {
+		if (n == 0 || n > 255) {
+			throw std::runtime_error("Error: Property sizes must be between 1 and 255.");
+		}
+	}
+
+	vr::DriverPose_t originalPose;
+	vr::VRControllerState_t originalState;
+	if (hasDevice) {
+		vrinputemulator::VRInputEmulator inputEmulator;
+		inputEmulator.connect();
+		if (deviceId >= inputEmulator.getVirtualDeviceCount()) {
+			throw std::runtime_error("Error: Unknown virtual device.");
+		}
+		originalPose = inputEmulator.getVirtualDevicePose(deviceId);
+		originalState = inputEmulator.getVirtualControllerState(deviceId);
+		inputEmulator.disconnect();
+	}
+	auto propertyId = vr::Prop_VendorSpecific_Reserved_Start; // nobody else reads it
+
+	std::vector<BenchmarkResult> results;
+	for (auto& transport : transports) {
+		for (auto clientCount : clientCounts) {
+			std::vector<std::unique_ptr<vrinputemulator::VRInputEmulator>> clients;
+			for (unsigned c = 0; c < clientCount; ++c) {
+				clients.emplace_back(new vrinputemulator::VRInputEmulator());
+				clients.back()->connect(transport == "ring");
+			}
+			if (transport == "ring" && !clients.front()->isDataRingEnabled()) {
+				std::cerr << "Data ring not available, skipping ring transport" << std::endl;
+				break;
+			}
+			for (auto threadCount : threadCounts) {
+				for (auto& scenario : scenarios) {
+					bool needsDevice = scenario == "pose" || scenario == "batch" || scenario == "property";
+					if (needsDevice && !hasDevice) {
+						std::cerr << "No virtual device given, skipping " << scenario << std::endl;
+						continue;
+					} else if (scenario == "batch" && threadCount > 1) {
+						std::cerr << "Batches are per connection, skipping batch with " << threadCount << " threads" << std::endl;
+						continue;
+					}
+					std::vector<unsigned> payloads = { 0 };
+					if (scenario == "batch") {
+						payloads = batchSizes;
+					} else if (scenario == "property") {
+						payloads = propertySizes;
+					}
+					for (auto payload : payloads) {
+						std::function<void(vrinputemulator::VRInputEmulator&, unsigned)> op;
+						bool flush = false;
+						if (scenario == "ping") {
+							op = [](vrinputemulator::VRInputEmulator& inputEmulator, unsigned) {
+								inputEmulator.ping();
+							};
+						} else if (scenario == "oneway") {
+							flush = true;
+							op = [](vrinputemulator::VRInputEmulator& inputEmulator, unsigned) {
+								inputEmulator.ping(false, false);
+							};
+						} else if (scenario == "pose") {
+							flush = true;
+							op = [&originalPose, deviceId](vrinputemulator::VRInputEmulator& inputEmulator, unsigned i) {
+								auto pose = originalPose;
+								pose.vecPosition[1] += 0.001 * (double)(i % 10);
+								inputEmulator.setVirtualDevicePose(deviceId, pose, false);
+							};
+						} else if (scenario == "batch") {
+							flush = true;
+							op = [&originalState, deviceId, payload](vrinputemulator::VRInputEmulator& inputEmulator, unsigned i) {
+								auto state = originalState;
+								inputEmulator.beginBatch();
+								for (unsigned n = 0; n < payload; ++n) {
+									state.unPacketNum = i * payload + n;
+									state.rAxis[0].x = (float)(n % 10) / 10.0f;
+									state.ulButtonPressed = (n & 1) ? vr::ButtonMaskFromId(vr::k_EButton_SteamVR_Trigger) : 0;
+									inputEmulator.setVirtualControllerState(deviceId, state, false);
+								}
+								inputEmulator.commitBatch();
+							};
+						} else {
+							op = [deviceId, propertyId, payload](vrinputemulator::VRInputEmulator& inputEmulator, unsigned i) {
+								inputEmulator.setVirtualDeviceProperty(deviceId, propertyId, std::string(payload, (char)('a' + i % 26)));
+							};
+						}
+						BenchmarkResult all = { scenario, transport, clientCount, threadCount, payload, 0 };
+						for (unsigned r = 1; r <= repetitions; ++r) {
+							BenchmarkResult result = { scenario, transport, clientCount, threadCount, payload, r };
+							result.samples = _runBenchmark(clients, threadCount, warmup, count, flush, op);
+							if (scenario == "batch") {
+								result.samples.items = result.samples.ops * payload;
+							}
+							all.samples.latenciesNs.insert(all.samples.latenciesNs.end(), result.samples.latenciesNs.begin(), result.samples.latenciesNs.end());
+							all.samples.ops += result.samples.ops;
+							all.samples.items += result.samples.items;
+							all.samples.seconds += result.samples.seconds;
+							std::cerr << scenario << " " << transport << " " << clientCount << "x" << threadCount << " payload " << payload
+								<< ": repetition " << r << "/" << repetitions << " done" << std::endl;
+							results.push_back(std::move(result));
+						}
+						results.push_back(std::move(all));
+					}
+				}
+			}
+			for (auto& c : clients) {
+				c->disconnect();
+			}
+		}
+	}
+
+	if (hasDevice) {
+		vrinputemulator::VRInputEmulator inputEmulator;
+		inputEmulator.connect();
+		inputEmulator.setVirtualDevicePose(deviceId, originalPose);
+		inputEmulator.setVirtualControllerState(deviceId, originalState);
+		inputEmulator.removeVirtualDeviceProperty(deviceId, propertyId);
+		inputEmulator.disconnect();
+	}
+	if (outFile.empty()) {
+		_writeBenchmarkResults(std::cout, results, json);
+	} else {
+		std::ofstream out(outFile, std::ios::trunc);
+		if (!out) {
+			throw std::runtime_error("Error: Could not open " + outFile);
+		}
+		_writeBenchmarkResults(out, results, json);
+	}
+}
+
+
+void dumpTrace(int argc, const char* argv[]) {
+	if (argc > 2 && std::strcmp(argv[2], "help") == 0) {
+		std::stringstream ss;
+		ss << "Usage: client_commandline.exe tracedump <filename>" << std::endl
+			<< "  Writes the driver's hook trace into <filename> in the driver's trace directory (next to the driver log)";
+		throw std::runtime_error(ss.str());
+	} else if (argc < 3) {
+		throw std::runtime_error("Error: Too few arguments.");
+	}
+	vrinputemulator::VRInputEmulator inputEmulator;
+	inputEmulator.connect();
+	auto info = inputEmulator.dumpTrace(argv[2]);
+	std::cout << "Wrote " << info.recordCount << " trace records to " << info.path << std::endl;
+	inputEmulator.disconnect();
+}
+
+
+// Reads a trace file written by the driver, records are sorted by timestamp
+static std::vector<vrinputemulator::trace::TraceRecord> _readTraceFile(const std::string& path, vrinputemulator::trace::TraceFileHeader& header) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		throw std::runtime_error("Error: Could not open " + path);
+	}
+	if (!file.read((char*)&header, sizeof(header)) || std::memcmp(header.magic, TRACE_FILE_MAGIC, sizeof(TRACE_FILE_MAGIC)) != 0) {
+		throw std::runtime_error("Error: Not a trace file.");
+	} else if (header.version != TRACE_FILE_VERSION || header.recordSize != sizeof(vrinputemulator::trace::TraceRecord)) {
+		throw std::runtime_error("Error: Unsupported trace file version.");
+	}
+	std::vector<vrinputemulator::trace::TraceRecord> records((size_t)header.recordCount);
+	if (!records.empty() && !file.read((char*)records.data(), records.size() * sizeof(vrinputemulator::trace::TraceRecord))) {
+		throw std::runtime_error("Error: Trace file is truncated.");
+	}
+	return records;
+}
+
+
+void decodeTrace(int argc, const char* argv[]) {
+	if (argc > 2 && std::strcmp(argv[2], "help") == 0) {
+		std::stringstream ss;
+		ss << "Usage: client_commandline.exe tracedecode <file> [chrome <outfile>]" << std::endl
+			<< "  Prints the records of a hook trace file, or converts them into a Chrome trace (chrome://tracing)";
+		throw std::runtime_error(ss.str());
+	} else if (argc < 3) {
+		throw std::runtime_error("Error: Too few arguments.");
+	}
+	vrinputemulator::trace::TraceFileHeader header;
+	auto records = _readTraceFile(argv[2], header);
+	uint64_t startTime = records.empty() ? 0 : records.front().timestampNs;
+
+	if (argc > 3) {
+		if (std::strcmp(argv[3], "chrome") != 0) {
+			throw std::runtime_error("Error: Unknown output format.");
+		} else if (argc < 5) {
+			throw std::runtime_error("Error: Too few arguments.");
+		}
+		std::ofstream out(argv[4], std::ios::trunc);
+		if (!out) {
+			throw std::runtime_error(std::string("Error: Could not open ") + argv[4]);
+		}
+		// Complete events ("ph":"X"), timestamps and durations in microseconds. The duration includes the calls
+		// into vrserver, so nested hooks line up.
+		out << "{\"traceEvents\":[";
+		out.setf(std::ios::fixed);
+		out.precision(3);
+		for (size_t i = 0; i < records.size(); ++i) {
+			auto& r = records[i];
+			out << (i > 0 ? ",\n" : "\n")
+				<< "{\"name\":\"" << vrinputemulator::trace::traceHookName(r.hook) << "\",\"cat\":\"hook\",\"ph\":\"X\""
+				<< ",\"ts\":" << (double)(r.timestampNs - startTime) / 1000.0 << ",\"dur\":" << (double)((uint64_t)r.elapsedNs + r.vrserverNs) / 1000.0
+				<< ",\"pid\":1,\"tid\":" << r.threadIndex
+				<< ",\"args\":{\"device\":" << r.deviceId << ",\"arg\":" << r.arg << ",\"mode\":\"" << vrinputemulator::trace::traceModeName(r.mode) << "\""
+				<< ",\"own_us\":" << (double)r.elapsedNs / 1000.0 << ",\"vrserver_us\":" << (double)r.vrserverNs / 1000.0 << "}}";
+		}
+		out << "\n]}" << std::endl;
+		std::cout << "Converted " << records.size() << " trace records from " << header.threadCount << " threads to " << argv[4] << std::endl;
+	} else {
+		std::cout << "Trace records: " << records.size() << " from " << header.threadCount << " threads" << std::endl
+			<< "time [ms]\tthread\thook\t\t\tdevice\targ\tmode\t\t\town [us]\tvrserver [us]" << std::endl;
+		std::cout.setf(std::ios::fixed);
+		std::cout.precision(3);
+		for (auto& r : records) {
+			std::cout << (double)(r.timestampNs - startTime) / 1.0E6 << "\t" << r.threadIndex << "\t"
+				<< std::left << std::setw(16) << vrinputemulator::trace::traceHookName(r.hook) << "\t";
+			if (r.deviceId < vr::k_unMaxTrackedDeviceCount) {
+				std::cout << r.deviceId;
+			} else {
+				std::cout << "-";
+			}
+			std::cout << "\t" << r.arg << "\t" << std::setw(16) << vrinputemulator::trace::traceModeName(r.mode) << "\t"
+				<< std::right << (double)r.elapsedNs / 1000.0 << "\t\t" << (double)r.vrserverNs / 1000.0 << std::endl;
+		}
+	}
+}
+
+
+void hookStats(int argc, const char* argv[]) {
+	if (argc > 2 && std::strcmp(argv[2], "help") == 0) {
+		std::stringstream ss;
+		ss << "Usage: client_commandline.exe stats [<interval ms>] [<count>]" << std::endl
+			<< "  Prints the call rates of the driver's hooks over <interval ms> (default 1000), <count> times (default 1, 0 = forever)." << std::endl
+			<< "  Latency percentiles cover all calls since the driver was started and only count the driver's own code," << std::endl
+			<< "  not the time spent in vrserver (see tracedecode for that).";
+		throw std::runtime_error(ss.str());
+	}
+	uint32_t interval = argc > 2 ? std::stoul(argv[2]) : 1000;
+	uint32_t count = argc > 3 ? std::stoul(argv[3]) : 1;
+	if (interval == 0) {
+		throw std::runtime_error("Error: Interval must be greater than 0.");
+	}
+	vrinputemulator::VRInputEmulator inputEmulator;
+	inputEmulator.connect();
+	auto previous = inputEmulator.getHookStats();
+	for (uint32_t n = 0; count == 0 || n < count; ++n) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(interval));
+		auto current = inputEmulator.getHookStats();
+		double seconds = (double)(current.sampleTimeNs - previous.sampleTimeNs) / 1.0E9;
+		std::cout << "hook			device	mode			calls/s		calls		own p50 [us]	own p99 [us]	own p999 [us]	own max [us]" << std::endl;
+		std::cout.setf(std::ios::fixed);
+		std::cout.precision(3);
+		// Entries keep their index, so the previous sample is a prefix of the current one
+		for (size_t i = 0; i < current.entries.size(); ++i) {
+			auto& e = current.entries[i];
+			auto previousCount = i < previous.entries.size() ? previous.entries[i].callCount : 0;
+			std::cout << std::left << std::setw(16) << vrinputemulator::trace::traceHookName(e.hook) << "\t";
+			if (e.deviceId < vr::k_unMaxTrackedDeviceCount) {
+				std::cout << e.deviceId;
+			} else {
+				std::cout << "-";
+			}
+			std::cout << "\t" << std::setw(16) << vrinputemulator::trace::traceModeName(e.mode) << "\t" << std::right
+				<< std::setw(10) << (seconds > 0.0 ? (double)(e.callCount - previousCount) / seconds : 0.0) << "\t"
+				<< std::setw(10) << e.callCount << "\t"
+				<< (double)e.p50Ns / 1000.0 << "\t\t" << (double)e.p99Ns / 1000.0 << "\t\t"
+				<< (double)e.p999Ns / 1000.0 << "\t\t" << (double)e.maxNs / 1000.0 << std::endl;
+		}
+		std::cout << std::endl;
+		previous = std::move(current);
+	}
+	inputEmulator.disconnect();
+}
+
+
+static const char* _requestTypeName(uint32_t type) {
+	switch ((vrinputemulator::ipc::RequestType)type) {
+	case vrinputemulator::ipc::RequestType::IPC_Ping:
+		return "IPC_Ping";
+	case vrinputemulator::ipc::RequestType::OpenVR_PoseUpdate:
+		return "OpenVR_PoseUpdate";
+	case vrinputemulator::ipc::RequestType::Batch:
+		return "Batch";
+	case vrinputemulator::ipc::RequestType::VirtualDevices_SetDevicePose:
+		return "VirtualDevices_SetDevicePose";
+	case vrinputemulator::ipc::RequestType::VirtualDevices_SetControllerState:
+		return "VirtualDevices_SetControllerState";
+	case vrinputemulator::ipc::RequestType::Debug_GetLatencyStats:
+		return "Debug_GetLatencyStats";
+	default:
+		return nullptr;
+	}
+}
+
+void latency(int argc, const char* argv[]) {
+	if (argc < 3 || std::strcmp(argv[2], "help") == 0) {
+		std::stringstream ss;
+		ss << "Usage: client_commandline.exe latency <virtualId> [<poses/s>] [<count>] [queue|ring]" << std::endl
+			<< "  Streams <count> (default 10000) synthetic poses at <poses/s> (default 1000) to a virtual device and prints" << std::endl
+			<< "  the driver's stage latencies, measured from the moment a pose was sent. Every 100th pose is sent modal so" << std::endl
+			<< "  the reply stage is covered too. The device should be published, unpublished devices have no apply stage." << std::endl
+			<< "  With \"ring\", non-modal poses go through the shared pose table.";
+		throw std::runtime_error(ss.str());
+	}
+	uint32_t deviceId = std::atoi(argv[2]);
+	uint32_t rate = argc > 3 ? std::stoul(argv[3]) : 1000;
+	uint32_t count = argc > 4 ? std::stoul(argv[4]) : 10000;
+	bool useDataRing = false;
+	if (argc > 5) {
+		if (std::strcmp(argv[5], "ring") == 0) {
+			useDataRing = true;
+		} else if (std::strcmp(argv[5], "queue") != 0) {
+			throw std::runtime_error("Error: Unknown transport");
+		}
+	}
+	if (rate == 0) {
+		throw std::runtime_error("Error: Rate must be greater than 0.");
+	}
+	vrinputemulator::VRInputEmulator inputEmulator;
+	inputEmulator.connect(useDataRing);
+	std::cout << "Transport: " << (inputEmulator.isDataRingEnabled() ? "data ring" : "message queue")
+		<< ", clock offset to driver: " << (double)inputEmulator.clockOffsetNs() / 1000.0 << " us" << std::endl;
+	auto originalPose = inputEmulator.getVirtualDevicePose(deviceId);
+	auto pose = originalPose;
+	pose.poseIsValid = true;
+	pose.result = vr::TrackingResult_Running_OK;
+	inputEmulator.setLatencyTracing(true);
+	// Small circle around the current position, one turn per second
+	auto period = std::chrono::nanoseconds(1000000000 / rate);
+	auto startTime = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < count; ++i) {
+		double angle = 2.0 * 3.14159265358979323846 * (double)i / (double)rate;
+		pose.vecPosition[0] = originalPose.vecPosition[0] + 0.01 * std::cos(angle);
+		pose.vecPosition[2] = originalPose.vecPosition[2] + 0.01 * std::sin(angle);
+		inputEmulator.setVirtualDevicePose(deviceId, pose, i % 100 == 99);
+		std::this_thread::sleep_until(startTime + (i + 1) * period);
+	}
+	inputEmulator.ping(); // everything sent before has been applied
+	inputEmulator.setVirtualDevicePose(deviceId, originalPose);
+	inputEmulator.setLatencyTracing(false);
+	auto stats = inputEmulator.getLatencyStats();
+	auto clientId = inputEmulator.clientId(); // the stats only know the id we had while connected
+	inputEmulator.disconnect();
+	std::cout << "request\t\t\t\tstage\t\tcount\t\tavg [us]\tp50 [us]\tp99 [us]\tp999 [us]\tmax [us]" << std::endl;
+	std::cout.setf(std::ios::fixed);
+	std::cout.precision(3);
+	for (auto& e : stats.entries) {
+		if (e.clientId != clientId) {
+			continue;
+		}
+		auto name = _requestTypeName(e.requestType);
+		std::stringstream type;
+		if (name) {
+			type << name;
+		} else {
+			type << "type " << e.requestType;
+		}
+		std::cout << std::left << std::setw(32) << type.str() << "\t" << std::setw(8) << vrinputemulator::trace::latencyStageName(e.stage)
+			<< "\t" << std::right << std::setw(10) << e.count << "\t"
+			<< (e.count ? (double)e.totalNs / (double)e.count / 1000.0 : 0.0) << "\t\t"
+			<< (double)e.p50Ns / 1000.0 << "\t\t" << (double)e.p99Ns / 1000.0 << "\t\t"
+			<< (double)e.p999Ns / 1000.0 << "\t\t" << (double)e.maxNs / 1000.0 << std::endl;
+	}
+}
+
+
+// Hook calls the driver traced during one phase of benchmarkhooks
+struct HookPhaseResult {
+	std::string name;
+	double seconds = 0.0;
+	uint64_t workloadCalls = 0; // calls made by the phase's workload threads
+	std::map<std::pair<uint16_t, uint8_t>, std::vector<uint32_t>> ownNs; // (hook, mode) => sorted own times
+	std::vector<uint16_t> wrappedThreads; // driver threads whose trace ring does not reach back to the phase start
+};
+
+// Runs workload on threadCount threads (none without a workload) for durationMs, then cuts the hook calls of that
+// time span out of a trace dump. The driver stamps its hook stats and trace records with the same clock.
+static HookPhaseResult _runHookPhase(vrinputemulator::VRInputEmulator& inputEmulator, const std::string& name, unsigned durationMs,
+		unsigned threadCount, const std::function<void(unsigned, uint64_t)>& workload) {
+	HookPhaseResult result;
+	result.name = name;
+	std::atomic<bool> stopped(false);
+	std::atomic<uint64_t> workloadCalls(0);
+	std::vector<std::exception_ptr> errors(threadCount);
+	std::vector<std::thread> threads;
+	auto startNs = inputEmulator.getHookStats().sampleTimeNs;
+	if (workload) {
+		for (unsigned t = 0; t < threadCount; ++t) {
+			threads.emplace_back([&, t]() {
+				uint64_t i = 0;
+				try {
+					for (; !stopped.load(); ++i) {
+						workload(t, i);
+					}
+				} catch (...) {
+					errors[t] = std::current_exception();
+				}
+				workloadCalls.fetch_add(i);
+			});
+		}
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(durationMs));
+	stopped.store(true);
+	for (auto& t : threads) {
+		t.join();
+	}
+	for (auto& e : errors) {
+		if (e) {
+			std::rethrow_exception(e);
+		}
+	}
+	auto stopNs = inputEmulator.getHookStats().sampleTimeNs;
+	result.seconds = (double)(stopNs - startNs) / 1.0E9;
+	result.workloadCalls = workloadCalls.load();
+
+	auto info = inputEmulator.dumpTrace("benchmarkhooks.trc");
+	vrinputemulator::trace::TraceFileHeader header;
+	auto records = _readTraceFile(info.path, header);
+	std::map<uint16_t, uint64_t> oldestRecords; // thread index => timestamp of its oldest record
+	for (auto& r : records) {
+		oldestRecords.insert({ r.threadIndex, r.timestampNs });
+		if (r.timestampNs >= startNs && r.timestampNs < stopNs) {
+			result.ownNs[{ r.hook, r.mode }].push_back(r.elapsedNs);
+		}
+	}
+	for (auto& t : oldestRecords) {
+		if (t.second > startNs && t.second < stopNs) {
+			result.wrappedThreads.push_back(t.first);
+		}
+	}
+	for (auto& e : result.ownNs) {
+		std::sort(e.second.begin(), e.second.end());
+	}
+	return result;
+}
+
+static void _printHookPhases(const std::vector<HookPhaseResult>& phases) {
+	std::cout << "phase\t\t\thook\t\t\tmode\t\t\tcalls/s\t\town p50 [us]\town p99 [us]\town p999 [us]\town max [us]" << std::endl;
+	std::cout.setf(std::ios::fixed);
+	std::cout.precision(3);
+	for (auto& p : phases) {
+		for (auto& e : p.ownNs) {
+			std::cout << std::left << std::setw(16) << p.name << "\t" << std::setw(16) << vrinputemulator::trace::traceHookName(e.first.first) << "\t"
+				<< std::setw(16) << vrinputemulator::trace::traceModeName(e.first.second) << "\t" << std::right
+				<< std::setw(10) << (double)e.second.size() / p.seconds << "\t"
+				<< vrinputemulator::percentileMicros(e.second, 0.5) << "\t\t" << vrinputemulator::percentileMicros(e.second, 0.99) << "\t\t"
+				<< vrinputemulator::percentileMicros(e.second, 0.999) << "\t\t" << (double)e.second.back() / 1000.0 << std::endl;
+		}
+	}
+	std::cout << std::endl;
+	for (auto& p : phases) {
+		std::cout << p.name << ": " << (double)p.workloadCalls / p.seconds << " workload calls/s" << std::endl;
+		for (auto t : p.wrappedThreads) {
+			std::cout << "  Warning: The trace ring of driver thread " << t << " wrapped, its calls are only partly counted (use a shorter --duration)" << std::endl;
+		}
+	}
+}
+
+// Devices the driver manipulates (openvr devices it hooked), found by asking for every openvr id
+static std::vector<vrinputemulator::DeviceInfo> _manipulatedDevices(vrinputemulator::VRInputEmulator& inputEmulator) {
+	std::vector<vrinputemulator::DeviceInfo> devices;
+	for (uint32_t id = 0; id < vr::k_unMaxTrackedDeviceCount; ++id) {
+		try {
+			vrinputemulator::DeviceInfo info;
+			inputEmulator.getDeviceInfo(id, info);
+			devices.push_back(info);
+		} catch (const vrinputemulator::vrinputemulator_notfound&) {
+		}
+	}
+	return devices;
+}
+
+void benchmarkHooks(int argc, const char* argv[]) {
+	if (argc < 3 || std::strcmp(argv[2], "help") == 0) {
+		std::stringstream ss;
+		ss << "Usage: client_commandline.exe benchmarkhooks <scenario> [<option> <value>]..." << std::endl
+			<< "  Measures the driver's own time per hook call and device mode while devices send poses (SteamVR or headless_host)." << std::endl
+			<< "  Every scenario runs a few phases, each phase gets one row per hook and mode." << std::endl
+			<< "  Scenarios:" << std::endl
+			<< "    contention\t\tPose hooks without and with threads changing device offsets as fast as they can" << std::endl
+			<< "    modes\t\tPose, button and axis hooks with the controllers in each device mode (redirect and swap in" << std::endl
+			<< "\t\t\tpairs), the workload sends <rate> button and axis events per second. Leaves all devices in" << std::endl
+			<< "\t\t\tnormal mode. TriggerHapticPulse only shows up when vrserver triggers pulses." << std::endl
+			<< "    devices\t\tDevice registry: hook calls (one lookup each) with events sent to every device, then modal" << std::endl
+			<< "\t\t\tvel/acc compensation mode changes (iterate all devices) against modal pings. Leaves the" << std::endl
+			<< "\t\t\tvel/acc mode disabled. For 64 devices run headless_host with --controllers 63." << std::endl
+			<< "    motioncompensation\tPose hooks without motion compensation, then with each vel/acc mode (0 - 4). The reference" << std::endl
+			<< "\t\t\tdevice shows up as MotionCompensation, the compensated devices as Default. Leaves all" << std::endl
+			<< "\t\t\tdevices in normal mode and the vel/acc mode disabled. For 13 devices run headless_host with --controllers 12." << std::endl
+			<< "  Options:" << std::endl
+			<< "  --duration <ms>\tLength of each phase (default: 3000). The driver keeps the last 8192 calls per thread, at" << std::endl
+			<< "\t\t\t1120 poses/s that is about 7 s." << std::endl
+			<< "  --threads <n>\t\tWorkload threads (default: 1)" << std::endl
+			<< "  --rate <n>\t\tEvents per second of the event workload over all threads (default: 1000)" << std::endl
+			<< "  --reference <id>\tMotion compensation reference device (default: the last controller)";
+		throw std::runtime_error(ss.str());
+	}
+	std::string scenario = argv[2];
+	unsigned durationMs = 3000;
+	unsigned threadCount = 1;
+	unsigned eventRate = 1000;
+	uint32_t referenceId = vr::k_unTrackedDeviceIndexInvalid;
+	for (int i = 3; i < argc; i += 2) {
+		if (i + 1 >= argc) {
+			throw std::runtime_error(std::string("Error: Missing value for ") + argv[i]);
+		}
+		std::string option = argv[i];
+		const char* value = argv[i + 1];
+		if (option == "--duration") {
+			durationMs = std::stoul(value);
+		} else if (option == "--threads") {
+			threadCount = std::stoul(value);
+		} else if (option == "--rate") {
+			eventRate = std::stoul(value);
+		} else if (option == "--reference") {
+			referenceId = std::stoul(value);
+		} else {
+			throw std::runtime_error("Error: Unknown option " + option);
+		}
+	}
+	if (durationMs == 0 || threadCount == 0 || eventRate == 0) {
+		throw std::runtime_error("Error: Duration, threads and rate must be greater than 0.");
+	}
+	vrinputemulator::VRInputEmulator inputEmulator;
+	inputEmulator.connect();
+	auto devices = _manipulatedDevices(inputEmulator);
+	if (devices.empty()) {
+		throw std::runtime_error("Error: The driver has no devices.");
+	}
+	std::cout << "Devices: " << devices.size() << std::endl;
+	std::vector<uint32_t> controllers;
+	for (auto& d : devices) {
+		if (d.deviceClass == vr::TrackedDeviceClass_Controller) {
+			controllers.push_back(d.deviceId);
+		}
+	}
+	// Button press, button release and axis update in turn, spread over eventTargets
+	std::vector<uint32_t> eventTargets;
+	auto eventPeriod = std::chrono::nanoseconds(1000000000ull * threadCount / eventRate);
+	std::chrono::steady_clock::time_point eventStartTime;
+	auto eventWorkload = [&](unsigned t, uint64_t i) {
+		uint64_t n = i * threadCount + t;
+		auto deviceId = eventTargets[(n / 3) % eventTargets.size()];
+		if (n % 3 == 0) {
+			inputEmulator.openvrButtonEvent(vrinputemulator::ButtonEventType::ButtonPressed, deviceId, vr::k_EButton_SteamVR_Trigger);
+		} else if (n % 3 == 1) {
+			inputEmulator.openvrButtonEvent(vrinputemulator::ButtonEventType::ButtonUnpressed, deviceId, vr::k_EButton_SteamVR_Trigger);
+		} else {
+			vr::VRControllerAxis_t axis = { (float)(n % 100) / 100.0f, 0.0f };
+			inputEmulator.openvrAxisEvent(deviceId, 0, axis);
+		}
+		std::this_thread::sleep_until(eventStartTime + (i + 1) * eventPeriod);
+	};
+	std::vector<HookPhaseResult> phases;
+	if (scenario == "contention") {
+		// Offsets on and zero in both phases, so only the configuration traffic differs
+		std::vector<vrinputemulator::DeviceOffsets> originalOffsets(devices.size());
+		for (size_t d = 0; d < devices.size(); ++d) {
+			inputEmulator.getDeviceOffsets(devices[d].deviceId, originalOffsets[d]);
+			inputEmulator.setWorldFromDriverTranslationOffset(devices[d].deviceId, { 0.0, 0.0, 0.0 });
+			inputEmulator.enableDeviceOffsets(devices[d].deviceId, true);
+		}
+		phases.push_back(_runHookPhase(inputEmulator, "idle", durationMs, 0, nullptr));
+		phases.push_back(_runHookPhase(inputEmulator, "offset churn", durationMs, threadCount, [&](unsigned t, uint64_t i) {
+			auto deviceId = devices[(t + i) % devices.size()].deviceId;
+			inputEmulator.setWorldFromDriverTranslationOffset(deviceId, { 0.0, (i & 1) ? 1.0E-6 : 0.0, 0.0 });
+		}));
+		for (size_t d = 0; d < devices.size(); ++d) {
+			inputEmulator.setWorldFromDriverTranslationOffset(devices[d].deviceId, originalOffsets[d].worldFromDriverTranslationOffset);
+			inputEmulator.enableDeviceOffsets(devices[d].deviceId, originalOffsets[d].offsetsEnabled);
+		}
+	} else if (scenario == "modes") {
+		if (controllers.empty()) {
+			throw std::runtime_error("Error: The driver has no controllers.");
+		}
+		eventTargets = controllers;
+		auto resetModes = [&]() {
+			for (auto& d : devices) {
+				inputEmulator.setDeviceNormalMode(d.deviceId);
+			}
+		};
+		auto runModePhase = [&](const std::string& name, const std::function<void()>& setMode) {
+			resetModes();
+			setMode();
+			eventStartTime = std::chrono::steady_clock::now();
+			phases.push_back(_runHookPhase(inputEmulator, name, durationMs, threadCount, eventWorkload));
+		};
+		runModePhase("Default", []() {});
+		runModePhase("FakeDisconnected", [&]() {
+			for (auto id : controllers) {
+				inputEmulator.setDeviceFakeDisconnectedMode(id);
+			}
+		});
+		if (controllers.size() >= 2) {
+			runModePhase("Redirect", [&]() {
+				for (size_t c = 0; c + 1 < controllers.size(); c += 2) {
+					inputEmulator.setDeviceRedictMode(controllers[c], controllers[c + 1]);
+				}
+			});
+			runModePhase("Swap", [&]() {
+				for (size_t c = 0; c + 1 < controllers.size(); c += 2) {
+					inputEmulator.setDeviceSwapMode(controllers[c], controllers[c + 1]);
+				}
+			});
+		} else {
+			std::cout << "Only one controller, skipping redirect and swap" << std::endl;
+		}
+		runModePhase("MotionComp", [&]() {
+			inputEmulator.setDeviceMotionCompensationMode(controllers.front());
+		});
+		resetModes();
+	} else if (scenario == "devices") {
+		for (auto& d : devices) {
+			eventTargets.push_back(d.deviceId);
+		}
+		eventStartTime = std::chrono::steady_clock::now();
+		phases.push_back(_runHookPhase(inputEmulator, "lookups", durationMs, threadCount, eventWorkload));
+		// A vel/acc mode change walks all devices of the registry, a ping is the same round trip without it
+		phases.push_back(_runHookPhase(inputEmulator, "ping", durationMs, threadCount, [&](unsigned, uint64_t) {
+			inputEmulator.ping();
+		}));
+		phases.push_back(_runHookPhase(inputEmulator, "iteration", durationMs, threadCount, [&](unsigned t, uint64_t i) {
+			inputEmulator.setMotionVelAccCompensationMode((uint32_t)((i + t) & 1));
+		}));
+		inputEmulator.setMotionVelAccCompensationMode(0);
+	} else if (scenario == "motioncompensation") {
+		if (referenceId == vr::k_unTrackedDeviceIndexInvalid) {
+			if (controllers.empty()) {
+				throw std::runtime_error("Error: The driver has no controllers, use --reference.");
+			}
+			referenceId = controllers.back();
+		}
+		for (auto& d : devices) {
+			inputEmulator.setDeviceNormalMode(d.deviceId);
+		}
+		phases.push_back(_runHookPhase(inputEmulator, "off", durationMs, 0, nullptr));
+		const char* velAccModeNames[] = { "mc disabled", "mc set zero", "mc substract", "mc linear", "mc kalman" };
+		for (uint32_t velAccMode = 0; velAccMode < 5; ++velAccMode) {
+			inputEmulator.setDeviceMotionCompensationMode(referenceId, velAccMode);
+			phases.push_back(_runHookPhase(inputEmulator, velAccModeNames[velAccMode], durationMs, 0, nullptr));
+		}
+		inputEmulator.setDeviceNormalMode(referenceId);
+		inputEmulator.setMotionVelAccCompensationMode(0);
+	} else {
+		throw std::runtime_error("Error: Unknown scenario " + scenario);
+	}
+	inputEmulator.disconnect();
+	_printHookPhases(phases);
 }
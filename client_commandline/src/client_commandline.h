@@ -34,3 +34,15 @@ void deviceOffsets(int argc, const char* argv[]);
 void deviceModes(int argc, const char* argv[]);
 
 void benchmarkIPC(int argc, const char* argv[]);
+
+void benchmarkSuite(int argc, const char* argv[]);
+
+void dumpTrace(int argc, const char* argv[]);
+
+void decodeTrace(int argc, const char* argv[]);
+
+void hookStats(int argc, const char* argv[]);
+
+void latency(int argc, const char* argv[]);
+
+void benchmarkHooks(int argc, const char* argv[]);
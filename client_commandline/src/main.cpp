@@ -25,7 +25,13 @@ void printHelp(int argc, const char* argv[]) {
 		<< "  devicetranslationoffset\tConfigure the device translation offset" << std::endl
 		<< "  devicerotationoffset\t\tConfigure the device rotation offset" << std::endl
 		<< "  devicemirrormode\t\tConfigure the device mirror mode" << std::endl
-		<< "  benchmarkipc\t\t\tipc benchmarks" << std::endl;
+		<< "  benchmarkipc\t\t\tipc benchmarks" << std::endl
+		<< "  benchmark\t\t\tipc benchmark suite with csv or json output" << std::endl
+		<< "  benchmarkhooks\t\tMeasures the driver's hook costs per device mode and workload" << std::endl
+		<< "  tracedump\t\t\tWrites the driver's hook trace into a file" << std::endl
+		<< "  tracedecode\t\t\tPrints or converts a hook trace file" << std::endl
+		<< "  stats\t\t\t\tPrints call rates and latencies of the driver's hooks" << std::endl
+		<< "  latency\t\t\tMeasures the ipc latency of pose updates" << std::endl;
 }
 
 
@@ -74,6 +80,18 @@ int main(int argc, const char* argv[]) {
 			deviceModes(argc, argv);
 		} else if (std::strcmp(argv[1], "benchmarkipc") == 0) {
 			benchmarkIPC(argc, argv);
+		} else if (std::strcmp(argv[1], "benchmark") == 0) {
+			benchmarkSuite(argc, argv);
+		} else if (std::strcmp(argv[1], "benchmarkhooks") == 0) {
+			benchmarkHooks(argc, argv);
+		} else if (std::strcmp(argv[1], "tracedump") == 0) {
+			dumpTrace(argc, argv);
+		} else if (std::strcmp(argv[1], "tracedecode") == 0) {
+			decodeTrace(argc, argv);
+		} else if (std::strcmp(argv[1], "stats") == 0) {
+			hookStats(argc, argv);
+		} else if (std::strcmp(argv[1], "latency") == 0) {
+			latency(argc, argv);
 		} else {
 			throw std::runtime_error("Error: Unknown command.");
 		}
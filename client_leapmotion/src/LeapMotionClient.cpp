@@ -97,7 +97,34 @@ void LeapMotionClient::onFrame(const Leap::Controller& controller) {
 		rightPose.vecWorldFromDriverTranslation[1] = hmdPose.mDeviceToAbsoluteTracking.m[1][3] + rightTranslationOffset[1];
 		rightPose.vecWorldFromDriverTranslation[2] = hmdPose.mDeviceToAbsoluteTracking.m[2][3] + rightTranslationOffset[2];
 
-		auto handleHand = [this](const Leap::Hand& h, vr::DriverPose_t& pose, vr::VRControllerState_t& state, bool& handPresent, bool& readyFlag, const std::string& serial, uint32_t& virtualId) {
+		// Sends all properties and the publish request at once and only waits for the replies at the end,
+		// so setting up a device takes two round trips instead of one per request
+		auto addVirtualController = [this](const std::string& serial) {
+			uint32_t virtualId = inputEmulator->addVirtualDevice(vrinputemulator::VirtualDeviceType::TrackedController, serial.c_str(), true);
+			std::vector<std::future<void>> replies;
+			replies.push_back(inputEmulator->setVirtualDevicePropertyAsync(virtualId, vr::Prop_DeviceClass_Int32, (int32_t)vr::TrackedDeviceClass_Controller));
+			replies.push_back(inputEmulator->setVirtualDevicePropertyAsync(virtualId, vr::Prop_SupportedButtons_Uint64, (uint64_t)
+				vr::ButtonMaskFromId(vr::k_EButton_System) |
+				vr::ButtonMaskFromId(vr::k_EButton_ApplicationMenu) |
+				vr::ButtonMaskFromId(vr::k_EButton_Grip) |
+				vr::ButtonMaskFromId(vr::k_EButton_Axis0) |
+				vr::ButtonMaskFromId(vr::k_EButton_Axis1)
+			));
+			replies.push_back(inputEmulator->setVirtualDevicePropertyAsync(virtualId, vr::Prop_Axis0Type_Int32, (int32_t)vr::k_eControllerAxis_Joystick));
+			replies.push_back(inputEmulator->setVirtualDevicePropertyAsync(virtualId, vr::Prop_Axis1Type_Int32, (int32_t)vr::k_eControllerAxis_Trigger));
+			replies.push_back(inputEmulator->setVirtualDevicePropertyAsync(virtualId, vr::Prop_HardwareRevision_Uint64, (uint64_t)666));
+			replies.push_back(inputEmulator->setVirtualDevicePropertyAsync(virtualId, vr::Prop_FirmwareVersion_Uint64, (uint64_t)666));
+			replies.push_back(inputEmulator->setVirtualDevicePropertyAsync(virtualId, vr::Prop_RenderModelName_String, std::string("vr_controller_vive_1_5")));
+			replies.push_back(inputEmulator->setVirtualDevicePropertyAsync(virtualId, vr::Prop_ManufacturerName_String, std::string("Leap Motion")));
+			replies.push_back(inputEmulator->setVirtualDevicePropertyAsync(virtualId, vr::Prop_ModelNumber_String, std::string("Leap Motion Controller")));
+			replies.push_back(inputEmulator->publishVirtualDeviceAsync(virtualId));
+			for (auto& r : replies) {
+				r.get();
+			}
+			return virtualId;
+		};
+
+		auto handleHand = [this, &addVirtualController](const Leap::Hand& h, vr::DriverPose_t& pose, vr::VRControllerState_t& state, bool& handPresent, bool& readyFlag, const std::string& serial, uint32_t& virtualId) {
 			double fingerBendFactor[5];
 			Leap::Vector position;
 			Leap::Vector velocity;
@@ -143,23 +170,7 @@ void LeapMotionClient::onFrame(const Leap::Controller& controller) {
 			pose.result = vr::ETrackingResult::TrackingResult_Running_OK;
 
 			if (!readyFlag) {
-				virtualId = inputEmulator->addVirtualDevice(vrinputemulator::VirtualDeviceType::TrackedController, serial.c_str(), true);
-				inputEmulator->setVirtualDeviceProperty(virtualId, vr::Prop_DeviceClass_Int32, (int32_t)vr::TrackedDeviceClass_Controller);
-				inputEmulator->setVirtualDeviceProperty(virtualId, vr::Prop_SupportedButtons_Uint64, (uint64_t)
-					vr::ButtonMaskFromId(vr::k_EButton_System) |
-					vr::ButtonMaskFromId(vr::k_EButton_ApplicationMenu) |
-					vr::ButtonMaskFromId(vr::k_EButton_Grip) |
-					vr::ButtonMaskFromId(vr::k_EButton_Axis0) |
-					vr::ButtonMaskFromId(vr::k_EButton_Axis1)
-					);
-				inputEmulator->setVirtualDeviceProperty(virtualId, vr::Prop_Axis0Type_Int32, (int32_t)vr::k_eControllerAxis_Joystick);
-				inputEmulator->setVirtualDeviceProperty(virtualId, vr::Prop_Axis1Type_Int32, (int32_t)vr::k_eControllerAxis_Trigger);
-				inputEmulator->setVirtualDeviceProperty(virtualId, vr::Prop_HardwareRevision_Uint64, (uint64_t)666);
-				inputEmulator->setVirtualDeviceProperty(virtualId, vr::Prop_FirmwareVersion_Uint64, (uint64_t)666);
-				inputEmulator->setVirtualDeviceProperty(virtualId, vr::Prop_RenderModelName_String, std::string("vr_controller_vive_1_5"));
-				inputEmulator->setVirtualDeviceProperty(virtualId, vr::Prop_ManufacturerName_String, std::string("Leap Motion"));
-				inputEmulator->setVirtualDeviceProperty(virtualId, vr::Prop_ModelNumber_String, std::string("Leap Motion Controller"));
-				inputEmulator->publishVirtualDevice(virtualId);
+				virtualId = addVirtualController(serial);
 
 				readyFlag = true;
 			}
@@ -182,7 +193,7 @@ void LeapMotionClient::onFrame(const Leap::Controller& controller) {
 			inputEmulator->setVirtualControllerState(virtualId, state);
 		};
 
-		auto handleHand2 = [this](const Leap::Hand& h, vr::DriverPose_t& pose, vr::VRControllerState_t& state, bool& handPresent, bool& readyFlag, const std::string& serial, uint32_t& virtualId) {
+		auto handleHand2 = [this, &addVirtualController](const Leap::Hand& h, vr::DriverPose_t& pose, vr::VRControllerState_t& state, bool& handPresent, bool& readyFlag, const std::string& serial, uint32_t& virtualId) {
 			handPresent = true;
 
 			Leap::Vector position = h.palmPosition();
@@ -207,23 +218,7 @@ void LeapMotionClient::onFrame(const Leap::Controller& controller) {
 			pose.result = vr::ETrackingResult::TrackingResult_Running_OK;
 
 			if (!readyFlag) {
-				virtualId = inputEmulator->addVirtualDevice(vrinputemulator::VirtualDeviceType::TrackedController, serial.c_str(), true);
-				inputEmulator->setVirtualDeviceProperty(virtualId, vr::Prop_DeviceClass_Int32, (int32_t)vr::TrackedDeviceClass_Controller);
-				inputEmulator->setVirtualDeviceProperty(virtualId, vr::Prop_SupportedButtons_Uint64, (uint64_t)
-					vr::ButtonMaskFromId(vr::k_EButton_System) |
-					vr::ButtonMaskFromId(vr::k_EButton_ApplicationMenu) |
-					vr::ButtonMaskFromId(vr::k_EButton_Grip) |
-					vr::ButtonMaskFromId(vr::k_EButton_Axis0) |
-					vr::ButtonMaskFromId(vr::k_EButton_Axis1)
-				);
-				inputEmulator->setVirtualDeviceProperty(virtualId, vr::Prop_Axis0Type_Int32, (int32_t)vr::k_eControllerAxis_Joystick);
-				inputEmulator->setVirtualDeviceProperty(virtualId, vr::Prop_Axis1Type_Int32, (int32_t)vr::k_eControllerAxis_Trigger);
-				inputEmulator->setVirtualDeviceProperty(virtualId, vr::Prop_HardwareRevision_Uint64, (uint64_t)666);
-				inputEmulator->setVirtualDeviceProperty(virtualId, vr::Prop_FirmwareVersion_Uint64, (uint64_t)666);
-				inputEmulator->setVirtualDeviceProperty(virtualId, vr::Prop_RenderModelName_String, std::string("vr_controller_vive_1_5"));
-				inputEmulator->setVirtualDeviceProperty(virtualId, vr::Prop_ManufacturerName_String, std::string("Leap Motion"));
-				inputEmulator->setVirtualDeviceProperty(virtualId, vr::Prop_ModelNumber_String, std::string("Leap Motion Controller"));
-				inputEmulator->publishVirtualDevice(virtualId);
+				virtualId = addVirtualController(serial);
 
 				readyFlag = true;
 			}
@@ -16,7 +16,6 @@ MyStackViewPage {
 
         RowLayout {
             spacing: 18
-            Layout.bottomMargin: 64
 
             MyText {
                 text: "Vel/Acc Compensation Mode:"
@@ -32,7 +31,8 @@ MyStackViewPage {
                     "Disabled",
                     "Set Zero",
                     "Use Reference Tracker",
-                    "Linear Approximation (Experimental)"
+                    "Linear Approximation (Experimental)",
+                    "Kalman Filter"
                 ]
                 onCurrentIndexChanged: {
                     if (setupFinished) {
@@ -42,6 +42,52 @@ MyStackViewPage {
             }
         }
 
+        RowLayout {
+            spacing: 18
+            visible: deviceSelectionComboBox.currentIndex == 4
+
+            MyText {
+                text: "Process Noise:"
+            }
+
+            MyTextField {
+                id: kalmanProcessNoiseInputField
+                text: "100"
+                keyBoardUID: 300
+                Layout.preferredWidth: 200
+                horizontalAlignment: Text.AlignHCenter
+                function onInputEvent(input) {
+                    var val = parseFloat(input)
+                    if (!isNaN(val) && val > 0.0) {
+                        DeviceManipulationTabController.setMotionCompensationKalmanFilterNoise(val, DeviceManipulationTabController.getMotionCompensationKalmanObservationNoise())
+                    } else {
+                        text = DeviceManipulationTabController.getMotionCompensationKalmanProcessNoise()
+                    }
+                }
+            }
+
+            MyText {
+                text: "Observation Noise:"
+                Layout.leftMargin: 32
+            }
+
+            MyTextField {
+                id: kalmanObservationNoiseInputField
+                text: "1e-7"
+                keyBoardUID: 301
+                Layout.preferredWidth: 200
+                horizontalAlignment: Text.AlignHCenter
+                function onInputEvent(input) {
+                    var val = parseFloat(input)
+                    if (!isNaN(val) && val > 0.0) {
+                        DeviceManipulationTabController.setMotionCompensationKalmanFilterNoise(DeviceManipulationTabController.getMotionCompensationKalmanProcessNoise(), val)
+                    } else {
+                        text = DeviceManipulationTabController.getMotionCompensationKalmanObservationNoise()
+                    }
+                }
+            }
+        }
+
         Item {
             Layout.fillWidth: true
             Layout.fillHeight: true
@@ -50,6 +96,8 @@ MyStackViewPage {
 
         Component.onCompleted: {
             deviceSelectionComboBox.currentIndex = DeviceManipulationTabController.getMotionCompensationVelAccMode()
+            kalmanProcessNoiseInputField.text = DeviceManipulationTabController.getMotionCompensationKalmanProcessNoise()
+            kalmanObservationNoiseInputField.text = DeviceManipulationTabController.getMotionCompensationKalmanObservationNoise()
             setupFinished = true
         }
 
@@ -58,6 +106,10 @@ MyStackViewPage {
             onMotionCompensationVelAccModeChanged: {
                 deviceSelectionComboBox.currentIndex = mode
             }
+            onMotionCompensationKalmanFilterNoiseChanged: {
+                kalmanProcessNoiseInputField.text = processNoise
+                kalmanObservationNoiseInputField.text = observationNoise
+            }
         }
 
     }
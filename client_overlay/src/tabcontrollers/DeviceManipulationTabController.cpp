@@ -243,6 +243,14 @@ unsigned DeviceManipulationTabController::getMotionCompensationVelAccMode() {
 	return motionCompensationVelAccMode;
 }
 
+double DeviceManipulationTabController::getMotionCompensationKalmanProcessNoise() {
+	return motionCompensationKalmanProcessNoise;
+}
+
+double DeviceManipulationTabController::getMotionCompensationKalmanObservationNoise() {
+	return motionCompensationKalmanObservationNoise;
+}
+
 
 #define DEVICEMANIPULATIONSETTINGS_GETTRANSLATIONVECTOR(name) { \
 	double valueX = settings->value(#name ## "_x", 0.0).toDouble(); \
@@ -262,6 +270,8 @@ void DeviceManipulationTabController::reloadDeviceManipulationSettings() {
 	auto settings = OverlayController::appSettings();
 	settings->beginGroup("deviceManipulationSettings");
 	motionCompensationVelAccMode = settings->value("motionCompensationVelAccMode").toUInt();
+	motionCompensationKalmanProcessNoise = settings->value("motionCompensationKalmanProcessNoise", 100.0).toDouble();
+	motionCompensationKalmanObservationNoise = settings->value("motionCompensationKalmanObservationNoise", 1.0E-7).toDouble();
 	settings->endGroup();
 }
 
@@ -294,6 +304,8 @@ void DeviceManipulationTabController::saveDeviceManipulationSettings() {
 	auto settings = OverlayController::appSettings();
 	settings->beginGroup("deviceManipulationSettings");
 	settings->setValue("motionCompensationVelAccMode", motionCompensationVelAccMode);
+	settings->setValue("motionCompensationKalmanProcessNoise", motionCompensationKalmanProcessNoise);
+	settings->setValue("motionCompensationKalmanObservationNoise", motionCompensationKalmanObservationNoise);
 	settings->endGroup();
 	settings->sync();
 }
@@ -427,6 +439,18 @@ void DeviceManipulationTabController::setMotionCompensationVelAccMode(unsigned m
 	}
 }
 
+void DeviceManipulationTabController::setMotionCompensationKalmanFilterNoise(double processNoise, double observationNoise, bool notify) {
+	if (motionCompensationKalmanProcessNoise != processNoise || motionCompensationKalmanObservationNoise != observationNoise) {
+		motionCompensationKalmanProcessNoise = processNoise;
+		motionCompensationKalmanObservationNoise = observationNoise;
+		vrInputEmulator.setMotionCompensationKalmanFilterNoise(processNoise, observationNoise);
+		saveDeviceManipulationSettings();
+		if (notify) {
+			emit motionCompensationKalmanFilterNoiseChanged(processNoise, observationNoise);
+		}
+	}
+}
+
 unsigned DeviceManipulationTabController::getRenderModelCount() {
 	return (unsigned)vr::VRRenderModels()->GetRenderModelCount();
 }
@@ -572,6 +596,7 @@ void DeviceManipulationTabController::setDeviceMode(unsigned index, unsigned mod
 			vrInputEmulator.setDeviceSwapMode(deviceInfos[index]->openvrId, deviceInfos[targedIndex]->openvrId);
 			break;
 		case 4:
+			vrInputEmulator.setMotionCompensationKalmanFilterNoise(motionCompensationKalmanProcessNoise, motionCompensationKalmanObservationNoise);
 			vrInputEmulator.setDeviceMotionCompensationMode(deviceInfos[index]->openvrId, motionCompensationVelAccMode);
 			break;
 		default:
@@ -61,6 +61,8 @@ private:
 	std::vector<DeviceManipulationProfile> deviceManipulationProfiles;
 
 	uint32_t motionCompensationVelAccMode = 0;
+	double motionCompensationKalmanProcessNoise = 100.0;
+	double motionCompensationKalmanObservationNoise = 1.0E-7;
 
 	unsigned settingsUpdateCounter = 0;
 
@@ -88,6 +90,8 @@ public:
 	Q_INVOKABLE double getDriverRotationOffset(unsigned index, unsigned axis);
 	Q_INVOKABLE double getDriverTranslationOffset(unsigned index, unsigned axis);
 	Q_INVOKABLE unsigned getMotionCompensationVelAccMode();
+	Q_INVOKABLE double getMotionCompensationKalmanProcessNoise();
+	Q_INVOKABLE double getMotionCompensationKalmanObservationNoise();
 
 	void reloadDeviceManipulationSettings();
 	void reloadDeviceManipulationProfiles();
@@ -120,6 +124,7 @@ public slots:
 	void deleteDeviceManipulationProfile(unsigned index);
 
 	void setMotionCompensationVelAccMode(unsigned mode, bool notify = true);
+	void setMotionCompensationKalmanFilterNoise(double processNoise, double observationNoise, bool notify = true);
 
 signals:
 	void deviceCountChanged(unsigned deviceCount);
@@ -127,6 +132,7 @@ signals:
 	void motionCompensationSettingsChanged();
 	void deviceManipulationProfilesChanged();
 	void motionCompensationVelAccModeChanged(unsigned mode);
+	void motionCompensationKalmanFilterNoiseChanged(double processNoise, double observationNoise);
 };
 
 } // namespace inputemulator
@@ -1,9 +1,10 @@
 #include "driver_ipc_shm.h"
 #include "../../stdafx.h"
 #include "../../driver_vrinputemulator.h"
-#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include "../../utils/LatencyStats.h"
 #include <ipc_protocol.h>
 #include <openvr_math.h>
+#include <algorithm>
 
 namespace vrinputemulator {
 namespace driver {
@@ -12,14 +13,371 @@ namespace driver {
 void IpcShmCommunicator::init(CServerDriver* driver) {
 	_driver = driver;
 	_ipcThreadStopFlag = false;
+	try {
+		boost::interprocess::named_semaphore::remove(_ipcDataDoorbellName.c_str());
+		_ipcDataDoorbell.reset(new boost::interprocess::named_semaphore(boost::interprocess::create_only, _ipcDataDoorbellName.c_str(), 0));
+	} catch (std::exception& e) {
+		LOG(ERROR) << "Could not create data ring doorbell, data rings are disabled: " << e.what();
+	}
+	try {
+		_poseTable.reset(new ipc::ShmPoseTable(boost::interprocess::create_only, _poseTableName));
+	} catch (std::exception& e) {
+		LOG(ERROR) << "Could not create shared memory pose table: " << e.what();
+	}
+	{
+		std::lock_guard<std::mutex> lock(_dataPlaneMutex);
+		_dataLanes.clear();
+		_dataLanes.insert({ 0, std::make_shared<DataLane>() }); // shared lane for requests without known client
+		_dataPlaneQueued = 0;
+		_dataLanesVersion++;
+	}
+	_controlThread = std::thread(_controlThreadFunc, this, driver);
 	_ipcThread = std::thread(_ipcThreadFunc, this, driver);
+	if (_ipcDataDoorbell) {
+		_dataRingThread = std::thread(_dataRingThreadFunc, this, driver);
+	}
 }
 
 void IpcShmCommunicator::shutdown() {
 	if (_ipcThreadRunning) {
 		_ipcThreadStopFlag = true;
+		// The ipc thread blocks until a message arrives, so send it one
+		try {
+			boost::interprocess::message_queue queue(boost::interprocess::open_only, _ipcQueueName.c_str());
+			ipc::Request message(ipc::RequestType::IPC_Wakeup);
+			queue.send(&message, message.frameSize(), 0);
+		} catch (std::exception& e) {
+			LOG(ERROR) << "Could not wake up ipc thread: " << e.what();
+		}
+	}
+	if (_ipcThread.joinable()) {
 		_ipcThread.join();
 	}
+	if (_controlThread.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(_controlPlaneMutex);
+			_ipcThreadStopFlag = true;
+		}
+		_controlPlaneCondition.notify_all();
+		{
+			std::lock_guard<std::mutex> lock(_dataPendingMutex);
+		}
+		_dataPendingCondition.notify_all();
+		_controlThread.join();
+	}
+	if (_dataRingThread.joinable()) {
+		_ipcThreadStopFlag = true;
+		_ringDataDoorbell();
+		_dataRingThread.join();
+	}
+	if (_ipcDataDoorbell) {
+		_ipcDataDoorbell.reset();
+		boost::interprocess::named_semaphore::remove(_ipcDataDoorbellName.c_str());
+	}
+	_poseTable.reset();
+	_logPlaneStats();
+	_dataLanes.clear();
+	_dataPlaneQueued = 0;
+	_controlPlaneQueue.clear();
+}
+
+void IpcShmCommunicator::runFrame() {
+	std::lock_guard<std::mutex> lock(_frameMutex);
+	if (_poseTable) {
+		_applyPoseTable(_driver);
+	}
+}
+
+// Returns true when at least one pose has been applied
+bool IpcShmCommunicator::_applyPoseTable(CServerDriver* driver) {
+	if (!_poseTable->fetchDirty()) {
+		return false;
+	}
+	std::unique_lock<std::mutex> lock(_poseTableMutex, std::try_to_lock);
+	if (!lock.owns_lock()) {
+		// The other thread is already on it, mark the table dirty again so nothing gets lost
+		_poseTable->markDirty();
+		return false;
+	}
+	bool applied = false;
+	auto deviceCount = driver->virtualDevices_getDeviceCount();
+	if (deviceCount > ipc::ShmPoseTable::slotCount) {
+		deviceCount = ipc::ShmPoseTable::slotCount;
+	}
+	for (uint32_t i = 0; i < deviceCount; ++i) {
+		vr::DriverPose_t pose;
+		int64_t timestamp;
+		uint32_t clientId;
+		if (_poseTable->readPose(i, _poseTableSequences[i], pose, timestamp, clientId)) {
+			auto device = driver->virtualDevices_getDevice(i);
+			if (device) {
+				LatencyScope latencyScope(ipc::RequestType::VirtualDevices_SetDevicePose, clientId, timestamp, ipc::clockNs());
+				device->updatePose(pose, -ipc::timestampAge(timestamp));
+				applied = true;
+			}
+		}
+	}
+	return applied;
+}
+
+std::shared_ptr<IpcShmCommunicator::ReplyQueue> IpcShmCommunicator::_getReplyQueue(uint32_t clientId) {
+	std::lock_guard<std::mutex> lock(_ipcEndpointsMutex);
+	auto i = _ipcEndpoints.find(clientId);
+	if (i != _ipcEndpoints.end()) {
+		return i->second.replyQueue;
+	}
+	return nullptr;
+}
+
+IpcShmCommunicator::ReplyQueue::ReplyQueue(const char* name, ReplyOverflowPolicy policy)
+		: policy(policy), _queue(boost::interprocess::open_only, name) {}
+
+bool IpcShmCommunicator::ReplyQueue::send(const void* buffer, size_t size, unsigned priority) {
+	LatencyScope::markReply();
+	if (_overflowed) {
+		_repliesDropped++;
+		return false;
+	}
+	if (_queue.try_send(buffer, size, priority)) {
+		_repliesSent++;
+		return true;
+	}
+	switch (policy) {
+	case ReplyOverflowPolicy::DropOldest:
+		{
+			ipc::Reply oldest;
+			uint64_t recvSize;
+			unsigned recvPriority;
+			if (_queue.try_receive(&oldest, sizeof(ipc::Reply), recvSize, recvPriority)) {
+				_repliesDropped++;
+			}
+			if (_queue.try_send(buffer, size, priority)) {
+				_repliesSent++;
+				return true;
+			}
+		}
+		break;
+	case ReplyOverflowPolicy::Disconnect:
+		_overflowed = true;
+		break;
+	default:
+		break;
+	}
+	_repliesDropped++;
+	return false;
+}
+
+void IpcShmCommunicator::ReplyQueue::getStatus(ipc::Reply_IPC_ClientStatus& status) {
+	status.replyOverflowPolicy = policy;
+	status.pendingReplies = (uint32_t)_queue.get_num_msg();
+	status.repliesSent = _repliesSent;
+	status.repliesDropped = _repliesDropped;
+}
+
+// Drops endpoints whose process has died or whose reply queue overflowed with the disconnect policy
+void IpcShmCommunicator::_reapEndpoints() {
+	std::vector<uint32_t> reaped;
+	std::vector<uint32_t> terminated;
+	{
+		std::lock_guard<std::mutex> lock(_ipcEndpointsMutex);
+		for (auto i = _ipcEndpoints.begin(); i != _ipcEndpoints.end();) {
+			auto& endpoint = i->second;
+			auto dropped = endpoint.replyQueue->repliesDropped();
+			if (dropped != endpoint.repliesDroppedLogged) {
+				LOG(WARNING) << "Reply queue of client " << i->first << " is full, " << dropped << " replies dropped so far";
+				endpoint.repliesDroppedLogged = dropped;
+			}
+			if (endpoint.replyQueue->overflowed()) {
+				LOG(WARNING) << "Dropping client " << i->first << ": reply queue overflowed";
+			} else if (endpoint.process && WaitForSingleObject(endpoint.process.get(), 0) == WAIT_OBJECT_0) {
+				LOG(INFO) << "Dropping client " << i->first << ": process has terminated";
+				terminated.push_back(i->first);
+			} else {
+				++i;
+				continue;
+			}
+			reaped.push_back(i->first);
+			i = _ipcEndpoints.erase(i);
+		}
+	}
+	for (auto clientId : reaped) {
+		_closeDataLane(clientId);
+		LatencyStats::setTraced(clientId, false);
+	}
+	if (_poseTable && !terminated.empty()) {
+		// A client that died in the middle of a pose table write would keep the slot locked forever
+		std::lock_guard<std::mutex> lock(_poseTableMutex);
+		for (auto clientId : terminated) {
+			auto abandoned = _poseTable->abandonWrites(clientId, _poseTableSequences);
+			if (abandoned) {
+				LOG(WARNING) << "Unlocked " << abandoned << " pose table slots of client " << clientId;
+			}
+		}
+	}
+	if (!reaped.empty()) {
+		std::lock_guard<std::mutex> lock(_pendingBatchesMutex);
+		for (auto i = _pendingBatches.begin(); i != _pendingBatches.end();) {
+			if (std::find(reaped.begin(), reaped.end(), i->first.first) != reaped.end()) {
+				i = _pendingBatches.erase(i);
+			} else {
+				++i;
+			}
+		}
+		for (auto i = _rejectedBatches.begin(); i != _rejectedBatches.end();) {
+			if (std::find(reaped.begin(), reaped.end(), i->first) != reaped.end()) {
+				i = _rejectedBatches.erase(i);
+			} else {
+				++i;
+			}
+		}
+	}
+}
+
+void IpcShmCommunicator::_ringDataDoorbell() {
+	if (_ipcDataDoorbell) {
+		_ipcDataDoorbell->post();
+	}
+}
+
+bool IpcShmCommunicator::_isDataRingRequest(ipc::RequestType type) {
+	switch (type) {
+	case ipc::RequestType::IPC_Ping:
+	case ipc::RequestType::OpenVR_PoseUpdate:
+	case ipc::RequestType::OpenVR_ButtonEvent:
+	case ipc::RequestType::OpenVR_AxisEvent:
+	case ipc::RequestType::OpenVR_ProximitySensorEvent:
+	case ipc::RequestType::OpenVR_VendorSpecificEvent:
+	case ipc::RequestType::VirtualDevices_SetDevicePose:
+	case ipc::RequestType::VirtualDevices_SetControllerState:
+	case ipc::RequestType::Batch:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool IpcShmCommunicator::_isBatchableRequest(ipc::RequestType type) {
+	switch (type) {
+	case ipc::RequestType::OpenVR_PoseUpdate:
+	case ipc::RequestType::OpenVR_ButtonEvent:
+	case ipc::RequestType::OpenVR_AxisEvent:
+	case ipc::RequestType::OpenVR_ProximitySensorEvent:
+	case ipc::RequestType::OpenVR_VendorSpecificEvent:
+	case ipc::RequestType::VirtualDevices_SetDevicePose:
+	case ipc::RequestType::VirtualDevices_SetControllerState:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// dequeueNs: when the last part of the batch was taken from the transport
+void IpcShmCommunicator::_handleBatch(IpcShmCommunicator* _this, CServerDriver* driver, ipc::Request& message, int64_t dequeueNs) {
+	auto& batch = message.msg.batch;
+	std::vector<uint8_t> data;
+	auto status = ipc::ReplyStatus::Ok;
+	{
+		// Collect parts until the batch is complete
+		std::lock_guard<std::mutex> lock(_this->_pendingBatchesMutex);
+		auto key = std::make_pair(batch.clientId, batch.batchId);
+		if (_this->_rejectedBatches.count(key)) {
+			// A part of the batch did not fit into the client's lane or the control plane queue (see _rejectRequest())
+			_this->_pendingBatches.erase(key);
+			if (!batch.lastPart) {
+				return;
+			}
+			status = ipc::ReplyStatus::InvalidOperation;
+		}
+		auto& pending = _this->_pendingBatches[key];
+		if (pending.size() + batch.dataSize > _maxBatchSize) {
+			LOG(ERROR) << "Batch " << batch.batchId << " of client " << batch.clientId << " exceeds the maximum batch size, dropping it";
+			_this->_pendingBatches.erase(key);
+			return;
+		}
+		if (status == ipc::ReplyStatus::Ok) {
+			pending.insert(pending.end(), batch.data, batch.data + batch.dataSize);
+		}
+		if (!batch.lastPart) {
+			return;
+		}
+		data.swap(pending);
+		_this->_pendingBatches.erase(key);
+	}
+	{
+		std::lock_guard<std::mutex> lock(_this->_frameMutex);
+		size_t offset = 0;
+		while (offset < data.size()) {
+			ipc::Request_BatchOpHeader opHeader;
+			if (data.size() - offset < sizeof(ipc::Request_BatchOpHeader)) {
+				status = ipc::ReplyStatus::InvalidOperation;
+				break;
+			}
+			std::memcpy(&opHeader, data.data() + offset, sizeof(ipc::Request_BatchOpHeader));
+			offset += sizeof(ipc::Request_BatchOpHeader);
+			if (opHeader.length > sizeof(ipc::Request::msg) || data.size() - offset < opHeader.length) {
+				status = ipc::ReplyStatus::InvalidOperation;
+				break;
+			}
+			ipc::Request op(opHeader.type, message.timestamp);
+			op.length = opHeader.length;
+			std::memcpy(&op.msg, data.data() + offset, opHeader.length);
+			offset += (opHeader.length + 7) & ~(size_t)7;
+			if (!_isBatchableRequest(op.type) || !op.isValidFrame(op.frameSize())) {
+				LOG(ERROR) << "Invalid operation in batch " << batch.batchId << " of client " << batch.clientId << " (type " << (int)op.type << ")";
+				status = ipc::ReplyStatus::InvalidOperation;
+				continue;
+			}
+			LatencyScope latencyScope(op.type, batch.clientId, message.timestamp, dequeueNs);
+			_handleRequest(_this, driver, op, dequeueNs);
+		}
+	}
+	if (batch.messageId != 0) {
+		auto replyQueue = _this->_getReplyQueue(batch.clientId);
+		if (replyQueue) {
+			ipc::Reply reply(ipc::ReplyType::GenericReply);
+			reply.messageId = batch.messageId;
+			reply.status = status;
+			replyQueue->send(&reply, reply.frameSize(), 0);
+		} else {
+			LOG(ERROR) << "Error while applying batch: Unknown clientId " << batch.clientId;
+		}
+	}
+}
+
+// Trace files may only be written into the trace directory (next to the driver log), so clients cannot make
+// the driver create or overwrite arbitrary files. Returns false when fileName is not a bare file name.
+bool IpcShmCommunicator::_traceFilePath(const char* fileName, std::string& path) {
+	std::string name(fileName);
+	if (name.empty() || name == "." || name == ".." || name.find_first_of("/\\:*?\"<>|") != std::string::npos) {
+		return false;
+	}
+	for (auto c : name) {
+		if ((unsigned char)c < 0x20) {
+			return false;
+		}
+	}
+	CreateDirectoryA(_traceDirectory.c_str(), nullptr); // fails when it already exists
+	auto relativePath = _traceDirectory + "\\" + name;
+	char fullPath[MAX_PATH];
+	auto length = GetFullPathNameA(relativePath.c_str(), MAX_PATH, fullPath, nullptr);
+	if (length == 0 || length >= MAX_PATH) {
+		return false;
+	}
+	path = fullPath;
+	return true;
+}
+
+void IpcShmCommunicator::_replyClockSync(const ipc::Request& message) {
+	auto replyQueue = _getReplyQueue(message.msg.ipc_ClockSync.clientId);
+	if (replyQueue) {
+		ipc::Reply reply(ipc::ReplyType::IPC_ClockSync);
+		reply.messageId = message.msg.ipc_ClockSync.messageId;
+		reply.status = ipc::ReplyStatus::Ok;
+		reply.msg.ipc_ClockSync.driverTimeNs = ipc::clockNs();
+		replyQueue->send(&reply, reply.frameSize(), 0);
+	} else {
+		LOG(ERROR) << "Error during clock sync: unknown clientID " << message.msg.ipc_ClockSync.clientId;
+	}
 }
 
 void IpcShmCommunicator::_ipcThreadFunc(IpcShmCommunicator* _this, CServerDriver * driver) {
@@ -37,904 +395,1622 @@ void IpcShmCommunicator::_ipcThreadFunc(IpcShmCommunicator* _this, CServerDriver
 
 		while (!_this->_ipcThreadStopFlag) {
 			try {
+				// Block until something arrives, then handle everything that is pending before blocking again
 				ipc::Request message;
 				uint64_t recv_size;
 				unsigned priority;
-				boost::posix_time::ptime timeout = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(50);
-				if (messageQueue.timed_receive(&message, sizeof(ipc::Request), recv_size, priority, timeout)) {
+				messageQueue.receive(&message, sizeof(ipc::Request), recv_size, priority);
+				do {
 					LOG(TRACE) << "CServerDriver::_ipcThreadFunc: IPC request received ( type " << (int)message.type << ")";
-					if (recv_size == sizeof(ipc::Request)) {
-						switch (message.type) {
-
-						case ipc::RequestType::IPC_ClientConnect:
-							{
-								try {
-									auto queue = std::make_shared<boost::interprocess::message_queue>(boost::interprocess::open_only, message.msg.ipc_ClientConnect.queueName);
-									ipc::Reply reply(ipc::ReplyType::IPC_ClientConnect);
-									reply.messageId = message.msg.ipc_ClientConnect.messageId;
-									reply.msg.ipc_ClientConnect.ipcProcotolVersion = IPC_PROTOCOL_VERSION;
-									if (message.msg.ipc_ClientConnect.ipcProcotolVersion == IPC_PROTOCOL_VERSION) {
-										auto clientId = _this->_ipcClientIdNext++;
-										_this->_ipcEndpoints.insert({ clientId, queue });
-										reply.msg.ipc_ClientConnect.clientId = clientId;
-										reply.status = ipc::ReplyStatus::Ok;
-										LOG(INFO) << "New client connected: endpoint \"" << message.msg.ipc_ClientConnect.queueName << "\", cliendId " << clientId;
-									} else {
-										reply.msg.ipc_ClientConnect.clientId = 0;
-										reply.status = ipc::ReplyStatus::InvalidVersion;
-										LOG(INFO) << "Client (endpoint \"" << message.msg.ipc_ClientConnect.queueName << "\") reports incompatible ipc version "
-											<< message.msg.ipc_ClientConnect.ipcProcotolVersion;
-									}
-									queue->send(&reply, sizeof(ipc::Reply), 0);
-								} catch (std::exception& e) {
-									LOG(ERROR) << "Error during client connect: " << e.what();
-								}
-							}
-							break;
+					if (message.type == ipc::RequestType::IPC_Wakeup) {
+						// Nothing to do, we only needed to wake up
+					} else if (message.type == ipc::RequestType::IPC_ClockSync && message.isValidFrame(recv_size)) {
+						// Answered right away, any queueing would end up in the round trip the client measures
+						_this->_replyClockSync(message);
+					} else if (message.isValidFrame(recv_size)) {
+						_this->_dispatchRequest(message);
+					} else if (message.type == ipc::RequestType::IPC_ClientConnect && recv_size == sizeof(ipc::Request)) {
+						// Clients with an older protocol version send unframed messages, let them through so they get a proper InvalidVersion reply
+						_this->_dispatchRequest(message);
+					} else {
+						LOG(ERROR) << "Error in ipc server receive loop: invalid frame (type " << (int)message.type << ", length " << message.length << ", received size " << recv_size << ")";
+					}
+				} while (!_this->_ipcThreadStopFlag && messageQueue.try_receive(&message, sizeof(ipc::Request), recv_size, priority));
+			} catch (std::exception& ex) {
+				LOG(ERROR) << "Exception caught in ipc server receive loop: " << ex.what();
+			}
+		}
+		boost::interprocess::message_queue::remove(_this->_ipcQueueName.c_str());
+	} catch (std::exception& ex) {
+		LOG(ERROR) << "Exception caught in ipc server thread: " << ex.what();
+	}
+	_this->_ipcThreadRunning = false;
+	LOG(DEBUG) << "CServerDriver::_ipcThreadFunc: thread stopped";
+}
 
-						case ipc::RequestType::IPC_ClientDisconnect:
-							{
-								ipc::Reply reply(ipc::ReplyType::GenericReply);
-								reply.messageId = message.msg.ipc_ClientDisconnect.messageId;
-								auto i = _this->_ipcEndpoints.find(message.msg.ipc_ClientDisconnect.clientId);
-								if (i != _this->_ipcEndpoints.end()) {
-									reply.status = ipc::ReplyStatus::Ok;
-									auto msgQueue = i->second;
-									_this->_ipcEndpoints.erase(i);
-									LOG(INFO) << "Client disconnected: clientId " << message.msg.ipc_ClientDisconnect.clientId;
-									if (reply.messageId != 0) {
-										msgQueue->send(&reply, sizeof(ipc::Reply), 0);
-									}
-								} else {
-									LOG(ERROR) << "Error during client disconnect: unknown clientID " << message.msg.ipc_ClientDisconnect.clientId;
-								}
+// Data plane: Serves the client lanes (data requests from the message queue and data rings) round-robin,
+// and applies the pose table. Sleeps on the doorbell semaphore when there is nothing to do.
+void IpcShmCommunicator::_dataRingThreadFunc(IpcShmCommunicator* _this, CServerDriver * driver) {
+	_this->_dataRingThreadRunning = true;
+	LOG(DEBUG) << "CServerDriver::_dataRingThreadFunc: thread started";
+	struct LaneRef {
+		std::shared_ptr<DataLane> lane;
+		std::shared_ptr<ipc::ShmRing> ring;
+	};
+	std::vector<LaneRef> lanes;
+	uint32_t lanesVersion = 0;
+	PoseCoalescer poses;
+	while (!_this->_ipcThreadStopFlag) {
+		try {
+			if (lanesVersion != _this->_dataLanesVersion) {
+				std::lock_guard<std::mutex> lock(_this->_dataPlaneMutex);
+				lanes.clear();
+				for (auto& l : _this->_dataLanes) {
+					lanes.push_back({ l.second, l.second->closed ? nullptr : l.second->ring });
+				}
+				lanesVersion = _this->_dataLanesVersion;
+			}
+			bool idle = true;
+			// Deficit round-robin: Every round each lane may spend its quantum, the cost of a request is its frame size.
+			// A lane that runs dry loses its remaining deficit, so idle clients cannot save up for a burst.
+			for (auto& ref : lanes) {
+				auto& lane = *ref.lane;
+				lane.deficit += lane.quantum;
+				while (lane.deficit > 0) {
+					PlaneRequest entry;
+					bool queued = false;
+					bool closedAndEmpty = false;
+					{
+						std::lock_guard<std::mutex> lock(_this->_dataPlaneMutex);
+						if (!lane.requests.empty()) {
+							entry = lane.requests.front();
+							lane.requests.pop_front();
+							_this->_dataPlaneQueued--;
+							queued = true;
+						} else if (lane.closed) {
+							closedAndEmpty = true;
+							auto i = _this->_dataLanes.find(lane.clientId);
+							if (i != _this->_dataLanes.end() && i->second == ref.lane) {
+								_this->_dataLanes.erase(i);
+								_this->_dataLanesVersion++;
 							}
-							break;
-
-						case ipc::RequestType::IPC_Ping:
-							{
-								LOG(TRACE) << "Ping received: clientId " << message.msg.ipc_Ping.clientId << ", nonce " << message.msg.ipc_Ping.nonce;
-								auto i = _this->_ipcEndpoints.find(message.msg.ipc_Ping.clientId);
-								if (i != _this->_ipcEndpoints.end()) {
-									ipc::Reply reply(ipc::ReplyType::IPC_Ping);
-									reply.messageId = message.msg.ipc_Ping.messageId;
-									reply.status = ipc::ReplyStatus::Ok;
-									reply.msg.ipc_Ping.nonce = message.msg.ipc_Ping.nonce;
-									if (reply.messageId != 0) {
-										i->second->send(&reply, sizeof(ipc::Reply), 0);
-									}
-								} else {
-									LOG(ERROR) << "Error during ping: unknown clientID " << message.msg.ipc_ClientDisconnect.clientId;
-								}
+						}
+					}
+					if (queued) {
+						lane.deficit -= entry.request.frameSize();
+					} else {
+						uint32_t recv_size;
+						if (closedAndEmpty || !ref.ring || !ref.ring->pop(&entry.request, sizeof(ipc::Request), recv_size)) {
+							if (ref.ring && ref.ring->corrupted()) {
+								// Requests still in the message queue lane are handled, the ring is never read again
+								LOG(ERROR) << "Data ring of client " << lane.clientId << " is corrupted, closing it";
+								ref.ring = nullptr;
+								_this->_closeDataLane(lane.clientId);
 							}
+							lane.deficit = 0;
 							break;
+						}
+						lane.deficit -= recv_size;
+						if (!entry.request.isValidFrame(recv_size)) {
+							LOG(ERROR) << "Error in data ring receive loop: invalid frame (type " << (int)entry.request.type << ", length " << entry.request.length << ", received size " << recv_size << ")";
+							continue;
+						} else if (!_isDataRingRequest(entry.request.type)) {
+							LOG(ERROR) << "Error in data ring receive loop: Message type not allowed on data ring (" << (int)entry.request.type << ")";
+							continue;
+						}
+						entry.deviceKey = _requestDeviceKey(entry.request);
+						if (LatencyStats::isTraced(lane.clientId)) {
+							entry.enqueueTime = std::chrono::steady_clock::now();
+						}
+					}
+					idle = false;
+					if (_isCoalescablePose(entry.request) && entry.deviceKey >= 0 && entry.deviceKey < _deviceKeyAll) {
+						_this->_coalescePose(poses, entry, queued);
+					} else {
+						_this->_flushPoses(driver, poses);
+						_this->_handleDataPlaneRequest(driver, entry, queued);
+					}
+				}
+				_this->_flushPoses(driver, poses);
+			}
+			if (_this->_poseTable && _this->_applyPoseTable(driver)) {
+				idle = false;
+			}
+			if (idle) {
+				bool canSleep = true;
+				_this->_dataPlaneWaiting.store(1, std::memory_order_seq_cst);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				{
+					std::lock_guard<std::mutex> lock(_this->_dataPlaneMutex);
+					if (_this->_dataPlaneQueued > 0 || lanesVersion != _this->_dataLanesVersion) {
+						canSleep = false;
+					}
+				}
+				for (auto& ref : lanes) {
+					if (ref.ring && !ref.ring->prepareWait()) {
+						canSleep = false;
+					}
+				}
+				if (_this->_poseTable) {
+					_this->_poseTable->prepareWait();
+					if (_this->_applyPoseTable(driver)) {
+						canSleep = false;
+					}
+				}
+				if (canSleep) {
+					_this->_ipcDataDoorbell->wait();
+				}
+				_this->_dataPlaneWaiting.store(0, std::memory_order_relaxed);
+				for (auto& ref : lanes) {
+					if (ref.ring) {
+						ref.ring->cancelWait();
+					}
+				}
+				if (_this->_poseTable) {
+					_this->_poseTable->cancelWait();
+				}
+			}
+		} catch (std::exception& ex) {
+			LOG(ERROR) << "Exception caught in data ring thread: " << ex.what();
+		}
+	}
+	_this->_dataRingThreadRunning = false;
+	LOG(DEBUG) << "CServerDriver::_dataRingThreadFunc: thread stopped";
+}
 
-						case ipc::RequestType::OpenVR_ButtonEvent:
-							{
-								if (vr::VRServerDriverHost()) {
-									unsigned iterCount = min(message.msg.ipc_ButtonEvent.eventCount, REQUEST_OPENVR_BUTTONEVENT_MAXCOUNT);
-									for (unsigned i = 0; i < iterCount; ++i) {
-										auto& e = message.msg.ipc_ButtonEvent.events[i];
-										try {
-											driver->openvr_buttonEvent(e.deviceId, e.eventType, e.buttonId, e.timeOffset);
-										} catch (std::exception& e) {
-											LOG(ERROR) << "Error in ipc thread: " << e.what();
-										}
-									}
-								}
-							}
-							break;
+void IpcShmCommunicator::_controlThreadFunc(IpcShmCommunicator* _this, CServerDriver * driver) {
+	LOG(DEBUG) << "CServerDriver::_controlThreadFunc: thread started";
+	const auto statsInterval = std::chrono::seconds(60);
+	const auto reapInterval = std::chrono::seconds(1);
+	auto statsLastRequestCount = _this->_controlPlaneStats.requestCount.load() + _this->_dataPlaneStats.requestCount.load();
+	auto statsNextTime = std::chrono::steady_clock::now() + statsInterval;
+	auto reapNextTime = std::chrono::steady_clock::now() + reapInterval;
+	while (true) {
+		PlaneRequest entry;
+		{
+			std::unique_lock<std::mutex> lock(_this->_controlPlaneMutex);
+			_this->_controlPlaneCondition.wait_until(lock, statsNextTime < reapNextTime ? statsNextTime : reapNextTime, [_this]() {
+				return _this->_ipcThreadStopFlag || !_this->_controlPlaneQueue.empty();
+			});
+			if (_this->_ipcThreadStopFlag) {
+				break;
+			}
+			if (!_this->_controlPlaneQueue.empty()) {
+				entry = _this->_controlPlaneQueue.front();
+				_this->_controlPlaneQueue.pop_front();
+			}
+		}
+		if (std::chrono::steady_clock::now() >= statsNextTime) {
+			auto requestCount = _this->_controlPlaneStats.requestCount.load() + _this->_dataPlaneStats.requestCount.load();
+			if (requestCount != statsLastRequestCount) {
+				_this->_logPlaneStats();
+				statsLastRequestCount = requestCount;
+			}
+			statsNextTime = std::chrono::steady_clock::now() + statsInterval;
+		}
+		if (std::chrono::steady_clock::now() >= reapNextTime) {
+			_this->_reapEndpoints();
+			reapNextTime = std::chrono::steady_clock::now() + reapInterval;
+		}
+		if (entry.request.type == ipc::RequestType::None) {
+			continue;
+		}
+		_this->_controlPlaneStats.add(entry.enqueueTime);
+		// Let the data plane catch up with the requests for this device that arrived earlier. New data requests
+		// for the device are routed to the control plane meanwhile, so this does not wait for later ones.
+		if (entry.controlBarrier) {
+			auto dataPending = [_this, &entry]() {
+				return entry.deviceKey == _deviceKeyAll ? _this->_dataPendingTotal > 0
+					: (_this->_dataPending[entry.deviceKey] > 0 || _this->_dataPending[_deviceKeyAll] > 0);
+			};
+			if (dataPending()) {
+				std::unique_lock<std::mutex> lock(_this->_dataPendingMutex);
+				_this->_dataPendingWaiting = 1;
+				_this->_dataPendingCondition.wait(lock, [_this, &dataPending]() {
+					return _this->_ipcThreadStopFlag || !dataPending();
+				});
+				_this->_dataPendingWaiting = 0;
+			}
+		}
+		try {
+			LatencyScope latencyScope(entry.request.type, _requestClientId(entry.request), entry.request.timestamp, _timePointNs(entry.enqueueTime));
+			_handleRequest(_this, driver, entry.request, _timePointNs(entry.enqueueTime));
+		} catch (std::exception& ex) {
+			LOG(ERROR) << "Exception caught in control thread: " << ex.what();
+		}
+		if (entry.controlBarrier) {
+			_this->_controlPending[entry.deviceKey]--;
+			_this->_controlPendingTotal--;
+		}
+	}
+	LOG(DEBUG) << "CServerDriver::_controlThreadFunc: thread stopped";
+}
 
-						case ipc::RequestType::OpenVR_AxisEvent:
-							{
-								if (vr::VRServerDriverHost()) {
-									for (unsigned i = 0; i < message.msg.ipc_AxisEvent.eventCount; ++i) {
-										auto& e = message.msg.ipc_AxisEvent.events[i];
-										driver->openvr_axisEvent(e.deviceId, e.axisId, e.axisState);
-									}
-								}
-							}
-							break;
+// Returns the device a request refers to (see PlaneRequest::deviceKey)
+int IpcShmCommunicator::_requestDeviceKey(const ipc::Request& message) {
+	auto openvrKey = [](uint32_t deviceId) {
+		return deviceId < vr::k_unMaxTrackedDeviceCount ? (int)deviceId : _deviceKeyNone;
+	};
+	auto virtualKey = [](uint32_t deviceId) {
+		return deviceId < vr::k_unMaxTrackedDeviceCount ? (int)(vr::k_unMaxTrackedDeviceCount + deviceId) : _deviceKeyNone;
+	};
+	switch (message.type) {
+	case ipc::RequestType::OpenVR_PoseUpdate:
+		return openvrKey(message.msg.ipc_PoseUpdate.deviceId);
+	case ipc::RequestType::OpenVR_ButtonEvent:
+		{
+			int key = _deviceKeyNone;
+			unsigned count = message.msg.ipc_ButtonEvent.eventCount < REQUEST_OPENVR_BUTTONEVENT_MAXCOUNT ? message.msg.ipc_ButtonEvent.eventCount : REQUEST_OPENVR_BUTTONEVENT_MAXCOUNT;
+			for (unsigned i = 0; i < count; ++i) {
+				int k = openvrKey(message.msg.ipc_ButtonEvent.events[i].deviceId);
+				if (key != _deviceKeyNone && k != key) {
+					return _deviceKeyAll;
+				}
+				key = k;
+			}
+			return key;
+		}
+	case ipc::RequestType::OpenVR_AxisEvent:
+		{
+			int key = _deviceKeyNone;
+			unsigned count = message.msg.ipc_AxisEvent.eventCount < REQUEST_OPENVR_AXISEVENT_MAXCOUNT ? message.msg.ipc_AxisEvent.eventCount : REQUEST_OPENVR_AXISEVENT_MAXCOUNT;
+			for (unsigned i = 0; i < count; ++i) {
+				int k = openvrKey(message.msg.ipc_AxisEvent.events[i].deviceId);
+				if (key != _deviceKeyNone && k != key) {
+					return _deviceKeyAll;
+				}
+				key = k;
+			}
+			return key;
+		}
+	case ipc::RequestType::OpenVR_ProximitySensorEvent:
+		return openvrKey(message.msg.ovr_ProximitySensorEvent.deviceId);
+	case ipc::RequestType::OpenVR_VendorSpecificEvent:
+		return openvrKey(message.msg.ovr_VendorSpecificEvent.deviceId);
+	case ipc::RequestType::VirtualDevices_PublishDevice:
+	case ipc::RequestType::VirtualDevices_GetDeviceInfo:
+	case ipc::RequestType::VirtualDevices_GetDevicePose:
+	case ipc::RequestType::VirtualDevices_GetControllerState:
+		return virtualKey(message.msg.vd_GenericDeviceIdMessage.deviceId);
+	case ipc::RequestType::VirtualDevices_SetDeviceProperty:
+		return virtualKey(message.msg.vd_SetDeviceProperty.virtualDeviceId);
+	case ipc::RequestType::VirtualDevices_RemoveDeviceProperty:
+		return virtualKey(message.msg.vd_RemoveDeviceProperty.virtualDeviceId);
+	case ipc::RequestType::VirtualDevices_SetDevicePose:
+		return virtualKey(message.msg.vd_SetDevicePose.virtualDeviceId);
+	case ipc::RequestType::VirtualDevices_SetControllerState:
+		return virtualKey(message.msg.vd_SetControllerState.virtualDeviceId);
+	case ipc::RequestType::DeviceManipulation_GetDeviceInfo:
+	case ipc::RequestType::DeviceManipulation_GetDeviceOffsets:
+	case ipc::RequestType::DeviceManipulation_DefaultMode:
+	case ipc::RequestType::DeviceManipulation_FakeDisconnectedMode:
+		return openvrKey(message.msg.vd_GenericDeviceIdMessage.deviceId);
+	case ipc::RequestType::DeviceManipulation_ButtonMapping:
+		return openvrKey(message.msg.dm_ButtonMapping.deviceId);
+	case ipc::RequestType::DeviceManipulation_SetDeviceOffsets:
+		return openvrKey(message.msg.dm_DeviceOffsets.deviceId);
+	case ipc::RequestType::DeviceManipulation_MotionCompensationMode:
+		return openvrKey(message.msg.dm_MotionCompensationMode.deviceId);
+	case ipc::RequestType::DeviceManipulation_TriggerHapticPulse:
+		return openvrKey(message.msg.dm_triggerHapticPulse.deviceId);
+	// These change more than one device, and a ping reply should mean that everything sent before has been applied
+	case ipc::RequestType::IPC_Ping:
+	case ipc::RequestType::Batch:
+	case ipc::RequestType::DeviceManipulation_RedirectMode:
+	case ipc::RequestType::DeviceManipulation_SwapMode:
+	case ipc::RequestType::DeviceManipulation_SetMotionCompensationProperties:
+		return _deviceKeyAll;
+	default:
+		return _deviceKeyNone;
+	}
+}
 
-						case ipc::RequestType::OpenVR_PoseUpdate:
-							{
-								if (vr::VRServerDriverHost()) {
-									driver->openvr_poseUpdate(message.msg.ipc_PoseUpdate.deviceId, message.msg.ipc_PoseUpdate.pose, message.timestamp);
-								}
-							}
-							break;
+// Returns the client a request belongs to (0 when unknown)
+uint32_t IpcShmCommunicator::_requestClientId(const ipc::Request& message) {
+	switch (message.type) {
+	case ipc::RequestType::None:
+	case ipc::RequestType::IPC_ClientConnect:
+	case ipc::RequestType::IPC_Wakeup:
+		return 0;
+	default:
+		// All other payloads start with the client id, which the union members share as common initial sequence
+		return message.msg.vd_GenericClientMessage.clientId;
+	}
+}
 
-						case ipc::RequestType::OpenVR_ProximitySensorEvent:
-							{
-								driver->openvr_proximityEvent(message.msg.ipc_PoseUpdate.deviceId, message.msg.ovr_ProximitySensorEvent.sensorTriggered);
-							}
-							break;
+int64_t IpcShmCommunicator::_timePointNs(const std::chrono::steady_clock::time_point& time) {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+}
 
-						case ipc::RequestType::OpenVR_VendorSpecificEvent:
-							{
-								driver->openvr_vendorSpecificEvent(message.msg.ovr_VendorSpecificEvent.deviceId, message.msg.ovr_VendorSpecificEvent.eventType,
-									message.msg.ovr_VendorSpecificEvent.eventData, message.msg.ovr_VendorSpecificEvent.timeOffset);
-							}
-							break;
+// Called by the ipc thread for every request taken from the message queue
+void IpcShmCommunicator::_dispatchRequest(const ipc::Request& message) {
+	PlaneRequest entry;
+	entry.request = message;
+	entry.enqueueTime = std::chrono::steady_clock::now();
+	entry.deviceKey = _requestDeviceKey(message);
+	// Without doorbell there is no data ring thread, the control plane then handles everything
+	bool dataPlane = _ipcDataDoorbell && _isDataRingRequest(message.type) && entry.deviceKey != _deviceKeyNone;
+	if (dataPlane && _controlPendingTotal > 0) {
+		if (entry.deviceKey == _deviceKeyAll || _controlPending[entry.deviceKey] > 0 || _controlPending[_deviceKeyAll] > 0) {
+			dataPlane = false; // must not overtake the pending control requests
+		}
+	}
+	if (dataPlane) {
+		_dataPending[entry.deviceKey]++;
+		_dataPendingTotal++;
+		auto clientId = _requestClientId(message);
+		bool rejected = false;
+		{
+			std::lock_guard<std::mutex> lock(_dataPlaneMutex);
+			auto i = _dataLanes.find(clientId);
+			if (i == _dataLanes.end() || i->second->closed) {
+				i = _dataLanes.find(0);
+			}
+			auto& lane = *i->second;
+			if (lane.requests.size() >= _maxPlaneQueueSize) {
+				// Only happens when a client floods the message queue. This thread receives for all clients, so
+				// instead of waiting for the lane to drain the lane's oldest pose nobody waits for makes room.
+				auto pose = std::find_if(lane.requests.begin(), lane.requests.end(), [](const PlaneRequest& queued) {
+					return _isCoalescablePose(queued.request);
+				});
+				if (pose != lane.requests.end()) {
+					_releaseDataPending(pose->deviceKey);
+					lane.requests.erase(pose);
+					_dataPlaneQueued--;
+				} else {
+					rejected = true;
+				}
+				_laneRequestsDropped++;
+			}
+			if (!rejected) {
+				lane.requests.push_back(entry);
+				_dataPlaneQueued++;
+			}
+		}
+		if (rejected) {
+			_releaseDataPending(entry.deviceKey);
+			_rejectRequest(message);
+			return;
+		}
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (_dataPlaneWaiting.load(std::memory_order_relaxed) && _dataPlaneWaiting.exchange(0)) {
+			_ringDataDoorbell();
+		}
+	} else {
+		if (entry.deviceKey != _deviceKeyNone) {
+			entry.controlBarrier = true;
+			_controlPending[entry.deviceKey]++;
+			_controlPendingTotal++;
+		}
+		bool rejected = false;
+		{
+			std::lock_guard<std::mutex> lock(_controlPlaneMutex);
+			// This thread receives for all clients and must not wait for the control plane. Connects and disconnects
+			// are rare and can't be answered with a rejection, so they are always queued.
+			if (_controlPlaneQueue.size() >= _maxPlaneQueueSize && message.type != ipc::RequestType::IPC_ClientConnect
+					&& message.type != ipc::RequestType::IPC_ClientDisconnect) {
+				rejected = true;
+			} else {
+				_controlPlaneQueue.push_back(entry);
+			}
+		}
+		if (rejected) {
+			if (entry.controlBarrier) {
+				_controlPending[entry.deviceKey]--;
+				_controlPendingTotal--;
+			}
+			_controlRequestsRejected++;
+			_rejectRequest(message);
+			return;
+		}
+		_controlPlaneCondition.notify_one();
+	}
+}
 
-						case ipc::RequestType::VirtualDevices_GetDeviceCount:
-							{
-								auto i = _this->_ipcEndpoints.find(message.msg.vd_GenericClientMessage.clientId);
-								if (i != _this->_ipcEndpoints.end()) {
-									ipc::Reply resp(ipc::ReplyType::VirtualDevices_GetDeviceCount);
-									resp.messageId = message.msg.vd_GenericClientMessage.messageId;
-									resp.status = ipc::ReplyStatus::Ok;
-									resp.msg.vd_GetDeviceCount.deviceCount = driver->virtualDevices_getDeviceCount();
-									i->second->send(&resp, sizeof(ipc::Reply), 0);
-								} else {
-									LOG(ERROR) << "Error while getting virtual device count: Unknown clientId " << message.msg.vd_AddDevice.clientId;
-								}
+// Tells the sender of a request that did not fit into its lane or the control plane queue, if it waits for a reply
+void IpcShmCommunicator::_rejectRequest(const ipc::Request& message) {
+	uint32_t messageId = 0;
+	auto replyType = ipc::ReplyType::GenericReply;
+	switch (message.type) {
+	case ipc::RequestType::IPC_Ping:
+		messageId = message.msg.ipc_Ping.messageId;
+		replyType = ipc::ReplyType::IPC_Ping;
+		break;
+	case ipc::RequestType::Batch:
+		{
+			// The parts that are still to come are dropped as well (see _handleBatch())
+			std::lock_guard<std::mutex> lock(_pendingBatchesMutex);
+			auto key = std::make_pair(message.msg.batch.clientId, message.msg.batch.batchId);
+			_pendingBatches.erase(key);
+			_rejectedBatches.insert(key);
+		}
+		messageId = message.msg.batch.lastPart ? message.msg.batch.messageId : 0;
+		break;
+	case ipc::RequestType::None:
+	case ipc::RequestType::IPC_ClientConnect:
+	case ipc::RequestType::IPC_Wakeup:
+	case ipc::RequestType::OpenVR_PoseUpdate:
+	case ipc::RequestType::OpenVR_ButtonEvent:
+	case ipc::RequestType::OpenVR_AxisEvent:
+	case ipc::RequestType::OpenVR_ProximitySensorEvent:
+	case ipc::RequestType::OpenVR_VendorSpecificEvent:
+		break; // no message id
+	default:
+		// All other payloads start with the client id and the message id, see _requestClientId()
+		messageId = message.msg.vd_GenericClientMessage.messageId;
+		break;
+	}
+	if (messageId != 0) {
+		auto replyQueue = _getReplyQueue(_requestClientId(message));
+		if (replyQueue) {
+			ipc::Reply reply(replyType);
+			reply.messageId = messageId;
+			reply.status = ipc::ReplyStatus::QueueFull;
+			replyQueue->send(&reply, reply.frameSize(), 0);
+		}
+	}
+}
 
-							}
-							break;
+// queued: request comes from the message queue (and not from a data ring)
+void IpcShmCommunicator::_handleDataPlaneRequest(CServerDriver* driver, PlaneRequest& entry, bool queued) {
+	if (queued) {
+		_dataPlaneStats.add(entry.enqueueTime);
+	}
+	try {
+		LatencyScope latencyScope(entry.request.type, _requestClientId(entry.request), entry.request.timestamp, _timePointNs(entry.enqueueTime));
+		_handleRequest(this, driver, entry.request, _timePointNs(entry.enqueueTime));
+	} catch (std::exception& ex) {
+		LOG(ERROR) << "Exception caught in data plane: " << ex.what();
+	}
+	if (queued) {
+		_releaseDataPending(entry.deviceKey);
+	}
+}
 
-						case ipc::RequestType::VirtualDevices_GetDeviceInfo:
-							{
-								auto i = _this->_ipcEndpoints.find(message.msg.vd_GenericDeviceIdMessage.clientId);
-								if (i != _this->_ipcEndpoints.end()) {
-									ipc::Reply resp(ipc::ReplyType::VirtualDevices_GetDeviceInfo);
-									resp.messageId = message.msg.vd_GenericDeviceIdMessage.messageId;
-									if (message.msg.vd_GenericDeviceIdMessage.deviceId >= vr::k_unMaxTrackedDeviceCount) {
-										resp.status = ipc::ReplyStatus::InvalidId;
-									} else {
-										auto d = driver->virtualDevices_getDevice(message.msg.vd_GenericDeviceIdMessage.deviceId);
-										if (!d) {
-											resp.status = ipc::ReplyStatus::NotFound;
-										} else {
-											resp.msg.vd_GetDeviceInfo.virtualDeviceId = message.msg.vd_GenericDeviceIdMessage.deviceId;
-											resp.msg.vd_GetDeviceInfo.openvrDeviceId = d->openvrDeviceId();
-											resp.msg.vd_GetDeviceInfo.deviceType = d->deviceType();
-											strncpy_s(resp.msg.vd_GetDeviceInfo.deviceSerial, d->serialNumber().c_str(), 127);
-											resp.msg.vd_GetDeviceInfo.deviceSerial[127] = '\0';
-											resp.status = ipc::ReplyStatus::Ok;
-										}
-									}
-									i->second->send(&resp, sizeof(ipc::Reply), 0);
-								} else {
-									LOG(ERROR) << "Error while getting virtual device info: Unknown clientId " << message.msg.vd_AddDevice.clientId;
-								}
+// Called when a data request from the message queue is done (or dropped), wakes up a control request waiting for it
+void IpcShmCommunicator::_releaseDataPending(int deviceKey) {
+	_dataPending[deviceKey]--;
+	_dataPendingTotal--;
+	if (_dataPendingWaiting.load()) {
+		{
+			std::lock_guard<std::mutex> lock(_dataPendingMutex);
+		}
+		_dataPendingCondition.notify_one();
+	}
+}
 
-							}
-							break;
+// Pose updates nobody waits for. Modal requests need their reply, so they are never skipped.
+bool IpcShmCommunicator::_isCoalescablePose(const ipc::Request& message) {
+	switch (message.type) {
+	case ipc::RequestType::OpenVR_PoseUpdate:
+		return true;
+	case ipc::RequestType::VirtualDevices_SetDevicePose:
+		return message.msg.vd_SetDevicePose.messageId == 0;
+	default:
+		return false;
+	}
+}
 
-						case ipc::RequestType::VirtualDevices_GetDevicePose:
-							{
-								auto i = _this->_ipcEndpoints.find(message.msg.vd_GenericDeviceIdMessage.clientId);
-								if (i != _this->_ipcEndpoints.end()) {
-									ipc::Reply resp(ipc::ReplyType::VirtualDevices_GetDevicePose);
-									resp.messageId = message.msg.vd_GenericDeviceIdMessage.messageId;
-									if (message.msg.vd_GenericDeviceIdMessage.deviceId >= vr::k_unMaxTrackedDeviceCount) {
-										resp.status = ipc::ReplyStatus::InvalidId;
-									} else {
-										auto d = driver->virtualDevices_getDevice(message.msg.vd_GenericDeviceIdMessage.deviceId);
-										if (!d) {
-											resp.status = ipc::ReplyStatus::NotFound;
-										} else {
-											resp.msg.vd_GetDevicePose.pose = d->GetPose();
-											resp.status = ipc::ReplyStatus::Ok;
-										}
-									}
-									i->second->send(&resp, sizeof(ipc::Reply), 0);
-								} else {
-									LOG(ERROR) << "Error while getting virtual device pose: Unknown clientId " << message.msg.vd_AddDevice.clientId;
-								}
-							}
-							break;
+// When a client falls behind, its lane contains a backlog of poses. Instead of forwarding every one of them to
+// vrserver, only the newest pose per device is applied when the poses are flushed. Any other request flushes the
+// collected poses first, so button and axis events keep their order relative to the poses and to each other.
+void IpcShmCommunicator::_coalescePose(PoseCoalescer& poses, PlaneRequest& entry, bool queued) {
+	auto& slot = poses.slots[entry.deviceKey];
+	if (slot.used) {
+		if (slot.queued) {
+			_dataPlaneStats.add(slot.entry.enqueueTime);
+			_releaseDataPending(slot.entry.deviceKey);
+		}
+		_posesCoalesced++;
+	} else {
+		slot.used = true;
+		poses.order.push_back(entry.deviceKey);
+	}
+	slot.entry = entry;
+	slot.queued = queued;
+}
 
-						case ipc::RequestType::VirtualDevices_GetControllerState:
-							{
-								auto i = _this->_ipcEndpoints.find(message.msg.vd_GenericDeviceIdMessage.clientId);
-								if (i != _this->_ipcEndpoints.end()) {
-									ipc::Reply resp(ipc::ReplyType::VirtualDevices_GetControllerState);
-									resp.messageId = message.msg.vd_GenericDeviceIdMessage.messageId;
-									if (message.msg.vd_GenericDeviceIdMessage.deviceId >= vr::k_unMaxTrackedDeviceCount) {
-										resp.status = ipc::ReplyStatus::InvalidId;
-									} else {
-										auto d = driver->virtualDevices_getDevice(message.msg.vd_GenericDeviceIdMessage.deviceId);
-										if (!d) {
-											resp.status = ipc::ReplyStatus::NotFound;
-										} else {
-											auto c = (vr::IVRControllerComponent*)d->GetComponent(vr::IVRControllerComponent_Version);
-											if (c) {
-												resp.msg.vd_GetControllerState.controllerState = c->GetControllerState();
-												resp.status = ipc::ReplyStatus::Ok;
-											} else {
-												resp.status = ipc::ReplyStatus::InvalidType;
-											}
-										}
-									}
-									i->second->send(&resp, sizeof(ipc::Reply), 0);
-								} else {
-									LOG(ERROR) << "Error while getting virtual controller state: Unknown clientId " << message.msg.vd_AddDevice.clientId;
-								}
+void IpcShmCommunicator::_flushPoses(CServerDriver* driver, PoseCoalescer& poses) {
+	for (auto key : poses.order) {
+		auto& slot = poses.slots[key];
+		_handleDataPlaneRequest(driver, slot.entry, slot.queued);
+		slot.used = false;
+	}
+	poses.order.clear();
+}
 
-							}
-							break;
+void IpcShmCommunicator::_openDataLane(uint32_t clientId, std::shared_ptr<ipc::ShmRing> ring, uint32_t weight) {
+	if (weight == 0) {
+		weight = 1;
+	} else if (weight > _dataLaneMaxWeight) {
+		weight = _dataLaneMaxWeight;
+	}
+	auto lane = std::make_shared<DataLane>();
+	lane->clientId = clientId;
+	lane->quantum = weight * _dataLaneQuantum;
+	lane->ring = ring;
+	{
+		std::lock_guard<std::mutex> lock(_dataPlaneMutex);
+		_dataLanes[clientId] = lane;
+		_dataLanesVersion++;
+	}
+	_ringDataDoorbell(); // let the data ring thread pick up the new lane
+}
 
-						case ipc::RequestType::VirtualDevices_AddDevice:
-							{
-								auto i = _this->_ipcEndpoints.find(message.msg.vd_AddDevice.clientId);
-								if (i != _this->_ipcEndpoints.end()) {
-									auto result = driver->virtualDevices_addDevice(message.msg.vd_AddDevice.deviceType, message.msg.vd_AddDevice.deviceSerial);
-									ipc::Reply resp(ipc::ReplyType::VirtualDevices_AddDevice);
-									resp.messageId = message.msg.vd_AddDevice.messageId;
-									if (result >= 0) {
-										resp.status = ipc::ReplyStatus::Ok;
-										resp.msg.vd_AddDevice.virtualDeviceId = (uint32_t)result;
-									} else if (result == -1) {
-										resp.status = ipc::ReplyStatus::TooManyDevices;
-									} else if (result == -2) {
-										resp.status = ipc::ReplyStatus::AlreadyInUse;
-										auto d = driver->virtualDevices_findDevice(message.msg.vd_AddDevice.deviceSerial);
-										resp.msg.vd_AddDevice.virtualDeviceId = d->virtualDeviceId();
-									} else if (result == -3) {
-										resp.status = ipc::ReplyStatus::InvalidType;
-									} else {
-										resp.status = ipc::ReplyStatus::UnknownError;
-									}
-									if (resp.status != ipc::ReplyStatus::Ok) {
-										LOG(ERROR) << "Error while adding virtual device: Error code " << (int)resp.status;
-									}
-									if (resp.messageId != 0) {
-										i->second->send(&resp, sizeof(ipc::Reply), 0);
-									}
-								} else {
-									LOG(ERROR) << "Error while adding virtual device: Unknown clientId " << message.msg.vd_AddDevice.clientId;
-								}
-							}
-							break;
+// The lane is removed by the data ring thread once its queued requests are handled
+void IpcShmCommunicator::_closeDataLane(uint32_t clientId) {
+	{
+		std::lock_guard<std::mutex> lock(_dataPlaneMutex);
+		auto i = _dataLanes.find(clientId);
+		if (i == _dataLanes.end()) {
+			return;
+		}
+		i->second->closed = true;
+		_dataLanesVersion++;
+	}
+	_ringDataDoorbell();
+}
 
-						case ipc::RequestType::VirtualDevices_PublishDevice:
-							{
-								auto result = driver->virtualDevices_publishDevice(message.msg.vd_GenericDeviceIdMessage.deviceId);
-								ipc::Reply resp(ipc::ReplyType::GenericReply);
-								resp.messageId = message.msg.vd_GenericDeviceIdMessage.messageId;
-								if (result >= 0) {
-									resp.status = ipc::ReplyStatus::Ok;
-								} else if (result == -1) {
-									resp.status = ipc::ReplyStatus::InvalidId;
-								} else if (result == -2) {
-									resp.status = ipc::ReplyStatus::NotFound;
-								} else if (result == -3) {
-									resp.status = ipc::ReplyStatus::Ok; // It's already published, let's regard this as "Ok"
-								} else if (result == -4) {
-									resp.status = ipc::ReplyStatus::MissingProperty;
-								} else {
-									resp.status = ipc::ReplyStatus::UnknownError;
-								}
-								if (resp.status != ipc::ReplyStatus::Ok) {
-									LOG(ERROR) << "Error while publishing virtual device: Error code " << (int)resp.status;
-								}
-								if (resp.messageId != 0) {
-									auto i = _this->_ipcEndpoints.find(message.msg.vd_GenericDeviceIdMessage.clientId);
-									if (i != _this->_ipcEndpoints.end()) {
-										i->second->send(&resp, sizeof(ipc::Reply), 0);
-									} else {
-										LOG(ERROR) << "Error while publishing virtual device: Unknown clientId " << message.msg.vd_GenericDeviceIdMessage.clientId;
-									}
-								}
-							}
-							break;
+void IpcShmCommunicator::PlaneStats::add(const std::chrono::steady_clock::time_point& enqueueTime) {
+	uint64_t delay = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - enqueueTime).count();
+	requestCount++;
+	totalDelayUs += delay;
+	auto currentMax = maxDelayUs.load(std::memory_order_relaxed);
+	while (delay > currentMax && !maxDelayUs.compare_exchange_weak(currentMax, delay, std::memory_order_relaxed));
+}
 
-						case ipc::RequestType::VirtualDevices_SetDeviceProperty:
-							{
-								ipc::Reply resp(ipc::ReplyType::GenericReply);
-								resp.messageId = message.msg.vd_SetDeviceProperty.messageId;
-								if (message.msg.vd_SetDeviceProperty.virtualDeviceId >= driver->virtualDevices_getDeviceCount()) {
-									resp.status = ipc::ReplyStatus::InvalidId;
-								} else {
-									auto device = driver->virtualDevices_getDevice(message.msg.vd_SetDeviceProperty.virtualDeviceId);
-									if (!device) {
-										resp.status = ipc::ReplyStatus::NotFound;
-									} else {
-										resp.status = ipc::ReplyStatus::Ok;
-										switch (message.msg.vd_SetDeviceProperty.valueType) {
-										case DevicePropertyValueType::BOOL:
-											LOG(TRACE) << "CTrackedDeviceDriver[" << device->serialNumber() << "]::setTrackedDeviceProperty("
-												<< message.msg.vd_SetDeviceProperty.deviceProperty << ", " << message.msg.vd_SetDeviceProperty.value.boolValue << ")";
-											device->setTrackedDeviceProperty(message.msg.vd_SetDeviceProperty.deviceProperty, message.msg.vd_SetDeviceProperty.value.boolValue);
-											break;
-										case DevicePropertyValueType::FLOAT:
-											LOG(TRACE) << "CTrackedDeviceDriver[" << device->serialNumber() << "]::setTrackedDeviceProperty("
-												<< message.msg.vd_SetDeviceProperty.deviceProperty << ", " << message.msg.vd_SetDeviceProperty.value.floatValue << ")";
-											device->setTrackedDeviceProperty(message.msg.vd_SetDeviceProperty.deviceProperty, message.msg.vd_SetDeviceProperty.value.floatValue);
-											break;
-										case DevicePropertyValueType::INT32:
-											LOG(TRACE) << "CTrackedDeviceDriver[" << device->serialNumber() << "]::setTrackedDeviceProperty("
-												<< message.msg.vd_SetDeviceProperty.deviceProperty << ", " << message.msg.vd_SetDeviceProperty.value.int32Value << ")";
-											device->setTrackedDeviceProperty(message.msg.vd_SetDeviceProperty.deviceProperty, message.msg.vd_SetDeviceProperty.value.int32Value);
-											break;
-										case DevicePropertyValueType::MATRIX34:
-											LOG(TRACE) << "CTrackedDeviceDriver[" << device->serialNumber() << "]::setTrackedDeviceProperty("
-												<< message.msg.vd_SetDeviceProperty.deviceProperty << ", <matrix34> )";
-											device->setTrackedDeviceProperty(message.msg.vd_SetDeviceProperty.deviceProperty, message.msg.vd_SetDeviceProperty.value.matrix34Value);
-											break;
-										case DevicePropertyValueType::MATRIX44:
-											LOG(TRACE) << "CTrackedDeviceDriver[" << device->serialNumber() << "]::setTrackedDeviceProperty("
-												<< message.msg.vd_SetDeviceProperty.deviceProperty << ", <matrix44> )";
-											device->setTrackedDeviceProperty(message.msg.vd_SetDeviceProperty.deviceProperty, message.msg.vd_SetDeviceProperty.value.matrix44Value);
-											break;
-										case DevicePropertyValueType::VECTOR3:
-											LOG(TRACE) << "CTrackedDeviceDriver[" << device->serialNumber() << "]::setTrackedDeviceProperty("
-												<< message.msg.vd_SetDeviceProperty.deviceProperty << ", <vector3> )";
-											device->setTrackedDeviceProperty(message.msg.vd_SetDeviceProperty.deviceProperty, message.msg.vd_SetDeviceProperty.value.vector3Value);
-											break;
-										case DevicePropertyValueType::VECTOR4:
-											LOG(TRACE) << "CTrackedDeviceDriver[" << device->serialNumber() << "]::setTrackedDeviceProperty("
-												<< message.msg.vd_SetDeviceProperty.deviceProperty << ", <vector4> )";
-											device->setTrackedDeviceProperty(message.msg.vd_SetDeviceProperty.deviceProperty, message.msg.vd_SetDeviceProperty.value.vector4Value);
-											break;
-										case DevicePropertyValueType::STRING:
-											LOG(TRACE) << "CTrackedDeviceDriver[" << device->serialNumber() << "]::setTrackedDeviceProperty("
-												<< message.msg.vd_SetDeviceProperty.deviceProperty << ", " << message.msg.vd_SetDeviceProperty.value.stringValue << ")";
-											device->setTrackedDeviceProperty(message.msg.vd_SetDeviceProperty.deviceProperty, std::string(message.msg.vd_SetDeviceProperty.value.stringValue));
-											break;
-										case DevicePropertyValueType::UINT64:
-											LOG(TRACE) << "CTrackedDeviceDriver[" << device->serialNumber() << "]::setTrackedDeviceProperty("
-												<< message.msg.vd_SetDeviceProperty.deviceProperty << ", " << message.msg.vd_SetDeviceProperty.value.uint64Value << ")";
-											device->setTrackedDeviceProperty(message.msg.vd_SetDeviceProperty.deviceProperty, message.msg.vd_SetDeviceProperty.value.uint64Value);
-											break;
-										default:
-											resp.status = ipc::ReplyStatus::InvalidType;
-											break;
-										}
-									}
-								}
-								if (resp.status != ipc::ReplyStatus::Ok) {
-									LOG(ERROR) << "Error while setting device property: Error code " << (int)resp.status;
-								}
-								if (resp.messageId != 0) {
-									auto i = _this->_ipcEndpoints.find(message.msg.vd_SetDeviceProperty.clientId);
-									if (i != _this->_ipcEndpoints.end()) {
-										i->second->send(&resp, sizeof(ipc::Reply), 0);
-									} else {
-										LOG(ERROR) << "Error while setting device property: Unknown clientId " << message.msg.vd_SetDeviceProperty.clientId;
-									}
-								}
-							}
-							break;
+void IpcShmCommunicator::_logPlaneStats() {
+	auto logPlane = [](const char* name, PlaneStats& stats) {
+		uint64_t count = stats.requestCount;
+		LOG(INFO) << "IPC " << name << " plane: " << count << " requests, queueing delay avg "
+			<< (count ? stats.totalDelayUs / count : 0) << " us, max " << stats.maxDelayUs << " us";
+	};
+	logPlane("data", _dataPlaneStats);
+	logPlane("control", _controlPlaneStats);
+	LOG(INFO) << "IPC data plane: " << _posesCoalesced << " pose updates coalesced, " << _laneRequestsDropped << " requests dropped from full lanes";
+	LOG(INFO) << "IPC control plane: " << _controlRequestsRejected << " requests rejected by the full queue";
+}
 
-						case ipc::RequestType::VirtualDevices_RemoveDeviceProperty:
-							{
-								ipc::Reply resp(ipc::ReplyType::GenericReply);
-								resp.messageId = message.msg.vd_RemoveDeviceProperty.messageId;
-								if (message.msg.vd_RemoveDeviceProperty.virtualDeviceId >= driver->virtualDevices_getDeviceCount()) {
-									resp.status = ipc::ReplyStatus::InvalidId;
-								} else {
-									auto device = driver->virtualDevices_getDevice(message.msg.vd_RemoveDeviceProperty.virtualDeviceId);
-									if (!device) {
-										resp.status = ipc::ReplyStatus::NotFound;
-									} else {
-										LOG(TRACE) << "CTrackedDeviceDriver[" << device->serialNumber() << "]::removeTrackedDeviceProperty("
-											<< message.msg.vd_RemoveDeviceProperty.deviceProperty << ")";
-										device->removeTrackedDeviceProperty(message.msg.vd_RemoveDeviceProperty.deviceProperty);
-										resp.status = ipc::ReplyStatus::Ok;
-									}
-								}
-								if (resp.status != ipc::ReplyStatus::Ok) {
-									LOG(ERROR) << "Error while removing device property: Error code " << (int)resp.status;
-								}
-								if (resp.messageId != 0) {
-									auto i = _this->_ipcEndpoints.find(message.msg.vd_RemoveDeviceProperty.clientId);
-									if (i != _this->_ipcEndpoints.end()) {
-										i->second->send(&resp, sizeof(ipc::Reply), 0);
-									} else {
-										LOG(ERROR) << "Error while removing device property: Unknown clientId " << message.msg.vd_RemoveDeviceProperty.clientId;
-									}
-								}
-							}
-							break;
+// dequeueNs: when the request was taken from the transport (for latency tracing)
+void IpcShmCommunicator::_handleRequest(IpcShmCommunicator* _this, CServerDriver* driver, ipc::Request& message, int64_t dequeueNs) {
+	switch (message.type) {
 
-						case ipc::RequestType::VirtualDevices_SetDevicePose:
-							{
-								ipc::Reply resp(ipc::ReplyType::GenericReply);
-								resp.messageId = message.msg.vd_SetDevicePose.messageId;
-								if (message.msg.vd_SetDevicePose.virtualDeviceId >= driver->virtualDevices_getDeviceCount()) {
-									resp.status = ipc::ReplyStatus::InvalidId;
-								} else {
-									auto device = driver->virtualDevices_getDevice(message.msg.vd_SetDevicePose.virtualDeviceId);
-									if (!device) {
-										resp.status = ipc::ReplyStatus::NotFound;
-									} else {
-										auto now = std::chrono::duration_cast <std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-										auto diff = 0.0;
-										if (message.timestamp < now) {
-											diff = ((double)now - message.timestamp) / 1000.0;
-										}
-										device->updatePose(message.msg.vd_SetDevicePose.pose, -diff);
-										resp.status = ipc::ReplyStatus::Ok;
-									}
-								}
-								if (resp.status != ipc::ReplyStatus::Ok) {
-									LOG(ERROR) << "Error while updating device pose: Error code " << (int)resp.status;
-								}
-								if (resp.messageId != 0) {
-									auto i = _this->_ipcEndpoints.find(message.msg.vd_SetDevicePose.clientId);
-									if (i != _this->_ipcEndpoints.end()) {
-										i->second->send(&resp, sizeof(ipc::Reply), 0);
-									} else {
-										LOG(ERROR) << "Error while updating device pose: Unknown clientId " << message.msg.vd_SetDevicePose.clientId;
-									}
-								}
-							}
-							break;
+	case ipc::RequestType::IPC_ClientConnect:
+		{
+			try {
+				message.msg.ipc_ClientConnect.queueName[127] = '\0';
+				message.msg.ipc_ClientConnect.dataRingName[127] = '\0';
+				auto queue = std::make_shared<ReplyQueue>(message.msg.ipc_ClientConnect.queueName, message.msg.ipc_ClientConnect.replyOverflowPolicy);
+				ipc::Reply reply(ipc::ReplyType::IPC_ClientConnect);
+				reply.messageId = message.msg.ipc_ClientConnect.messageId;
+				reply.msg.ipc_ClientConnect.ipcProcotolVersion = IPC_PROTOCOL_VERSION;
+				reply.msg.ipc_ClientConnect.dataRingEnabled = false;
+				if (message.msg.ipc_ClientConnect.ipcProcotolVersion == IPC_PROTOCOL_VERSION) {
+					IpcEndpoint endpoint;
+					endpoint.replyQueue = queue;
+					if (message.msg.ipc_ClientConnect.processId != 0) {
+						auto process = OpenProcess(SYNCHRONIZE, FALSE, message.msg.ipc_ClientConnect.processId);
+						if (process) {
+							endpoint.process.reset(process, CloseHandle);
+						} else {
+							LOG(WARNING) << "Could not open process " << message.msg.ipc_ClientConnect.processId << " of new client, dead client detection is disabled";
+						}
+					}
+					std::shared_ptr<ipc::ShmRing> dataRing;
+					if (message.msg.ipc_ClientConnect.dataRingName[0] != '\0' && _this->_ipcDataDoorbell) {
+						try {
+							dataRing = std::make_shared<ipc::ShmRing>(boost::interprocess::open_only, message.msg.ipc_ClientConnect.dataRingName, (uint32_t)sizeof(ipc::Request));
+							reply.msg.ipc_ClientConnect.dataRingEnabled = true;
+						} catch (std::exception& e) {
+							LOG(ERROR) << "Could not open data ring \"" << message.msg.ipc_ClientConnect.dataRingName << "\": " << e.what();
+						}
+					}
+					uint32_t clientId;
+					{
+						std::lock_guard<std::mutex> lock(_this->_ipcEndpointsMutex);
+						clientId = _this->_ipcClientIdNext++;
+						_this->_ipcEndpoints.insert({ clientId, endpoint });
+					}
+					if (_this->_ipcDataDoorbell) {
+						_this->_openDataLane(clientId, dataRing, message.msg.ipc_ClientConnect.dataLaneWeight);
+					}
+					reply.msg.ipc_ClientConnect.clientId = clientId;
+					reply.status = ipc::ReplyStatus::Ok;
+					LOG(INFO) << "New client connected: endpoint \"" << message.msg.ipc_ClientConnect.queueName << "\", cliendId " << clientId
+						<< ", reply overflow policy " << (int)queue->policy << ", data lane weight " << message.msg.ipc_ClientConnect.dataLaneWeight
+						<< (dataRing ? ", data ring enabled" : "");
+				} else {
+					reply.msg.ipc_ClientConnect.clientId = 0;
+					reply.status = ipc::ReplyStatus::InvalidVersion;
+					LOG(INFO) << "Client (endpoint \"" << message.msg.ipc_ClientConnect.queueName << "\") reports incompatible ipc version "
+						<< message.msg.ipc_ClientConnect.ipcProcotolVersion;
+				}
+				queue->send(&reply, reply.frameSize(), 0);
+			} catch (std::exception& e) {
+				LOG(ERROR) << "Error during client connect: " << e.what();
+			}
+		}
+		break;
 
-						case ipc::RequestType::VirtualDevices_SetControllerState:
-							{
-								ipc::Reply resp(ipc::ReplyType::GenericReply);
-								resp.messageId = message.msg.vd_SetControllerState.messageId;
-								if (message.msg.vd_SetControllerState.virtualDeviceId >= driver->virtualDevices_getDeviceCount()) {
-									resp.status = ipc::ReplyStatus::InvalidId;
-								} else {
-									auto device = driver->virtualDevices_getDevice(message.msg.vd_SetControllerState.virtualDeviceId);
-									if (!device) {
-										resp.status = ipc::ReplyStatus::NotFound;
-									} else {
-										resp.status = ipc::ReplyStatus::Ok;
-										if (device->deviceType() == VirtualDeviceType::TrackedController) {
-											auto controller = (CTrackedControllerDriver*)device;
-											auto now = std::chrono::duration_cast <std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-											auto diff = 0.0;
-											if (message.timestamp < now) {
-												diff = ((double)now - message.timestamp) / 1000.0;
-											}
-											controller->updateControllerState(message.msg.vd_SetControllerState.controllerState, -diff);
-										} else {
-											resp.status = ipc::ReplyStatus::InvalidType;
-										}
-									}
-								}
-								if (resp.status != ipc::ReplyStatus::Ok) {
-									LOG(ERROR) << "Error while updating controller state: Error code " << (int)resp.status;
-								}
-								if (resp.messageId != 0) {
-									auto i = _this->_ipcEndpoints.find(message.msg.vd_SetControllerState.clientId);
-									if (i != _this->_ipcEndpoints.end()) {
-										i->second->send(&resp, sizeof(ipc::Reply), 0);
-									} else {
-										LOG(ERROR) << "Error while updating controller state: Unknown clientId " << message.msg.vd_SetControllerState.clientId;
-									}
-								}
-							}
-							break;
+	case ipc::RequestType::IPC_ClientDisconnect:
+		{
+			ipc::Reply reply(ipc::ReplyType::GenericReply);
+			reply.messageId = message.msg.ipc_ClientDisconnect.messageId;
+			std::shared_ptr<ReplyQueue> msgQueue;
+			{
+				std::lock_guard<std::mutex> lock(_this->_ipcEndpointsMutex);
+				auto i = _this->_ipcEndpoints.find(message.msg.ipc_ClientDisconnect.clientId);
+				if (i != _this->_ipcEndpoints.end()) {
+					msgQueue = i->second.replyQueue;
+					_this->_ipcEndpoints.erase(i);
+				}
+			}
+			if (msgQueue) {
+				_this->_closeDataLane(message.msg.ipc_ClientDisconnect.clientId);
+				LatencyStats::setTraced(message.msg.ipc_ClientDisconnect.clientId, false);
+				reply.status = ipc::ReplyStatus::Ok;
+				LOG(INFO) << "Client disconnected: clientId " << message.msg.ipc_ClientDisconnect.clientId;
+				if (reply.messageId != 0) {
+					msgQueue->send(&reply, reply.frameSize(), 0);
+				}
+			} else {
+				LOG(ERROR) << "Error during client disconnect: unknown clientID " << message.msg.ipc_ClientDisconnect.clientId;
+			}
+		}
+		break;
 
-						case ipc::RequestType::DeviceManipulation_GetDeviceInfo:
-							{
-								ipc::Reply resp(ipc::ReplyType::GenericReply);
-								resp.messageId = message.msg.vd_GenericDeviceIdMessage.messageId;
-								if (message.msg.vd_GenericDeviceIdMessage.deviceId >= vr::k_unMaxTrackedDeviceCount) {
-									resp.status = ipc::ReplyStatus::InvalidId;
-								} else {
-									OpenvrDeviceManipulationInfo* info = driver->deviceManipulation_getInfo(message.msg.vd_GenericDeviceIdMessage.deviceId);
-									if (!info) {
-										resp.status = ipc::ReplyStatus::NotFound;
-									} else {
-										resp.status = ipc::ReplyStatus::Ok;
-										resp.msg.dm_deviceInfo.deviceId = message.msg.vd_GenericDeviceIdMessage.deviceId;
-										resp.msg.dm_deviceInfo.deviceMode = info->deviceMode();
-										resp.msg.dm_deviceInfo.deviceClass = info->deviceClass();
-										resp.msg.dm_deviceInfo.offsetsEnabled = info->areOffsetsEnabled();
-										resp.msg.dm_deviceInfo.buttonMappingEnabled = info->buttonMappingEnabled();
-										resp.msg.dm_deviceInfo.redirectSuspended = info->redirectSuspended();
-									}
-								}
-								if (resp.status != ipc::ReplyStatus::Ok) {
-									LOG(ERROR) << "Error while updating device button mapping: Error code " << (int)resp.status;
-								}
-								if (resp.messageId != 0) {
-									auto i = _this->_ipcEndpoints.find(message.msg.dm_ButtonMapping.clientId);
-									if (i != _this->_ipcEndpoints.end()) {
-										i->second->send(&resp, sizeof(ipc::Reply), 0);
-									} else {
-										LOG(ERROR) << "Error while updating device button mapping: Unknown clientId " << message.msg.dm_ButtonMapping.clientId;
-									}
-								}
-							}
-							break;
-							
-						case ipc::RequestType::DeviceManipulation_ButtonMapping:
-							{
-								ipc::Reply resp(ipc::ReplyType::GenericReply);
-								resp.messageId = message.msg.dm_ButtonMapping.messageId;
-								if (message.msg.dm_ButtonMapping.deviceId >= vr::k_unMaxTrackedDeviceCount) {
-									resp.status = ipc::ReplyStatus::InvalidId;
-								} else {
-									OpenvrDeviceManipulationInfo* info = driver->deviceManipulation_getInfo(message.msg.dm_ButtonMapping.deviceId);
-									if (!info) {
-										resp.status = ipc::ReplyStatus::NotFound;
-									} else {
-										resp.status = ipc::ReplyStatus::Ok;
-										if (message.msg.dm_ButtonMapping.enableMapping > 0) {
-											info->setButtonMappingEnabled(message.msg.dm_ButtonMapping.enableMapping == 1 ? true : false);
-										}
-										switch (message.msg.dm_ButtonMapping.mappingOperation) {
-											case 0:
-												break;
-											case 1:
-												for (unsigned i = 0; i < message.msg.dm_ButtonMapping.mappingCount; ++i) {
-													info->addButtonMapping(message.msg.dm_ButtonMapping.buttonMappings[i * 2], message.msg.dm_ButtonMapping.buttonMappings[i * 2 + 1]);
-												}
-												break;
-											case 2:
-												for (unsigned i = 0; i < message.msg.dm_ButtonMapping.mappingCount; ++i) {
-													info->eraseButtonMapping(message.msg.dm_ButtonMapping.buttonMappings[i]);
-												}
-												break;
-											case 3:
-												info->eraseAllButtonMappings();
-												break;
-											default:
-												resp.status = ipc::ReplyStatus::InvalidOperation;
-												break;
-										}
-									}
-								}
-								if (resp.status != ipc::ReplyStatus::Ok) {
-									LOG(ERROR) << "Error while updating device button mapping: Error code " << (int)resp.status;
-								}
-								if (resp.messageId != 0) {
-									auto i = _this->_ipcEndpoints.find(message.msg.dm_ButtonMapping.clientId);
-									if (i != _this->_ipcEndpoints.end()) {
-										i->second->send(&resp, sizeof(ipc::Reply), 0);
-									} else {
-										LOG(ERROR) << "Error while updating device button mapping: Unknown clientId " << message.msg.dm_ButtonMapping.clientId;
-									}
-								}
-							}
-							break;
+	case ipc::RequestType::Batch:
+		_handleBatch(_this, driver, message, dequeueNs);
+		break;
 
-						case ipc::RequestType::DeviceManipulation_GetDeviceOffsets:
-							{
-								ipc::Reply resp(ipc::ReplyType::DeviceManipulation_GetDeviceOffsets);
-								resp.messageId = message.msg.vd_GenericDeviceIdMessage.messageId;
-								if (message.msg.vd_GenericDeviceIdMessage.deviceId >= vr::k_unMaxTrackedDeviceCount) {
-									resp.status = ipc::ReplyStatus::InvalidId;
-								} else {
-									OpenvrDeviceManipulationInfo* info = driver->deviceManipulation_getInfo(message.msg.vd_GenericDeviceIdMessage.deviceId);
-									if (!info) {
-										resp.status = ipc::ReplyStatus::NotFound;
-									} else {
-										resp.status = ipc::ReplyStatus::Ok;
-										resp.msg.dm_deviceOffsets.deviceId = message.msg.vd_GenericDeviceIdMessage.deviceId;
-										resp.msg.dm_deviceOffsets.offsetsEnabled = info->areOffsetsEnabled();
-										resp.msg.dm_deviceOffsets.worldFromDriverRotationOffset = info->worldFromDriverRotationOffset();
-										resp.msg.dm_deviceOffsets.worldFromDriverTranslationOffset = info->worldFromDriverTranslationOffset();
-										resp.msg.dm_deviceOffsets.driverFromHeadRotationOffset = info->driverFromHeadRotationOffset();
-										resp.msg.dm_deviceOffsets.driverFromHeadTranslationOffset = info->driverFromHeadTranslationOffset();
-										resp.msg.dm_deviceOffsets.driverFromHeadTranslationOffset = info->driverFromHeadTranslationOffset();
-										resp.msg.dm_deviceOffsets.deviceRotationOffset = info->deviceRotationOffset();
-										resp.msg.dm_deviceOffsets.deviceTranslationOffset = info->deviceTranslationOffset();
-									}
-								}
-								if (resp.status != ipc::ReplyStatus::Ok) {
-									LOG(ERROR) << "Error while updating device button mapping: Error code " << (int)resp.status;
-								}
-								if (resp.messageId != 0) {
-									auto i = _this->_ipcEndpoints.find(message.msg.dm_ButtonMapping.clientId);
-									if (i != _this->_ipcEndpoints.end()) {
-										i->second->send(&resp, sizeof(ipc::Reply), 0);
-									} else {
-										LOG(ERROR) << "Error while updating device button mapping: Unknown clientId " << message.msg.dm_ButtonMapping.clientId;
-									}
-								}
-							}
-							break;
+	case ipc::RequestType::IPC_ClientStatus:
+		{
+			auto replyQueue = _this->_getReplyQueue(message.msg.ipc_ClientStatus.clientId);
+			if (replyQueue) {
+				ipc::Reply reply(ipc::ReplyType::IPC_ClientStatus);
+				reply.messageId = message.msg.ipc_ClientStatus.messageId;
+				reply.status = ipc::ReplyStatus::Ok;
+				replyQueue->getStatus(reply.msg.ipc_ClientStatus);
+				replyQueue->send(&reply, reply.frameSize(), 0);
+			} else {
+				LOG(ERROR) << "Error while getting client status: unknown clientID " << message.msg.ipc_ClientStatus.clientId;
+			}
+		}
+		break;
 
-						case ipc::RequestType::DeviceManipulation_SetDeviceOffsets:
-							{
-								ipc::Reply resp(ipc::ReplyType::GenericReply);
-								resp.messageId = message.msg.dm_DeviceOffsets.messageId;
-								if (message.msg.dm_DeviceOffsets.deviceId >= vr::k_unMaxTrackedDeviceCount) {
-									resp.status = ipc::ReplyStatus::InvalidId;
-								} else {
-									OpenvrDeviceManipulationInfo* info = driver->deviceManipulation_getInfo(message.msg.dm_DeviceOffsets.deviceId);
-									if (!info) {
-										resp.status = ipc::ReplyStatus::NotFound;
-									} else {
-										resp.status = ipc::ReplyStatus::Ok;
-										if (message.msg.dm_DeviceOffsets.enableOffsets > 0) {
-											info->enableOffsets(message.msg.dm_DeviceOffsets.enableOffsets == 1 ? true : false);
-										}
-										switch (message.msg.dm_DeviceOffsets.offsetOperation) {
-										case 0:
-											if (message.msg.dm_DeviceOffsets.worldFromDriverRotationOffsetValid) {
-												info->worldFromDriverRotationOffset() = message.msg.dm_DeviceOffsets.worldFromDriverRotationOffset;
-											}
-											if (message.msg.dm_DeviceOffsets.worldFromDriverTranslationOffsetValid) {
-												info->worldFromDriverTranslationOffset() = message.msg.dm_DeviceOffsets.worldFromDriverTranslationOffset;
-											}
-											if (message.msg.dm_DeviceOffsets.driverFromHeadRotationOffsetValid) {
-												info->driverFromHeadRotationOffset() = message.msg.dm_DeviceOffsets.driverFromHeadRotationOffset;
-											}
-											if (message.msg.dm_DeviceOffsets.driverFromHeadTranslationOffsetValid) {
-												info->driverFromHeadTranslationOffset() = message.msg.dm_DeviceOffsets.driverFromHeadTranslationOffset;
-											}
-											if (message.msg.dm_DeviceOffsets.deviceRotationOffsetValid) {
-												info->deviceRotationOffset() = message.msg.dm_DeviceOffsets.deviceRotationOffset;
-											}
-											if (message.msg.dm_DeviceOffsets.deviceTranslationOffsetValid) {
-												info->deviceTranslationOffset() = message.msg.dm_DeviceOffsets.deviceTranslationOffset;
-											}
-											break;
-										case 1:
-											if (message.msg.dm_DeviceOffsets.worldFromDriverRotationOffsetValid) {
-												info->worldFromDriverRotationOffset() =  message.msg.dm_DeviceOffsets.worldFromDriverRotationOffset * info->worldFromDriverRotationOffset();
-											}
-											if (message.msg.dm_DeviceOffsets.worldFromDriverTranslationOffsetValid) {
-												info->worldFromDriverTranslationOffset() = info->worldFromDriverTranslationOffset() + message.msg.dm_DeviceOffsets.worldFromDriverTranslationOffset;
-											}
-											if (message.msg.dm_DeviceOffsets.driverFromHeadRotationOffsetValid) {
-												info->driverFromHeadRotationOffset() = message.msg.dm_DeviceOffsets.driverFromHeadRotationOffset * info->driverFromHeadRotationOffset();
-											}
-											if (message.msg.dm_DeviceOffsets.driverFromHeadTranslationOffsetValid) {
-												info->driverFromHeadTranslationOffset() = info->driverFromHeadTranslationOffset() + message.msg.dm_DeviceOffsets.driverFromHeadTranslationOffset;
-											}
-											if (message.msg.dm_DeviceOffsets.deviceRotationOffsetValid) {
-												info->deviceRotationOffset() = message.msg.dm_DeviceOffsets.deviceRotationOffset * info->deviceRotationOffset();
-											}
-											if (message.msg.dm_DeviceOffsets.deviceTranslationOffsetValid) {
-												info->deviceTranslationOffset() = info->deviceTranslationOffset() + message.msg.dm_DeviceOffsets.deviceTranslationOffset;
-											}
-											break;
-										}
-									}
-								}
-								if (resp.status != ipc::ReplyStatus::Ok) {
-									LOG(ERROR) << "Error while updating device pose offset: Error code " << (int)resp.status;
-								}
-								if (resp.messageId != 0) {
-									auto i = _this->_ipcEndpoints.find(message.msg.dm_DeviceOffsets.clientId);
-									if (i != _this->_ipcEndpoints.end()) {
-										i->second->send(&resp, sizeof(ipc::Reply), 0);
-									} else {
-										LOG(ERROR) << "Error while updating device pose offset: Unknown clientId " << message.msg.dm_DeviceOffsets.clientId;
-									}
-								}
-							}
-							break;
+	case ipc::RequestType::IPC_Ping:
+		{
+			LOG(TRACE) << "Ping received: clientId " << message.msg.ipc_Ping.clientId << ", nonce " << message.msg.ipc_Ping.nonce;
+			auto replyQueue = _this->_getReplyQueue(message.msg.ipc_Ping.clientId);
+			if (replyQueue) {
+				ipc::Reply reply(ipc::ReplyType::IPC_Ping);
+				reply.messageId = message.msg.ipc_Ping.messageId;
+				reply.status = ipc::ReplyStatus::Ok;
+				reply.msg.ipc_Ping.nonce = message.msg.ipc_Ping.nonce;
+				if (reply.messageId != 0) {
+					replyQueue->send(&reply, reply.frameSize(), 0);
+				}
+			} else {
+				LOG(ERROR) << "Error during ping: unknown clientID " << message.msg.ipc_ClientDisconnect.clientId;
+			}
+		}
+		break;
 
-						case ipc::RequestType::DeviceManipulation_DefaultMode:
-							{
-								ipc::Reply resp(ipc::ReplyType::GenericReply);
-								resp.messageId = message.msg.vd_GenericDeviceIdMessage.messageId;
-								if (message.msg.vd_GenericDeviceIdMessage.deviceId >= vr::k_unMaxTrackedDeviceCount) {
-									resp.status = ipc::ReplyStatus::InvalidId;
-								} else {
-									OpenvrDeviceManipulationInfo* info = driver->deviceManipulation_getInfo(message.msg.vd_GenericDeviceIdMessage.deviceId);
-									if (!info) {
-										resp.status = ipc::ReplyStatus::NotFound;
-									} else {
-										info->setDefaultMode();
-										resp.status = ipc::ReplyStatus::Ok;
-									}
-								}
-								if (resp.status != ipc::ReplyStatus::Ok) {
-									LOG(ERROR) << "Error while updating device pose offset: Error code " << (int)resp.status;
-								}
-								if (resp.messageId != 0) {
-									auto i = _this->_ipcEndpoints.find(message.msg.vd_GenericDeviceIdMessage.clientId);
-									if (i != _this->_ipcEndpoints.end()) {
-										i->second->send(&resp, sizeof(ipc::Reply), 0);
-									} else {
-										LOG(ERROR) << "Error while updating device pose offset: Unknown clientId " << message.msg.vd_GenericDeviceIdMessage.clientId;
-									}
-								}
-							}
-							break;
-								
-						case ipc::RequestType::DeviceManipulation_RedirectMode:
-							{
-								ipc::Reply resp(ipc::ReplyType::GenericReply);
-								resp.messageId = message.msg.dm_RedirectMode.messageId;
-								if (message.msg.dm_RedirectMode.deviceId >= vr::k_unMaxTrackedDeviceCount) {
-									resp.status = ipc::ReplyStatus::InvalidId;
-								} else {
-									OpenvrDeviceManipulationInfo* info = driver->deviceManipulation_getInfo(message.msg.dm_RedirectMode.deviceId);
-									if (!info) {
-										resp.status = ipc::ReplyStatus::NotFound;
-									} else {
-										OpenvrDeviceManipulationInfo* infoTarget = driver->deviceManipulation_getInfo(message.msg.dm_RedirectMode.targetId);
-										if (info && (info->deviceMode() == 0 || info->deviceMode() == 1) 
-												&& infoTarget && (infoTarget->deviceMode() == 0 || infoTarget->deviceMode() == 1)) {
-											info->setRedirectMode(false, infoTarget);
-											infoTarget->setRedirectMode(true, info);
-											resp.status = ipc::ReplyStatus::Ok;
-										} else {
-											resp.status = ipc::ReplyStatus::UnknownError;
-										}
-									}
-								}
-								if (resp.status != ipc::ReplyStatus::Ok) {
-									LOG(ERROR) << "Error while updating device pose offset: Error code " << (int)resp.status;
-								}
-								if (resp.messageId != 0) {
-									auto i = _this->_ipcEndpoints.find(message.msg.dm_RedirectMode.clientId);
-									if (i != _this->_ipcEndpoints.end()) {
-										i->second->send(&resp, sizeof(ipc::Reply), 0);
-									} else {
-										LOG(ERROR) << "Error while updating device pose offset: Unknown clientId " << message.msg.dm_RedirectMode.clientId;
-									}
-								}
-							}
-							break;
+	case ipc::RequestType::OpenVR_ButtonEvent:
+		{
+			if (vr::VRServerDriverHost()) {
+				unsigned iterCount = min(message.msg.ipc_ButtonEvent.eventCount, REQUEST_OPENVR_BUTTONEVENT_MAXCOUNT);
+				for (unsigned i = 0; i < iterCount; ++i) {
+					auto& e = message.msg.ipc_ButtonEvent.events[i];
+					try {
+						driver->openvr_buttonEvent(e.deviceId, e.eventType, e.buttonId, e.timeOffset);
+					} catch (std::exception& e) {
+						LOG(ERROR) << "Error in ipc thread: " << e.what();
+					}
+				}
+			}
+		}
+		break;
 
-						case ipc::RequestType::DeviceManipulation_SwapMode:
-						{
-							ipc::Reply resp(ipc::ReplyType::GenericReply);
-							resp.messageId = message.msg.dm_SwapMode.messageId;
-							if (message.msg.dm_SwapMode.deviceId >= vr::k_unMaxTrackedDeviceCount) {
-								resp.status = ipc::ReplyStatus::InvalidId;
-							} else {
-								OpenvrDeviceManipulationInfo* info = driver->deviceManipulation_getInfo(message.msg.dm_SwapMode.deviceId);
-								if (!info) {
-									resp.status = ipc::ReplyStatus::NotFound;
-								} else {
-									OpenvrDeviceManipulationInfo* infoTarget = driver->deviceManipulation_getInfo(message.msg.dm_SwapMode.targetId);
-									if (info && (info->deviceMode() == 0 || info->deviceMode() == 1)
-										&& infoTarget && (infoTarget->deviceMode() == 0 || infoTarget->deviceMode() == 1)) {
-										info->setSwapMode(infoTarget);
-										infoTarget->setSwapMode(info);
-										resp.status = ipc::ReplyStatus::Ok;
-									} else {
-										resp.status = ipc::ReplyStatus::UnknownError;
-									}
-								}
-							}
-							if (resp.status != ipc::ReplyStatus::Ok) {
-								LOG(ERROR) << "Error while updating device pose offset: Error code " << (int)resp.status;
-							}
-							if (resp.messageId != 0) {
-								auto i = _this->_ipcEndpoints.find(message.msg.dm_SwapMode.clientId);
-								if (i != _this->_ipcEndpoints.end()) {
-									i->second->send(&resp, sizeof(ipc::Reply), 0);
-								} else {
-									LOG(ERROR) << "Error while updating device pose offset: Unknown clientId " << message.msg.dm_SwapMode.clientId;
-								}
-							}
-						}
-						break;
+	case ipc::RequestType::OpenVR_AxisEvent:
+		{
+			if (vr::VRServerDriverHost()) {
+				for (unsigned i = 0; i < message.msg.ipc_AxisEvent.eventCount; ++i) {
+					auto& e = message.msg.ipc_AxisEvent.events[i];
+					driver->openvr_axisEvent(e.deviceId, e.axisId, e.axisState);
+				}
+			}
+		}
+		break;
 
-						case ipc::RequestType::DeviceManipulation_MotionCompensationMode:
-							{
-								ipc::Reply resp(ipc::ReplyType::GenericReply);
-								resp.messageId = message.msg.dm_MotionCompensationMode.messageId;
-								if (message.msg.dm_MotionCompensationMode.deviceId >= vr::k_unMaxTrackedDeviceCount) {
-									resp.status = ipc::ReplyStatus::InvalidId;
-								} else {
-									OpenvrDeviceManipulationInfo* info = driver->deviceManipulation_getInfo(message.msg.dm_MotionCompensationMode.deviceId);
-									if (!info) {
-										resp.status = ipc::ReplyStatus::NotFound;
-									} else {
-										auto serverDriver = CServerDriver::getInstance();
-										if (serverDriver) {
-											serverDriver->setMotionCompensationVelAccMode(message.msg.dm_MotionCompensationMode.velAccCompensationMode);
-											info->setMotionCompensationMode();
-											resp.status = ipc::ReplyStatus::Ok;
-										} else {
-											resp.status = ipc::ReplyStatus::UnknownError;
-										}
-									}
-								}
-								if (resp.status != ipc::ReplyStatus::Ok) {
-									LOG(ERROR) << "Error while updating device pose offset: Error code " << (int)resp.status;
-								}
-								if (resp.messageId != 0) {
-									auto i = _this->_ipcEndpoints.find(message.msg.dm_MotionCompensationMode.clientId);
-									if (i != _this->_ipcEndpoints.end()) {
-										i->second->send(&resp, sizeof(ipc::Reply), 0);
-									} else {
-										LOG(ERROR) << "Error while updating device pose offset: Unknown clientId " << message.msg.dm_MotionCompensationMode.clientId;
-									}
-								}
-							}
-							break;
+	case ipc::RequestType::OpenVR_PoseUpdate:
+		{
+			if (vr::VRServerDriverHost()) {
+				driver->openvr_poseUpdate(message.msg.ipc_PoseUpdate.deviceId, message.msg.ipc_PoseUpdate.pose, message.timestamp);
+			}
+		}
+		break;
 
-						case ipc::RequestType::DeviceManipulation_FakeDisconnectedMode:
-						{
-							ipc::Reply resp(ipc::ReplyType::GenericReply);
-							resp.messageId = message.msg.vd_GenericDeviceIdMessage.messageId;
-							if (message.msg.vd_GenericDeviceIdMessage.deviceId >= vr::k_unMaxTrackedDeviceCount) {
-								resp.status = ipc::ReplyStatus::InvalidId;
-							} else {
-								OpenvrDeviceManipulationInfo* info = driver->deviceManipulation_getInfo(message.msg.vd_GenericDeviceIdMessage.deviceId);
-								if (!info) {
-									resp.status = ipc::ReplyStatus::NotFound;
-								} else {
-									info->setFakeDisconnectedMode();
-									resp.status = ipc::ReplyStatus::Ok;
-								}
-							}
-							if (resp.status != ipc::ReplyStatus::Ok) {
-								LOG(ERROR) << "Error while updating device pose offset: Error code " << (int)resp.status;
-							}
-							if (resp.messageId != 0) {
-								auto i = _this->_ipcEndpoints.find(message.msg.vd_GenericDeviceIdMessage.clientId);
-								if (i != _this->_ipcEndpoints.end()) {
-									i->second->send(&resp, sizeof(ipc::Reply), 0);
-								} else {
-									LOG(ERROR) << "Error while updating device pose offset: Unknown clientId " << message.msg.vd_GenericDeviceIdMessage.clientId;
-								}
-							}
+	case ipc::RequestType::OpenVR_ProximitySensorEvent:
+		{
+			driver->openvr_proximityEvent(message.msg.ipc_PoseUpdate.deviceId, message.msg.ovr_ProximitySensorEvent.sensorTriggered);
+		}
+		break;
+
+	case ipc::RequestType::OpenVR_VendorSpecificEvent:
+		{
+			driver->openvr_vendorSpecificEvent(message.msg.ovr_VendorSpecificEvent.deviceId, message.msg.ovr_VendorSpecificEvent.eventType,
+				message.msg.ovr_VendorSpecificEvent.eventData, message.msg.ovr_VendorSpecificEvent.timeOffset);
+		}
+		break;
+
+	case ipc::RequestType::VirtualDevices_GetDeviceCount:
+		{
+			auto replyQueue = _this->_getReplyQueue(message.msg.vd_GenericClientMessage.clientId);
+			if (replyQueue) {
+				ipc::Reply resp(ipc::ReplyType::VirtualDevices_GetDeviceCount);
+				resp.messageId = message.msg.vd_GenericClientMessage.messageId;
+				resp.status = ipc::ReplyStatus::Ok;
+				resp.msg.vd_GetDeviceCount.deviceCount = driver->virtualDevices_getDeviceCount();
+				replyQueue->send(&resp, resp.frameSize(), 0);
+			} else {
+				LOG(ERROR) << "Error while getting virtual device count: Unknown clientId " << message.msg.vd_AddDevice.clientId;
+			}
+
+		}
+		break;
+
+	case ipc::RequestType::VirtualDevices_GetDeviceInfo:
+		{
+			auto replyQueue = _this->_getReplyQueue(message.msg.vd_GenericDeviceIdMessage.clientId);
+			if (replyQueue) {
+				ipc::Reply resp(ipc::ReplyType::VirtualDevices_GetDeviceInfo);
+				resp.messageId = message.msg.vd_GenericDeviceIdMessage.messageId;
+				if (message.msg.vd_GenericDeviceIdMessage.deviceId >= vr::k_unMaxTrackedDeviceCount) {
+					resp.status = ipc::ReplyStatus::InvalidId;
+				} else {
+					auto d = driver->virtualDevices_getDevice(message.msg.vd_GenericDeviceIdMessage.deviceId);
+					if (!d) {
+						resp.status = ipc::ReplyStatus::NotFound;
+					} else {
+						resp.msg.vd_GetDeviceInfo.virtualDeviceId = message.msg.vd_GenericDeviceIdMessage.deviceId;
+						resp.msg.vd_GetDeviceInfo.openvrDeviceId = d->openvrDeviceId();
+						resp.msg.vd_GetDeviceInfo.deviceType = d->deviceType();
+						strncpy_s(resp.msg.vd_GetDeviceInfo.deviceSerial, d->serialNumber().c_str(), 127);
+						resp.msg.vd_GetDeviceInfo.deviceSerial[127] = '\0';
+						resp.status = ipc::ReplyStatus::Ok;
+					}
+				}
+				replyQueue->send(&resp, resp.frameSize(), 0);
+			} else {
+				LOG(ERROR) << "Error while getting virtual device info: Unknown clientId " << message.msg.vd_AddDevice.clientId;
+			}
+
+		}
+		break;
+
+	case ipc::RequestType::VirtualDevices_GetDevicePose:
+		{
+			auto replyQueue = _this->_getReplyQueue(message.msg.vd_GenericDeviceIdMessage.clientId);
+			if (replyQueue) {
+				ipc::Reply resp(ipc::ReplyType::VirtualDevices_GetDevicePose);
+				resp.messageId = message.msg.vd_GenericDeviceIdMessage.messageId;
+				if (message.msg.vd_GenericDeviceIdMessage.deviceId >= vr::k_unMaxTrackedDeviceCount) {
+					resp.status = ipc::ReplyStatus::InvalidId;
+				} else {
+					auto d = driver->virtualDevices_getDevice(message.msg.vd_GenericDeviceIdMessage.deviceId);
+					if (!d) {
+						resp.status = ipc::ReplyStatus::NotFound;
+					} else {
+						resp.msg.vd_GetDevicePose.pose = d->GetPose();
+						resp.status = ipc::ReplyStatus::Ok;
+					}
+				}
+				replyQueue->send(&resp, resp.frameSize(), 0);
+			} else {
+				LOG(ERROR) << "Error while getting virtual device pose: Unknown clientId " << message.msg.vd_AddDevice.clientId;
+			}
+		}
+		break;
+
+	case ipc::RequestType::VirtualDevices_GetControllerState:
+		{
+			auto replyQueue = _this->_getReplyQueue(message.msg.vd_GenericDeviceIdMessage.clientId);
+			if (replyQueue) {
+				ipc::Reply resp(ipc::ReplyType::VirtualDevices_GetControllerState);
+				resp.messageId = message.msg.vd_GenericDeviceIdMessage.messageId;
+				if (message.msg.vd_GenericDeviceIdMessage.deviceId >= vr::k_unMaxTrackedDeviceCount) {
+					resp.status = ipc::ReplyStatus::InvalidId;
+				} else {
+					auto d = driver->virtualDevices_getDevice(message.msg.vd_GenericDeviceIdMessage.deviceId);
+					if (!d) {
+						resp.status = ipc::ReplyStatus::NotFound;
+					} else {
+						auto c = (vr::IVRControllerComponent*)d->GetComponent(vr::IVRControllerComponent_Version);
+						if (c) {
+							resp.msg.vd_GetControllerState.controllerState = c->GetControllerState();
+							resp.status = ipc::ReplyStatus::Ok;
+						} else {
+							resp.status = ipc::ReplyStatus::InvalidType;
 						}
+					}
+				}
+				replyQueue->send(&resp, resp.frameSize(), 0);
+			} else {
+				LOG(ERROR) << "Error while getting virtual controller state: Unknown clientId " << message.msg.vd_AddDevice.clientId;
+			}
+
+		}
+		break;
+
+	case ipc::RequestType::VirtualDevices_AddDevice:
+		{
+			auto replyQueue = _this->_getReplyQueue(message.msg.vd_AddDevice.clientId);
+			if (replyQueue) {
+				auto result = driver->virtualDevices_addDevice(message.msg.vd_AddDevice.deviceType, message.msg.vd_AddDevice.deviceSerial);
+				ipc::Reply resp(ipc::ReplyType::VirtualDevices_AddDevice);
+				resp.messageId = message.msg.vd_AddDevice.messageId;
+				if (result >= 0) {
+					resp.status = ipc::ReplyStatus::Ok;
+					resp.msg.vd_AddDevice.virtualDeviceId = (uint32_t)result;
+				} else if (result == -1) {
+					resp.status = ipc::ReplyStatus::TooManyDevices;
+				} else if (result == -2) {
+					resp.status = ipc::ReplyStatus::AlreadyInUse;
+					auto d = driver->virtualDevices_findDevice(message.msg.vd_AddDevice.deviceSerial);
+					resp.msg.vd_AddDevice.virtualDeviceId = d->virtualDeviceId();
+				} else if (result == -3) {
+					resp.status = ipc::ReplyStatus::InvalidType;
+				} else {
+					resp.status = ipc::ReplyStatus::UnknownError;
+				}
+				if (resp.status != ipc::ReplyStatus::Ok) {
+					LOG(ERROR) << "Error while adding virtual device: Error code " << (int)resp.status;
+				}
+				if (resp.messageId != 0) {
+					replyQueue->send(&resp, resp.frameSize(), 0);
+				}
+			} else {
+				LOG(ERROR) << "Error while adding virtual device: Unknown clientId " << message.msg.vd_AddDevice.clientId;
+			}
+		}
+		break;
+
+	case ipc::RequestType::VirtualDevices_PublishDevice:
+		{
+			auto result = driver->virtualDevices_publishDevice(message.msg.vd_GenericDeviceIdMessage.deviceId);
+			ipc::Reply resp(ipc::ReplyType::GenericReply);
+			resp.messageId = message.msg.vd_GenericDeviceIdMessage.messageId;
+			if (result >= 0) {
+				resp.status = ipc::ReplyStatus::Ok;
+			} else if (result == -1) {
+				resp.status = ipc::ReplyStatus::InvalidId;
+			} else if (result == -2) {
+				resp.status = ipc::ReplyStatus::NotFound;
+			} else if (result == -3) {
+				resp.status = ipc::ReplyStatus::Ok; // It's already published, let's regard this as "Ok"
+			} else if (result == -4) {
+				resp.status = ipc::ReplyStatus::MissingProperty;
+			} else {
+				resp.status = ipc::ReplyStatus::UnknownError;
+			}
+			if (resp.status != ipc::ReplyStatus::Ok) {
+				LOG(ERROR) << "Error while publishing virtual device: Error code " << (int)resp.status;
+			}
+			if (resp.messageId != 0) {
+				auto replyQueue = _this->_getReplyQueue(message.msg.vd_GenericDeviceIdMessage.clientId);
+				if (replyQueue) {
+					replyQueue->send(&resp, resp.frameSize(), 0);
+				} else {
+					LOG(ERROR) << "Error while publishing virtual device: Unknown clientId " << message.msg.vd_GenericDeviceIdMessage.clientId;
+				}
+			}
+		}
+		break;
+
+	case ipc::RequestType::VirtualDevices_SetDeviceProperty:
+		{
+			ipc::Reply resp(ipc::ReplyType::GenericReply);
+			resp.messageId = message.msg.vd_SetDeviceProperty.messageId;
+			if (message.msg.vd_SetDeviceProperty.virtualDeviceId >= driver->virtualDevices_getDeviceCount()) {
+				resp.status = ipc::ReplyStatus::InvalidId;
+			} else {
+				auto device = driver->virtualDevices_getDevice(message.msg.vd_SetDeviceProperty.virtualDeviceId);
+				if (!device) {
+					resp.status = ipc::ReplyStatus::NotFound;
+				} else {
+					resp.status = ipc::ReplyStatus::Ok;
+					switch (message.msg.vd_SetDeviceProperty.valueType) {
+					case DevicePropertyValueType::BOOL:
+						LOG(TRACE) << "CTrackedDeviceDriver[" << device->serialNumber() << "]::setTrackedDeviceProperty("
+							<< message.msg.vd_SetDeviceProperty.deviceProperty << ", " << message.msg.vd_SetDeviceProperty.value.boolValue << ")";
+						device->setTrackedDeviceProperty(message.msg.vd_SetDeviceProperty.deviceProperty, message.msg.vd_SetDeviceProperty.value.boolValue);
+						break;
+					case DevicePropertyValueType::FLOAT:
+						LOG(TRACE) << "CTrackedDeviceDriver[" << device->serialNumber() << "]::setTrackedDeviceProperty("
+							<< message.msg.vd_SetDeviceProperty.deviceProperty << ", " << message.msg.vd_SetDeviceProperty.value.floatValue << ")";
+						device->setTrackedDeviceProperty(message.msg.vd_SetDeviceProperty.deviceProperty, message.msg.vd_SetDeviceProperty.value.floatValue);
+						break;
+					case DevicePropertyValueType::INT32:
+						LOG(TRACE) << "CTrackedDeviceDriver[" << device->serialNumber() << "]::setTrackedDeviceProperty("
+							<< message.msg.vd_SetDeviceProperty.deviceProperty << ", " << message.msg.vd_SetDeviceProperty.value.int32Value << ")";
+						device->setTrackedDeviceProperty(message.msg.vd_SetDeviceProperty.deviceProperty, message.msg.vd_SetDeviceProperty.value.int32Value);
 						break;
+					case DevicePropertyValueType::MATRIX34:
+						LOG(TRACE) << "CTrackedDeviceDriver[" << device->serialNumber() << "]::setTrackedDeviceProperty("
+							<< message.msg.vd_SetDeviceProperty.deviceProperty << ", <matrix34> )";
+						device->setTrackedDeviceProperty(message.msg.vd_SetDeviceProperty.deviceProperty, message.msg.vd_SetDeviceProperty.value.matrix34Value);
+						break;
+					case DevicePropertyValueType::MATRIX44:
+						LOG(TRACE) << "CTrackedDeviceDriver[" << device->serialNumber() << "]::setTrackedDeviceProperty("
+							<< message.msg.vd_SetDeviceProperty.deviceProperty << ", <matrix44> )";
+						device->setTrackedDeviceProperty(message.msg.vd_SetDeviceProperty.deviceProperty, message.msg.vd_SetDeviceProperty.value.matrix44Value);
+						break;
+					case DevicePropertyValueType::VECTOR3:
+						LOG(TRACE) << "CTrackedDeviceDriver[" << device->serialNumber() << "]::setTrackedDeviceProperty("
+							<< message.msg.vd_SetDeviceProperty.deviceProperty << ", <vector3> )";
+						device->setTrackedDeviceProperty(message.msg.vd_SetDeviceProperty.deviceProperty, message.msg.vd_SetDeviceProperty.value.vector3Value);
+						break;
+					case DevicePropertyValueType::VECTOR4:
+						LOG(TRACE) << "CTrackedDeviceDriver[" << device->serialNumber() << "]::setTrackedDeviceProperty("
+							<< message.msg.vd_SetDeviceProperty.deviceProperty << ", <vector4> )";
+						device->setTrackedDeviceProperty(message.msg.vd_SetDeviceProperty.deviceProperty, message.msg.vd_SetDeviceProperty.value.vector4Value);
+						break;
+					case DevicePropertyValueType::STRING:
+						LOG(TRACE) << "CTrackedDeviceDriver[" << device->serialNumber() << "]::setTrackedDeviceProperty("
+							<< message.msg.vd_SetDeviceProperty.deviceProperty << ", " << message.msg.vd_SetDeviceProperty.value.stringValue << ")";
+						device->setTrackedDeviceProperty(message.msg.vd_SetDeviceProperty.deviceProperty, std::string(message.msg.vd_SetDeviceProperty.value.stringValue));
+						break;
+					case DevicePropertyValueType::UINT64:
+						LOG(TRACE) << "CTrackedDeviceDriver[" << device->serialNumber() << "]::setTrackedDeviceProperty("
+							<< message.msg.vd_SetDeviceProperty.deviceProperty << ", " << message.msg.vd_SetDeviceProperty.value.uint64Value << ")";
+						device->setTrackedDeviceProperty(message.msg.vd_SetDeviceProperty.deviceProperty, message.msg.vd_SetDeviceProperty.value.uint64Value);
+						break;
+					default:
+						resp.status = ipc::ReplyStatus::InvalidType;
+						break;
+					}
+				}
+			}
+			if (resp.status != ipc::ReplyStatus::Ok) {
+				LOG(ERROR) << "Error while setting device property: Error code " << (int)resp.status;
+			}
+			if (resp.messageId != 0) {
+				auto replyQueue = _this->_getReplyQueue(message.msg.vd_SetDeviceProperty.clientId);
+				if (replyQueue) {
+					replyQueue->send(&resp, resp.frameSize(), 0);
+				} else {
+					LOG(ERROR) << "Error while setting device property: Unknown clientId " << message.msg.vd_SetDeviceProperty.clientId;
+				}
+			}
+		}
+		break;
 
-						case ipc::RequestType::DeviceManipulation_TriggerHapticPulse:
-						{
-							ipc::Reply resp(ipc::ReplyType::GenericReply);
-							resp.messageId = message.msg.dm_triggerHapticPulse.messageId;
-							if (message.msg.dm_triggerHapticPulse.deviceId >= vr::k_unMaxTrackedDeviceCount) {
-								resp.status = ipc::ReplyStatus::InvalidId;
-							} else {
-								OpenvrDeviceManipulationInfo* info = driver->deviceManipulation_getInfo(message.msg.dm_triggerHapticPulse.deviceId);
-								if (!info) {
-									resp.status = ipc::ReplyStatus::NotFound;
-								} else {
-									info->triggerHapticPulse(message.msg.dm_triggerHapticPulse.axisId, message.msg.dm_triggerHapticPulse.durationMicroseconds, message.msg.dm_triggerHapticPulse.directMode);
-									resp.status = ipc::ReplyStatus::Ok;
-								}
-							}
-							if (resp.status != ipc::ReplyStatus::Ok) {
-								LOG(ERROR) << "Error while triggering haptic pulse: Error code " << (int)resp.status;
+	case ipc::RequestType::VirtualDevices_RemoveDeviceProperty:
+		{
+			ipc::Reply resp(ipc::ReplyType::GenericReply);
+			resp.messageId = message.msg.vd_RemoveDeviceProperty.messageId;
+			if (message.msg.vd_RemoveDeviceProperty.virtualDeviceId >= driver->virtualDevices_getDeviceCount()) {
+				resp.status = ipc::ReplyStatus::InvalidId;
+			} else {
+				auto device = driver->virtualDevices_getDevice(message.msg.vd_RemoveDeviceProperty.virtualDeviceId);
+				if (!device) {
+					resp.status = ipc::ReplyStatus::NotFound;
+				} else {
+					LOG(TRACE) << "CTrackedDeviceDriver[" << device->serialNumber() << "]::removeTrackedDeviceProperty("
+						<< message.msg.vd_RemoveDeviceProperty.deviceProperty << ")";
+					device->removeTrackedDeviceProperty(message.msg.vd_RemoveDeviceProperty.deviceProperty);
+					resp.status = ipc::ReplyStatus::Ok;
+				}
+			}
+			if (resp.status != ipc::ReplyStatus::Ok) {
+				LOG(ERROR) << "Error while removing device property: Error code " << (int)resp.status;
+			}
+			if (resp.messageId != 0) {
+				auto replyQueue = _this->_getReplyQueue(message.msg.vd_RemoveDeviceProperty.clientId);
+				if (replyQueue) {
+					replyQueue->send(&resp, resp.frameSize(), 0);
+				} else {
+					LOG(ERROR) << "Error while removing device property: Unknown clientId " << message.msg.vd_RemoveDeviceProperty.clientId;
+				}
+			}
+		}
+		break;
+
+	case ipc::RequestType::VirtualDevices_SetDevicePose:
+		{
+			ipc::Reply resp(ipc::ReplyType::GenericReply);
+			resp.messageId = message.msg.vd_SetDevicePose.messageId;
+			if (message.msg.vd_SetDevicePose.virtualDeviceId >= driver->virtualDevices_getDeviceCount()) {
+				resp.status = ipc::ReplyStatus::InvalidId;
+			} else {
+				auto device = driver->virtualDevices_getDevice(message.msg.vd_SetDevicePose.virtualDeviceId);
+				if (!device) {
+					resp.status = ipc::ReplyStatus::NotFound;
+				} else {
+					device->updatePose(message.msg.vd_SetDevicePose.pose, -ipc::timestampAge(message.timestamp));
+					resp.status = ipc::ReplyStatus::Ok;
+				}
+			}
+			if (resp.status != ipc::ReplyStatus::Ok) {
+				LOG(ERROR) << "Error while updating device pose: Error code " << (int)resp.status;
+			}
+			if (resp.messageId != 0) {
+				auto replyQueue = _this->_getReplyQueue(message.msg.vd_SetDevicePose.clientId);
+				if (replyQueue) {
+					replyQueue->send(&resp, resp.frameSize(), 0);
+				} else {
+					LOG(ERROR) << "Error while updating device pose: Unknown clientId " << message.msg.vd_SetDevicePose.clientId;
+				}
+			}
+		}
+		break;
+
+	case ipc::RequestType::VirtualDevices_SetControllerState:
+		{
+			ipc::Reply resp(ipc::ReplyType::GenericReply);
+			resp.messageId = message.msg.vd_SetControllerState.messageId;
+			if (message.msg.vd_SetControllerState.virtualDeviceId >= driver->virtualDevices_getDeviceCount()) {
+				resp.status = ipc::ReplyStatus::InvalidId;
+			} else {
+				auto device = driver->virtualDevices_getDevice(message.msg.vd_SetControllerState.virtualDeviceId);
+				if (!device) {
+					resp.status = ipc::ReplyStatus::NotFound;
+				} else {
+					resp.status = ipc::ReplyStatus::Ok;
+					if (device->deviceType() == VirtualDeviceType::TrackedController) {
+						auto controller = (CTrackedControllerDriver*)device;
+						controller->updateControllerState(message.msg.vd_SetControllerState.controllerState, -ipc::timestampAge(message.timestamp));
+					} else {
+						resp.status = ipc::ReplyStatus::InvalidType;
+					}
+				}
+			}
+			if (resp.status != ipc::ReplyStatus::Ok) {
+				LOG(ERROR) << "Error while updating controller state: Error code " << (int)resp.status;
+			}
+			if (resp.messageId != 0) {
+				auto replyQueue = _this->_getReplyQueue(message.msg.vd_SetControllerState.clientId);
+				if (replyQueue) {
+					replyQueue->send(&resp, resp.frameSize(), 0);
+				} else {
+					LOG(ERROR) << "Error while updating controller state: Unknown clientId " << message.msg.vd_SetControllerState.clientId;
+				}
+			}
+		}
+		break;
+
+	case ipc::RequestType::DeviceManipulation_GetDeviceInfo:
+		{
+			ipc::Reply resp(ipc::ReplyType::DeviceManipulation_GetDeviceInfo);
+			resp.messageId = message.msg.vd_GenericDeviceIdMessage.messageId;
+			if (message.msg.vd_GenericDeviceIdMessage.deviceId >= vr::k_unMaxTrackedDeviceCount) {
+				resp.status = ipc::ReplyStatus::InvalidId;
+			} else {
+				OpenvrDeviceManipulationInfo* info = driver->deviceManipulation_getInfo(message.msg.vd_GenericDeviceIdMessage.deviceId);
+				if (!info) {
+					resp.status = ipc::ReplyStatus::NotFound;
+				} else {
+					resp.status = ipc::ReplyStatus::Ok;
+					resp.msg.dm_deviceInfo.deviceId = message.msg.vd_GenericDeviceIdMessage.deviceId;
+					auto config = info->config();
+					resp.msg.dm_deviceInfo.deviceMode = config.deviceMode;
+					resp.msg.dm_deviceInfo.deviceClass = info->deviceClass();
+					resp.msg.dm_deviceInfo.offsetsEnabled = config.offsetsEnabled;
+					resp.msg.dm_deviceInfo.buttonMappingEnabled = config.enableButtonMapping;
+					resp.msg.dm_deviceInfo.redirectSuspended = config.redirectSuspended;
+				}
+			}
+			if (resp.status != ipc::ReplyStatus::Ok) {
+				LOG(ERROR) << "Error while updating device button mapping: Error code " << (int)resp.status;
+			}
+			if (resp.messageId != 0) {
+				auto replyQueue = _this->_getReplyQueue(message.msg.dm_ButtonMapping.clientId);
+				if (replyQueue) {
+					replyQueue->send(&resp, resp.frameSize(), 0);
+				} else {
+					LOG(ERROR) << "Error while updating device button mapping: Unknown clientId " << message.msg.dm_ButtonMapping.clientId;
+				}
+			}
+		}
+		break;
+		
+	case ipc::RequestType::DeviceManipulation_ButtonMapping:
+		{
+			ipc::Reply resp(ipc::ReplyType::GenericReply);
+			resp.messageId = message.msg.dm_ButtonMapping.messageId;
+			if (message.msg.dm_ButtonMapping.deviceId >= vr::k_unMaxTrackedDeviceCount) {
+				resp.status = ipc::ReplyStatus::InvalidId;
+			} else {
+				OpenvrDeviceManipulationInfo* info = driver->deviceManipulation_getInfo(message.msg.dm_ButtonMapping.deviceId);
+				if (!info) {
+					resp.status = ipc::ReplyStatus::NotFound;
+				} else {
+					resp.status = ipc::ReplyStatus::Ok;
+					if (message.msg.dm_ButtonMapping.enableMapping > 0) {
+						info->setButtonMappingEnabled(message.msg.dm_ButtonMapping.enableMapping == 1 ? true : false);
+					}
+					switch (message.msg.dm_ButtonMapping.mappingOperation) {
+						case 0:
+							break;
+						case 1:
+							for (unsigned i = 0; i < message.msg.dm_ButtonMapping.mappingCount; ++i) {
+								info->addButtonMapping(message.msg.dm_ButtonMapping.buttonMappings[i * 2], message.msg.dm_ButtonMapping.buttonMappings[i * 2 + 1]);
 							}
-							if (resp.messageId != 0) {
-								auto i = _this->_ipcEndpoints.find(message.msg.dm_triggerHapticPulse.clientId);
-								if (i != _this->_ipcEndpoints.end()) {
-									i->second->send(&resp, sizeof(ipc::Reply), 0);
-								} else {
-									LOG(ERROR) << "Error while triggering haptic pulse: Unknown clientId " << message.msg.dm_triggerHapticPulse.clientId;
-								}
+							break;
+						case 2:
+							for (unsigned i = 0; i < message.msg.dm_ButtonMapping.mappingCount; ++i) {
+								info->eraseButtonMapping(message.msg.dm_ButtonMapping.buttonMappings[i]);
 							}
+							break;
+						case 3:
+							info->eraseAllButtonMappings();
+							break;
+						default:
+							resp.status = ipc::ReplyStatus::InvalidOperation;
+							break;
+					}
+				}
+			}
+			if (resp.status != ipc::ReplyStatus::Ok) {
+				LOG(ERROR) << "Error while updating device button mapping: Error code " << (int)resp.status;
+			}
+			if (resp.messageId != 0) {
+				auto replyQueue = _this->_getReplyQueue(message.msg.dm_ButtonMapping.clientId);
+				if (replyQueue) {
+					replyQueue->send(&resp, resp.frameSize(), 0);
+				} else {
+					LOG(ERROR) << "Error while updating device button mapping: Unknown clientId " << message.msg.dm_ButtonMapping.clientId;
+				}
+			}
+		}
+		break;
+
+	case ipc::RequestType::DeviceManipulation_GetDeviceOffsets:
+		{
+			ipc::Reply resp(ipc::ReplyType::DeviceManipulation_GetDeviceOffsets);
+			resp.messageId = message.msg.vd_GenericDeviceIdMessage.messageId;
+			if (message.msg.vd_GenericDeviceIdMessage.deviceId >= vr::k_unMaxTrackedDeviceCount) {
+				resp.status = ipc::ReplyStatus::InvalidId;
+			} else {
+				OpenvrDeviceManipulationInfo* info = driver->deviceManipulation_getInfo(message.msg.vd_GenericDeviceIdMessage.deviceId);
+				if (!info) {
+					resp.status = ipc::ReplyStatus::NotFound;
+				} else {
+					resp.status = ipc::ReplyStatus::Ok;
+					resp.msg.dm_deviceOffsets.deviceId = message.msg.vd_GenericDeviceIdMessage.deviceId;
+					auto config = info->config();
+					resp.msg.dm_deviceOffsets.offsetsEnabled = config.offsetsEnabled;
+					resp.msg.dm_deviceOffsets.worldFromDriverRotationOffset = config.worldFromDriverRotationOffset;
+					resp.msg.dm_deviceOffsets.worldFromDriverTranslationOffset = config.worldFromDriverTranslationOffset;
+					resp.msg.dm_deviceOffsets.driverFromHeadRotationOffset = config.driverFromHeadRotationOffset;
+					resp.msg.dm_deviceOffsets.driverFromHeadTranslationOffset = config.driverFromHeadTranslationOffset;
+					resp.msg.dm_deviceOffsets.deviceRotationOffset = config.deviceRotationOffset;
+					resp.msg.dm_deviceOffsets.deviceTranslationOffset = config.deviceTranslationOffset;
+				}
+			}
+			if (resp.status != ipc::ReplyStatus::Ok) {
+				LOG(ERROR) << "Error while updating device button mapping: Error code " << (int)resp.status;
+			}
+			if (resp.messageId != 0) {
+				auto replyQueue = _this->_getReplyQueue(message.msg.dm_ButtonMapping.clientId);
+				if (replyQueue) {
+					replyQueue->send(&resp, resp.frameSize(), 0);
+				} else {
+					LOG(ERROR) << "Error while updating device button mapping: Unknown clientId " << message.msg.dm_ButtonMapping.clientId;
+				}
+			}
+		}
+		break;
+
+	case ipc::RequestType::DeviceManipulation_SetDeviceOffsets:
+		{
+			ipc::Reply resp(ipc::ReplyType::GenericReply);
+			resp.messageId = message.msg.dm_DeviceOffsets.messageId;
+			if (message.msg.dm_DeviceOffsets.deviceId >= vr::k_unMaxTrackedDeviceCount) {
+				resp.status = ipc::ReplyStatus::InvalidId;
+			} else {
+				OpenvrDeviceManipulationInfo* info = driver->deviceManipulation_getInfo(message.msg.dm_DeviceOffsets.deviceId);
+				if (!info) {
+					resp.status = ipc::ReplyStatus::NotFound;
+				} else {
+					resp.status = ipc::ReplyStatus::Ok;
+					if (message.msg.dm_DeviceOffsets.enableOffsets > 0) {
+						info->enableOffsets(message.msg.dm_DeviceOffsets.enableOffsets == 1 ? true : false);
+					}
+					switch (message.msg.dm_DeviceOffsets.offsetOperation) {
+					case 0:
+						if (message.msg.dm_DeviceOffsets.worldFromDriverRotationOffsetValid) {
+							info->setWorldFromDriverRotationOffset(message.msg.dm_DeviceOffsets.worldFromDriverRotationOffset);
+						}
+						if (message.msg.dm_DeviceOffsets.worldFromDriverTranslationOffsetValid) {
+							info->setWorldFromDriverTranslationOffset(message.msg.dm_DeviceOffsets.worldFromDriverTranslationOffset);
+						}
+						if (message.msg.dm_DeviceOffsets.driverFromHeadRotationOffsetValid) {
+							info->setDriverFromHeadRotationOffset(message.msg.dm_DeviceOffsets.driverFromHeadRotationOffset);
+						}
+						if (message.msg.dm_DeviceOffsets.driverFromHeadTranslationOffsetValid) {
+							info->setDriverFromHeadTranslationOffset(message.msg.dm_DeviceOffsets.driverFromHeadTranslationOffset);
+						}
+						if (message.msg.dm_DeviceOffsets.deviceRotationOffsetValid) {
+							info->setDeviceRotationOffset(message.msg.dm_DeviceOffsets.deviceRotationOffset);
+						}
+						if (message.msg.dm_DeviceOffsets.deviceTranslationOffsetValid) {
+							info->setDeviceTranslationOffset(message.msg.dm_DeviceOffsets.deviceTranslationOffset);
 						}
 						break;
-
-						case ipc::RequestType::DeviceManipulation_SetMotionCompensationProperties:
-						{
-							ipc::Reply resp(ipc::ReplyType::GenericReply);
-							resp.messageId = message.msg.dm_SetMotionCompensationProperties.messageId;
-							auto serverDriver = CServerDriver::getInstance();
-							if (serverDriver) {
-								serverDriver->setMotionCompensationVelAccMode(message.msg.dm_SetMotionCompensationProperties.velAccCompensationMode);
-								resp.status = ipc::ReplyStatus::Ok;
-							} else {
-								resp.status = ipc::ReplyStatus::UnknownError;
-							}
-							if (resp.status != ipc::ReplyStatus::Ok) {
-								LOG(ERROR) << "Error while setting motion compensation properties: Error code " << (int)resp.status;
-							}
-							if (resp.messageId != 0) {
-								auto i = _this->_ipcEndpoints.find(message.msg.dm_SetMotionCompensationProperties.clientId);
-								if (i != _this->_ipcEndpoints.end()) {
-									i->second->send(&resp, sizeof(ipc::Reply), 0);
-								} else {
-									LOG(ERROR) << "Error while setting motion compensation properties: Unknown clientId " << message.msg.dm_SetMotionCompensationProperties.clientId;
-								}
-							}
+					case 1:
+						if (message.msg.dm_DeviceOffsets.worldFromDriverRotationOffsetValid) {
+							info->setWorldFromDriverRotationOffset(message.msg.dm_DeviceOffsets.worldFromDriverRotationOffset * info->worldFromDriverRotationOffset());
+						}
+						if (message.msg.dm_DeviceOffsets.worldFromDriverTranslationOffsetValid) {
+							info->setWorldFromDriverTranslationOffset(info->worldFromDriverTranslationOffset() + message.msg.dm_DeviceOffsets.worldFromDriverTranslationOffset);
+						}
+						if (message.msg.dm_DeviceOffsets.driverFromHeadRotationOffsetValid) {
+							info->setDriverFromHeadRotationOffset(message.msg.dm_DeviceOffsets.driverFromHeadRotationOffset * info->driverFromHeadRotationOffset());
+						}
+						if (message.msg.dm_DeviceOffsets.driverFromHeadTranslationOffsetValid) {
+							info->setDriverFromHeadTranslationOffset(info->driverFromHeadTranslationOffset() + message.msg.dm_DeviceOffsets.driverFromHeadTranslationOffset);
+						}
+						if (message.msg.dm_DeviceOffsets.deviceRotationOffsetValid) {
+							info->setDeviceRotationOffset(message.msg.dm_DeviceOffsets.deviceRotationOffset * info->deviceRotationOffset());
+						}
+						if (message.msg.dm_DeviceOffsets.deviceTranslationOffsetValid) {
+							info->setDeviceTranslationOffset(info->deviceTranslationOffset() + message.msg.dm_DeviceOffsets.deviceTranslationOffset);
 						}
 						break;
+					}
+				}
+			}
+			if (resp.status != ipc::ReplyStatus::Ok) {
+				LOG(ERROR) << "Error while updating device pose offset: Error code " << (int)resp.status;
+			}
+			if (resp.messageId != 0) {
+				auto replyQueue = _this->_getReplyQueue(message.msg.dm_DeviceOffsets.clientId);
+				if (replyQueue) {
+					replyQueue->send(&resp, resp.frameSize(), 0);
+				} else {
+					LOG(ERROR) << "Error while updating device pose offset: Unknown clientId " << message.msg.dm_DeviceOffsets.clientId;
+				}
+			}
+		}
+		break;
 
-						default:
-							LOG(ERROR) << "Error in ipc server receive loop: Unknown message type (" << (int)message.type << ")";
-							break;
-						}
+	case ipc::RequestType::DeviceManipulation_DefaultMode:
+		{
+			ipc::Reply resp(ipc::ReplyType::GenericReply);
+			resp.messageId = message.msg.vd_GenericDeviceIdMessage.messageId;
+			if (message.msg.vd_GenericDeviceIdMessage.deviceId >= vr::k_unMaxTrackedDeviceCount) {
+				resp.status = ipc::ReplyStatus::InvalidId;
+			} else {
+				OpenvrDeviceManipulationInfo* info = driver->deviceManipulation_getInfo(message.msg.vd_GenericDeviceIdMessage.deviceId);
+				if (!info) {
+					resp.status = ipc::ReplyStatus::NotFound;
+				} else {
+					info->setDefaultMode();
+					resp.status = ipc::ReplyStatus::Ok;
+				}
+			}
+			if (resp.status != ipc::ReplyStatus::Ok) {
+				LOG(ERROR) << "Error while updating device pose offset: Error code " << (int)resp.status;
+			}
+			if (resp.messageId != 0) {
+				auto replyQueue = _this->_getReplyQueue(message.msg.vd_GenericDeviceIdMessage.clientId);
+				if (replyQueue) {
+					replyQueue->send(&resp, resp.frameSize(), 0);
+				} else {
+					LOG(ERROR) << "Error while updating device pose offset: Unknown clientId " << message.msg.vd_GenericDeviceIdMessage.clientId;
+				}
+			}
+		}
+		break;
+			
+	case ipc::RequestType::DeviceManipulation_RedirectMode:
+		{
+			ipc::Reply resp(ipc::ReplyType::GenericReply);
+			resp.messageId = message.msg.dm_RedirectMode.messageId;
+			if (message.msg.dm_RedirectMode.deviceId >= vr::k_unMaxTrackedDeviceCount) {
+				resp.status = ipc::ReplyStatus::InvalidId;
+			} else {
+				OpenvrDeviceManipulationInfo* info = driver->deviceManipulation_getInfo(message.msg.dm_RedirectMode.deviceId);
+				if (!info) {
+					resp.status = ipc::ReplyStatus::NotFound;
+				} else {
+					OpenvrDeviceManipulationInfo* infoTarget = driver->deviceManipulation_getInfo(message.msg.dm_RedirectMode.targetId);
+					if (info && (info->deviceMode() == 0 || info->deviceMode() == 1) 
+							&& infoTarget && (infoTarget->deviceMode() == 0 || infoTarget->deviceMode() == 1)) {
+						info->setRedirectMode(false, infoTarget);
+						infoTarget->setRedirectMode(true, info);
+						resp.status = ipc::ReplyStatus::Ok;
 					} else {
-						LOG(ERROR) << "Error in ipc server receive loop: received size is wrong (" << recv_size << " != " << sizeof(ipc::Request) << ")";
+						resp.status = ipc::ReplyStatus::UnknownError;
 					}
 				}
-			} catch (std::exception& ex) {
-				LOG(ERROR) << "Exception caught in ipc server receive loop: " << ex.what();
+			}
+			if (resp.status != ipc::ReplyStatus::Ok) {
+				LOG(ERROR) << "Error while updating device pose offset: Error code " << (int)resp.status;
+			}
+			if (resp.messageId != 0) {
+				auto replyQueue = _this->_getReplyQueue(message.msg.dm_RedirectMode.clientId);
+				if (replyQueue) {
+					replyQueue->send(&resp, resp.frameSize(), 0);
+				} else {
+					LOG(ERROR) << "Error while updating device pose offset: Unknown clientId " << message.msg.dm_RedirectMode.clientId;
+				}
+			}
+		}
+		break;
+
+	case ipc::RequestType::DeviceManipulation_SwapMode:
+	{
+		ipc::Reply resp(ipc::ReplyType::GenericReply);
+		resp.messageId = message.msg.dm_SwapMode.messageId;
+		if (message.msg.dm_SwapMode.deviceId >= vr::k_unMaxTrackedDeviceCount) {
+			resp.status = ipc::ReplyStatus::InvalidId;
+		} else {
+			OpenvrDeviceManipulationInfo* info = driver->deviceManipulation_getInfo(message.msg.dm_SwapMode.deviceId);
+			if (!info) {
+				resp.status = ipc::ReplyStatus::NotFound;
+			} else {
+				OpenvrDeviceManipulationInfo* infoTarget = driver->deviceManipulation_getInfo(message.msg.dm_SwapMode.targetId);
+				if (info && (info->deviceMode() == 0 || info->deviceMode() == 1)
+					&& infoTarget && (infoTarget->deviceMode() == 0 || infoTarget->deviceMode() == 1)) {
+					info->setSwapMode(infoTarget);
+					infoTarget->setSwapMode(info);
+					resp.status = ipc::ReplyStatus::Ok;
+				} else {
+					resp.status = ipc::ReplyStatus::UnknownError;
+				}
+			}
+		}
+		if (resp.status != ipc::ReplyStatus::Ok) {
+			LOG(ERROR) << "Error while updating device pose offset: Error code " << (int)resp.status;
+		}
+		if (resp.messageId != 0) {
+			auto replyQueue = _this->_getReplyQueue(message.msg.dm_SwapMode.clientId);
+			if (replyQueue) {
+				replyQueue->send(&resp, resp.frameSize(), 0);
+			} else {
+				LOG(ERROR) << "Error while updating device pose offset: Unknown clientId " << message.msg.dm_SwapMode.clientId;
 			}
 		}
-		boost::interprocess::message_queue::remove(_this->_ipcQueueName.c_str());
-	} catch (std::exception& ex) {
-		LOG(ERROR) << "Exception caught in ipc server thread: " << ex.what();
 	}
-	_this->_ipcThreadRunning = false;
-	LOG(DEBUG) << "CServerDriver::_ipcThreadFunc: thread stopped";
+	break;
+
+	case ipc::RequestType::DeviceManipulation_MotionCompensationMode:
+		{
+			ipc::Reply resp(ipc::ReplyType::GenericReply);
+			resp.messageId = message.msg.dm_MotionCompensationMode.messageId;
+			if (message.msg.dm_MotionCompensationMode.deviceId >= vr::k_unMaxTrackedDeviceCount) {
+				resp.status = ipc::ReplyStatus::InvalidId;
+			} else {
+				OpenvrDeviceManipulationInfo* info = driver->deviceManipulation_getInfo(message.msg.dm_MotionCompensationMode.deviceId);
+				if (!info) {
+					resp.status = ipc::ReplyStatus::NotFound;
+				} else {
+					auto serverDriver = CServerDriver::getInstance();
+					if (serverDriver) {
+						serverDriver->setMotionCompensationVelAccMode(message.msg.dm_MotionCompensationMode.velAccCompensationMode);
+						info->setMotionCompensationMode();
+						resp.status = ipc::ReplyStatus::Ok;
+					} else {
+						resp.status = ipc::ReplyStatus::UnknownError;
+					}
+				}
+			}
+			if (resp.status != ipc::ReplyStatus::Ok) {
+				LOG(ERROR) << "Error while updating device pose offset: Error code " << (int)resp.status;
+			}
+			if (resp.messageId != 0) {
+				auto replyQueue = _this->_getReplyQueue(message.msg.dm_MotionCompensationMode.clientId);
+				if (replyQueue) {
+					replyQueue->send(&resp, resp.frameSize(), 0);
+				} else {
+					LOG(ERROR) << "Error while updating device pose offset: Unknown clientId " << message.msg.dm_MotionCompensationMode.clientId;
+				}
+			}
+		}
+		break;
+
+	case ipc::RequestType::DeviceManipulation_FakeDisconnectedMode:
+	{
+		ipc::Reply resp(ipc::ReplyType::GenericReply);
+		resp.messageId = message.msg.vd_GenericDeviceIdMessage.messageId;
+		if (message.msg.vd_GenericDeviceIdMessage.deviceId >= vr::k_unMaxTrackedDeviceCount) {
+			resp.status = ipc::ReplyStatus::InvalidId;
+		} else {
+			OpenvrDeviceManipulationInfo* info = driver->deviceManipulation_getInfo(message.msg.vd_GenericDeviceIdMessage.deviceId);
+			if (!info) {
+				resp.status = ipc::ReplyStatus::NotFound;
+			} else {
+				info->setFakeDisconnectedMode();
+				resp.status = ipc::ReplyStatus::Ok;
+			}
+		}
+		if (resp.status != ipc::ReplyStatus::Ok) {
+			LOG(ERROR) << "Error while updating device pose offset: Error code " << (int)resp.status;
+		}
+		if (resp.messageId != 0) {
+			auto replyQueue = _this->_getReplyQueue(message.msg.vd_GenericDeviceIdMessage.clientId);
+			if (replyQueue) {
+				replyQueue->send(&resp, resp.frameSize(), 0);
+			} else {
+				LOG(ERROR) << "Error while updating device pose offset: Unknown clientId " << message.msg.vd_GenericDeviceIdMessage.clientId;
+			}
+		}
+	}
+	break;
+
+	case ipc::RequestType::DeviceManipulation_TriggerHapticPulse:
+	{
+		ipc::Reply resp(ipc::ReplyType::GenericReply);
+		resp.messageId = message.msg.dm_triggerHapticPulse.messageId;
+		if (message.msg.dm_triggerHapticPulse.deviceId >= vr::k_unMaxTrackedDeviceCount) {
+			resp.status = ipc::ReplyStatus::InvalidId;
+		} else {
+			OpenvrDeviceManipulationInfo* info = driver->deviceManipulation_getInfo(message.msg.dm_triggerHapticPulse.deviceId);
+			if (!info) {
+				resp.status = ipc::ReplyStatus::NotFound;
+			} else {
+				info->triggerHapticPulse(message.msg.dm_triggerHapticPulse.axisId, message.msg.dm_triggerHapticPulse.durationMicroseconds, message.msg.dm_triggerHapticPulse.directMode);
+				resp.status = ipc::ReplyStatus::Ok;
+			}
+		}
+		if (resp.status != ipc::ReplyStatus::Ok) {
+			LOG(ERROR) << "Error while triggering haptic pulse: Error code " << (int)resp.status;
+		}
+		if (resp.messageId != 0) {
+			auto replyQueue = _this->_getReplyQueue(message.msg.dm_triggerHapticPulse.clientId);
+			if (replyQueue) {
+				replyQueue->send(&resp, resp.frameSize(), 0);
+			} else {
+				LOG(ERROR) << "Error while triggering haptic pulse: Unknown clientId " << message.msg.dm_triggerHapticPulse.clientId;
+			}
+		}
+	}
+	break;
+
+	case ipc::RequestType::DeviceManipulation_SetMotionCompensationProperties:
+	{
+		ipc::Reply resp(ipc::ReplyType::GenericReply);
+		resp.messageId = message.msg.dm_SetMotionCompensationProperties.messageId;
+		auto serverDriver = CServerDriver::getInstance();
+		if (serverDriver) {
+			auto& props = message.msg.dm_SetMotionCompensationProperties;
+			if (props.kalmanFilterNoiseValid && !(props.kalmanFilterProcessNoise > 0.0 && props.kalmanFilterObservationNoise > 0.0)) {
+				resp.status = ipc::ReplyStatus::InvalidOperation; // the noise has to be positive
+			} else {
+				if (props.kalmanFilterNoiseValid) {
+					serverDriver->setMotionCompensationKalmanFilterNoise(props.kalmanFilterProcessNoise, props.kalmanFilterObservationNoise);
+				}
+				if (props.velAccCompensationModeValid) {
+					serverDriver->setMotionCompensationVelAccMode(props.velAccCompensationMode);
+				}
+				resp.status = ipc::ReplyStatus::Ok;
+			}
+		} else {
+			resp.status = ipc::ReplyStatus::UnknownError;
+		}
+		if (resp.status != ipc::ReplyStatus::Ok) {
+			LOG(ERROR) << "Error while setting motion compensation properties: Error code " << (int)resp.status;
+		}
+		if (resp.messageId != 0) {
+			auto replyQueue = _this->_getReplyQueue(message.msg.dm_SetMotionCompensationProperties.clientId);
+			if (replyQueue) {
+				replyQueue->send(&resp, resp.frameSize(), 0);
+			} else {
+				LOG(ERROR) << "Error while setting motion compensation properties: Unknown clientId " << message.msg.dm_SetMotionCompensationProperties.clientId;
+			}
+		}
+	}
+	break;
+
+	case ipc::RequestType::Debug_DumpTrace:
+	{
+		ipc::Reply resp(ipc::ReplyType::Debug_DumpTrace);
+		resp.messageId = message.msg.dbg_DumpTrace.messageId;
+		message.msg.dbg_DumpTrace.fileName[sizeof(message.msg.dbg_DumpTrace.fileName) - 1] = '\0';
+		std::string path;
+		uint64_t recordCount = 0;
+		uint32_t threadCount = 0;
+		if (!_this->_traceFilePath(message.msg.dbg_DumpTrace.fileName, path)) {
+			resp.status = ipc::ReplyStatus::InvalidOperation;
+			LOG(ERROR) << "Error while writing hook trace: Invalid file name \"" << message.msg.dbg_DumpTrace.fileName << "\"";
+		} else if (TraceRecorder::dump(path, recordCount, threadCount)) {
+			resp.status = ipc::ReplyStatus::Ok;
+			resp.msg.dbg_DumpTrace.recordCount = recordCount;
+			resp.msg.dbg_DumpTrace.threadCount = threadCount;
+			strncpy_s(resp.msg.dbg_DumpTrace.path, path.c_str(), sizeof(resp.msg.dbg_DumpTrace.path) - 1);
+			LOG(INFO) << "Hook trace written to " << path << ": " << recordCount << " records from " << threadCount << " threads";
+		} else {
+			resp.status = ipc::ReplyStatus::UnknownError;
+			LOG(ERROR) << "Error while writing hook trace: Could not write " << path;
+		}
+		if (resp.messageId != 0) {
+			auto replyQueue = _this->_getReplyQueue(message.msg.dbg_DumpTrace.clientId);
+			if (replyQueue) {
+				replyQueue->send(&resp, resp.frameSize(), 0);
+			} else {
+				LOG(ERROR) << "Error while writing hook trace: Unknown clientId " << message.msg.dbg_DumpTrace.clientId;
+			}
+		}
+	}
+	break;
+
+	case ipc::RequestType::Debug_GetHookStats:
+	{
+		ipc::Reply resp(ipc::ReplyType::Debug_GetHookStats);
+		resp.messageId = message.msg.dbg_GetHookStats.messageId;
+		resp.status = ipc::ReplyStatus::Ok;
+		auto& stats = resp.msg.dbg_GetHookStats;
+		stats.sampleTimeNs = TraceRecorder::now();
+		stats.totalEntries = HookStats::entryCount();
+		stats.firstEntry = message.msg.dbg_GetHookStats.firstEntry;
+		stats.entryCount = 0;
+		while (stats.entryCount < HOOKSTATS_ENTRIES_PER_REPLY
+				&& HookStats::getEntry(stats.firstEntry + stats.entryCount, stats.entries[stats.entryCount])) {
+			stats.entryCount++;
+		}
+		if (resp.messageId != 0) {
+			auto replyQueue = _this->_getReplyQueue(message.msg.dbg_GetHookStats.clientId);
+			if (replyQueue) {
+				replyQueue->send(&resp, resp.frameSize(), 0);
+			} else {
+				LOG(ERROR) << "Error while getting hook stats: Unknown clientId " << message.msg.dbg_GetHookStats.clientId;
+			}
+		}
+	}
+	break;
+
+	case ipc::RequestType::Debug_SetLatencyTracing:
+	{
+		ipc::Reply resp(ipc::ReplyType::GenericReply);
+		resp.messageId = message.msg.dbg_SetLatencyTracing.messageId;
+		if (LatencyStats::setTraced(message.msg.dbg_SetLatencyTracing.clientId, message.msg.dbg_SetLatencyTracing.enable != 0)) {
+			resp.status = ipc::ReplyStatus::Ok;
+		} else {
+			resp.status = ipc::ReplyStatus::InvalidOperation;
+			LOG(ERROR) << "Error while enabling latency tracing: Too many traced clients";
+		}
+		if (resp.messageId != 0) {
+			auto replyQueue = _this->_getReplyQueue(message.msg.dbg_SetLatencyTracing.clientId);
+			if (replyQueue) {
+				replyQueue->send(&resp, resp.frameSize(), 0);
+			} else {
+				LOG(ERROR) << "Error while enabling latency tracing: Unknown clientId " << message.msg.dbg_SetLatencyTracing.clientId;
+			}
+		}
+	}
+	break;
+
+	case ipc::RequestType::Debug_GetLatencyStats:
+	{
+		ipc::Reply resp(ipc::ReplyType::Debug_GetLatencyStats);
+		resp.messageId = message.msg.dbg_GetLatencyStats.messageId;
+		resp.status = ipc::ReplyStatus::Ok;
+		auto& stats = resp.msg.dbg_GetLatencyStats;
+		stats.sampleTimeNs = TraceRecorder::now();
+		stats.totalEntries = LatencyStats::entryCount();
+		stats.firstEntry = message.msg.dbg_GetLatencyStats.firstEntry;
+		stats.entryCount = 0;
+		while (stats.entryCount < LATENCYSTATS_ENTRIES_PER_REPLY
+				&& LatencyStats::getEntry(stats.firstEntry + stats.entryCount, stats.entries[stats.entryCount])) {
+			stats.entryCount++;
+		}
+		if (resp.messageId != 0) {
+			auto replyQueue = _this->_getReplyQueue(message.msg.dbg_GetLatencyStats.clientId);
+			if (replyQueue) {
+				replyQueue->send(&resp, resp.frameSize(), 0);
+			} else {
+				LOG(ERROR) << "Error while getting latency stats: Unknown clientId " << message.msg.dbg_GetLatencyStats.clientId;
+			}
+		}
+	}
+	break;
+
+	default:
+		LOG(ERROR) << "Error in ipc server receive loop: Unknown message type (" << (int)message.type << ")";
+		break;	}
 }
 
 
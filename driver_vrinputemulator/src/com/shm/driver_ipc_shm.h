@@ -3,8 +3,20 @@
 #include <thread>
 #include <string>
 #include <map>
+#include <set>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <vector>
 #include <boost/interprocess/ipc/message_queue.hpp>
+#include <boost/interprocess/sync/named_semaphore.hpp>
+#include <openvr_driver.h>
+#include <ipc_protocol.h>
+#include <ipc_shmring.h>
+#include <ipc_shmposetable.h>
 
 
 // driver namespace
@@ -15,13 +27,129 @@ namespace driver {
 class CServerDriver;
 
 
+/**
+ * Requests from the server message queue are handled on two planes: The data plane (pose and input injection,
+ * served by the data ring thread together with the data rings and the pose table) and the control plane
+ * (everything else, served by the control thread). The ipc thread only receives and dispatches, so a slow
+ * publish or property write no longer holds up the poses queued behind it.
+ *
+ * The data plane keeps one inbound lane per client (its data requests from the message queue plus its data ring,
+ * requests without a known client share lane 0). Lanes are served by a deficit round-robin scheduler, each lane
+ * may spend its quantum (weight * _dataLaneQuantum bytes, the weight is set on connect) per round, so a client
+ * flooding poses cannot starve the button events of another client. A full lane never stalls the ipc thread:
+ * the lane's oldest pose nobody waits for is dropped to make room, without one the new request is rejected.
+ *
+ * Ordering guarantee: Requests of one client from the message queue that refer to the same device are applied
+ * in the order they were received, no matter which plane handles them. A data request for a device with pending
+ * control requests is handed to the control plane as well, and a control request waits until all data requests
+ * for its device that were received before it have been applied. OpenVR device ids and virtual device ids are
+ * tracked separately. Requests sent over the data rings or the pose table are not part of this ordering.
+ */
 class IpcShmCommunicator {
 public:
 	void init(CServerDriver* driver);
 	void shutdown();
 
+	// Called at the start of every frame. Applies new poses from the shared pose table.
+	// Batches are applied under the same lock, so a batch never straddles two frames.
+	void runFrame();
+
 private:
+	// Reply queue of a client. Replies are sent without blocking, when the queue is full the client's
+	// overflow policy decides what happens.
+	class ReplyQueue {
+	public:
+		ReplyQueue(const char* name, ReplyOverflowPolicy policy);
+
+		// Returns false when the reply has been dropped
+		bool send(const void* buffer, size_t size, unsigned priority);
+		void getStatus(ipc::Reply_IPC_ClientStatus& status);
+		uint64_t repliesDropped() const { return _repliesDropped; }
+		// Disconnect policy only: the queue has overflowed and the client is going to be dropped
+		bool overflowed() const { return _overflowed; }
+
+		const ReplyOverflowPolicy policy;
+
+	private:
+		boost::interprocess::message_queue _queue;
+		std::atomic<uint64_t> _repliesSent = { 0 };
+		std::atomic<uint64_t> _repliesDropped = { 0 };
+		std::atomic<bool> _overflowed = { false };
+	};
+
+	struct IpcEndpoint {
+		std::shared_ptr<ReplyQueue> replyQueue;
+		std::shared_ptr<void> process; // optional, handle of the client process
+		uint64_t repliesDroppedLogged = 0;
+	};
+
+	static const int _deviceKeyNone = -1;
+	static const int _deviceKeyAll = 2 * vr::k_unMaxTrackedDeviceCount; // request may touch any device
+	static const int _deviceKeyCount = 2 * vr::k_unMaxTrackedDeviceCount + 1; // openvr ids, virtual ids, all
+	static const size_t _maxPlaneQueueSize = 256;
+	static const int64_t _dataLaneQuantum = 4096; // bytes per round and weight unit
+	static const uint32_t _dataLaneMaxWeight = 16;
+
+	struct PlaneRequest {
+		ipc::Request request;
+		std::chrono::steady_clock::time_point enqueueTime;
+		int deviceKey = _deviceKeyNone;
+		bool controlBarrier = false; // counted in _controlPending, released when the control plane is done with it
+	};
+
+	struct DataLane {
+		uint32_t clientId = 0;
+		int64_t quantum = _dataLaneQuantum;
+		int64_t deficit = 0; // data ring thread only
+		std::shared_ptr<ipc::ShmRing> ring; // optional
+		std::deque<PlaneRequest> requests; // guarded by _dataPlaneMutex
+		bool closed = false; // guarded by _dataPlaneMutex, client is gone, lane is removed once it is empty
+	};
+
+	// Newest pose update per device of the requests handled in one lane turn (see _coalescePose())
+	struct PoseCoalescer {
+		struct Slot {
+			PlaneRequest entry;
+			bool queued = false; // from the message queue, counts in _dataPending
+			bool used = false;
+		};
+		std::vector<Slot> slots = std::vector<Slot>(_deviceKeyAll);
+		std::vector<int> order; // used slots in order of arrival
+	};
+
+	struct PlaneStats {
+		std::atomic<uint64_t> requestCount = { 0 };
+		std::atomic<uint64_t> totalDelayUs = { 0 };
+		std::atomic<uint64_t> maxDelayUs = { 0 };
+		void add(const std::chrono::steady_clock::time_point& enqueueTime);
+	};
+
 	static void _ipcThreadFunc(IpcShmCommunicator* _this, CServerDriver* driver);
+	static void _dataRingThreadFunc(IpcShmCommunicator* _this, CServerDriver* driver);
+	static void _controlThreadFunc(IpcShmCommunicator* _this, CServerDriver* driver);
+	static int _requestDeviceKey(const ipc::Request& message);
+	void _reapEndpoints();
+	static uint32_t _requestClientId(const ipc::Request& message);
+	static int64_t _timePointNs(const std::chrono::steady_clock::time_point& time);
+	void _dispatchRequest(const ipc::Request& message);
+	void _rejectRequest(const ipc::Request& message);
+	void _releaseDataPending(int deviceKey);
+	void _handleDataPlaneRequest(CServerDriver* driver, PlaneRequest& entry, bool queued);
+	static bool _isCoalescablePose(const ipc::Request& message);
+	void _coalescePose(PoseCoalescer& poses, PlaneRequest& entry, bool queued);
+	void _flushPoses(CServerDriver* driver, PoseCoalescer& poses);
+	void _openDataLane(uint32_t clientId, std::shared_ptr<ipc::ShmRing> ring, uint32_t weight);
+	void _closeDataLane(uint32_t clientId);
+	void _logPlaneStats();
+	static void _handleRequest(IpcShmCommunicator* _this, CServerDriver* driver, ipc::Request& message, int64_t dequeueNs);
+	static void _handleBatch(IpcShmCommunicator* _this, CServerDriver* driver, ipc::Request& message, int64_t dequeueNs);
+	void _replyClockSync(const ipc::Request& message);
+	bool _traceFilePath(const char* fileName, std::string& path);
+	static bool _isDataRingRequest(ipc::RequestType type);
+	static bool _isBatchableRequest(ipc::RequestType type);
+	std::shared_ptr<ReplyQueue> _getReplyQueue(uint32_t clientId);
+	void _ringDataDoorbell();
+	bool _applyPoseTable(CServerDriver* driver);
 
 	CServerDriver* _driver = nullptr;
 	std::thread _ipcThread;
@@ -29,7 +157,48 @@ private:
 	volatile bool _ipcThreadStopFlag = false;
 	std::string _ipcQueueName = "driver_vrinputemulator.server_queue";
 	uint32_t _ipcClientIdNext = 1;
-	std::map<uint32_t, std::shared_ptr<boost::interprocess::message_queue>> _ipcEndpoints;
+	std::mutex _ipcEndpointsMutex;
+	std::map<uint32_t, IpcEndpoint> _ipcEndpoints;
+
+	std::thread _dataRingThread;
+	volatile bool _dataRingThreadRunning = false;
+	std::string _ipcDataDoorbellName = "driver_vrinputemulator.data_doorbell";
+	std::unique_ptr<boost::interprocess::named_semaphore> _ipcDataDoorbell;
+
+	std::mutex _dataPlaneMutex;
+	std::map<uint32_t, std::shared_ptr<DataLane>> _dataLanes; // clientId -> lane, guarded by _dataPlaneMutex
+	std::atomic<uint32_t> _dataLanesVersion = { 0 }; // Incremented on every change so the data ring thread knows when to refresh its lane list
+	size_t _dataPlaneQueued = 0; // requests in all lanes, guarded by _dataPlaneMutex
+	std::atomic<uint32_t> _dataPlaneWaiting = { 0 }; // set while the data ring thread is about to sleep on the doorbell
+	std::atomic<uint32_t> _dataPending[_deviceKeyCount] = {}; // data requests from the message queue in flight per device
+	std::atomic<uint32_t> _dataPendingTotal = { 0 };
+	std::mutex _dataPendingMutex;
+	std::condition_variable _dataPendingCondition; // signaled when _dataPending drops while the control plane waits for it
+	std::atomic<uint32_t> _dataPendingWaiting = { 0 }; // set while the control thread waits on _dataPendingCondition
+	PlaneStats _dataPlaneStats;
+	std::atomic<uint64_t> _posesCoalesced = { 0 }; // pose updates skipped because a newer one for the same device was queued
+	std::atomic<uint64_t> _laneRequestsDropped = { 0 }; // requests dropped from (or rejected by) a full lane, see _dispatchRequest()
+
+	std::thread _controlThread;
+	std::mutex _controlPlaneMutex;
+	std::condition_variable _controlPlaneCondition;
+	std::deque<PlaneRequest> _controlPlaneQueue;
+	std::atomic<uint32_t> _controlPending[_deviceKeyCount] = {}; // control requests in flight per device
+	std::atomic<uint32_t> _controlPendingTotal = { 0 };
+	PlaneStats _controlPlaneStats;
+	std::atomic<uint64_t> _controlRequestsRejected = { 0 }; // requests rejected because the control plane queue was full
+
+	std::string _poseTableName = "driver_vrinputemulator.pose_table";
+	std::string _traceDirectory = "driver_vrinputemulator_traces"; // relative to the working directory, like the driver log
+	std::unique_ptr<ipc::ShmPoseTable> _poseTable;
+	std::mutex _poseTableMutex;
+	uint32_t _poseTableSequences[ipc::ShmPoseTable::slotCount] = {}; // sequence number of the last applied pose per slot
+
+	static const size_t _maxBatchSize = 64 * 1024;
+	std::mutex _frameMutex;
+	std::mutex _pendingBatchesMutex;
+	std::map<std::pair<uint32_t, uint32_t>, std::vector<uint8_t>> _pendingBatches; // (clientId, batchId) -> data received so far
+	std::set<std::pair<uint32_t, uint32_t>> _rejectedBatches; // (clientId, batchId) of batches with a part dropped from a full lane
 };
 
 
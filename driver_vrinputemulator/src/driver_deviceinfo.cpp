@@ -14,141 +14,260 @@ namespace driver {
 		lhs[2] += rhs.v[2];
 
 
-void OpenvrDeviceManipulationInfo::handleNewDevicePose(vr::IVRServerDriverHost* driver, _DetourTrackedDevicePoseUpdated_t origFunc, uint32_t& unWhichDevice, const vr::DriverPose_t& pose) {
-	std::lock_guard<std::recursive_mutex> lock(_mutex);
-	if (m_deviceMode == 1) { // fake disconnect mode
-		if (!_disconnectedMsgSend) {
-			vr::DriverPose_t newPose = pose;
-			newPose.poseIsValid = false;
-			newPose.deviceIsConnected = false;
-			newPose.result = vr::TrackingResult_Uninitialized;
-			_disconnectedMsgSend = true;
-			origFunc(driver, unWhichDevice, newPose, sizeof(vr::DriverPose_t));
-		}
-	} else if (m_deviceMode == 3 && !m_redirectSuspended) { // redirect target
-		//nop
-	} else if (m_deviceMode == 5) { // motion compensation mode
-		auto serverDriver = CServerDriver::getInstance();
-		if (serverDriver) {
-			if (pose.poseIsValid && pose.result == vr::TrackingResult_Running_OK) {
-				if (!serverDriver->_isMotionCompensationZeroPoseValid()) {
-					serverDriver->_setMotionCompensationZeroPose(pose);
-				} else {
-					serverDriver->_updateMotionCompensationRefPose(pose);
-				}
-			}
-		}
-		if (!_disconnectedMsgSend) {
-			vr::DriverPose_t newPose = pose;
-			newPose.poseIsValid = false;
-			newPose.deviceIsConnected = false;
-			newPose.result = vr::TrackingResult_Uninitialized;
-			_disconnectedMsgSend = true;
-			origFunc(driver, unWhichDevice, newPose, sizeof(vr::DriverPose_t));
+std::recursive_mutex OpenvrDeviceManipulationInfo::_configWriteMutex;
+
+
+static bool _isIdentity(const vr::HmdQuaternion_t& q) {
+	return q.w == 1.0 && q.x == 0.0 && q.y == 0.0 && q.z == 0.0;
+}
+
+static bool _isZero(const vr::HmdVector3d_t& v) {
+	return v.v[0] == 0.0 && v.v[1] == 0.0 && v.v[2] == 0.0;
+}
+
+static vr::EVRButtonId _mapButton(const OpenvrDeviceManipulationConfig& config, vr::EVRButtonId button) {
+	if (config.enableButtonMapping) {
+		auto i = config.buttonMapping.find(button);
+		if (i != config.buttonMapping.end()) {
+			return i->second;
 		}
-	} else {
+	}
+	return button;
+}
+
+void OpenvrDeviceManipulationConfig::compileOffsets() {
+	offsetsActive = offsetsEnabled && (!_isIdentity(worldFromDriverRotationOffset) || !_isZero(worldFromDriverTranslationOffset)
+		|| !_isIdentity(driverFromHeadRotationOffset) || !_isZero(driverFromHeadTranslationOffset)
+		|| !_isIdentity(deviceRotationOffset) || !_isZero(deviceTranslationOffset));
+}
+
+
+template<typename F>
+void OpenvrDeviceManipulationInfo::_updateConfig(F change) {
+	std::lock_guard<std::recursive_mutex> lock(_configWriteMutex);
+	auto config = _config.copy();
+	change(config);
+	config.compileOffsets();
+	config.selectModeHandler();
+	_config.publish(config);
+}
+
+
+const OpenvrDeviceManipulationInfo::ModeHandlers OpenvrDeviceManipulationInfo::_modeHandlers[(int)DeviceModeHandler::Count] = {
+	// Default
+	{ &OpenvrDeviceManipulationInfo::_poseDefault, &OpenvrDeviceManipulationInfo::_buttonDefault, &OpenvrDeviceManipulationInfo::_axisDefault, &OpenvrDeviceManipulationInfo::_hapticDefault },
+	// FakeDisconnected
+	{ &OpenvrDeviceManipulationInfo::_poseFakeDisconnected, &OpenvrDeviceManipulationInfo::_buttonNop, &OpenvrDeviceManipulationInfo::_axisNop, &OpenvrDeviceManipulationInfo::_hapticNop },
+	// RedirectSource
+	{ &OpenvrDeviceManipulationInfo::_poseRedirectSource, &OpenvrDeviceManipulationInfo::_buttonRedirectSource, &OpenvrDeviceManipulationInfo::_axisForward, &OpenvrDeviceManipulationInfo::_hapticNop },
+	// RedirectTarget
+	{ &OpenvrDeviceManipulationInfo::_poseNop, &OpenvrDeviceManipulationInfo::_buttonRedirectTarget, &OpenvrDeviceManipulationInfo::_axisNop, &OpenvrDeviceManipulationInfo::_hapticForward },
+	// RedirectSuspended
+	{ &OpenvrDeviceManipulationInfo::_poseDefault, &OpenvrDeviceManipulationInfo::_buttonRedirectSuspended, &OpenvrDeviceManipulationInfo::_axisDefault, &OpenvrDeviceManipulationInfo::_hapticDefault },
+	// Swap
+	{ &OpenvrDeviceManipulationInfo::_poseSwap, &OpenvrDeviceManipulationInfo::_buttonForward, &OpenvrDeviceManipulationInfo::_axisForward, &OpenvrDeviceManipulationInfo::_hapticForward },
+	// MotionCompensation
+	{ &OpenvrDeviceManipulationInfo::_poseMotionCompensation, &OpenvrDeviceManipulationInfo::_buttonNop, &OpenvrDeviceManipulationInfo::_axisNop, &OpenvrDeviceManipulationInfo::_hapticNop },
+};
+
+void OpenvrDeviceManipulationConfig::selectModeHandler() {
+	switch (deviceMode) {
+	case 1:
+		modeHandler = DeviceModeHandler::FakeDisconnected;
+		break;
+	case 2:
+		modeHandler = redirectSuspended ? DeviceModeHandler::RedirectSuspended : DeviceModeHandler::RedirectSource;
+		break;
+	case 3:
+		modeHandler = redirectSuspended ? DeviceModeHandler::RedirectSuspended : DeviceModeHandler::RedirectTarget;
+		break;
+	case 4:
+		modeHandler = DeviceModeHandler::Swap;
+		break;
+	case 5:
+		modeHandler = DeviceModeHandler::MotionCompensation;
+		break;
+	default:
+		modeHandler = DeviceModeHandler::Default;
+		break;
+	}
+}
+
+
+void OpenvrDeviceManipulationInfo::handleNewDevicePose(vr::IVRServerDriverHost* driver, _DetourTrackedDevicePoseUpdated_t origFunc, uint32_t& unWhichDevice, const vr::DriverPose_t& pose) {
+	auto config = _config.read();
+	TraceScope::setMode((uint8_t)config->modeHandler);
+	(this->*_modeHandlers[(int)config->modeHandler].pose)(*config, driver, origFunc, unWhichDevice, pose);
+}
+
+void OpenvrDeviceManipulationInfo::_transformPose(const OpenvrDeviceManipulationConfig& config, vr::DriverPose_t& newPose) {
+	if (config.offsetsActive) {
+		// Multiplying with an identity offset or adding a zero offset leaves the pose as it is, so all offsets are applied unconditionally
+		newPose.qWorldFromDriverRotation = config.worldFromDriverRotationOffset * newPose.qWorldFromDriverRotation;
+		VECTOR_ADD(newPose.vecWorldFromDriverTranslation, config.worldFromDriverTranslationOffset);
+		newPose.qDriverFromHeadRotation = config.driverFromHeadRotationOffset * newPose.qDriverFromHeadRotation;
+		VECTOR_ADD(newPose.vecDriverFromHeadTranslation, config.driverFromHeadTranslationOffset);
+		newPose.qRotation = config.deviceRotationOffset * newPose.qRotation;
+		VECTOR_ADD(newPose.vecPosition, config.deviceTranslationOffset);
+	}
+	auto serverDriver = CServerDriver::getInstance();
+	if (serverDriver) {
+		serverDriver->_applyMotionCompensation(newPose, this);
+	}
+}
+
+void OpenvrDeviceManipulationInfo::_sendDisconnectedPose(vr::IVRServerDriverHost* driver, _DetourTrackedDevicePoseUpdated_t origFunc, uint32_t unWhichDevice, const vr::DriverPose_t& pose) {
+	if (!_disconnectedMsgSend.exchange(true)) {
 		vr::DriverPose_t newPose = pose;
-		if (m_offsetsEnabled) {
-			if (m_worldFromDriverRotationOffset.w != 1.0 || m_worldFromDriverRotationOffset.x != 0.0
-					|| m_worldFromDriverRotationOffset.y != 0.0 || m_worldFromDriverRotationOffset.z != 0.0) {
-				newPose.qWorldFromDriverRotation = m_worldFromDriverRotationOffset * newPose.qWorldFromDriverRotation;
-			}
-			if (m_worldFromDriverTranslationOffset.v[0] != 0.0 || m_worldFromDriverTranslationOffset.v[1] != 0.0 || m_worldFromDriverTranslationOffset.v[2] != 0.0) {
-				VECTOR_ADD(newPose.vecWorldFromDriverTranslation, m_worldFromDriverTranslationOffset);
-			}
-			if (m_driverFromHeadRotationOffset.w != 1.0 || m_driverFromHeadRotationOffset.x != 0.0
-					|| m_driverFromHeadRotationOffset.y != 0.0 || m_driverFromHeadRotationOffset.z != 0.0) {
-				newPose.qDriverFromHeadRotation = m_driverFromHeadRotationOffset * newPose.qDriverFromHeadRotation;
-			}
-			if (m_driverFromHeadTranslationOffset.v[0] != 0.0 || m_driverFromHeadTranslationOffset.v[1] != 0.0 || m_driverFromHeadTranslationOffset.v[2] != 0.0) {
-				VECTOR_ADD(newPose.vecDriverFromHeadTranslation, m_driverFromHeadTranslationOffset);
-			}
-			if (m_deviceRotationOffset.w != 1.0 || m_deviceRotationOffset.x != 0.0
-					|| m_deviceRotationOffset.y != 0.0 || m_deviceRotationOffset.z != 0.0) {
-				newPose.qRotation = m_deviceRotationOffset * newPose.qRotation;
-			}
-			if (m_deviceTranslationOffset.v[0] != 0.0 || m_deviceTranslationOffset.v[1] != 0.0 || m_deviceTranslationOffset.v[2] != 0.0) {
-				VECTOR_ADD(newPose.vecPosition, m_deviceTranslationOffset);
-			}
-		}
-		auto serverDriver = CServerDriver::getInstance();
-		if (serverDriver) {
-			serverDriver->_applyMotionCompensation(newPose, this);
-		}
-		if (m_deviceMode == 2 && !m_redirectSuspended) { // redirect source
-			if (!_disconnectedMsgSend) {
-				vr::DriverPose_t newPose2 = pose;
-				newPose2.poseIsValid = false;
-				newPose2.deviceIsConnected = false;
-				newPose2.result = vr::TrackingResult_Uninitialized;
-				_disconnectedMsgSend = true;
-				origFunc(driver, unWhichDevice, newPose2, sizeof(vr::DriverPose_t));
+		newPose.poseIsValid = false;
+		newPose.deviceIsConnected = false;
+		newPose.result = vr::TrackingResult_Uninitialized;
+		traceVrserverCall(origFunc, driver, unWhichDevice, newPose, sizeof(vr::DriverPose_t));
+	}
+}
+
+void OpenvrDeviceManipulationInfo::_poseDefault(const OpenvrDeviceManipulationConfig& config, vr::IVRServerDriverHost* driver, _DetourTrackedDevicePoseUpdated_t origFunc, uint32_t unWhichDevice, const vr::DriverPose_t& pose) {
+	vr::DriverPose_t newPose = pose;
+	_transformPose(config, newPose);
+	traceVrserverCall(origFunc, driver, unWhichDevice, newPose, sizeof(vr::DriverPose_t));
+}
+
+void OpenvrDeviceManipulationInfo::_poseFakeDisconnected(const OpenvrDeviceManipulationConfig& config, vr::IVRServerDriverHost* driver, _DetourTrackedDevicePoseUpdated_t origFunc, uint32_t unWhichDevice, const vr::DriverPose_t& pose) {
+	_sendDisconnectedPose(driver, origFunc, unWhichDevice, pose);
+}
+
+void OpenvrDeviceManipulationInfo::_poseRedirectSource(const OpenvrDeviceManipulationConfig& config, vr::IVRServerDriverHost* driver, _DetourTrackedDevicePoseUpdated_t origFunc, uint32_t unWhichDevice, const vr::DriverPose_t& pose) {
+	vr::DriverPose_t newPose = pose;
+	_transformPose(config, newPose);
+	_sendDisconnectedPose(driver, origFunc, unWhichDevice, pose);
+	traceVrserverCall(origFunc, driver, config.redirectRef->openvrId(), newPose, sizeof(vr::DriverPose_t));
+}
+
+void OpenvrDeviceManipulationInfo::_poseSwap(const OpenvrDeviceManipulationConfig& config, vr::IVRServerDriverHost* driver, _DetourTrackedDevicePoseUpdated_t origFunc, uint32_t unWhichDevice, const vr::DriverPose_t& pose) {
+	vr::DriverPose_t newPose = pose;
+	_transformPose(config, newPose);
+	traceVrserverCall(origFunc, driver, config.redirectRef->openvrId(), newPose, sizeof(vr::DriverPose_t));
+}
+
+void OpenvrDeviceManipulationInfo::_poseMotionCompensation(const OpenvrDeviceManipulationConfig& config, vr::IVRServerDriverHost* driver, _DetourTrackedDevicePoseUpdated_t origFunc, uint32_t unWhichDevice, const vr::DriverPose_t& pose) {
+	auto serverDriver = CServerDriver::getInstance();
+	if (serverDriver) {
+		if (pose.poseIsValid && pose.result == vr::TrackingResult_Running_OK) {
+			if (!serverDriver->_isMotionCompensationZeroPoseValid()) {
+				serverDriver->_setMotionCompensationZeroPose(pose);
+			} else {
+				serverDriver->_updateMotionCompensationRefPose(pose);
 			}
-			origFunc(driver, m_redirectRef->openvrId(), newPose, sizeof(vr::DriverPose_t));
-		} else if (m_deviceMode == 4) { // swap mode
-			origFunc(driver, m_redirectRef->openvrId(), newPose, sizeof(vr::DriverPose_t));
-		} else {
-			origFunc(driver, unWhichDevice, newPose, sizeof(vr::DriverPose_t));
 		}
 	}
+	_sendDisconnectedPose(driver, origFunc, unWhichDevice, pose);
 }
 
 
 void OpenvrDeviceManipulationInfo::handleButtonEvent(vr::IVRServerDriverHost* driver, void* origFunc, uint32_t& unWhichDevice, ButtonEventType eventType, vr::EVRButtonId eButtonId, double eventTimeOffset) {
-	std::lock_guard<std::recursive_mutex> lock(_mutex);
-	if (eButtonId == vr::k_EButton_System && (m_deviceMode == 2 || m_deviceMode == 3)) {
-		if (eventType == ButtonEventType::ButtonUnpressed) {
-			m_redirectSuspended = !m_redirectSuspended;
-			_disconnectedMsgSend = false;
-			m_redirectRef->m_redirectSuspended = m_redirectSuspended;
-			m_redirectRef->_disconnectedMsgSend = false;
-		}
-	} else if (m_deviceMode == 1 || (m_deviceMode == 3 && !m_redirectSuspended) || m_deviceMode == 5) {
-		//nop
-	} else {
-		vr::EVRButtonId button = eButtonId;
-		getButtonMapping(eButtonId, button);
-		if (m_deviceMode == 0 || ((m_deviceMode == 3 || m_deviceMode == 2) && m_redirectSuspended)) {
-			((_DetourTrackedDeviceButtonPressed_t)origFunc)(driver, unWhichDevice, button, eventTimeOffset);
-		} else if ((m_deviceMode == 2 && !m_redirectSuspended) || m_deviceMode == 4) {
-			((_DetourTrackedDeviceButtonPressed_t)origFunc)(driver, m_redirectRef->openvrId(), button, eventTimeOffset);
-		}
+	bool toggleRedirect;
+	{
+		auto config = _config.read();
+		TraceScope::setMode((uint8_t)config->modeHandler);
+		toggleRedirect = (this->*_modeHandlers[(int)config->modeHandler].button)(*config, driver, origFunc, unWhichDevice, eventType, eButtonId, eventTimeOffset);
+	}
+	// Outside of the read, so publishing can free the old snapshot right away instead of deferring it
+	if (toggleRedirect) {
+		_toggleRedirectSuspended();
 	}
 }
 
-void OpenvrDeviceManipulationInfo::handleAxisEvent(vr::IVRServerDriverHost* driver, _DetourTrackedDeviceAxisUpdated_t origFunc, uint32_t& unWhichDevice, uint32_t unWhichAxis, const vr::VRControllerAxis_t& axisState) {
-	std::lock_guard<std::recursive_mutex> lock(_mutex);
-	if (m_deviceMode == 1 || (m_deviceMode == 3 && !m_redirectSuspended) || m_deviceMode == 5) {
-		//nop
-	} else {
-		if (m_deviceMode == 0 || ((m_deviceMode == 3 || m_deviceMode == 2) && m_redirectSuspended)) {
-			origFunc(driver, unWhichDevice, unWhichAxis, axisState);
-		} else if ((m_deviceMode == 2 && !m_redirectSuspended) || m_deviceMode == 4) {
-			origFunc(driver, m_redirectRef->openvrId(), unWhichAxis, axisState);
-		}
+bool OpenvrDeviceManipulationInfo::_buttonDefault(const OpenvrDeviceManipulationConfig& config, vr::IVRServerDriverHost* driver, void* origFunc, uint32_t unWhichDevice, ButtonEventType eventType, vr::EVRButtonId eButtonId, double eventTimeOffset) {
+	auto button = _mapButton(config, eButtonId);
+	traceVrserverCall((_DetourTrackedDeviceButtonPressed_t)origFunc, driver, unWhichDevice, button, eventTimeOffset);
+	return false;
+}
+
+bool OpenvrDeviceManipulationInfo::_buttonForward(const OpenvrDeviceManipulationConfig& config, vr::IVRServerDriverHost* driver, void* origFunc, uint32_t unWhichDevice, ButtonEventType eventType, vr::EVRButtonId eButtonId, double eventTimeOffset) {
+	auto button = _mapButton(config, eButtonId);
+	traceVrserverCall((_DetourTrackedDeviceButtonPressed_t)origFunc, driver, config.redirectRef->openvrId(), button, eventTimeOffset);
+	return false;
+}
+
+// In redirect mode the system button toggles the redirect suspension
+bool OpenvrDeviceManipulationInfo::_buttonRedirectSource(const OpenvrDeviceManipulationConfig& config, vr::IVRServerDriverHost* driver, void* origFunc, uint32_t unWhichDevice, ButtonEventType eventType, vr::EVRButtonId eButtonId, double eventTimeOffset) {
+	if (eButtonId == vr::k_EButton_System) {
+		return eventType == ButtonEventType::ButtonUnpressed;
+	}
+	return _buttonForward(config, driver, origFunc, unWhichDevice, eventType, eButtonId, eventTimeOffset);
+}
+
+bool OpenvrDeviceManipulationInfo::_buttonRedirectTarget(const OpenvrDeviceManipulationConfig& config, vr::IVRServerDriverHost* driver, void* origFunc, uint32_t unWhichDevice, ButtonEventType eventType, vr::EVRButtonId eButtonId, double eventTimeOffset) {
+	if (eButtonId == vr::k_EButton_System) {
+		return eventType == ButtonEventType::ButtonUnpressed;
 	}
+	return false;
+}
+
+bool OpenvrDeviceManipulationInfo::_buttonRedirectSuspended(const OpenvrDeviceManipulationConfig& config, vr::IVRServerDriverHost* driver, void* origFunc, uint32_t unWhichDevice, ButtonEventType eventType, vr::EVRButtonId eButtonId, double eventTimeOffset) {
+	if (eButtonId == vr::k_EButton_System) {
+		return eventType == ButtonEventType::ButtonUnpressed;
+	}
+	return _buttonDefault(config, driver, origFunc, unWhichDevice, eventType, eButtonId, eventTimeOffset);
+}
+
+void OpenvrDeviceManipulationInfo::_toggleRedirectSuspended() {
+	std::lock_guard<std::recursive_mutex> lock(_configWriteMutex);
+	auto config = _config.copy();
+	if ((config.deviceMode == 2 || config.deviceMode == 3) && config.redirectRef) {
+		config.redirectSuspended = !config.redirectSuspended;
+		config.selectModeHandler();
+		_disconnectedMsgSend = false;
+		_config.publish(config);
+		auto suspended = config.redirectSuspended;
+		config.redirectRef->_updateConfig([suspended](OpenvrDeviceManipulationConfig& c) {
+			c.redirectSuspended = suspended;
+		});
+		config.redirectRef->_disconnectedMsgSend = false;
+	}
+}
+
+void OpenvrDeviceManipulationInfo::handleAxisEvent(vr::IVRServerDriverHost* driver, _DetourTrackedDeviceAxisUpdated_t origFunc, uint32_t& unWhichDevice, uint32_t unWhichAxis, const vr::VRControllerAxis_t& axisState) {
+	auto config = _config.read();
+	TraceScope::setMode((uint8_t)config->modeHandler);
+	(this->*_modeHandlers[(int)config->modeHandler].axis)(*config, driver, origFunc, unWhichDevice, unWhichAxis, axisState);
+}
+
+void OpenvrDeviceManipulationInfo::_axisDefault(const OpenvrDeviceManipulationConfig& config, vr::IVRServerDriverHost* driver, _DetourTrackedDeviceAxisUpdated_t origFunc, uint32_t unWhichDevice, uint32_t unWhichAxis, const vr::VRControllerAxis_t& axisState) {
+	traceVrserverCall(origFunc, driver, unWhichDevice, unWhichAxis, axisState);
+}
+
+void OpenvrDeviceManipulationInfo::_axisForward(const OpenvrDeviceManipulationConfig& config, vr::IVRServerDriverHost* driver, _DetourTrackedDeviceAxisUpdated_t origFunc, uint32_t unWhichDevice, uint32_t unWhichAxis, const vr::VRControllerAxis_t& axisState) {
+	traceVrserverCall(origFunc, driver, config.redirectRef->openvrId(), unWhichAxis, axisState);
 }
 
 
 bool OpenvrDeviceManipulationInfo::triggerHapticPulse(uint32_t unAxisId, uint16_t usPulseDurationMicroseconds, bool directMode) {
-	std::lock_guard<std::recursive_mutex> lock(_mutex);
 	if (m_controllerComponent) {
 		if (directMode) {
-			return m_triggerHapticPulseFunc(m_controllerComponent, unAxisId, usPulseDurationMicroseconds);
-		} else if ((m_deviceMode == 3 && !m_redirectSuspended) || m_deviceMode == 4) {
-			m_redirectRef->triggerHapticPulse(unAxisId, usPulseDurationMicroseconds, true);
-		} else  if (m_deviceMode == 0 || ((m_deviceMode == 3 || m_deviceMode == 2) && m_redirectSuspended)) {
-			return m_triggerHapticPulseFunc(m_controllerComponent, unAxisId, usPulseDurationMicroseconds);
+			return traceVrserverCall(m_triggerHapticPulseFunc, m_controllerComponent, unAxisId, usPulseDurationMicroseconds);
 		}
+		auto config = _config.read();
+		TraceScope::setMode((uint8_t)config->modeHandler);
+		return (this->*_modeHandlers[(int)config->modeHandler].haptic)(*config, unAxisId, usPulseDurationMicroseconds);
 	}
 	return true;
 }
 
+bool OpenvrDeviceManipulationInfo::_hapticDefault(const OpenvrDeviceManipulationConfig& config, uint32_t unAxisId, uint16_t usPulseDurationMicroseconds) {
+	return traceVrserverCall(m_triggerHapticPulseFunc, m_controllerComponent, unAxisId, usPulseDurationMicroseconds);
+}
+
+bool OpenvrDeviceManipulationInfo::_hapticForward(const OpenvrDeviceManipulationConfig& config, uint32_t unAxisId, uint16_t usPulseDurationMicroseconds) {
+	config.redirectRef->triggerHapticPulse(unAxisId, usPulseDurationMicroseconds, true);
+	return true;
+}
+
 bool OpenvrDeviceManipulationInfo::getButtonMapping(vr::EVRButtonId button, vr::EVRButtonId& mappedButton) {
-	std::lock_guard<std::recursive_mutex> lock(_mutex);
-	if (m_enableButtonMapping) {
-		auto i = m_buttonMapping.find(button);
-		if (i != m_buttonMapping.end()) {
+	auto config = _config.read();
+	if (config->enableButtonMapping) {
+		auto i = config->buttonMapping.find(button);
+		if (i != config->buttonMapping.end()) {
 			mappedButton = i->second;
 			return true;
 		}
@@ -156,86 +275,150 @@ bool OpenvrDeviceManipulationInfo::getButtonMapping(vr::EVRButtonId button, vr::
 	return false;
 }
 
+void OpenvrDeviceManipulationInfo::setButtonMappingEnabled(bool enable) {
+	_updateConfig([enable](OpenvrDeviceManipulationConfig& config) {
+		config.enableButtonMapping = enable;
+	});
+}
+
 void OpenvrDeviceManipulationInfo::addButtonMapping(vr::EVRButtonId button, vr::EVRButtonId mappedButton) {
-	std::lock_guard<std::recursive_mutex> lock(_mutex);
-	m_buttonMapping[button] = mappedButton;
+	_updateConfig([button, mappedButton](OpenvrDeviceManipulationConfig& config) {
+		config.buttonMapping[button] = mappedButton;
+	});
 }
 
 void OpenvrDeviceManipulationInfo::eraseButtonMapping(vr::EVRButtonId button) {
-	std::lock_guard<std::recursive_mutex> lock(_mutex);
-	m_buttonMapping.erase(button);
+	_updateConfig([button](OpenvrDeviceManipulationConfig& config) {
+		config.buttonMapping.erase(button);
+	});
 }
 
 void OpenvrDeviceManipulationInfo::eraseAllButtonMappings() {
-	std::lock_guard<std::recursive_mutex> lock(_mutex);
-	m_buttonMapping.clear();
+	_updateConfig([](OpenvrDeviceManipulationConfig& config) {
+		config.buttonMapping.clear();
+	});
+}
+
+void OpenvrDeviceManipulationInfo::enableOffsets(bool enable) {
+	_updateConfig([enable](OpenvrDeviceManipulationConfig& config) {
+		config.offsetsEnabled = enable;
+	});
+}
+
+void OpenvrDeviceManipulationInfo::setWorldFromDriverRotationOffset(const vr::HmdQuaternion_t& value) {
+	_updateConfig([&value](OpenvrDeviceManipulationConfig& config) {
+		config.worldFromDriverRotationOffset = value;
+	});
+}
+
+void OpenvrDeviceManipulationInfo::setWorldFromDriverTranslationOffset(const vr::HmdVector3d_t& value) {
+	_updateConfig([&value](OpenvrDeviceManipulationConfig& config) {
+		config.worldFromDriverTranslationOffset = value;
+	});
+}
+
+void OpenvrDeviceManipulationInfo::setDriverFromHeadRotationOffset(const vr::HmdQuaternion_t& value) {
+	_updateConfig([&value](OpenvrDeviceManipulationConfig& config) {
+		config.driverFromHeadRotationOffset = value;
+	});
+}
+
+void OpenvrDeviceManipulationInfo::setDriverFromHeadTranslationOffset(const vr::HmdVector3d_t& value) {
+	_updateConfig([&value](OpenvrDeviceManipulationConfig& config) {
+		config.driverFromHeadTranslationOffset = value;
+	});
+}
+
+void OpenvrDeviceManipulationInfo::setDeviceRotationOffset(const vr::HmdQuaternion_t& value) {
+	_updateConfig([&value](OpenvrDeviceManipulationConfig& config) {
+		config.deviceRotationOffset = value;
+	});
+}
+
+void OpenvrDeviceManipulationInfo::setDeviceTranslationOffset(const vr::HmdVector3d_t& value) {
+	_updateConfig([&value](OpenvrDeviceManipulationConfig& config) {
+		config.deviceTranslationOffset = value;
+	});
 }
 
 int OpenvrDeviceManipulationInfo::setDefaultMode() {
-	std::lock_guard<std::recursive_mutex> lock(_mutex);
+	std::lock_guard<std::recursive_mutex> lock(_configWriteMutex);
 	auto res = _disableOldMode(0);
 	if (res == 0) {
-		m_deviceMode = 0;
+		_updateConfig([](OpenvrDeviceManipulationConfig& config) {
+			config.deviceMode = 0;
+		});
 	}
 	return 0; 
 }
 
 int OpenvrDeviceManipulationInfo::setRedirectMode(bool target, OpenvrDeviceManipulationInfo* ref) {
-	std::lock_guard<std::recursive_mutex> lock(_mutex);
+	std::lock_guard<std::recursive_mutex> lock(_configWriteMutex);
 	auto res = _disableOldMode(target ? 3 : 2);
 	if (res == 0) {
-		m_redirectSuspended = false;
-		m_redirectRef = ref;
-		if (target) {
-			m_deviceMode = 3;
-		} else {
-			m_deviceMode = 2;
-		}
+		_updateConfig([target, ref](OpenvrDeviceManipulationConfig& config) {
+			config.redirectSuspended = false;
+			config.redirectRef = ref;
+			if (target) {
+				config.deviceMode = 3;
+			} else {
+				config.deviceMode = 2;
+			}
+		});
 	}
 	return 0; 
 }
 
 int OpenvrDeviceManipulationInfo::setSwapMode(OpenvrDeviceManipulationInfo* ref) {
-	std::lock_guard<std::recursive_mutex> lock(_mutex);
+	std::lock_guard<std::recursive_mutex> lock(_configWriteMutex);
 	auto res = _disableOldMode(4);
 	if (res == 0) {
-		m_redirectRef = ref;
-		m_deviceMode = 4;
+		_updateConfig([ref](OpenvrDeviceManipulationConfig& config) {
+			config.redirectRef = ref;
+			config.deviceMode = 4;
+		});
 	}
 	return 0;
 }
 
 int OpenvrDeviceManipulationInfo::setMotionCompensationMode() {
-	std::lock_guard<std::recursive_mutex> lock(_mutex);
+	std::lock_guard<std::recursive_mutex> lock(_configWriteMutex);
 	auto res = _disableOldMode(5);
 	auto serverDriver = CServerDriver::getInstance();
 	if (res == 0 && serverDriver) {
 		_disconnectedMsgSend = false;
 		serverDriver->enableMotionCompensation(true);
-		m_deviceMode = 5;
+		_updateConfig([](OpenvrDeviceManipulationConfig& config) {
+			config.deviceMode = 5;
+		});
 	}
 	return 0;
 }
 
 int OpenvrDeviceManipulationInfo::setFakeDisconnectedMode() {
-	std::lock_guard<std::recursive_mutex> lock(_mutex);
+	std::lock_guard<std::recursive_mutex> lock(_configWriteMutex);
 	auto res = _disableOldMode(1);
 	if (res == 0) {
 		_disconnectedMsgSend = false;
-		m_deviceMode = 1;
+		_updateConfig([](OpenvrDeviceManipulationConfig& config) {
+			config.deviceMode = 1;
+		});
 	}
 	return 0;
 }
 
 int OpenvrDeviceManipulationInfo::_disableOldMode(int newMode) {
-	if (m_deviceMode != newMode) {
-		if (m_deviceMode == 5) {
+	auto config = _config.copy();
+	if (config.deviceMode != newMode) {
+		if (config.deviceMode == 5) {
 			auto serverDriver = CServerDriver::getInstance();
 			if (serverDriver) {
 				serverDriver->enableMotionCompensation(false);
 			}
-		} else if (m_deviceMode == 3 || m_deviceMode == 2 || m_deviceMode == 4) {
-			m_redirectRef->m_deviceMode = 0;
+		} else if (config.deviceMode == 3 || config.deviceMode == 2 || config.deviceMode == 4) {
+			config.redirectRef->_updateConfig([](OpenvrDeviceManipulationConfig& c) {
+				c.deviceMode = 0;
+			});
 		}
 		if (newMode == 5) {
 			auto serverDriver = CServerDriver::getInstance();
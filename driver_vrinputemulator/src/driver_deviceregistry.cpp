@@ -0,0 +1,69 @@
+#include "stdafx.h"
+#include "driver_vrinputemulator.h"
+
+
+namespace vrinputemulator {
+namespace driver {
+
+
+DeviceRegistry::DeviceRegistry() {
+	for (uint32_t i = 0; i < maxDevices; ++i) {
+		_manipulationInfos[i].store(nullptr, std::memory_order_relaxed);
+		_driverHosts[i].store(nullptr, std::memory_order_relaxed);
+		_virtualDevices[i].store(nullptr, std::memory_order_relaxed);
+	}
+}
+
+
+void DeviceRegistry::setVirtualDevice(uint32_t openvrId, CTrackedDeviceDriver* device) {
+	if (openvrId < maxDevices) {
+		_virtualDevices[openvrId].store(device, std::memory_order_release);
+	}
+}
+
+
+bool DeviceRegistry::addDevice(std::shared_ptr<OpenvrDeviceManipulationInfo> info, _DetourTrackedDeviceActivate_t activateFunc) {
+	auto index = _entryCount.load(std::memory_order_relaxed);
+	if (index >= maxDevices || _driverIndex.find(info->driver()) != _driverIndex.notFound) {
+		return false;
+	}
+	_entries[index].info = info;
+	_entries[index].activateFunc = activateFunc;
+	_entryCount.store(index + 1, std::memory_order_release);
+	_driverIndex.insert(info->driver(), index);
+	return true;
+}
+
+
+bool DeviceRegistry::addControllerComponent(vr::IVRControllerComponent* component, OpenvrDeviceManipulationInfo* info) {
+	auto index = _driverIndex.find(info->driver());
+	if (index == _driverIndex.notFound) {
+		return false;
+	}
+	return _controllerComponentIndex.insert(component, index);
+}
+
+
+_DetourTrackedDeviceActivate_t DeviceRegistry::activateDevice(vr::ITrackedDeviceServerDriver* driver, uint32_t openvrId) {
+	auto index = _driverIndex.find(driver);
+	if (index == _driverIndex.notFound) {
+		return nullptr;
+	}
+	auto& entry = _entries[index];
+	entry.info->setOpenvrId(openvrId);
+	if (openvrId < maxDevices && entry.info->isValid()) {
+		_driverHosts[openvrId].store(entry.info->driverHost(), std::memory_order_release);
+		_manipulationInfos[openvrId].store(entry.info.get(), std::memory_order_release);
+	}
+	return entry.activateFunc;
+}
+
+
+OpenvrDeviceManipulationInfo* DeviceRegistry::findByControllerComponent(vr::IVRControllerComponent* component) const {
+	auto index = _controllerComponentIndex.find(component);
+	return index != _controllerComponentIndex.notFound ? _entries[index].info.get() : nullptr;
+}
+
+
+} // end namespace driver
+} // end namespace vrinputemulator
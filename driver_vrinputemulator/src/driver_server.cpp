@@ -5,8 +5,8 @@
 #include <ipc_protocol.h>
 #include <openvr_math.h>
 #include <MinHook.h>
-#include <map>
 #include <vector>
+#include <cstring>
 
 namespace vrinputemulator {
 namespace driver {
@@ -38,8 +38,8 @@ namespace driver {
 
 CServerDriver* CServerDriver::singleton = nullptr;
 
-std::map<vr::ITrackedDeviceServerDriver*, std::shared_ptr<OpenvrDeviceManipulationInfo>> CServerDriver::_openvrDeviceInfos;
-OpenvrDeviceManipulationInfo* CServerDriver::_openvrIdToDeviceInfoMap[vr::k_unMaxTrackedDeviceCount]; // index == openvrId
+std::recursive_mutex CServerDriver::_openvrDevicesMutex;
+DeviceRegistry CServerDriver::_devices;
 
 CServerDriver::_DetourFuncInfo<_DetourTrackedDeviceAdded_t> CServerDriver::_deviceAddedDetour;
 CServerDriver::_DetourFuncInfo<_DetourTrackedDevicePoseUpdated_t> CServerDriver::_poseUpatedDetour;
@@ -49,17 +49,13 @@ CServerDriver::_DetourFuncInfo<_DetourTrackedDeviceButtonTouched_t> CServerDrive
 CServerDriver::_DetourFuncInfo<_DetourTrackedDeviceButtonUntouched_t> CServerDriver::_buttonUntouchedDetour;
 CServerDriver::_DetourFuncInfo<_DetourTrackedDeviceAxisUpdated_t> CServerDriver::_axisUpdatedDetour;
 std::vector<CServerDriver::_DetourFuncInfo<_DetourTrackedDeviceActivate_t>> CServerDriver::_deviceActivateDetours;
-std::map<vr::ITrackedDeviceServerDriver*, CServerDriver::_DetourFuncInfo<_DetourTrackedDeviceActivate_t>*> CServerDriver::_deviceActivateDetourMap; // _this => DetourInfo
 
 std::vector<CServerDriver::_DetourFuncInfo<_DetourTriggerHapticPulse_t>> CServerDriver::_deviceTriggerHapticPulseDetours;
-std::map<vr::IVRControllerComponent*, std::shared_ptr<OpenvrDeviceManipulationInfo>> CServerDriver::_controllerComponentToDeviceInfos; // ControllerComponent => ManipulationInfo
 
 
 
 CServerDriver::CServerDriver() {
 	singleton = this;
-	memset(m_openvrIdToVirtualDeviceMap, 0, sizeof(CTrackedDeviceDriver*) * vr::k_unMaxTrackedDeviceCount);
-	memset(_openvrIdToDeviceInfoMap, 0, sizeof(OpenvrDeviceManipulationInfo*) * vr::k_unMaxTrackedDeviceCount);
 }
 
 
@@ -79,96 +75,98 @@ void CServerDriver::_poseUpatedDetourFunc(vr::IVRServerDriverHost* _this, uint32
 	// Vive Controller: 369 calls/s each
 	//
 	// Time is key. If we assume 1 HMD and 13 controllers, we have a total of  ~6000 calls/s. That's about 166 microseconds per call at 100% load.
-
-	/*if (unWhichDevice == 0) {
-		#define CALLCOUNTSAMPESIZE 1000
-		static uint64_t callcount = 0;
-		static uint64_t starttime = 0;
-		callcount++;
-		if (starttime == 0) {
-			starttime = std::chrono::duration_cast <std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-		} else if (callcount > CALLCOUNTSAMPESIZE) {
-			auto endtime = std::chrono::duration_cast <std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-			auto diff = endtime - starttime;
-			LOG(INFO) << "HMD pose update: " << CALLCOUNTSAMPESIZE << " calls in " << diff << "ms: " << CALLCOUNTSAMPESIZE * 1000 / diff << " calls / s";
-			starttime = std::chrono::duration_cast <std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-			callcount = 0;
-		}
-	}*/
-	if (_openvrIdToDeviceInfoMap[unWhichDevice] && _openvrIdToDeviceInfoMap[unWhichDevice]->isValid()) {
-		_openvrIdToDeviceInfoMap[unWhichDevice]->handleNewDevicePose(_this, _poseUpatedDetour.origFunc, unWhichDevice, newPose);
+	//
+	// Call rates and per call costs can be taken from the hook trace (see TraceRecorder).
+	TraceScope traceScope(trace::TraceHook::PoseUpdated, unWhichDevice);
+	auto info = _devices.manipulationInfo(unWhichDevice);
+	if (info) {
+		info->handleNewDevicePose(_this, _poseUpatedDetour.origFunc, unWhichDevice, newPose);
 	} else {
-		return _poseUpatedDetour.origFunc(_this, unWhichDevice, newPose, unPoseStructSize);
+		return traceVrserverCall(_poseUpatedDetour.origFunc, _this, unWhichDevice, newPose, unPoseStructSize);
 	}
 }
 
 void CServerDriver::_buttonPressedDetourFunc(vr::IVRServerDriverHost* _this, uint32_t unWhichDevice, vr::EVRButtonId eButtonId, double eventTimeOffset) {
-	LOG(TRACE) << "Detour::buttonPressedDetourFunc(" << _this << ", " << unWhichDevice << ", " << (int)eButtonId << ", " << eventTimeOffset << ")";
-	if (_openvrIdToDeviceInfoMap[unWhichDevice] && _openvrIdToDeviceInfoMap[unWhichDevice]->isValid()) {
-		_openvrIdToDeviceInfoMap[unWhichDevice]->handleButtonEvent(_this, _buttonPressedDetour.origFunc, unWhichDevice, ButtonEventType::ButtonPressed, eButtonId, eventTimeOffset);
+	TraceScope traceScope(trace::TraceHook::ButtonPressed, unWhichDevice, (uint32_t)eButtonId);
+	auto info = _devices.manipulationInfo(unWhichDevice);
+	if (info) {
+		info->handleButtonEvent(_this, _buttonPressedDetour.origFunc, unWhichDevice, ButtonEventType::ButtonPressed, eButtonId, eventTimeOffset);
 	} else {
-		_buttonPressedDetour.origFunc(_this, unWhichDevice, eButtonId, eventTimeOffset);
+		traceVrserverCall(_buttonPressedDetour.origFunc, _this, unWhichDevice, eButtonId, eventTimeOffset);
 	}
 }
 
 void CServerDriver::_buttonUnpressedDetourFunc(vr::IVRServerDriverHost* _this, uint32_t unWhichDevice, vr::EVRButtonId eButtonId, double eventTimeOffset) {
-	LOG(TRACE) << "Detour::buttonUnpressedDetourFunc(" << _this << ", " << unWhichDevice << ", " << (int)eButtonId << ", " << eventTimeOffset << ")";
-	if (_openvrIdToDeviceInfoMap[unWhichDevice] && _openvrIdToDeviceInfoMap[unWhichDevice]->isValid()) {
-		_openvrIdToDeviceInfoMap[unWhichDevice]->handleButtonEvent(_this, _buttonUnpressedDetour.origFunc, unWhichDevice, ButtonEventType::ButtonUnpressed, eButtonId, eventTimeOffset);
+	TraceScope traceScope(trace::TraceHook::ButtonUnpressed, unWhichDevice, (uint32_t)eButtonId);
+	auto info = _devices.manipulationInfo(unWhichDevice);
+	if (info) {
+		info->handleButtonEvent(_this, _buttonUnpressedDetour.origFunc, unWhichDevice, ButtonEventType::ButtonUnpressed, eButtonId, eventTimeOffset);
 	} else {
-		_buttonUnpressedDetour.origFunc(_this, unWhichDevice, eButtonId, eventTimeOffset);
+		traceVrserverCall(_buttonUnpressedDetour.origFunc, _this, unWhichDevice, eButtonId, eventTimeOffset);
 	}
 }
 
 void CServerDriver::_buttonTouchedDetourFunc(vr::IVRServerDriverHost* _this, uint32_t unWhichDevice, vr::EVRButtonId eButtonId, double eventTimeOffset) {
-	LOG(TRACE) << "Detour::buttonTouchedDetourFunc(" << _this << ", " << unWhichDevice << ", " << (int)eButtonId << ", " << eventTimeOffset << ")";
-	if (_openvrIdToDeviceInfoMap[unWhichDevice] && _openvrIdToDeviceInfoMap[unWhichDevice]->isValid()) {
-		_openvrIdToDeviceInfoMap[unWhichDevice]->handleButtonEvent(_this, _buttonTouchedDetour.origFunc, unWhichDevice, ButtonEventType::ButtonTouched, eButtonId, eventTimeOffset);
+	TraceScope traceScope(trace::TraceHook::ButtonTouched, unWhichDevice, (uint32_t)eButtonId);
+	auto info = _devices.manipulationInfo(unWhichDevice);
+	if (info) {
+		info->handleButtonEvent(_this, _buttonTouchedDetour.origFunc, unWhichDevice, ButtonEventType::ButtonTouched, eButtonId, eventTimeOffset);
 	} else {
-		_buttonTouchedDetour.origFunc(_this, unWhichDevice, eButtonId, eventTimeOffset);
+		traceVrserverCall(_buttonTouchedDetour.origFunc, _this, unWhichDevice, eButtonId, eventTimeOffset);
 	}
 }
 
 void CServerDriver::_buttonUntouchedDetourFunc(vr::IVRServerDriverHost* _this, uint32_t unWhichDevice, vr::EVRButtonId eButtonId, double eventTimeOffset) {
-	LOG(TRACE) << "Detour::buttonUntouchedDetourFunc(" << _this << ", " << unWhichDevice << ", " << (int)eButtonId << ", " << eventTimeOffset << ")";
-	if (_openvrIdToDeviceInfoMap[unWhichDevice] && _openvrIdToDeviceInfoMap[unWhichDevice]->isValid()) {
-		_openvrIdToDeviceInfoMap[unWhichDevice]->handleButtonEvent(_this, _buttonUntouchedDetour.origFunc, unWhichDevice, ButtonEventType::ButtonUntouched, eButtonId, eventTimeOffset);
+	TraceScope traceScope(trace::TraceHook::ButtonUntouched, unWhichDevice, (uint32_t)eButtonId);
+	auto info = _devices.manipulationInfo(unWhichDevice);
+	if (info) {
+		info->handleButtonEvent(_this, _buttonUntouchedDetour.origFunc, unWhichDevice, ButtonEventType::ButtonUntouched, eButtonId, eventTimeOffset);
 	} else {
-		_buttonUntouchedDetour.origFunc(_this, unWhichDevice, eButtonId, eventTimeOffset);
+		traceVrserverCall(_buttonUntouchedDetour.origFunc, _this, unWhichDevice, eButtonId, eventTimeOffset);
 	}
 }
 
 void CServerDriver::_axisUpdatedDetourFunc(vr::IVRServerDriverHost* _this, uint32_t unWhichDevice, uint32_t unWhichAxis, const vr::VRControllerAxis_t & axisState) {
-	LOG(TRACE) << "Detour::axisUpdatedDetourFunc(" << _this << ", " << unWhichDevice << ", " << (int)unWhichAxis << ", <state>)";
-	if (_openvrIdToDeviceInfoMap[unWhichDevice] && _openvrIdToDeviceInfoMap[unWhichDevice]->isValid()) {
-		_openvrIdToDeviceInfoMap[unWhichDevice]->handleAxisEvent(_this, _axisUpdatedDetour.origFunc, unWhichDevice, unWhichAxis, axisState);
+	TraceScope traceScope(trace::TraceHook::AxisUpdated, unWhichDevice, unWhichAxis);
+	auto info = _devices.manipulationInfo(unWhichDevice);
+	if (info) {
+		info->handleAxisEvent(_this, _axisUpdatedDetour.origFunc, unWhichDevice, unWhichAxis, axisState);
 	} else {
-		_axisUpdatedDetour.origFunc(_this, unWhichDevice, unWhichAxis, axisState);
+		traceVrserverCall(_axisUpdatedDetour.origFunc, _this, unWhichDevice, unWhichAxis, axisState);
 	}
 }
 
 vr::EVRInitError CServerDriver::_deviceActivateDetourFunc(vr::ITrackedDeviceServerDriver* _this, uint32_t unObjectId) {
 	LOG(TRACE) << "Detour::deviceActivateDetourFunc(" << _this << ", " << unObjectId << ")";
-	auto i = _openvrDeviceInfos.find(_this);
-	if (i != _openvrDeviceInfos.end()) {
-		auto info = i->second;
-		info->setOpenvrId(unObjectId);
-		_openvrIdToDeviceInfoMap[unObjectId] = info.get();
-		LOG(INFO) << "Detour::deviceActivateDetourFunc: sucessfully added to trackedDeviceInfos";
+	_DetourTrackedDeviceActivate_t activateFunc;
+	{
+		std::lock_guard<std::recursive_mutex> lock(_openvrDevicesMutex);
+		activateFunc = _devices.activateDevice(_this, unObjectId);
+		if (activateFunc) {
+			LOG(INFO) << "Detour::deviceActivateDetourFunc: sucessfully added to trackedDeviceInfos";
+		} else {
+			// Device could not be registered, find the hook by its target function
+			auto deviceActivatedOrig = (*((void***)_this))[0];
+			for (auto& d : _deviceActivateDetours) {
+				if (d.targetFunc == deviceActivatedOrig) {
+					activateFunc = d.origFunc;
+					break;
+				}
+			}
+		}
 	}
-	auto& d = _deviceActivateDetourMap.find(_this);
-	if (d != _deviceActivateDetourMap.end()) {
-		return d->second->origFunc(_this, unObjectId);
+	if (activateFunc) {
+		return activateFunc(_this, unObjectId);
 	}
 	return vr::VRInitError_Unknown;
 }
 
 
 bool CServerDriver::_deviceTriggerHapticPulseDetourFunc(vr::IVRControllerComponent* _this, uint32_t unAxisId, uint16_t usPulseDurationMicroseconds) {
-	LOG(TRACE) << "Detour::deviceTriggerHapticPulseDetourFunc(" << _this << ", " << unAxisId << ", " << usPulseDurationMicroseconds << ")";
-	auto i = _controllerComponentToDeviceInfos.find(_this);
-	if (i != _controllerComponentToDeviceInfos.end()) {
-		auto info = i->second;
+	TraceScope traceScope(trace::TraceHook::TriggerHapticPulse, vr::k_unTrackedDeviceIndexInvalid, usPulseDurationMicroseconds);
+	auto info = _devices.findByControllerComponent(_this);
+	if (info) {
+		traceScope.setDeviceId(info->openvrId());
 		return info->triggerHapticPulse(unAxisId, usPulseDurationMicroseconds);
 	}
 	return true;
@@ -177,6 +175,7 @@ bool CServerDriver::_deviceTriggerHapticPulseDetourFunc(vr::IVRControllerCompone
 
 bool CServerDriver::_deviceAddedDetourFunc(vr::IVRServerDriverHost* _this, const char *pchDeviceSerialNumber, vr::ETrackedDeviceClass eDeviceClass, vr::ITrackedDeviceServerDriver *pDriver) {
 	LOG(TRACE) << "Detour::deviceAddedDetourFunc(" << _this << ", " << pchDeviceSerialNumber << ", " << (int)eDeviceClass << ", " << pDriver << ")";
+	std::unique_lock<std::recursive_mutex> lock(_openvrDevicesMutex);
 
 	// Redirect activate() function
 	auto deviceActivatedOrig = (*((void***)pDriver))[0];
@@ -194,12 +193,15 @@ bool CServerDriver::_deviceAddedDetourFunc(vr::IVRServerDriverHost* _this, const
 		CREATE_MH_HOOK(d, _deviceActivateDetourFunc, "deviceActivateDetour", pDriver, 0);
 		foundEntry = &d;
 	}
-	_deviceActivateDetourMap.insert({pDriver, foundEntry});
 
 	// Create ManipulationInfo entry
 	auto info = std::make_shared<OpenvrDeviceManipulationInfo>(pDriver, eDeviceClass, vr::k_unTrackedDeviceIndexInvalid, _this);
-	_openvrDeviceInfos.emplace(pDriver, info);
-	
+	if (!_devices.addDevice(info, foundEntry->origFunc)) {
+		LOG(ERROR) << "Detour::deviceAddedDetourFunc: Could not register device " << pchDeviceSerialNumber << " (already known or too many devices)";
+		lock.unlock();
+		return _deviceAddedDetour.origFunc(_this, pchDeviceSerialNumber, eDeviceClass, pDriver);
+	}
+
 	// Redirect TriggerHapticPulse() function
 	vr::IVRControllerComponent* controllerComponent = (vr::IVRControllerComponent*)pDriver->GetComponent(vr::IVRControllerComponent_Version);
 	if (controllerComponent) {
@@ -219,9 +221,10 @@ bool CServerDriver::_deviceAddedDetourFunc(vr::IVRServerDriverHost* _this, const
 			foundEntry2 = &d;
 		}
 		info->setControllerComponent(controllerComponent, foundEntry2->origFunc);
-		_controllerComponentToDeviceInfos.insert({controllerComponent, info});
+		_devices.addControllerComponent(controllerComponent, info.get());
 	}
 
+	lock.unlock();
 	return _deviceAddedDetour.origFunc(_this, pchDeviceSerialNumber, eDeviceClass, pDriver);
 };
 
@@ -266,19 +269,8 @@ void CServerDriver::Cleanup() {
 
 // Call frequency: ~93Hz
 void CServerDriver::RunFrame() {
-	/*#define CALLCOUNTSAMPESIZE 1000
-	static uint64_t callcount = 0;
-	static uint64_t starttime = 0;
-	callcount++;
-	if (starttime == 0) {
-		starttime = std::chrono::duration_cast <std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-	} else if (callcount > CALLCOUNTSAMPESIZE) {
-		auto endtime = std::chrono::duration_cast <std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-		auto diff = endtime - starttime;
-		LOG(INFO) << "RunFrame: " << CALLCOUNTSAMPESIZE << " calls in " << diff << "ms: " << CALLCOUNTSAMPESIZE * 1000 / diff << " calls / s";
-		starttime = std::chrono::duration_cast <std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-		callcount = 0;
-	}*/
+	TraceScope traceScope(trace::TraceHook::RunFrame, vr::k_unTrackedDeviceIndexInvalid);
+	shmCommunicator.runFrame();
 	for (int i = 0; i < vr::k_unMaxTrackedDeviceCount; ++i) {
 		auto vd = m_virtualDevices[i];
 		if (vd && vd->published() && vd->periodicPoseUpdates()) {
@@ -341,24 +333,19 @@ int32_t CServerDriver::virtualDevices_publishDevice(uint32_t emulatedDeviceId, b
 }
 
 void CServerDriver::_trackedDeviceActivated(uint32_t deviceId, CTrackedDeviceDriver * device) {
-	m_openvrIdToVirtualDeviceMap[deviceId] = device;
+	_devices.setVirtualDevice(deviceId, device);
 }
 
 void CServerDriver::_trackedDeviceDeactivated(uint32_t deviceId) {
-	m_openvrIdToVirtualDeviceMap[deviceId] = nullptr;
+	_devices.setVirtualDevice(deviceId, nullptr);
 }
 
 void CServerDriver::openvr_buttonEvent(uint32_t unWhichDevice, ButtonEventType eventType, vr::EVRButtonId eButtonId, double eventTimeOffset) {
-	auto devicePtr = this->m_openvrIdToVirtualDeviceMap[unWhichDevice];
+	auto devicePtr = _devices.virtualDevice(unWhichDevice);
 	if (devicePtr && devicePtr->deviceType() == VirtualDeviceType::TrackedController) {
 		((CTrackedControllerDriver*)devicePtr)->buttonEvent(eventType, eButtonId, eventTimeOffset);
 	} else {
-		vr::IVRServerDriverHost* driverHost;
-		if (_openvrIdToDeviceInfoMap[unWhichDevice] && _openvrIdToDeviceInfoMap[unWhichDevice]->isValid()) {
-			driverHost = _openvrIdToDeviceInfoMap[unWhichDevice]->driverHost();
-		} else {
-			driverHost = vr::VRServerDriverHost();
-		}
+		auto driverHost = _devices.driverHost(unWhichDevice);
 		switch (eventType) {
 			case ButtonEventType::ButtonPressed:
 				driverHost->TrackedDeviceButtonPressed(unWhichDevice, eButtonId, eventTimeOffset);
@@ -382,58 +369,34 @@ void CServerDriver::openvr_buttonEvent(uint32_t unWhichDevice, ButtonEventType e
 }
 
 void CServerDriver::openvr_axisEvent(uint32_t unWhichDevice, uint32_t unWhichAxis, const vr::VRControllerAxis_t & axisState) {
-	auto devicePtr = this->m_openvrIdToVirtualDeviceMap[unWhichDevice];
+	auto devicePtr = _devices.virtualDevice(unWhichDevice);
 	if (devicePtr && devicePtr->deviceType() == VirtualDeviceType::TrackedController) {
 		((CTrackedControllerDriver*)devicePtr)->axisEvent(unWhichAxis, axisState);
 	} else {
-		vr::IVRServerDriverHost* driverHost;
-		if (_openvrIdToDeviceInfoMap[unWhichDevice] && _openvrIdToDeviceInfoMap[unWhichDevice]->isValid()) {
-			driverHost = _openvrIdToDeviceInfoMap[unWhichDevice]->driverHost();
-		} else {
-			driverHost = vr::VRServerDriverHost();
-		}
+		auto driverHost = _devices.driverHost(unWhichDevice);
 		driverHost->TrackedDeviceAxisUpdated(unWhichDevice, unWhichAxis, axisState);
 	}
 }
 
 void CServerDriver::openvr_poseUpdate(uint32_t unWhichDevice, vr::DriverPose_t & newPose, int64_t timestamp) {
-	auto devicePtr = this->m_openvrIdToVirtualDeviceMap[unWhichDevice];
-	auto now = std::chrono::duration_cast <std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
-	auto diff = 0.0;
-	if (timestamp < now) {
-		diff = ((double)now - timestamp) / 1000.0;
-	}
+	auto devicePtr = _devices.virtualDevice(unWhichDevice);
+	auto diff = ipc::timestampAge(timestamp);
 	if (devicePtr) {
 		devicePtr->updatePose(newPose, -diff);
 	} else {
-		vr::IVRServerDriverHost* driverHost;
-		if (_openvrIdToDeviceInfoMap[unWhichDevice] && _openvrIdToDeviceInfoMap[unWhichDevice]->isValid()) {
-			driverHost = _openvrIdToDeviceInfoMap[unWhichDevice]->driverHost();
-		} else {
-			driverHost = vr::VRServerDriverHost();
-		}
+		auto driverHost = _devices.driverHost(unWhichDevice);
 		newPose.poseTimeOffset -= diff;
 		driverHost->TrackedDevicePoseUpdated(unWhichDevice, newPose, sizeof(vr::DriverPose_t));
 	}
 }
 
 void CServerDriver::openvr_proximityEvent(uint32_t unWhichDevice, bool bProximitySensorTriggered) {
-	vr::IVRServerDriverHost* driverHost;
-	if (_openvrIdToDeviceInfoMap[unWhichDevice] && _openvrIdToDeviceInfoMap[unWhichDevice]->isValid()) {
-		driverHost = _openvrIdToDeviceInfoMap[unWhichDevice]->driverHost();
-	} else {
-		driverHost = vr::VRServerDriverHost();
-	}
+	auto driverHost = _devices.driverHost(unWhichDevice);
 	driverHost->ProximitySensorState(unWhichDevice, bProximitySensorTriggered);
 }
 
 void CServerDriver::openvr_vendorSpecificEvent(uint32_t unWhichDevice, vr::EVREventType eventType, vr::VREvent_Data_t & eventData, double eventTimeOffset) {
-	vr::IVRServerDriverHost* driverHost;
-	if (_openvrIdToDeviceInfoMap[unWhichDevice] && _openvrIdToDeviceInfoMap[unWhichDevice]->isValid()) {
-		driverHost = _openvrIdToDeviceInfoMap[unWhichDevice]->driverHost();
-	} else {
-		driverHost = vr::VRServerDriverHost();
-	}
+	auto driverHost = _devices.driverHost(unWhichDevice);
 	driverHost->VendorSpecificEvent(unWhichDevice, eventType, eventData, eventTimeOffset);
 }
 
@@ -460,94 +423,273 @@ CTrackedDeviceDriver * CServerDriver::virtualDevices_findDevice(const std::strin
 }
 
 OpenvrDeviceManipulationInfo* CServerDriver::deviceManipulation_getInfo(uint32_t unWhichDevice) {
-	std::lock_guard<std::recursive_mutex> lock(_openvrDevicesMutex);
-	if (_openvrIdToDeviceInfoMap[unWhichDevice] && _openvrIdToDeviceInfoMap[unWhichDevice]->isValid()) {
-		return _openvrIdToDeviceInfoMap[unWhichDevice];
-	}
-	return nullptr;
+	return _devices.manipulationInfo(unWhichDevice);
 }
 
 void CServerDriver::enableMotionCompensation(bool enable) {
+	std::lock_guard<std::mutex> lock(_motionCompensationMutex);
 	_motionCompensationZeroPoseValid = false;
 	_motionCompensationRefPoseValid = false;
 	_motionCompensationEnabled = enable;
+	_publishMotionCompensationRef();
 }
 
 void CServerDriver::setMotionCompensationVelAccMode(uint32_t velAccMode) {
+	std::lock_guard<std::mutex> lock(_motionCompensationMutex);
 	if (_motionCompensationVelAccMode != velAccMode) {
 		_motionCompensationRefVelAccValid = false;
-		for (auto d : _openvrDeviceInfos) {
-			d.second->setLastDriverPoseValid(false);
+		for (uint32_t i = 0; i < _devices.deviceCount(); ++i) {
+			_devices.device(i)->setLastDriverPoseValid(false);
 		}
 		_motionCompensationVelAccMode = velAccMode;
+		_publishMotionCompensationRef();
 	}
 }
 
+void CServerDriver::setMotionCompensationKalmanFilterNoise(double processNoise, double observationNoise) {
+	std::lock_guard<std::mutex> lock(_motionCompensationMutex);
+	_motionCompensationKalmanProcessNoise = processNoise;
+	_motionCompensationKalmanObservationNoise = observationNoise;
+	_publishMotionCompensationRef();
+}
+
 void CServerDriver::disableMotionCompensationOnAllDevices() {
-	for (auto d : _openvrDeviceInfos) {
-		if (d.second->deviceMode() == 5) {
-			d.second->setDefaultMode();
+	for (uint32_t i = 0; i < _devices.deviceCount(); ++i) {
+		auto info = _devices.device(i);
+		if (info->deviceMode() == 5) {
+			info->setDefaultMode();
 		}
 	}
 }
 
 bool CServerDriver::_isMotionCompensationZeroPoseValid() {
+	std::lock_guard<std::mutex> lock(_motionCompensationMutex);
 	return _motionCompensationZeroPoseValid;
 }
 
 void CServerDriver::_setMotionCompensationZeroPose(const vr::DriverPose_t& pose) {
+	std::lock_guard<std::mutex> lock(_motionCompensationMutex);
 	// convert pose from driver space to app space
 	auto tmpConj = vrmath::quaternionConjugate(pose.qWorldFromDriverRotation);
-	_motionCompensationZeroPos = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, tmpConj, pose.vecPosition, true) - pose.vecWorldFromDriverTranslation;
+	_motionCompensationZeroPos = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, pose.vecPosition, true) - pose.vecWorldFromDriverTranslation;
 	_motionCompensationZeroRot = tmpConj * pose.qRotation;
 
 	_motionCompensationZeroPoseValid = true;
+	_publishMotionCompensationRef();
+}
+
+// Steady clock time a pose is valid at
+static uint64_t _poseTimeNs(const vr::DriverPose_t& pose) {
+	auto now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	return (uint64_t)(now + (int64_t)(pose.poseTimeOffset * 1.0E9));
 }
 
 void CServerDriver::_updateMotionCompensationRefPose(const vr::DriverPose_t& pose) {
+	std::lock_guard<std::mutex> lock(_motionCompensationMutex);
+	// Start a new history when the reference's driver space changes or its pose times go backwards
+	auto timeNs = _poseTimeNs(pose);
+	if (!_motionCompensationRefPoseValid || timeNs <= _motionCompensationRefTimeNs
+			|| std::memcmp(&_motionCompensationRefWorldFromDriverRotation, &pose.qWorldFromDriverRotation, sizeof(vr::HmdQuaternion_t)) != 0
+			|| std::memcmp(_motionCompensationRefWorldFromDriverTranslation, pose.vecWorldFromDriverTranslation, sizeof(_motionCompensationRefWorldFromDriverTranslation)) != 0) {
+		_motionCompensationHistoryFirst = _motionCompensationHistoryNext;
+	}
+	_motionCompensationRefTimeNs = timeNs;
+
 	// convert pose from driver space to app space
 	auto tmpConj = vrmath::quaternionConjugate(pose.qWorldFromDriverRotation);
-	_motionCompensationRefPos = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, tmpConj, pose.vecPosition, true) - pose.vecWorldFromDriverTranslation;
+	_motionCompensationRefPos = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, pose.vecPosition, true) - pose.vecWorldFromDriverTranslation;
 	auto poseWorldRot = tmpConj * pose.qRotation;
 
-	// calculate orientation difference and its inverse
+	// calculate orientation difference
 	_motionCompensationRotDiff = poseWorldRot * vrmath::quaternionConjugate(_motionCompensationZeroRot);
-	_motionCompensationRotDiffInv = vrmath::quaternionConjugate(_motionCompensationRotDiff);
 
 	// Convert velocity and acceleration values into app space and undo device rotation
 	if (_motionCompensationVelAccMode == 2) {
-		auto tmpRot = tmpConj * vrmath::quaternionConjugate(pose.qRotation);
-		auto tmpRotInv = vrmath::quaternionConjugate(tmpRot);
-		_motionCompensationRefPosVel = vrmath::quaternionRotateVector(tmpRot, tmpRotInv, { pose.vecVelocity[0], pose.vecVelocity[1], pose.vecVelocity[2] });
-		_motionCompensationRefPosAcc = vrmath::quaternionRotateVector(tmpRot, tmpRotInv, { pose.vecAcceleration[0], pose.vecAcceleration[1], pose.vecAcceleration[2] });
-		_motionCompensationRefRotVel = vrmath::quaternionRotateVector(tmpRot, tmpRotInv, { pose.vecAngularVelocity[0], pose.vecAngularVelocity[1], pose.vecAngularVelocity[2] });
-		_motionCompensationRefRotAcc = vrmath::quaternionRotateVector(tmpRot, tmpRotInv, { pose.vecAngularAcceleration[0], pose.vecAngularAcceleration[1], pose.vecAngularAcceleration[2] });
+		auto tmpRot = vrmath::rotationMatrixFromQuaternion(tmpConj * vrmath::quaternionConjugate(pose.qRotation));
+		vrmath::rotateVector(tmpRot, pose.vecVelocity, _motionCompensationRefPosVel.v);
+		vrmath::rotateVector(tmpRot, pose.vecAcceleration, _motionCompensationRefPosAcc.v);
+		vrmath::rotateVector(tmpRot, pose.vecAngularVelocity, _motionCompensationRefRotVel.v);
+		vrmath::rotateVector(tmpRot, pose.vecAngularAcceleration, _motionCompensationRefRotAcc.v);
 		_motionCompensationRefVelAccValid = true;
 	}
 
+	_motionCompensationRefWorldFromDriverRotation = pose.qWorldFromDriverRotation;
+	std::memcpy(_motionCompensationRefWorldFromDriverTranslation, pose.vecWorldFromDriverTranslation, sizeof(_motionCompensationRefWorldFromDriverTranslation));
 	_motionCompensationRefPoseValid = true;
+	_publishMotionCompensationRef(true);
+}
+
+void CServerDriver::_publishMotionCompensationRef(bool newRefSample) {
+	MotionCompensationRef ref;
+	MotionCompensationRefState state;
+	ref.generation = state.generation = ++_motionCompensationRefGeneration;
+	ref.active = _motionCompensationEnabled && _motionCompensationZeroPoseValid && _motionCompensationRefPoseValid;
+	ref.velAccMode = _motionCompensationVelAccMode;
+	ref.velAccValid = _motionCompensationRefVelAccValid;
+	ref.kalmanProcessNoise = _motionCompensationKalmanProcessNoise;
+	ref.kalmanObservationNoise = _motionCompensationKalmanObservationNoise;
+	if (ref.active) {
+		state.rotDiff = _motionCompensationRotDiff;
+		state.zeroPos = _motionCompensationZeroPos;
+		state.refPos = _motionCompensationRefPos;
+		state.refPosVel = _motionCompensationRefPosVel;
+		state.refPosAcc = _motionCompensationRefPosAcc;
+		state.refRotVel = _motionCompensationRefRotVel;
+		state.refRotAcc = _motionCompensationRefRotAcc;
+		_updateMotionCompensationTransform(ref.transform, state, _motionCompensationRefWorldFromDriverRotation, _motionCompensationRefWorldFromDriverTranslation);
+	}
+	if (ref.active && newRefSample) {
+		MotionCompensationRefSample sample;
+		sample.index = _motionCompensationHistoryNext++;
+		sample.timeNs = _motionCompensationRefTimeNs;
+		sample.rotDiff = state.rotDiff;
+		sample.refPos = state.refPos;
+		sample.rotation = ref.transform.rotation;
+		sample.translation = ref.transform.translation;
+		_motionCompensationHistory[sample.index % _motionCompensationHistorySize].write(sample);
+		if (_motionCompensationHistoryNext - _motionCompensationHistoryFirst > _motionCompensationHistorySize) {
+			_motionCompensationHistoryFirst = _motionCompensationHistoryNext - _motionCompensationHistorySize;
+		}
+		ref.refTimeNs = _motionCompensationRefTimeNs;
+		ref.historyLatest = sample.index;
+	} else {
+		// Everything else invalidates the history
+		_motionCompensationHistoryFirst = _motionCompensationHistoryNext;
+		ref.historyLatest = _motionCompensationHistoryFirst;
+	}
+	ref.historyFirst = _motionCompensationHistoryFirst;
+	_motionCompensationRefState.write(state);
+	_motionCompensationRef.write(ref);
+}
+
+void CServerDriver::_readMotionCompensationRefState(MotionCompensationRef& ref, MotionCompensationRefState& state) {
+	// The state is published first, so it is never older than ref. Re-read both until the generations match.
+	while (true) {
+		_motionCompensationRefState.read(state);
+		if (state.generation == ref.generation) {
+			break;
+		}
+		_motionCompensationRef.read(ref);
+	}
+}
+
+void CServerDriver::_updateMotionCompensationTransform(MotionCompensationTransform& transform, const MotionCompensationRefState& state, const vr::HmdQuaternion_t& worldFromDriverRotation, const double (&worldFromDriverTranslation)[3]) {
+	// The compensation below (driver space -> app space, compensate, app space -> driver space) composes to
+	// rotation = qWorldFromDriver * rotDiffInv * conj(qWorldFromDriver) and
+	// translation = qWorldFromDriver * (zeroPos + worldFromDriverTranslation - rotDiffInv * (worldFromDriverTranslation + refPos))
+	auto tmpConj = vrmath::quaternionConjugate(worldFromDriverRotation);
+	vr::HmdVector3d_t translation = { worldFromDriverTranslation[0], worldFromDriverTranslation[1], worldFromDriverTranslation[2] };
+	transform.rotation = worldFromDriverRotation * vrmath::quaternionConjugate(state.rotDiff) * tmpConj;
+	transform.rotationMatrix = vrmath::rotationMatrixFromQuaternion(transform.rotation);
+	auto refOffset = vrmath::quaternionRotateVector(state.rotDiff, translation + state.refPos, true);
+	transform.translation = vrmath::quaternionRotateVector(worldFromDriverRotation, state.zeroPos + translation - refOffset);
+	transform.worldFromDriverRotation = worldFromDriverRotation;
+	transform.worldFromDriverTranslation = translation;
+	transform.refGeneration = state.generation;
+	transform.valid = true;
+}
+
+static vr::HmdVector3d_t _lerp(const vr::HmdVector3d_t& a, const vr::HmdVector3d_t& b, double t) {
+	return { a.v[0] + (b.v[0] - a.v[0]) * t, a.v[1] + (b.v[1] - a.v[1]) * t, a.v[2] + (b.v[2] - a.v[2]) * t };
+}
+
+bool CServerDriver::_interpolateMotionCompensationRef(const MotionCompensationRef& ref, const vr::DriverPose_t& pose, MotionCompensationRefSample& sample) {
+	if (ref.historyFirst == ref.historyLatest) {
+		return false; // less than two samples
+	}
+	auto timeNs = _poseTimeNs(pose);
+	if (timeNs >= ref.refTimeNs) {
+		return false; // not older than the latest reference pose
+	}
+	MotionCompensationRefSample newer, older;
+	_motionCompensationHistory[ref.historyLatest % _motionCompensationHistorySize].read(newer);
+	if (newer.index != ref.historyLatest) {
+		return false; // ref is outdated by a whole ring
+	}
+	for (uint32_t i = ref.historyLatest; i != ref.historyFirst; ) {
+		--i;
+		_motionCompensationHistory[i % _motionCompensationHistorySize].read(older);
+		if (older.index != i) {
+			break; // overwritten in the meantime, use the oldest sample we have
+		}
+		if (older.timeNs <= timeNs) {
+			double t = (double)(timeNs - older.timeNs) / (double)(newer.timeNs - older.timeNs);
+			sample.index = newer.index;
+			sample.timeNs = timeNs;
+			sample.rotDiff = vrmath::quaternionSlerp(older.rotDiff, newer.rotDiff, t);
+			sample.refPos = _lerp(older.refPos, newer.refPos, t);
+			sample.rotation = vrmath::quaternionSlerp(older.rotation, newer.rotation, t);
+			sample.translation = _lerp(older.translation, newer.translation, t);
+			return true;
+		}
+		newer = older;
+	}
+	// Older than the whole history
+	sample = newer;
+	return true;
+}
+
+static bool _isSameDriverSpace(const MotionCompensationTransform& transform, const vr::DriverPose_t& pose) {
+	return std::memcmp(&transform.worldFromDriverRotation, &pose.qWorldFromDriverRotation, sizeof(vr::HmdQuaternion_t)) == 0
+		&& std::memcmp(transform.worldFromDriverTranslation.v, pose.vecWorldFromDriverTranslation, sizeof(pose.vecWorldFromDriverTranslation)) == 0;
 }
 
 bool CServerDriver::_applyMotionCompensation(vr::DriverPose_t& pose, OpenvrDeviceManipulationInfo* deviceInfo) {
-	if (_motionCompensationEnabled && _motionCompensationZeroPoseValid && _motionCompensationRefPoseValid) {
-		// convert pose from driver space to app space
-		vr::HmdQuaternion_t tmpConj = vrmath::quaternionConjugate(pose.qWorldFromDriverRotation);
-		auto poseWorldPos = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, tmpConj, pose.vecPosition, true) - pose.vecWorldFromDriverTranslation;
-		auto poseWorldRot = tmpConj * pose.qRotation;
-
-		// do motion compensation
-		auto compensatedPoseWorldPos = _motionCompensationZeroPos + vrmath::quaternionRotateVector(_motionCompensationRotDiff, _motionCompensationRotDiffInv, poseWorldPos - _motionCompensationRefPos, true);
-		auto compensatedPoseWorldRot = _motionCompensationRotDiffInv * poseWorldRot;
-
-		// convert back to driver space
-		pose.qRotation = pose.qWorldFromDriverRotation * compensatedPoseWorldRot;
-		auto adjPoseDriverPos = vrmath::quaternionRotateVector(pose.qWorldFromDriverRotation, tmpConj, compensatedPoseWorldPos + pose.vecWorldFromDriverTranslation);
-		pose.vecPosition[0] = adjPoseDriverPos.v[0];
-		pose.vecPosition[1] = adjPoseDriverPos.v[1];
-		pose.vecPosition[2] = adjPoseDriverPos.v[2];
+	MotionCompensationRef ref;
+	MotionCompensationRefState state;
+	_motionCompensationRef.read(ref);
+	if (ref.active && ref.velAccMode == 2 && ref.velAccValid) {
+		_readMotionCompensationRefState(ref, state);
+	}
+	if (ref.active) {
+		// Devices in the driver space of the reference device use the transform of the reference packet,
+		// the others keep their own one per reference generation. Poses older than the reference use the
+		// reference interpolated to their time instead.
+		const MotionCompensationTransform* transform = &ref.transform;
+		MotionCompensationTransform interpolatedTransform;
+		MotionCompensationRefSample interpolatedRef;
+		if (_interpolateMotionCompensationRef(ref, pose, interpolatedRef)) {
+			// The pose is older than the latest reference pose, compensate it with the reference at its own time
+			if (_isSameDriverSpace(ref.transform, pose)) {
+				interpolatedTransform.rotation = interpolatedRef.rotation;
+				interpolatedTransform.rotationMatrix = vrmath::rotationMatrixFromQuaternion(interpolatedRef.rotation);
+				interpolatedTransform.translation = interpolatedRef.translation;
+			} else {
+				if (state.generation != ref.generation) {
+					_readMotionCompensationRefState(ref, state);
+					if (!ref.active) {
+						return false;
+					}
+				}
+				auto interpolatedState = state;
+				interpolatedState.rotDiff = interpolatedRef.rotDiff;
+				interpolatedState.refPos = interpolatedRef.refPos;
+				_updateMotionCompensationTransform(interpolatedTransform, interpolatedState, pose.qWorldFromDriverRotation, pose.vecWorldFromDriverTranslation);
+			}
+			transform = &interpolatedTransform;
+		} else if (!_isSameDriverSpace(ref.transform, pose)) {
+			auto& deviceTransform = deviceInfo->motionCompensationTransform();
+			if (!deviceTransform.valid || deviceTransform.refGeneration != ref.generation || !_isSameDriverSpace(deviceTransform, pose)) {
+				if (state.generation != ref.generation) {
+					_readMotionCompensationRefState(ref, state);
+					if (!ref.active) {
+						return false;
+					}
+				}
+				_updateMotionCompensationTransform(deviceTransform, state, pose.qWorldFromDriverRotation, pose.vecWorldFromDriverTranslation);
+			}
+			transform = &deviceTransform;
+		}
+
+		// do motion compensation (in driver space, see _updateMotionCompensationTransform())
+		pose.qRotation = transform->rotation * pose.qRotation;
+		vrmath::rotateVector(transform->rotationMatrix, pose.vecPosition, pose.vecPosition);
+		pose.vecPosition[0] += transform->translation.v[0];
+		pose.vecPosition[1] += transform->translation.v[1];
+		pose.vecPosition[2] += transform->translation.v[2];
 
 		// Velocity / Acceleration Compensation
-		if (_motionCompensationVelAccMode == 1) { // Set Zero
+		if (ref.velAccMode == 1) { // Set Zero
 			pose.vecVelocity[0] = 0.0;
 			pose.vecVelocity[1] = 0.0;
 			pose.vecVelocity[2] = 0.0;
@@ -560,29 +702,29 @@ bool CServerDriver::_applyMotionCompensation(vr::DriverPose_t& pose, OpenvrDevic
 			pose.vecAngularAcceleration[0] = 0.0;
 			pose.vecAngularAcceleration[1] = 0.0;
 			pose.vecAngularAcceleration[2] = 0.0;
-		} else if (_motionCompensationVelAccMode == 2) { // Substract Motion Ref
-			if (_motionCompensationRefVelAccValid) {
-				auto tmpRot = pose.qWorldFromDriverRotation * pose.qRotation;
-				auto tmpRotInv = vrmath::quaternionConjugate(tmpRot);
-				auto tmpPosVel = vrmath::quaternionRotateVector(tmpRot, tmpRotInv, _motionCompensationRefPosVel);
+		} else if (ref.velAccMode == 2) { // Substract Motion Ref
+			if (ref.velAccValid && state.generation == ref.generation) {
+				// One matrix for the four rotations below
+				auto tmpRot = vrmath::rotationMatrixFromQuaternion(pose.qWorldFromDriverRotation * pose.qRotation);
+				auto tmpPosVel = vrmath::rotateVector(tmpRot, state.refPosVel);
 				pose.vecVelocity[0] -= tmpPosVel.v[0];
 				pose.vecVelocity[1] -= tmpPosVel.v[1];
 				pose.vecVelocity[2] -= tmpPosVel.v[2];
-				auto tmpPosAcc = vrmath::quaternionRotateVector(tmpRot, tmpRotInv, _motionCompensationRefPosAcc);
+				auto tmpPosAcc = vrmath::rotateVector(tmpRot, state.refPosAcc);
 				pose.vecAcceleration[0] -= tmpPosAcc.v[0];
 				pose.vecAcceleration[1] -= tmpPosAcc.v[1];
 				pose.vecAcceleration[2] -= tmpPosAcc.v[2];
-				auto tmpRotVel = vrmath::quaternionRotateVector(tmpRot, tmpRotInv, _motionCompensationRefRotVel);
+				auto tmpRotVel = vrmath::rotateVector(tmpRot, state.refRotVel);
 				pose.vecAngularVelocity[0] -= tmpRotVel.v[0];
 				pose.vecAngularVelocity[1] -= tmpRotVel.v[1];
 				pose.vecAngularVelocity[2] -= tmpRotVel.v[2];
-				auto tmpRotAcc = vrmath::quaternionRotateVector(tmpRot, tmpRotInv, _motionCompensationRefRotAcc);
+				auto tmpRotAcc = vrmath::rotateVector(tmpRot, state.refRotAcc);
 				pose.vecAngularAcceleration[0] -= tmpRotAcc.v[0];
 				pose.vecAngularAcceleration[1] -= tmpRotAcc.v[1];
 				pose.vecAngularAcceleration[2] -= tmpRotAcc.v[2];
 			}
-		} else if (_motionCompensationVelAccMode == 3) { // Linear Approximation
-			auto now = std::chrono::duration_cast <std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+		} else if (ref.velAccMode == 3) { // Linear Approximation
+			auto now = std::chrono::duration_cast <std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
 			if (deviceInfo->lastDriverPoseValid()) {
 				auto& lastPose = deviceInfo->lastDriverPose();
 				double tdiff = ((double)(now - deviceInfo->lastDriverPoseTime()) / 1.0E6) + (pose.poseTimeOffset - lastPose.poseTimeOffset);
@@ -627,6 +769,8 @@ bool CServerDriver::_applyMotionCompensation(vr::DriverPose_t& pose, OpenvrDevic
 				}
 			}
 			deviceInfo->setLastDriverPose(pose, now);
+		} else if (ref.velAccMode == 4) { // Kalman Filter
+			deviceInfo->motionCompensationFilter().filter(pose, _poseTimeNs(pose), ref.kalmanProcessNoise, ref.kalmanObservationNoise);
 		}
 		return true;
 	} else {
@@ -10,7 +10,13 @@
 #include <atomic>
 #include "logging.h"
 #include <vrinputemulator_types.h>
+#include <openvr_math.h>
 #include "utils/DevicePropertyValueVisitor.h"
+#include "utils/AtomicSnapshot.h"
+#include "utils/PointerIndex.h"
+#include "utils/Seqlock.h"
+#include "utils/PoseKalmanFilter.h"
+#include "utils/TraceRecorder.h"
 #include "com/shm/driver_ipc_shm.h"
 
 
@@ -56,11 +62,112 @@ public:
 
 
 
+class OpenvrDeviceManipulationInfo;
+
+// Behaviour of a device in the hooks, derived from device mode and redirect suspension (see OpenvrDeviceManipulationInfo::_modeHandlers)
+enum class DeviceModeHandler : uint8_t {
+	Default = 0,
+	FakeDisconnected,
+	RedirectSource,
+	RedirectTarget,
+	RedirectSuspended,
+	Swap,
+	MotionCompensation,
+	Count
+};
+
+// Manipulation settings of an openvr device. The hooks read them as an immutable snapshot (see AtomicSnapshot).
+struct OpenvrDeviceManipulationConfig {
+	int deviceMode = 0; // 0 .. default, 1 .. disabled, 2 .. redirect source, 3 .. redirect target, 4 .. swap mode, 5 .. motion compensation
+	bool redirectSuspended = false;
+	OpenvrDeviceManipulationInfo* redirectRef = nullptr;
+
+	bool offsetsEnabled = false;
+	vr::HmdQuaternion_t worldFromDriverRotationOffset = { 1.0, 0.0, 0.0, 0.0 };
+	vr::HmdVector3d_t worldFromDriverTranslationOffset = { 0.0, 0.0, 0.0 };
+	vr::HmdQuaternion_t driverFromHeadRotationOffset = { 1.0, 0.0, 0.0, 0.0 };
+	vr::HmdVector3d_t driverFromHeadTranslationOffset = { 0.0, 0.0, 0.0 };
+	vr::HmdQuaternion_t deviceRotationOffset = { 1.0, 0.0, 0.0, 0.0 };
+	vr::HmdVector3d_t deviceTranslationOffset = { 0.0, 0.0, 0.0 };
+
+	bool enableButtonMapping = false;
+	std::map<vr::EVRButtonId, vr::EVRButtonId> buttonMapping;
+
+	// Set by compileOffsets(): offsets are enabled and at least one of them is not the identity
+	bool offsetsActive = false;
+	void compileOffsets();
+
+	// Set by selectModeHandler()
+	DeviceModeHandler modeHandler = DeviceModeHandler::Default;
+	void selectModeHandler();
+};
+
+
+// Motion compensation precomposed into one rigid transform in driver space, for one driver space (worldFromDriver)
+// and one motion compensation reference pose. The driver space of a device rarely changes, so most poses only
+// need one rotation and one add.
+struct MotionCompensationTransform {
+	bool valid = false;
+	uint32_t refGeneration = 0;
+	vr::HmdQuaternion_t worldFromDriverRotation;
+	vr::HmdVector3d_t worldFromDriverTranslation;
+	vr::HmdQuaternion_t rotation;
+	vrmath::RotationMatrix33 rotationMatrix; // of rotation
+	vr::HmdVector3d_t translation;
+};
+
+
+// Motion compensation reference, computed once per reference pose and read by the pose hooks of all devices.
+// Carries the transform for the driver space of the reference device, which most devices share. Kept small,
+// because every pose hook copies it.
+struct MotionCompensationRef {
+	uint32_t generation = 0; // incremented with every reference change
+	bool active = false; // enabled, zero pose and reference pose valid
+	bool velAccValid = false;
+	uint32_t velAccMode = 0;
+	double kalmanProcessNoise = 0.0; // vel/acc mode 4
+	double kalmanObservationNoise = 0.0;
+	uint64_t refTimeNs = 0; // time the reference pose is valid at
+	uint32_t historyFirst = 0; // reference samples usable for interpolation, historyLatest is the one of this generation
+	uint32_t historyLatest = 0;
+	MotionCompensationTransform transform;
+};
+
+// The reference pose behind a MotionCompensationRef of the same generation. Only needed for devices in
+// another driver space and for velocity/acceleration mode 2.
+struct MotionCompensationRefState {
+	uint32_t generation = 0;
+	vr::HmdQuaternion_t rotDiff; // app space
+	vr::HmdVector3d_t zeroPos; // app space
+	vr::HmdVector3d_t refPos; // app space
+	vr::HmdVector3d_t refPosVel;
+	vr::HmdVector3d_t refPosAcc;
+	vr::HmdVector3d_t refRotVel;
+	vr::HmdVector3d_t refRotAcc;
+};
+
+// One reference pose in the motion compensation history, for interpolating the reference to the time of a
+// device pose. All samples between historyFirst and historyLatest share the reference device's driver space.
+struct MotionCompensationRefSample {
+	uint32_t index = 0; // running sample number, the slot is index % historySize
+	uint64_t timeNs = 0;
+	vr::HmdQuaternion_t rotDiff; // app space
+	vr::HmdVector3d_t refPos; // app space
+	vr::HmdQuaternion_t rotation; // MotionCompensationTransform for the reference device's driver space
+	vr::HmdVector3d_t translation;
+};
+
+
 // Stores manipulation information about an openvr device
 class OpenvrDeviceManipulationInfo {
 private:
+	// The pose/button/axis hooks only read _config and never block. Config changes (ipc, redirect suspend toggle)
+	// copy the current snapshot, change the copy and publish it. They are serialized by one mutex for all devices,
+	// because some of them change two devices at once.
+	static std::recursive_mutex _configWriteMutex;
+	AtomicSnapshot<OpenvrDeviceManipulationConfig> _config;
+
 	bool m_isValid = false;
-	std::recursive_mutex _mutex;
 	vr::ETrackedDeviceClass m_eDeviceClass = vr::TrackedDeviceClass_Invalid;
 	vr::ITrackedDeviceServerDriver* m_driver = nullptr;
 	vr::IVRServerDriverHost* m_driverHost = nullptr;
@@ -69,28 +176,48 @@ private:
 	vr::IVRControllerComponent* m_controllerComponent;
 	_DetourTriggerHapticPulse_t m_triggerHapticPulseFunc;
 
-	int m_deviceMode = 0; // 0 .. default, 1 .. disabled, 2 .. redirect source, 3 .. redirect target, 4 .. swap mode, 5 .. motion compensation
-	bool _disconnectedMsgSend = false;
-
-	bool m_offsetsEnabled = false;
-	vr::HmdQuaternion_t m_worldFromDriverRotationOffset = { 1.0, 0.0, 0.0, 0.0 };
-	vr::HmdVector3d_t m_worldFromDriverTranslationOffset = { 0.0, 0.0, 0.0 };
-	vr::HmdQuaternion_t m_driverFromHeadRotationOffset = { 1.0, 0.0, 0.0, 0.0 };
-	vr::HmdVector3d_t m_driverFromHeadTranslationOffset = { 0.0, 0.0, 0.0 };
-	vr::HmdQuaternion_t m_deviceRotationOffset = { 1.0, 0.0, 0.0, 0.0 };
-	vr::HmdVector3d_t m_deviceTranslationOffset = { 0.0, 0.0, 0.0 };
-
-	bool m_enableButtonMapping = false;
-	std::map<vr::EVRButtonId, vr::EVRButtonId> m_buttonMapping;
-
-	bool m_redirectSuspended = false;
-	OpenvrDeviceManipulationInfo* m_redirectRef = nullptr;
+	std::atomic<bool> _disconnectedMsgSend = { false };
 
 	bool m_lastDriverPoseValid = false;
 	vr::DriverPose_t m_lastDriverPose;
 	long long m_lastDriverPoseTime = 0;
 
+	MotionCompensationTransform m_motionCompensationTransform; // only used by the pose hook of this device, when its driver space differs from the reference device
+	PoseKalmanFilter m_motionCompensationFilter; // only used by the pose hook of this device
+
+	template<typename F> void _updateConfig(F change);
+	void _toggleRedirectSuspended();
 
+	// Hook implementations per DeviceModeHandler, picked with one table lookup per event
+	struct ModeHandlers {
+		void (OpenvrDeviceManipulationInfo::*pose)(const OpenvrDeviceManipulationConfig& config, vr::IVRServerDriverHost* driver, _DetourTrackedDevicePoseUpdated_t origFunc, uint32_t unWhichDevice, const vr::DriverPose_t& pose);
+		// Returns true when the redirect suspension needs to be toggled
+		bool (OpenvrDeviceManipulationInfo::*button)(const OpenvrDeviceManipulationConfig& config, vr::IVRServerDriverHost* driver, void* origFunc, uint32_t unWhichDevice, ButtonEventType eventType, vr::EVRButtonId eButtonId, double eventTimeOffset);
+		void (OpenvrDeviceManipulationInfo::*axis)(const OpenvrDeviceManipulationConfig& config, vr::IVRServerDriverHost* driver, _DetourTrackedDeviceAxisUpdated_t origFunc, uint32_t unWhichDevice, uint32_t unWhichAxis, const vr::VRControllerAxis_t& axisState);
+		bool (OpenvrDeviceManipulationInfo::*haptic)(const OpenvrDeviceManipulationConfig& config, uint32_t unAxisId, uint16_t usPulseDurationMicroseconds);
+	};
+	static const ModeHandlers _modeHandlers[(int)DeviceModeHandler::Count];
+
+	void _transformPose(const OpenvrDeviceManipulationConfig& config, vr::DriverPose_t& pose); // offsets and motion compensation
+	void _sendDisconnectedPose(vr::IVRServerDriverHost* driver, _DetourTrackedDevicePoseUpdated_t origFunc, uint32_t unWhichDevice, const vr::DriverPose_t& pose);
+	void _poseDefault(const OpenvrDeviceManipulationConfig& config, vr::IVRServerDriverHost* driver, _DetourTrackedDevicePoseUpdated_t origFunc, uint32_t unWhichDevice, const vr::DriverPose_t& pose);
+	void _poseFakeDisconnected(const OpenvrDeviceManipulationConfig& config, vr::IVRServerDriverHost* driver, _DetourTrackedDevicePoseUpdated_t origFunc, uint32_t unWhichDevice, const vr::DriverPose_t& pose);
+	void _poseRedirectSource(const OpenvrDeviceManipulationConfig& config, vr::IVRServerDriverHost* driver, _DetourTrackedDevicePoseUpdated_t origFunc, uint32_t unWhichDevice, const vr::DriverPose_t& pose);
+	void _poseSwap(const OpenvrDeviceManipulationConfig& config, vr::IVRServerDriverHost* driver, _DetourTrackedDevicePoseUpdated_t origFunc, uint32_t unWhichDevice, const vr::DriverPose_t& pose);
+	void _poseMotionCompensation(const OpenvrDeviceManipulationConfig& config, vr::IVRServerDriverHost* driver, _DetourTrackedDevicePoseUpdated_t origFunc, uint32_t unWhichDevice, const vr::DriverPose_t& pose);
+	void _poseNop(const OpenvrDeviceManipulationConfig& config, vr::IVRServerDriverHost* driver, _DetourTrackedDevicePoseUpdated_t origFunc, uint32_t unWhichDevice, const vr::DriverPose_t& pose) {}
+	bool _buttonDefault(const OpenvrDeviceManipulationConfig& config, vr::IVRServerDriverHost* driver, void* origFunc, uint32_t unWhichDevice, ButtonEventType eventType, vr::EVRButtonId eButtonId, double eventTimeOffset);
+	bool _buttonForward(const OpenvrDeviceManipulationConfig& config, vr::IVRServerDriverHost* driver, void* origFunc, uint32_t unWhichDevice, ButtonEventType eventType, vr::EVRButtonId eButtonId, double eventTimeOffset);
+	bool _buttonRedirectSource(const OpenvrDeviceManipulationConfig& config, vr::IVRServerDriverHost* driver, void* origFunc, uint32_t unWhichDevice, ButtonEventType eventType, vr::EVRButtonId eButtonId, double eventTimeOffset);
+	bool _buttonRedirectTarget(const OpenvrDeviceManipulationConfig& config, vr::IVRServerDriverHost* driver, void* origFunc, uint32_t unWhichDevice, ButtonEventType eventType, vr::EVRButtonId eButtonId, double eventTimeOffset);
+	bool _buttonRedirectSuspended(const OpenvrDeviceManipulationConfig& config, vr::IVRServerDriverHost* driver, void* origFunc, uint32_t unWhichDevice, ButtonEventType eventType, vr::EVRButtonId eButtonId, double eventTimeOffset);
+	bool _buttonNop(const OpenvrDeviceManipulationConfig& config, vr::IVRServerDriverHost* driver, void* origFunc, uint32_t unWhichDevice, ButtonEventType eventType, vr::EVRButtonId eButtonId, double eventTimeOffset) { return false; }
+	void _axisDefault(const OpenvrDeviceManipulationConfig& config, vr::IVRServerDriverHost* driver, _DetourTrackedDeviceAxisUpdated_t origFunc, uint32_t unWhichDevice, uint32_t unWhichAxis, const vr::VRControllerAxis_t& axisState);
+	void _axisForward(const OpenvrDeviceManipulationConfig& config, vr::IVRServerDriverHost* driver, _DetourTrackedDeviceAxisUpdated_t origFunc, uint32_t unWhichDevice, uint32_t unWhichAxis, const vr::VRControllerAxis_t& axisState);
+	void _axisNop(const OpenvrDeviceManipulationConfig& config, vr::IVRServerDriverHost* driver, _DetourTrackedDeviceAxisUpdated_t origFunc, uint32_t unWhichDevice, uint32_t unWhichAxis, const vr::VRControllerAxis_t& axisState) {}
+	bool _hapticDefault(const OpenvrDeviceManipulationConfig& config, uint32_t unAxisId, uint16_t usPulseDurationMicroseconds);
+	bool _hapticForward(const OpenvrDeviceManipulationConfig& config, uint32_t unAxisId, uint16_t usPulseDurationMicroseconds);
+	bool _hapticNop(const OpenvrDeviceManipulationConfig& config, uint32_t unAxisId, uint16_t usPulseDurationMicroseconds) { return true; }
 
 public:
 	OpenvrDeviceManipulationInfo() {}
@@ -109,7 +236,9 @@ public:
 	void setControllerComponent(vr::IVRControllerComponent* component, _DetourTriggerHapticPulse_t triggerHapticPulse);
 
 	void setFakeDisconnection(bool value);
-	int deviceMode() const { return m_deviceMode; }
+	// Current settings (a copy, use it to read several values consistently)
+	OpenvrDeviceManipulationConfig config() const { return _config.copy(); }
+	int deviceMode() const { return _config.read()->deviceMode; }
 	int setDefaultMode();
 	int setRedirectMode(bool target, OpenvrDeviceManipulationInfo* ref);
 	int setSwapMode(OpenvrDeviceManipulationInfo* ref);
@@ -118,30 +247,30 @@ public:
 
 	int _disableOldMode(int newMode);
 
-	bool areOffsetsEnabled() const { return m_offsetsEnabled; }
-	void enableOffsets(bool enable) { m_offsetsEnabled = enable; }
-	const vr::HmdQuaternion_t& worldFromDriverRotationOffset() const { return m_worldFromDriverRotationOffset; }
-	vr::HmdQuaternion_t& worldFromDriverRotationOffset() { return m_worldFromDriverRotationOffset; }
-	const vr::HmdVector3d_t& worldFromDriverTranslationOffset() const { return m_worldFromDriverTranslationOffset; }
-	vr::HmdVector3d_t& worldFromDriverTranslationOffset() { return m_worldFromDriverTranslationOffset; }
-	const vr::HmdQuaternion_t& driverFromHeadRotationOffset() const { return m_driverFromHeadRotationOffset; }
-	vr::HmdQuaternion_t& driverFromHeadRotationOffset() { return m_driverFromHeadRotationOffset; }
-	const vr::HmdVector3d_t& driverFromHeadTranslationOffset() const { return m_driverFromHeadTranslationOffset; }
-	vr::HmdVector3d_t& driverFromHeadTranslationOffset() { return m_driverFromHeadTranslationOffset; }
-	const vr::HmdQuaternion_t& deviceRotationOffset() const { return m_deviceRotationOffset; }
-	vr::HmdQuaternion_t& deviceRotationOffset() { return m_deviceRotationOffset; }
-	const vr::HmdVector3d_t& deviceTranslationOffset() const { return m_deviceTranslationOffset; }
-	vr::HmdVector3d_t& deviceTranslationOffset() { return m_deviceTranslationOffset; }
-
-	bool buttonMappingEnabled() const { return m_enableButtonMapping; }
-	void setButtonMappingEnabled(bool enable) { m_enableButtonMapping = enable; }
+	bool areOffsetsEnabled() const { return _config.read()->offsetsEnabled; }
+	void enableOffsets(bool enable);
+	vr::HmdQuaternion_t worldFromDriverRotationOffset() const { return _config.read()->worldFromDriverRotationOffset; }
+	void setWorldFromDriverRotationOffset(const vr::HmdQuaternion_t& value);
+	vr::HmdVector3d_t worldFromDriverTranslationOffset() const { return _config.read()->worldFromDriverTranslationOffset; }
+	void setWorldFromDriverTranslationOffset(const vr::HmdVector3d_t& value);
+	vr::HmdQuaternion_t driverFromHeadRotationOffset() const { return _config.read()->driverFromHeadRotationOffset; }
+	void setDriverFromHeadRotationOffset(const vr::HmdQuaternion_t& value);
+	vr::HmdVector3d_t driverFromHeadTranslationOffset() const { return _config.read()->driverFromHeadTranslationOffset; }
+	void setDriverFromHeadTranslationOffset(const vr::HmdVector3d_t& value);
+	vr::HmdQuaternion_t deviceRotationOffset() const { return _config.read()->deviceRotationOffset; }
+	void setDeviceRotationOffset(const vr::HmdQuaternion_t& value);
+	vr::HmdVector3d_t deviceTranslationOffset() const { return _config.read()->deviceTranslationOffset; }
+	void setDeviceTranslationOffset(const vr::HmdVector3d_t& value);
+
+	bool buttonMappingEnabled() const { return _config.read()->enableButtonMapping; }
+	void setButtonMappingEnabled(bool enable);
 	void addButtonMapping(vr::EVRButtonId button, vr::EVRButtonId mappedButton);
 	bool getButtonMapping(vr::EVRButtonId button, vr::EVRButtonId& mappedButton);
 	void eraseButtonMapping(vr::EVRButtonId button);
 	void eraseAllButtonMappings();
 
-	bool redirectSuspended() const { return m_redirectSuspended; }
-	OpenvrDeviceManipulationInfo* redirectRef() const { return m_redirectRef; }
+	bool redirectSuspended() const { return _config.read()->redirectSuspended; }
+	OpenvrDeviceManipulationInfo* redirectRef() const { return _config.read()->redirectRef; }
 
 	void handleNewDevicePose(vr::IVRServerDriverHost* driver, _DetourTrackedDevicePoseUpdated_t origFunc, uint32_t& unWhichDevice, const vr::DriverPose_t& newPose);
 	void handleButtonEvent(vr::IVRServerDriverHost* driver, void* origFunc, uint32_t& unWhichDevice, ButtonEventType eventType, vr::EVRButtonId eButtonId, double eventTimeOffset);
@@ -158,6 +287,78 @@ public:
 		m_lastDriverPoseTime = time;
 		m_lastDriverPoseValid = true;
 	}
+
+	MotionCompensationTransform& motionCompensationTransform() { return m_motionCompensationTransform; }
+	PoseKalmanFilter& motionCompensationFilter() { return m_motionCompensationFilter; }
+};
+
+
+/**
+* All openvr devices known to the driver.
+*
+* The fields the hooks need on every call are kept in flat arrays indexed by openvrId (hot). Everything that is
+* only needed when a device is added, activated or iterated lives in one entry per added device (cold), which is
+* found by driver or controller component pointer through open-addressing indices.
+*
+* Lookups are lock-free. Devices are only ever added, writers need to be serialized by the caller.
+*/
+class DeviceRegistry {
+public:
+	static const uint32_t maxDevices = vr::k_unMaxTrackedDeviceCount;
+
+	DeviceRegistry();
+	DeviceRegistry(const DeviceRegistry&) = delete;
+	DeviceRegistry& operator=(const DeviceRegistry&) = delete;
+
+	//// hot, indexed by openvrId ////
+
+	/** Manipulation info of an activated device, or nullptr */
+	OpenvrDeviceManipulationInfo* manipulationInfo(uint32_t openvrId) const {
+		return openvrId < maxDevices ? _manipulationInfos[openvrId].load(std::memory_order_acquire) : nullptr;
+	}
+
+	/** Driver host of an activated device, or the default driver host */
+	vr::IVRServerDriverHost* driverHost(uint32_t openvrId) const {
+		auto host = openvrId < maxDevices ? _driverHosts[openvrId].load(std::memory_order_acquire) : nullptr;
+		return host ? host : vr::VRServerDriverHost();
+	}
+
+	/** Virtual device of this driver, or nullptr */
+	CTrackedDeviceDriver* virtualDevice(uint32_t openvrId) const {
+		return openvrId < maxDevices ? _virtualDevices[openvrId].load(std::memory_order_acquire) : nullptr;
+	}
+
+	void setVirtualDevice(uint32_t openvrId, CTrackedDeviceDriver* device);
+
+	//// cold, one entry per added device ////
+
+	/** Returns false when the driver is already known or the registry is full */
+	bool addDevice(std::shared_ptr<OpenvrDeviceManipulationInfo> info, _DetourTrackedDeviceActivate_t activateFunc);
+
+	bool addControllerComponent(vr::IVRControllerComponent* component, OpenvrDeviceManipulationInfo* info);
+
+	/** Makes the device visible to the hooks under its openvrId. Returns the original activate function, or nullptr for unknown drivers. */
+	_DetourTrackedDeviceActivate_t activateDevice(vr::ITrackedDeviceServerDriver* driver, uint32_t openvrId);
+
+	OpenvrDeviceManipulationInfo* findByControllerComponent(vr::IVRControllerComponent* component) const;
+
+	/** Added devices, index < deviceCount() (whether they are activated or not) */
+	uint32_t deviceCount() const { return _entryCount.load(std::memory_order_acquire); }
+	OpenvrDeviceManipulationInfo* device(uint32_t index) const { return _entries[index].info.get(); }
+
+private:
+	std::atomic<OpenvrDeviceManipulationInfo*> _manipulationInfos[maxDevices];
+	std::atomic<vr::IVRServerDriverHost*> _driverHosts[maxDevices];
+	std::atomic<CTrackedDeviceDriver*> _virtualDevices[maxDevices];
+
+	struct Entry {
+		std::shared_ptr<OpenvrDeviceManipulationInfo> info;
+		_DetourTrackedDeviceActivate_t activateFunc = nullptr;
+	};
+	Entry _entries[maxDevices];
+	std::atomic<uint32_t> _entryCount = { 0 };
+	PointerIndex<vr::ITrackedDeviceServerDriver*, maxDevices * 2> _driverIndex; // => entry index
+	PointerIndex<vr::IVRControllerComponent*, maxDevices * 2> _controllerComponentIndex; // => entry index
 };
 
 
@@ -237,11 +438,13 @@ public:
 	/* Motion Compensation API */
 	void enableMotionCompensation(bool enable);
 	void setMotionCompensationVelAccMode(uint32_t velAccMode);
+	void setMotionCompensationKalmanFilterNoise(double processNoise, double observationNoise);
 	void disableMotionCompensationOnAllDevices();
 	bool _isMotionCompensationZeroPoseValid();
 	void _setMotionCompensationZeroPose(const vr::DriverPose_t& pose);
 	void _updateMotionCompensationRefPose(const vr::DriverPose_t& pose);
 	bool _applyMotionCompensation(vr::DriverPose_t& pose, OpenvrDeviceManipulationInfo* deviceInfo);
+	static void _updateMotionCompensationTransform(MotionCompensationTransform& transform, const MotionCompensationRefState& state, const vr::HmdQuaternion_t& worldFromDriverRotation, const double (&worldFromDriverTranslation)[3]);
 
 
 private:
@@ -251,20 +454,37 @@ private:
 	std::recursive_mutex _virtualDevicesMutex;
 	uint32_t m_virtualDeviceCount = 0;
 	std::shared_ptr<CTrackedDeviceDriver> m_virtualDevices[vr::k_unMaxTrackedDeviceCount];
-	CTrackedDeviceDriver* m_openvrIdToVirtualDeviceMap[vr::k_unMaxTrackedDeviceCount];
 
 	//// ipc shm related ////
 	IpcShmCommunicator shmCommunicator;
 
 
 	//// openvr device manipulation related ////
-	std::recursive_mutex _openvrDevicesMutex;
-	static std::map<vr::ITrackedDeviceServerDriver*, std::shared_ptr<OpenvrDeviceManipulationInfo>> _openvrDeviceInfos;
-	static OpenvrDeviceManipulationInfo* _openvrIdToDeviceInfoMap[vr::k_unMaxTrackedDeviceCount];
+	static std::recursive_mutex _openvrDevicesMutex; // serializes changes to _devices
+	static DeviceRegistry _devices;
 
 	//// motion compensation related ////
+	// The fields below are only used by the writers (ipc, pose hook of the reference device) under
+	// _motionCompensationMutex. Every change is published as one MotionCompensationRef for the pose hooks.
+	std::mutex _motionCompensationMutex;
+	Seqlock<MotionCompensationRef> _motionCompensationRef;
+	Seqlock<MotionCompensationRefState> _motionCompensationRefState; // written before _motionCompensationRef
+	void _publishMotionCompensationRef(bool newRefSample = false);
+	void _readMotionCompensationRefState(MotionCompensationRef& ref, MotionCompensationRefState& state);
+	bool _interpolateMotionCompensationRef(const MotionCompensationRef& ref, const vr::DriverPose_t& pose, MotionCompensationRefSample& sample);
+
+	// Ring of the latest reference poses, written by the reference device's pose hook and read lock-free
+	// by the pose hooks of all devices
+	static const uint32_t _motionCompensationHistorySize = 32;
+	Seqlock<MotionCompensationRefSample> _motionCompensationHistory[_motionCompensationHistorySize];
+	uint32_t _motionCompensationHistoryNext = 0;
+	uint32_t _motionCompensationHistoryFirst = 0;
+	uint64_t _motionCompensationRefTimeNs = 0;
+
 	bool _motionCompensationEnabled = false;
-	int _motionCompensationVelAccMode = 0; // 0 .. Disabled, 1 .. Set Zero, 2 .. Substract Motion Ref, 3 .. Linear Approximation
+	int _motionCompensationVelAccMode = 0; // 0 .. Disabled, 1 .. Set Zero, 2 .. Substract Motion Ref, 3 .. Linear Approximation, 4 .. Kalman Filter
+	double _motionCompensationKalmanProcessNoise = 100.0;
+	double _motionCompensationKalmanObservationNoise = 1.0E-7;
 
 	bool _motionCompensationZeroPoseValid = false;
 	vr::HmdVector3d_t _motionCompensationZeroPos;
@@ -273,7 +493,9 @@ private:
 	bool _motionCompensationRefPoseValid = false;
 	vr::HmdVector3d_t _motionCompensationRefPos;
 	vr::HmdQuaternion_t _motionCompensationRotDiff;
-	vr::HmdQuaternion_t _motionCompensationRotDiffInv;
+	vr::HmdQuaternion_t _motionCompensationRefWorldFromDriverRotation;
+	double _motionCompensationRefWorldFromDriverTranslation[3];
+	uint32_t _motionCompensationRefGeneration = 0;
 
 	bool _motionCompensationRefVelAccValid = false;
 	vr::HmdVector3d_t _motionCompensationRefPosVel;
@@ -313,11 +535,9 @@ private:
 
 	static std::vector<_DetourFuncInfo<_DetourTrackedDeviceActivate_t>> _deviceActivateDetours;
 	static vr::EVRInitError _deviceActivateDetourFunc(vr::ITrackedDeviceServerDriver* _this, uint32_t unObjectId);
-	static std::map<vr::ITrackedDeviceServerDriver*, _DetourFuncInfo<_DetourTrackedDeviceActivate_t>*> _deviceActivateDetourMap; // _this => DetourInfo
 
 	static std::vector<_DetourFuncInfo<_DetourTriggerHapticPulse_t>> _deviceTriggerHapticPulseDetours;
 	static bool _deviceTriggerHapticPulseDetourFunc(vr::IVRControllerComponent* _this, uint32_t unAxisId, uint16_t usPulseDurationMicroseconds);
-	static std::map<vr::IVRControllerComponent*, std::shared_ptr<OpenvrDeviceManipulationInfo>> _controllerComponentToDeviceInfos; // ControllerComponent => ManipulationInfo
 };
 
 
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+
+namespace vrinputemulator {
+namespace driver {
+
+
+/**
+ * Immutable value that is read wait-free and only ever replaced as a whole.
+ *
+ * Readers pin the current snapshot with a Reader (one atomic increment and decrement, never blocks).
+ * Writers build a new value and publish() it. publish() never waits either: the old value is retired and freed by a
+ * later publish() once every reader that could still see it is gone.
+ *
+ * Grace periods use two reader counters that take turns. New readers register with the counter of the current
+ * epoch. A writer flips the epoch only when the other counter is drained, which means every reader of the epoch
+ * before is gone, and so is every value that was retired before the last flip.
+ *
+ * Writers need to be serialized by the caller.
+ */
+template<typename T>
+class AtomicSnapshot {
+public:
+	class Reader {
+	public:
+		explicit Reader(const AtomicSnapshot& owner) : _owner(&owner) {
+			while (true) {
+				auto epoch = _owner->_epoch.load(std::memory_order_seq_cst);
+				_counter = &_owner->_readers[epoch & 1];
+				_counter->fetch_add(1, std::memory_order_seq_cst);
+				if (_owner->_epoch.load(std::memory_order_seq_cst) == epoch) {
+					break;
+				}
+				// The epoch flipped meanwhile, the writer may already consider this counter drained
+				_counter->fetch_sub(1, std::memory_order_release);
+			}
+			_value = _owner->_current.load(std::memory_order_seq_cst);
+		}
+		Reader(Reader&& other) : _owner(other._owner), _counter(other._counter), _value(other._value) {
+			other._owner = nullptr;
+		}
+		~Reader() {
+			if (_owner) {
+				_counter->fetch_sub(1, std::memory_order_release);
+			}
+		}
+		Reader(const Reader&) = delete;
+		Reader& operator=(const Reader&) = delete;
+
+		const T* operator->() const { return _value; }
+		const T& operator*() const { return *_value; }
+
+	private:
+		const AtomicSnapshot* _owner;
+		std::atomic<uint32_t>* _counter;
+		const T* _value;
+	};
+
+	AtomicSnapshot() : _current(new T()) {
+		_readers[0].store(0);
+		_readers[1].store(0);
+	}
+	~AtomicSnapshot() {
+		delete _current.load();
+		for (auto value : _retired) {
+			delete value;
+		}
+		for (auto value : _retiredBeforeFlip) {
+			delete value;
+		}
+	}
+	AtomicSnapshot(const AtomicSnapshot&) = delete;
+	AtomicSnapshot& operator=(const AtomicSnapshot&) = delete;
+
+	Reader read() const {
+		return Reader(*this);
+	}
+
+	// Copy of the current value, writers change it and publish it again
+	T copy() const {
+		Reader reader(*this);
+		return *reader;
+	}
+
+	void publish(const T& value) {
+		_retired.push_back(_current.exchange(new T(value), std::memory_order_seq_cst));
+		_reclaim();
+	}
+
+private:
+	// Frees what no reader can see anymore. At most two flips: one frees the values retired before the last flip,
+	// the second one (when the readers of the last epoch are gone as well) also those retired since.
+	void _reclaim() {
+		for (int i = 0; i < 2 && !(_retired.empty() && _retiredBeforeFlip.empty()); ++i) {
+			auto epoch = _epoch.load(std::memory_order_seq_cst);
+			if (_readers[(epoch + 1) & 1].load(std::memory_order_seq_cst) != 0) {
+				return; // readers of the previous epoch are still active, retry on the next publish()
+			}
+			for (auto value : _retiredBeforeFlip) {
+				delete value;
+			}
+			_retiredBeforeFlip.swap(_retired);
+			_retired.clear();
+			_epoch.store(epoch + 1, std::memory_order_seq_cst);
+		}
+	}
+
+	std::atomic<const T*> _current;
+	mutable std::atomic<uint32_t> _epoch = { 0 };
+	mutable std::atomic<uint32_t> _readers[2];
+	std::vector<const T*> _retired; // replaced since the last epoch flip
+	std::vector<const T*> _retiredBeforeFlip; // replaced before the last epoch flip
+};
+
+
+} // end namespace driver
+} // end namespace vrinputemulator
@@ -0,0 +1,75 @@
+#include "HookStats.h"
+#include "../stdafx.h"
+#include <openvr_driver.h>
+
+
+namespace vrinputemulator {
+namespace driver {
+
+
+std::atomic<HookStats::Histogram*> HookStats::_histograms[HookStats::histogramCount];
+std::atomic<HookStats::Histogram*> HookStats::_entries[HookStats::histogramCount];
+std::atomic<uint32_t> HookStats::_entryCount = { 0 };
+std::mutex HookStats::_allocateMutex;
+
+
+HookStats::Histogram* HookStats::_allocate(uint32_t slot, uint16_t hook, uint32_t deviceId, uint8_t mode) {
+	std::lock_guard<std::mutex> lock(_allocateMutex);
+	auto histogram = _histograms[slot].load(std::memory_order_acquire);
+	if (!histogram) {
+		histogram = new Histogram();
+		histogram->hook = hook;
+		histogram->mode = mode;
+		histogram->deviceId = deviceId;
+		auto index = _entryCount.load(std::memory_order_relaxed);
+		_entries[index].store(histogram, std::memory_order_release);
+		_entryCount.store(index + 1, std::memory_order_release);
+		_histograms[slot].store(histogram, std::memory_order_release);
+	}
+	return histogram;
+}
+
+
+void HookStats::record(uint16_t hook, uint32_t deviceId, uint8_t mode, uint32_t elapsedNs) {
+	if (hook >= (uint16_t)trace::TraceHook::Count) {
+		return;
+	}
+	auto deviceSlot = deviceId < deviceSlots - 1 ? deviceId : deviceSlots - 1;
+	auto modeSlot = mode < modeSlots - 1 ? mode : modeSlots - 1;
+	auto slot = (hook * deviceSlots + deviceSlot) * modeSlots + modeSlot;
+	auto histogram = _histograms[slot].load(std::memory_order_acquire);
+	if (!histogram) {
+		histogram = _allocate(slot, hook, deviceSlot < deviceSlots - 1 ? deviceId : vr::k_unTrackedDeviceIndexInvalid,
+			modeSlot < modeSlots - 1 ? mode : trace::traceModeNone);
+	}
+	histogram->latency.record(elapsedNs);
+}
+
+
+uint32_t HookStats::entryCount() {
+	return _entryCount.load(std::memory_order_acquire);
+}
+
+
+bool HookStats::getEntry(uint32_t index, trace::HookStatsEntry& entry) {
+	if (index >= entryCount()) {
+		return false;
+	}
+	auto histogram = _entries[index].load(std::memory_order_acquire);
+	auto summary = histogram->latency.summarize();
+	entry.hook = histogram->hook;
+	entry.mode = histogram->mode;
+	entry.reserved = 0;
+	entry.deviceId = histogram->deviceId;
+	entry.callCount = summary.count;
+	entry.totalNs = summary.totalNs;
+	entry.maxNs = summary.maxNs;
+	entry.p50Ns = summary.p50Ns;
+	entry.p99Ns = summary.p99Ns;
+	entry.p999Ns = summary.p999Ns;
+	return true;
+}
+
+
+} // end namespace driver
+} // end namespace vrinputemulator
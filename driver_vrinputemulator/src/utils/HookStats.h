@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <vrinputemulator_trace.h>
+#include "LatencyHistogram.h"
+
+
+namespace vrinputemulator {
+namespace driver {
+
+
+/**
+ * Call counts and latency histograms of the detour hooks, kept per hook, openvr device and device mode.
+ *
+ * A histogram (see LatencyHistogram) is allocated on the first call of its hook/device/mode combination, after
+ * that recording is a few relaxed atomic adds.
+ */
+class HookStats {
+public:
+	// Adds one hook call
+	static void record(uint16_t hook, uint32_t deviceId, uint8_t mode, uint32_t elapsedNs);
+
+	// Number of histograms allocated so far, the index of a histogram never changes
+	static uint32_t entryCount();
+
+	// Summary of the histogram at the given index. Returns false when the index is out of range.
+	static bool getEntry(uint32_t index, trace::HookStatsEntry& entry);
+
+private:
+	static const uint32_t deviceSlots = 65; // openvr ids 0-63, last slot for hooks without device
+	static const uint32_t modeSlots = 8; // 7 device modes, last slot for traceModeNone
+	static const uint32_t histogramCount = (uint32_t)trace::TraceHook::Count * deviceSlots * modeSlots;
+
+	struct Histogram {
+		uint16_t hook = 0;
+		uint8_t mode = 0;
+		uint32_t deviceId = 0;
+		LatencyHistogram latency;
+	};
+
+	static Histogram* _allocate(uint32_t slot, uint16_t hook, uint32_t deviceId, uint8_t mode);
+
+	static std::atomic<Histogram*> _histograms[histogramCount];
+	static std::atomic<Histogram*> _entries[histogramCount]; // in allocation order
+	static std::atomic<uint32_t> _entryCount;
+	static std::mutex _allocateMutex;
+};
+
+
+} // end namespace driver
+} // end namespace vrinputemulator
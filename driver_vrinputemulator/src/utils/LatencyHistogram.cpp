@@ -0,0 +1,81 @@
+#include "LatencyHistogram.h"
+#include "../stdafx.h"
+#include <algorithm>
+#include <cmath>
+
+
+namespace vrinputemulator {
+namespace driver {
+
+
+uint32_t LatencyHistogram::_bucketIndex(uint32_t value) {
+	if (value < linearLimit) {
+		return value;
+	}
+	uint32_t exponent = 31;
+	while (!(value & (1u << exponent))) {
+		--exponent;
+	}
+	auto shift = exponent - subBucketBits;
+	auto subBucket = (value >> shift) & ((1u << subBucketBits) - 1);
+	return linearLimit + (exponent - (subBucketBits + 1)) * (1u << subBucketBits) + subBucket;
+}
+
+
+uint32_t LatencyHistogram::_bucketUpperBound(uint32_t index) {
+	if (index < linearLimit) {
+		return index;
+	}
+	auto group = (index - linearLimit) >> subBucketBits;
+	auto subBucket = (index - linearLimit) & ((1u << subBucketBits) - 1);
+	auto shift = group + 1;
+	auto lower = ((1u << subBucketBits) + subBucket) << shift;
+	return lower + ((1u << shift) - 1);
+}
+
+
+uint32_t LatencyHistogram::_percentile(const uint64_t* buckets, uint64_t count, uint32_t maxNs, double fraction) {
+	auto rank = (uint64_t)std::ceil(fraction * (double)count);
+	if (rank == 0) {
+		rank = 1;
+	}
+	uint64_t sum = 0;
+	for (uint32_t i = 0; i < bucketCount; ++i) {
+		sum += buckets[i];
+		if (sum >= rank) {
+			return std::min<uint32_t>(_bucketUpperBound(i), maxNs);
+		}
+	}
+	return maxNs;
+}
+
+
+void LatencyHistogram::record(uint32_t valueNs) {
+	_totalNs.fetch_add(valueNs, std::memory_order_relaxed);
+	_buckets[_bucketIndex(valueNs)].fetch_add(1, std::memory_order_relaxed);
+	auto maxNs = _maxNs.load(std::memory_order_relaxed);
+	while (valueNs > maxNs && !_maxNs.compare_exchange_weak(maxNs, valueNs, std::memory_order_relaxed)) {
+	}
+}
+
+
+LatencyHistogram::Summary LatencyHistogram::summarize() const {
+	uint64_t buckets[bucketCount];
+	Summary summary;
+	for (uint32_t i = 0; i < bucketCount; ++i) {
+		buckets[i] = _buckets[i].load(std::memory_order_relaxed);
+		summary.count += buckets[i];
+	}
+	summary.totalNs = _totalNs.load(std::memory_order_relaxed);
+	summary.maxNs = _maxNs.load(std::memory_order_relaxed);
+	if (summary.count > 0) {
+		summary.p50Ns = _percentile(buckets, summary.count, summary.maxNs, 0.5);
+		summary.p99Ns = _percentile(buckets, summary.count, summary.maxNs, 0.99);
+		summary.p999Ns = _percentile(buckets, summary.count, summary.maxNs, 0.999);
+	}
+	return summary;
+}
+
+
+} // end namespace driver
+} // end namespace vrinputemulator
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+
+namespace vrinputemulator {
+namespace driver {
+
+
+/**
+ * Latency histogram in nanoseconds that can be recorded into from several threads.
+ *
+ * Buckets are log-linear (HDR style): values below 32 ns get one bucket each, every power of two above that is
+ * split into 16 buckets, so each bucket covers less than 1/16 of its value. Recording is a few relaxed atomic adds.
+ */
+class LatencyHistogram {
+public:
+	struct Summary {
+		uint64_t count = 0;
+		uint64_t totalNs = 0;
+		uint32_t p50Ns = 0; // percentiles have a relative error of less than 1/16
+		uint32_t p99Ns = 0;
+		uint32_t p999Ns = 0;
+		uint32_t maxNs = 0;
+	};
+
+	LatencyHistogram() {
+		for (auto& b : _buckets) {
+			b.store(0, std::memory_order_relaxed);
+		}
+	}
+	LatencyHistogram(const LatencyHistogram&) = delete;
+	LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+	void record(uint32_t valueNs);
+
+	// The percentiles are taken from a copy of the buckets, so they are consistent with count
+	Summary summarize() const;
+
+private:
+	static const uint32_t subBucketBits = 4;
+	static const uint32_t linearLimit = 2u << subBucketBits; // 32
+	static const uint32_t bucketCount = linearLimit + (32 - (subBucketBits + 1)) * (1u << subBucketBits);
+
+	static uint32_t _bucketIndex(uint32_t value);
+	static uint32_t _bucketUpperBound(uint32_t index);
+	static uint32_t _percentile(const uint64_t* buckets, uint64_t count, uint32_t maxNs, double fraction);
+
+	std::atomic<uint64_t> _totalNs = { 0 };
+	std::atomic<uint32_t> _maxNs = { 0 };
+	std::atomic<uint64_t> _buckets[bucketCount];
+};
+
+
+} // end namespace driver
+} // end namespace vrinputemulator
@@ -0,0 +1,110 @@
+#include "LatencyStats.h"
+#include "../stdafx.h"
+
+
+namespace vrinputemulator {
+namespace driver {
+
+
+std::atomic<uint32_t> LatencyStats::_tracedClients[LatencyStats::maxTracedClients];
+std::atomic<uint32_t> LatencyStats::_tracedClientCount = { 0 };
+std::atomic<LatencyStats::Histogram*> LatencyStats::_entries[LatencyStats::maxEntries];
+std::atomic<uint32_t> LatencyStats::_entryCount = { 0 };
+std::mutex LatencyStats::_allocateMutex;
+thread_local LatencyScope* LatencyScope::_current = nullptr;
+
+
+bool LatencyStats::setTraced(uint32_t clientId, bool traced) {
+	std::lock_guard<std::mutex> lock(_allocateMutex);
+	std::atomic<uint32_t>* freeSlot = nullptr;
+	for (auto& c : _tracedClients) {
+		auto id = c.load(std::memory_order_relaxed);
+		if (id == clientId) {
+			if (!traced) {
+				c.store(0, std::memory_order_relaxed);
+				_tracedClientCount.fetch_sub(1, std::memory_order_relaxed);
+			}
+			return true;
+		} else if (id == 0 && !freeSlot) {
+			freeSlot = &c;
+		}
+	}
+	if (!traced) {
+		return true;
+	} else if (!freeSlot) {
+		return false;
+	}
+	freeSlot->store(clientId, std::memory_order_relaxed);
+	_tracedClientCount.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+
+LatencyStats::Histogram* LatencyStats::_find(uint32_t begin, uint32_t end, uint32_t requestType, uint32_t clientId, uint8_t stage) {
+	for (uint32_t i = begin; i < end; ++i) {
+		auto histogram = _entries[i].load(std::memory_order_acquire);
+		if (histogram->requestType == requestType && histogram->clientId == clientId && histogram->stage == stage) {
+			return histogram;
+		}
+	}
+	return nullptr;
+}
+
+
+void LatencyStats::record(ipc::RequestType type, uint32_t clientId, trace::LatencyStage stage, int64_t latencyNs) {
+	auto count = _entryCount.load(std::memory_order_acquire);
+	auto histogram = _find(0, count, (uint32_t)type, clientId, (uint8_t)stage);
+	if (!histogram) {
+		std::lock_guard<std::mutex> lock(_allocateMutex);
+		auto newCount = _entryCount.load(std::memory_order_relaxed);
+		histogram = _find(count, newCount, (uint32_t)type, clientId, (uint8_t)stage);
+		if (!histogram) {
+			if (newCount >= maxEntries) {
+				return;
+			}
+			histogram = new Histogram();
+			histogram->requestType = (uint32_t)type;
+			histogram->clientId = clientId;
+			histogram->stage = (uint8_t)stage;
+			_entries[newCount].store(histogram, std::memory_order_release);
+			_entryCount.store(newCount + 1, std::memory_order_release);
+		}
+	}
+	if (latencyNs < 0) {
+		latencyNs = 0;
+	} else if (latencyNs > UINT32_MAX) {
+		latencyNs = UINT32_MAX;
+	}
+	histogram->latency.record((uint32_t)latencyNs);
+}
+
+
+uint32_t LatencyStats::entryCount() {
+	return _entryCount.load(std::memory_order_acquire);
+}
+
+
+bool LatencyStats::getEntry(uint32_t index, trace::LatencyStatsEntry& entry) {
+	if (index >= entryCount()) {
+		return false;
+	}
+	auto histogram = _entries[index].load(std::memory_order_acquire);
+	auto summary = histogram->latency.summarize();
+	entry.requestType = histogram->requestType;
+	entry.clientId = histogram->clientId;
+	entry.stage = histogram->stage;
+	for (auto& r : entry.reserved) {
+		r = 0;
+	}
+	entry.count = summary.count;
+	entry.totalNs = summary.totalNs;
+	entry.p50Ns = summary.p50Ns;
+	entry.p99Ns = summary.p99Ns;
+	entry.p999Ns = summary.p999Ns;
+	entry.maxNs = summary.maxNs;
+	return true;
+}
+
+
+} // end namespace driver
+} // end namespace vrinputemulator
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <openvr_driver.h>
+#include <vrinputemulator_trace.h>
+#include <ipc_protocol.h>
+#include "LatencyHistogram.h"
+
+
+namespace vrinputemulator {
+namespace driver {
+
+
+/**
+ * Stage latencies of the ipc requests of clients that enabled tracing (Debug_SetLatencyTracing), kept per request
+ * type, client and stage (see trace::LatencyStage).
+ *
+ * Histograms are allocated on first use and never freed. Lookups scan the allocated histograms, which is fine
+ * for the handful of request types a client traces at a time. Once maxEntries histograms exist, samples for new
+ * combinations are dropped.
+ */
+class LatencyStats {
+public:
+	static const uint32_t maxEntries = 1024;
+	static const uint32_t maxTracedClients = 16;
+
+	// Returns false when too many clients are traced already
+	static bool setTraced(uint32_t clientId, bool traced);
+
+	// Costs one relaxed load as long as no client is traced
+	static bool isTraced(uint32_t clientId) {
+		if (_tracedClientCount.load(std::memory_order_relaxed) == 0) {
+			return false;
+		}
+		for (auto& c : _tracedClients) {
+			if (c.load(std::memory_order_relaxed) == clientId) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Adds one sample, negative latencies (clock offset estimate off by more than the latency) count as 0
+	static void record(ipc::RequestType type, uint32_t clientId, trace::LatencyStage stage, int64_t latencyNs);
+
+	// Number of histograms allocated so far, the index of a histogram never changes
+	static uint32_t entryCount();
+
+	// Summary of the histogram at the given index. Returns false when the index is out of range.
+	static bool getEntry(uint32_t index, trace::LatencyStatsEntry& entry);
+
+private:
+	struct Histogram {
+		uint32_t requestType = 0;
+		uint32_t clientId = 0;
+		uint8_t stage = 0;
+		LatencyHistogram latency;
+	};
+
+	static Histogram* _find(uint32_t begin, uint32_t end, uint32_t requestType, uint32_t clientId, uint8_t stage);
+
+	static std::atomic<uint32_t> _tracedClients[maxTracedClients]; // 0 = unused (client ids start at 1)
+	static std::atomic<uint32_t> _tracedClientCount;
+	static std::atomic<Histogram*> _entries[maxEntries];
+	static std::atomic<uint32_t> _entryCount;
+	static std::mutex _allocateMutex;
+};
+
+
+// Stage timestamps of the ipc request handled by the calling thread. Dequeue is recorded on construction, hook
+// calls and replies made while the scope is active are recorded as the request's Apply and Reply stages.
+// Scopes of requests from untraced clients record nothing.
+class LatencyScope {
+public:
+	LatencyScope(ipc::RequestType type, uint32_t clientId, int64_t enqueueNs, int64_t dequeueNs) : _parent(_current) {
+		if (LatencyStats::isTraced(clientId)) {
+			_type = type;
+			_clientId = clientId;
+			_enqueueNs = enqueueNs;
+			LatencyStats::record(_type, _clientId, trace::LatencyStage::Dequeue, dequeueNs - _enqueueNs);
+			_current = this;
+		} else {
+			_current = nullptr;
+		}
+	}
+	~LatencyScope() {
+		_current = _parent;
+	}
+	LatencyScope(const LatencyScope&) = delete;
+	LatencyScope& operator=(const LatencyScope&) = delete;
+
+	// Only the first hook call of a request counts
+	static void markApply() {
+		if (_current && !_current->_applied) {
+			_current->_applied = true;
+			LatencyStats::record(_current->_type, _current->_clientId, trace::LatencyStage::Apply, ipc::clockNs() - _current->_enqueueNs);
+		}
+	}
+
+	static void markReply() {
+		if (_current) {
+			LatencyStats::record(_current->_type, _current->_clientId, trace::LatencyStage::Reply, ipc::clockNs() - _current->_enqueueNs);
+		}
+	}
+
+private:
+	ipc::RequestType _type = ipc::RequestType::None;
+	uint32_t _clientId = 0;
+	int64_t _enqueueNs = 0;
+	bool _applied = false;
+	LatencyScope* _parent;
+	static thread_local LatencyScope* _current;
+};
+
+
+} // end namespace driver
+} // end namespace vrinputemulator
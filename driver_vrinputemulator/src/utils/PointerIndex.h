@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+
+namespace vrinputemulator {
+namespace driver {
+
+
+/**
+ * Fixed-size open-addressing hash index from a pointer to a small integer (linear probing).
+ *
+ * Entries can only be added, never removed or changed. Lookups are lock-free and may run concurrently with an
+ * insert, inserts need to be serialized by the caller. Capacity must be a power of two and should be at least
+ * twice the number of entries to keep probe sequences short.
+ */
+template<typename K, uint32_t Capacity>
+class PointerIndex {
+	static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+	static const uint32_t notFound = 0xFFFFFFFF;
+
+	PointerIndex() {
+		for (auto& s : _slots) {
+			s.key.store(0, std::memory_order_relaxed);
+			s.value = notFound;
+		}
+	}
+	PointerIndex(const PointerIndex&) = delete;
+	PointerIndex& operator=(const PointerIndex&) = delete;
+
+	// Returns false when the key is already present or the index is full
+	bool insert(K key, uint32_t value) {
+		auto k = (uintptr_t)key;
+		if (!k) {
+			return false;
+		}
+		auto i = _hash(k);
+		for (uint32_t n = 0; n < Capacity; ++n, i = (i + 1) & (Capacity - 1)) {
+			auto slotKey = _slots[i].key.load(std::memory_order_relaxed);
+			if (slotKey == k) {
+				return false;
+			} else if (slotKey == 0) {
+				_slots[i].value = value;
+				_slots[i].key.store(k, std::memory_order_release); // publishes value
+				return true;
+			}
+		}
+		return false;
+	}
+
+	uint32_t find(K key) const {
+		auto k = (uintptr_t)key;
+		auto i = _hash(k);
+		for (uint32_t n = 0; n < Capacity; ++n, i = (i + 1) & (Capacity - 1)) {
+			auto slotKey = _slots[i].key.load(std::memory_order_acquire);
+			if (slotKey == k) {
+				return _slots[i].value;
+			} else if (slotKey == 0) {
+				break;
+			}
+		}
+		return notFound;
+	}
+
+private:
+	static uint32_t _hash(uintptr_t k) {
+		// Fibonacci hashing, the low bits of heap and vtable pointers are mostly zero
+		return (uint32_t)(((uint64_t)k * 0x9E3779B97F4A7C15ull) >> 32) & (Capacity - 1);
+	}
+
+	struct Slot {
+		std::atomic<uintptr_t> key;
+		uint32_t value;
+	};
+	Slot _slots[Capacity];
+};
+
+
+} // end namespace driver
+} // end namespace vrinputemulator
@@ -0,0 +1,135 @@
+#include "PoseKalmanFilter.h"
+#include "../stdafx.h"
+#include <cmath>
+#include <openvr_math.h>
+
+
+namespace vrinputemulator {
+namespace driver {
+
+
+// Rotation vector (axis * angle) -> unit quaternion
+static vr::HmdQuaternion_t _quaternionFromRotationVector(const double (&v)[3]) {
+	double angle = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+	if (angle < 1.0E-9) {
+		return { 1.0, v[0] / 2.0, v[1] / 2.0, v[2] / 2.0 };
+	}
+	double s = std::sin(angle / 2.0) / angle;
+	return { std::cos(angle / 2.0), v[0] * s, v[1] * s, v[2] * s };
+}
+
+// Unit quaternion -> rotation vector along the shorter arc
+static void _rotationVectorFromQuaternion(const vr::HmdQuaternion_t& q, double (&v)[3]) {
+	double sign = q.w < 0.0 ? -1.0 : 1.0;
+	double n = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z);
+	double s = n < 1.0E-9 ? 2.0 * sign : 2.0 * std::atan2(n, sign * q.w) / n * sign;
+	v[0] = q.x * s;
+	v[1] = q.y * s;
+	v[2] = q.z * s;
+}
+
+
+void PoseKalmanFilter::_restart(const vr::DriverPose_t& pose, uint64_t timeNs, double observationNoise) {
+	for (int i = 0; i < 3; ++i) {
+		_position[i] = pose.vecPosition[i];
+		_velocity[i] = 0.0;
+		_acceleration[i] = 0.0;
+		_angularVelocity[i] = 0.0;
+		_angularAcceleration[i] = 0.0;
+		for (int j = 0; j < 3; ++j) {
+			_covariance[i][j] = 0.0;
+		}
+	}
+	_covariance[0][0] = observationNoise;
+	_covariance[1][1] = 1.0; // (m/s)², a device at rest may start moving right away
+	_covariance[2][2] = 10.0;
+	_rotation = pose.qRotation;
+	_timeNs = timeNs;
+	_valid = true;
+}
+
+
+void PoseKalmanFilter::filter(vr::DriverPose_t& pose, uint64_t timeNs, double processNoise, double observationNoise) {
+	if (!_valid || timeNs <= _timeNs || timeNs - _timeNs > maxTimeStepNs) {
+		_restart(pose, timeNs, observationNoise);
+	} else {
+		double dt = (double)(timeNs - _timeNs) / 1.0E9;
+		double dt2 = dt * dt;
+		double dt3 = dt2 * dt;
+		_timeNs = timeNs;
+
+		// Predict: P = F P F^T + Q, with F = [1 dt dt²/2; 0 1 dt; 0 0 1] and Q from white noise jerk
+		double F[3][3] = { { 1.0, dt, dt2 / 2.0 }, { 0.0, 1.0, dt }, { 0.0, 0.0, 1.0 } };
+		double Q[3][3] = {
+			{ dt3 * dt2 / 20.0, dt2 * dt2 / 8.0, dt3 / 6.0 },
+			{ dt2 * dt2 / 8.0, dt3 / 3.0, dt2 / 2.0 },
+			{ dt3 / 6.0, dt2 / 2.0, dt }
+		};
+		double FP[3][3];
+		for (int i = 0; i < 3; ++i) {
+			for (int j = 0; j < 3; ++j) {
+				FP[i][j] = F[i][0] * _covariance[0][j] + F[i][1] * _covariance[1][j] + F[i][2] * _covariance[2][j];
+			}
+		}
+		for (int i = 0; i < 3; ++i) {
+			for (int j = 0; j < 3; ++j) {
+				_covariance[i][j] = FP[i][0] * F[j][0] + FP[i][1] * F[j][1] + FP[i][2] * F[j][2] + processNoise * Q[i][j];
+			}
+		}
+
+		// Update with H = [1 0 0]: K = P H^T / (H P H^T + R), P = (I - K H) P
+		double K[3];
+		double S = _covariance[0][0] + observationNoise;
+		for (int i = 0; i < 3; ++i) {
+			K[i] = _covariance[i][0] / S;
+		}
+		double P0[3] = { _covariance[0][0], _covariance[0][1], _covariance[0][2] };
+		for (int i = 0; i < 3; ++i) {
+			for (int j = 0; j < 3; ++j) {
+				_covariance[i][j] -= K[i] * P0[j];
+			}
+		}
+
+		// Position
+		for (int i = 0; i < 3; ++i) {
+			double predicted = _position[i] + _velocity[i] * dt + _acceleration[i] * dt2 / 2.0;
+			_velocity[i] += _acceleration[i] * dt;
+			double innovation = pose.vecPosition[i] - predicted;
+			_position[i] = predicted + K[0] * innovation;
+			_velocity[i] += K[1] * innovation;
+			_acceleration[i] += K[2] * innovation;
+		}
+
+		// Orientation, in error state around the predicted rotation
+		double step[3];
+		for (int i = 0; i < 3; ++i) {
+			step[i] = _angularVelocity[i] * dt + _angularAcceleration[i] * dt2 / 2.0;
+			_angularVelocity[i] += _angularAcceleration[i] * dt;
+		}
+		auto predicted = _quaternionFromRotationVector(step) * _rotation;
+		double innovation[3];
+		_rotationVectorFromQuaternion(pose.qRotation * vrmath::quaternionConjugate(predicted), innovation);
+		double correction[3];
+		for (int i = 0; i < 3; ++i) {
+			correction[i] = K[0] * innovation[i];
+			_angularVelocity[i] += K[1] * innovation[i];
+			_angularAcceleration[i] += K[2] * innovation[i];
+		}
+		_rotation = _quaternionFromRotationVector(correction) * predicted;
+		double n = std::sqrt(_rotation.w * _rotation.w + _rotation.x * _rotation.x + _rotation.y * _rotation.y + _rotation.z * _rotation.z);
+		_rotation = { _rotation.w / n, _rotation.x / n, _rotation.y / n, _rotation.z / n };
+	}
+
+	// Only the velocities are handed to SteamVR's prediction, extrapolating the estimated accelerations
+	// amplifies what is left of the measurement noise
+	for (int i = 0; i < 3; ++i) {
+		pose.vecVelocity[i] = _velocity[i];
+		pose.vecAcceleration[i] = 0.0;
+		pose.vecAngularVelocity[i] = _angularVelocity[i];
+		pose.vecAngularAcceleration[i] = 0.0;
+	}
+}
+
+
+} // end namespace driver
+} // end namespace vrinputemulator
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <openvr_driver.h>
+
+
+namespace vrinputemulator {
+namespace driver {
+
+
+/**
+ * Velocity estimator for the poses of one device (motion compensation vel/acc mode 4).
+ *
+ * Position and orientation each run a constant-acceleration Kalman filter (value, velocity and acceleration per
+ * axis, driven by white noise jerk). Orientation is filtered in error state: the filter predicts a rotation and
+ * corrects it by the rotation vector between prediction and measurement. All axes see the same time steps and
+ * noise parameters, so they share one covariance matrix and one gain. An update has a fixed cost and never
+ * allocates.
+ */
+class PoseKalmanFilter {
+public:
+	// Steps larger than this restart the filter from the measurement
+	static const uint64_t maxTimeStepNs = 100000000;
+
+	// Feeds a pose valid at timeNs into the filter and replaces its velocities with the estimates.
+	// processNoise is the spectral density of the jerk (m²/s⁵ and rad²/s⁵), observationNoise the variance
+	// of the measured positions (m²) and orientations (rad²).
+	void filter(vr::DriverPose_t& pose, uint64_t timeNs, double processNoise, double observationNoise);
+
+	void reset() { _valid = false; }
+
+private:
+	void _restart(const vr::DriverPose_t& pose, uint64_t timeNs, double observationNoise);
+
+	bool _valid = false;
+	uint64_t _timeNs = 0;
+	double _covariance[3][3]; // shared by all axes of position and orientation
+	double _position[3];
+	double _velocity[3];
+	double _acceleration[3];
+	vr::HmdQuaternion_t _rotation;
+	double _angularVelocity[3]; // driver space
+	double _angularAcceleration[3];
+};
+
+
+} // end namespace driver
+} // end namespace vrinputemulator
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+
+namespace vrinputemulator {
+namespace driver {
+
+
+/**
+ * Small, trivially copyable value that is written by one thread at a time and read by many.
+ *
+ * Readers copy the value and retry when a write happened in between, so they never see a torn value and never
+ * block the writer. The value is kept in atomic words, so concurrent copies are well-defined.
+ *
+ * Writers need to be serialized by the caller.
+ */
+template<typename T>
+class Seqlock {
+	static_assert(std::is_trivially_copyable<T>::value, "Seqlock needs a trivially copyable type");
+
+public:
+	Seqlock() {
+		write(T());
+	}
+	Seqlock(const Seqlock&) = delete;
+	Seqlock& operator=(const Seqlock&) = delete;
+
+	void read(T& value) const {
+		uint64_t buffer[wordCount];
+		uint32_t seq;
+		while (true) {
+			seq = _seq.load(std::memory_order_acquire);
+			if (seq & 1) {
+				std::this_thread::yield(); // a write is in progress
+				continue;
+			}
+			for (size_t i = 0; i < wordCount; ++i) {
+				buffer[i] = _data[i].load(std::memory_order_relaxed);
+			}
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (_seq.load(std::memory_order_relaxed) == seq) {
+				break;
+			}
+		}
+		std::memcpy(&value, buffer, sizeof(T));
+	}
+
+	void write(const T& value) {
+		uint64_t buffer[wordCount] = {};
+		std::memcpy(buffer, &value, sizeof(T));
+		auto seq = _seq.load(std::memory_order_relaxed);
+		_seq.store(seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		for (size_t i = 0; i < wordCount; ++i) {
+			_data[i].store(buffer[i], std::memory_order_relaxed);
+		}
+		_seq.store(seq + 2, std::memory_order_release);
+	}
+
+private:
+	static const size_t wordCount = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+	std::atomic<uint32_t> _seq = { 0 }; // odd while a write is in progress
+	std::atomic<uint64_t> _data[wordCount];
+};
+
+
+} // end namespace driver
+} // end namespace vrinputemulator
@@ -0,0 +1,90 @@
+#include "TraceRecorder.h"
+#include "../stdafx.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+
+namespace vrinputemulator {
+namespace driver {
+
+
+std::mutex TraceRecorder::_ringsMutex;
+std::vector<std::unique_ptr<TraceRecorder::Ring>> TraceRecorder::_rings;
+thread_local TraceRecorder::ThreadRing TraceRecorder::_threadRing;
+thread_local TraceScope* TraceScope::_current = nullptr;
+
+
+TraceRecorder::Ring* TraceRecorder::_acquireRing() {
+	std::lock_guard<std::mutex> lock(_ringsMutex);
+	for (auto& r : _rings) {
+		bool expected = false;
+		if (r->inUse.compare_exchange_strong(expected, true)) {
+			return r.get();
+		}
+	}
+	_rings.emplace_back(new Ring());
+	_rings.back()->threadIndex = (uint16_t)(_rings.size() - 1);
+	return _rings.back().get();
+}
+
+
+void TraceRecorder::record(trace::TraceRecord& record) {
+	auto ring = _threadRing.ring;
+	if (!ring) {
+		ring = _threadRing.ring = _acquireRing();
+	}
+	record.threadIndex = ring->threadIndex;
+	auto head = ring->head.load(std::memory_order_relaxed);
+	ring->records[head & (ringSize - 1)] = record;
+	ring->head.store(head + 1, std::memory_order_release);
+}
+
+
+bool TraceRecorder::dump(const std::string& path, uint64_t& recordCount, uint32_t& threadCount) {
+	std::vector<trace::TraceRecord> records;
+	{
+		std::lock_guard<std::mutex> lock(_ringsMutex);
+		threadCount = (uint32_t)_rings.size();
+		for (auto& r : _rings) {
+			auto head = r->head.load(std::memory_order_acquire);
+			auto first = head > ringSize ? head - ringSize : 0;
+			auto start = records.size();
+			for (auto i = first; i < head; ++i) {
+				records.push_back(r->records[i & (ringSize - 1)]);
+			}
+			// The owning thread kept writing while we copied, drop the records it may have overwritten
+			std::atomic_thread_fence(std::memory_order_acquire);
+			auto headAfter = r->head.load(std::memory_order_relaxed);
+			if (headAfter + 1 > first + ringSize) {
+				auto overwritten = std::min<uint64_t>(headAfter + 1 - (first + ringSize), head - first);
+				records.erase(records.begin() + start, records.begin() + start + (size_t)overwritten);
+			}
+		}
+	}
+	std::sort(records.begin(), records.end(), [](const trace::TraceRecord& a, const trace::TraceRecord& b) {
+		return a.timestampNs < b.timestampNs;
+	});
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file) {
+		return false;
+	}
+	trace::TraceFileHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, TRACE_FILE_MAGIC, sizeof(TRACE_FILE_MAGIC));
+	header.version = TRACE_FILE_VERSION;
+	header.recordSize = sizeof(trace::TraceRecord);
+	header.threadCount = threadCount;
+	header.recordCount = records.size();
+	file.write((const char*)&header, sizeof(header));
+	if (!records.empty()) {
+		file.write((const char*)records.data(), records.size() * sizeof(trace::TraceRecord));
+	}
+	recordCount = records.size();
+	return file.good();
+}
+
+
+} // end namespace driver
+} // end namespace vrinputemulator
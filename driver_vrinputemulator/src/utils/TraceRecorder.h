@@ -0,0 +1,142 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include <vrinputemulator_trace.h>
+#include "HookStats.h"
+#include "LatencyStats.h"
+
+
+namespace vrinputemulator {
+namespace driver {
+
+
+/**
+ * Always-on binary trace of the detour hooks.
+ *
+ * Every thread writes fixed-size records into its own ring (single writer, no locks, no allocation after the
+ * first record of a thread). When a ring is full the oldest records are overwritten. dump() collects the
+ * records of all rings and writes them into a trace file (see vrinputemulator_trace.h).
+ */
+class TraceRecorder {
+public:
+	static const size_t ringSize = 8192; // records per thread, power of two
+
+	static uint64_t now() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// Appends a record to the ring of the calling thread
+	static void record(trace::TraceRecord& record);
+
+	// Writes all records into a trace file. Returns false when the file could not be written.
+	static bool dump(const std::string& path, uint64_t& recordCount, uint32_t& threadCount);
+
+private:
+	struct Ring {
+		std::atomic<uint64_t> head = { 0 }; // index of the next record, only the owning thread writes it
+		std::atomic<bool> inUse = { true }; // false when the owning thread has exited, the ring can be reused
+		uint16_t threadIndex = 0;
+		trace::TraceRecord records[ringSize];
+	};
+
+	// Releases the ring of a thread on thread exit
+	struct ThreadRing {
+		Ring* ring = nullptr;
+		~ThreadRing() {
+			if (ring) {
+				ring->inUse = false;
+			}
+		}
+	};
+
+	static Ring* _acquireRing();
+
+	static std::mutex _ringsMutex;
+	static std::vector<std::unique_ptr<Ring>> _rings;
+	static thread_local ThreadRing _threadRing;
+};
+
+
+// Records one hook call: timestamp on construction, elapsed time on destruction (into the trace and the hook stats).
+// Time spent in calls into vrserver (see TraceVrserverCall) is recorded separately, the hook stats only cover the
+// driver's own code. A hook call made while handling a traced ipc request is that request's Apply stage.
+class TraceScope {
+public:
+	TraceScope(trace::TraceHook hook, uint32_t deviceId, uint32_t arg = 0) : _parent(_current) {
+		LatencyScope::markApply();
+		_record.timestampNs = TraceRecorder::now();
+		_record.hook = (uint16_t)hook;
+		_record.deviceId = deviceId;
+		_record.arg = arg;
+		_record.mode = trace::traceModeNone;
+		_current = this;
+	}
+	~TraceScope() {
+		auto elapsedNs = TraceRecorder::now() - _record.timestampNs;
+		_record.elapsedNs = (uint32_t)(elapsedNs - _vrserverNs);
+		_record.vrserverNs = (uint32_t)_vrserverNs;
+		_current = _parent;
+		if (_parent) {
+			_parent->_vrserverNs += _vrserverNs; // the enclosing hook waited for vrserver as well
+		}
+		TraceRecorder::record(_record);
+		HookStats::record(_record.hook, _record.deviceId, _record.mode, _record.elapsedNs);
+	}
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+
+	void setDeviceId(uint32_t deviceId) {
+		_record.deviceId = deviceId;
+	}
+
+	// Sets the device mode of the innermost hook call of the calling thread
+	static void setMode(uint8_t mode) {
+		if (_current) {
+			_current->_record.mode = mode;
+		}
+	}
+
+private:
+	friend class TraceVrserverCall;
+	trace::TraceRecord _record;
+	uint64_t _vrserverNs = 0;
+	TraceScope* _parent;
+	static thread_local TraceScope* _current;
+};
+
+
+// Wraps a call into vrserver made by a hook (e.g. the original function of a detour), its time is not counted
+// as the hook's own time
+class TraceVrserverCall {
+public:
+	TraceVrserverCall() : _scope(TraceScope::_current), _startNs(_scope ? TraceRecorder::now() : 0) {}
+	~TraceVrserverCall() {
+		if (_scope) {
+			_scope->_vrserverNs += TraceRecorder::now() - _startNs;
+		}
+	}
+	TraceVrserverCall(const TraceVrserverCall&) = delete;
+	TraceVrserverCall& operator=(const TraceVrserverCall&) = delete;
+
+private:
+	TraceScope* _scope;
+	uint64_t _startNs;
+};
+
+// Calls func(args...) as a TraceVrserverCall
+template<typename F, typename... Args>
+auto traceVrserverCall(F func, Args&&... args) -> decltype(func(std::forward<Args>(args)...)) {
+	TraceVrserverCall vrserverCall;
+	return func(std::forward<Args>(args)...);
+}
+
+
+} // end namespace driver
+} // end namespace vrinputemulator
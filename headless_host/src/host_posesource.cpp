@@ -0,0 +1,175 @@
+#include "host_posesource.h"
+#include <cmath>
+#include <cstring>
+
+
+namespace vrinputemulator {
+namespace host {
+
+
+static const double pi = 3.14159265358979323846;
+
+
+CSyntheticDevice::CSyntheticDevice(CPropertiesStub* properties, const std::string& serial, vr::ETrackedDeviceClass deviceClass, uint32_t index, uint32_t count)
+		: _properties(properties), _serial(serial), _deviceClass(deviceClass), _phase(count > 0 ? 2.0 * pi * (double)index / (double)count : 0.0) {}
+
+
+vr::EVRInitError CSyntheticDevice::Activate(uint32_t unObjectId) {
+	static const char* trackingSystemName = "headless";
+	static const char* modelNumber = "VRInputEmulator Headless Device";
+	int32_t deviceClass = (int32_t)_deviceClass;
+	_properties->setProperty(unObjectId, vr::Prop_TrackingSystemName_String, trackingSystemName, (uint32_t)std::strlen(trackingSystemName) + 1, vr::k_unStringPropertyTag);
+	_properties->setProperty(unObjectId, vr::Prop_ModelNumber_String, modelNumber, (uint32_t)std::strlen(modelNumber) + 1, vr::k_unStringPropertyTag);
+	_properties->setProperty(unObjectId, vr::Prop_SerialNumber_String, _serial.c_str(), (uint32_t)_serial.size() + 1, vr::k_unStringPropertyTag);
+	_properties->setProperty(unObjectId, vr::Prop_DeviceClass_Int32, &deviceClass, sizeof(deviceClass), vr::k_unInt32PropertyTag);
+	_openvrId.store(unObjectId, std::memory_order_release);
+	return vr::VRInitError_None;
+}
+
+
+void CSyntheticDevice::Deactivate() {
+	_openvrId.store(vr::k_unTrackedDeviceIndexInvalid, std::memory_order_release);
+}
+
+
+void* CSyntheticDevice::GetComponent(const char *pchComponentNameAndVersion) {
+	if (std::strcmp(pchComponentNameAndVersion, vr::ITrackedDeviceServerDriver_Version) == 0) {
+		return static_cast<vr::ITrackedDeviceServerDriver*>(this);
+	} else if (_deviceClass == vr::TrackedDeviceClass_Controller && std::strcmp(pchComponentNameAndVersion, vr::IVRControllerComponent_Version) == 0) {
+		return static_cast<vr::IVRControllerComponent*>(this);
+	}
+	return nullptr;
+}
+
+
+void CSyntheticDevice::DebugRequest(const char *pchRequest, char *pchResponseBuffer, uint32_t unResponseBufferSize) {
+	if (unResponseBufferSize > 0) {
+		pchResponseBuffer[0] = '\0';
+	}
+}
+
+
+vr::DriverPose_t CSyntheticDevice::GetPose() {
+	return pose(0.0);
+}
+
+
+vr::VRControllerState_t CSyntheticDevice::GetControllerState() {
+	vr::VRControllerState_t state;
+	std::memset(&state, 0, sizeof(vr::VRControllerState_t));
+	return state;
+}
+
+
+bool CSyntheticDevice::TriggerHapticPulse(uint32_t unAxisId, uint16_t usPulseDurationMicroseconds) {
+	_hapticPulseCount.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+
+vr::DriverPose_t CSyntheticDevice::pose(double seconds) const {
+	vr::DriverPose_t pose;
+	std::memset(&pose, 0, sizeof(vr::DriverPose_t));
+	pose.qWorldFromDriverRotation.w = 1.0;
+	pose.qDriverFromHeadRotation.w = 1.0;
+	if (_deviceClass == vr::TrackedDeviceClass_HMD) {
+		// Sways 5 cm sideways at 0.5 Hz, turns its head by +-20 degrees at 0.25 Hz
+		double yaw = 0.35 * std::sin(0.5 * pi * seconds);
+		pose.vecPosition[0] = 0.05 * std::sin(pi * seconds);
+		pose.vecPosition[1] = 1.7;
+		pose.vecVelocity[0] = 0.05 * pi * std::cos(pi * seconds);
+		pose.qRotation = { std::cos(yaw / 2.0), 0.0, std::sin(yaw / 2.0), 0.0 };
+		pose.vecAngularVelocity[1] = 0.35 * 0.5 * pi * std::cos(0.5 * pi * seconds);
+		pose.shouldApplyHeadModel = true;
+	} else {
+		// Circles with a radius of 30 cm in front of the HMD at 0.5 Hz, facing the direction of travel
+		double angle = pi * seconds + _phase;
+		pose.vecPosition[0] = 0.3 * std::cos(angle);
+		pose.vecPosition[1] = 1.2;
+		pose.vecPosition[2] = -0.4 + 0.3 * std::sin(angle);
+		pose.vecVelocity[0] = -0.3 * pi * std::sin(angle);
+		pose.vecVelocity[2] = 0.3 * pi * std::cos(angle);
+		pose.qRotation = { std::cos(-angle / 2.0), 0.0, std::sin(-angle / 2.0), 0.0 };
+		pose.vecAngularVelocity[1] = -pi;
+	}
+	pose.result = vr::TrackingResult_Running_OK;
+	pose.poseIsValid = true;
+	pose.deviceIsConnected = true;
+	return pose;
+}
+
+
+CPoseSource::CPoseSource(vr::IVRServerDriverHost* driverHost, CSyntheticDevice* device, double rate)
+	: _driverHost(driverHost), _device(device), _rate(rate) {}
+
+
+CPoseSource::~CPoseSource() {
+	stop();
+}
+
+
+void CPoseSource::start(std::chrono::steady_clock::time_point startTime) {
+	if (!_running.exchange(true)) {
+		_startTime = startTime;
+		_thread = std::thread(&CPoseSource::_run, this);
+	}
+}
+
+
+void CPoseSource::stop() {
+	if (_running.exchange(false) && _thread.joinable()) {
+		_thread.join();
+	}
+}
+
+
+CPoseSource::Sample CPoseSource::takeSample() {
+	std::lock_guard<std::mutex> lock(_sampleMutex);
+	Sample sample;
+	sample.poseCount = _sample.poseCount;
+	sample.lateCount = _sample.lateCount;
+	sample.callLatenciesNs.swap(_sample.callLatenciesNs);
+	return sample;
+}
+
+
+void CPoseSource::_run() {
+	auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / _rate));
+	auto deadline = _startTime;
+	while (_running.load(std::memory_order_relaxed)) {
+		deadline += period;
+		// Sleeps only wake up to about a millisecond precise (with timeBeginPeriod(1)), so the last part is spent
+		// yielding. At 1120 Hz that keeps a core busy.
+		auto now = std::chrono::steady_clock::now();
+		while (now < deadline) {
+			if (deadline - now > std::chrono::microseconds(1500)) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			} else {
+				std::this_thread::yield();
+			}
+			now = std::chrono::steady_clock::now();
+		}
+		bool late = now - deadline > period;
+		if (now - deadline > std::chrono::milliseconds(100)) {
+			deadline = now; // don't make up for long stalls with a burst
+		}
+		auto deviceId = _device->openvrId();
+		if (deviceId == vr::k_unTrackedDeviceIndexInvalid) {
+			continue;
+		}
+		auto pose = _device->pose(std::chrono::duration<double>(deadline - _startTime).count());
+		auto callStartTime = std::chrono::steady_clock::now();
+		_driverHost->TrackedDevicePoseUpdated(deviceId, pose, sizeof(vr::DriverPose_t));
+		auto callNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - callStartTime).count();
+		std::lock_guard<std::mutex> lock(_sampleMutex);
+		_sample.poseCount++;
+		if (late) {
+			_sample.lateCount++;
+		}
+		_sample.callLatenciesNs.push_back(callNs > UINT32_MAX ? UINT32_MAX : (uint32_t)callNs);
+	}
+}
+
+
+} // end namespace host
+} // end namespace vrinputemulator
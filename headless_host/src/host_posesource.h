@@ -0,0 +1,109 @@
+#pragma once
+
+#include <openvr_driver.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <string>
+#include "host_stubs.h"
+
+
+namespace vrinputemulator {
+namespace host {
+
+
+/**
+ * Synthetic tracked device the host adds in place of a lighthouse HMD or controller.
+ *
+ * The HMD sways and turns its head, controllers circle in front of it. Controllers provide an IVRControllerComponent
+ * and count the haptic pulses they get.
+ */
+class CSyntheticDevice : public vr::ITrackedDeviceServerDriver, public vr::IVRControllerComponent {
+public:
+	CSyntheticDevice(CPropertiesStub* properties, const std::string& serial, vr::ETrackedDeviceClass deviceClass, uint32_t index, uint32_t count);
+
+	// from ITrackedDeviceServerDriver
+
+	virtual vr::EVRInitError Activate(uint32_t unObjectId) override;
+	virtual void Deactivate() override;
+	virtual void EnterStandby() override {}
+	virtual void *GetComponent(const char *pchComponentNameAndVersion) override;
+	virtual void DebugRequest(const char *pchRequest, char *pchResponseBuffer, uint32_t unResponseBufferSize) override;
+	virtual vr::DriverPose_t GetPose() override;
+
+	// from IVRControllerComponent
+
+	virtual vr::VRControllerState_t GetControllerState() override;
+	virtual bool TriggerHapticPulse(uint32_t unAxisId, uint16_t usPulseDurationMicroseconds) override;
+
+	// from self
+
+	const std::string& serialNumber() const { return _serial; }
+	vr::ETrackedDeviceClass deviceClass() const { return _deviceClass; }
+
+	// k_unTrackedDeviceIndexInvalid until activated
+	uint32_t openvrId() const { return _openvrId.load(std::memory_order_acquire); }
+
+	uint64_t hapticPulseCount() const { return _hapticPulseCount.load(std::memory_order_relaxed); }
+
+	// Pose at the given number of seconds since the host started
+	vr::DriverPose_t pose(double seconds) const;
+
+private:
+	CPropertiesStub* _properties;
+	std::string _serial;
+	vr::ETrackedDeviceClass _deviceClass;
+	double _phase; // controllers are spread evenly around the circle
+	std::atomic<uint32_t> _openvrId = { vr::k_unTrackedDeviceIndexInvalid };
+	std::atomic<uint64_t> _hapticPulseCount = { 0 };
+};
+
+
+/**
+ * Sends the poses of a synthetic device from a thread of its own at a fixed rate, like the lighthouse driver does
+ * (Vive HMD: 1120 Hz, Vive controller: 369 Hz).
+ *
+ * Poses go through the IVRServerDriverHost interface and so through the driver's hooks. Every call is timed, a
+ * call that starts more than one period late counts as late.
+ */
+class CPoseSource {
+public:
+	struct Sample {
+		uint64_t poseCount = 0;
+		uint64_t lateCount = 0;
+		std::vector<uint32_t> callLatenciesNs; // TrackedDevicePoseUpdated() calls since the previous sample
+	};
+
+	CPoseSource(vr::IVRServerDriverHost* driverHost, CSyntheticDevice* device, double rate);
+	~CPoseSource();
+	CPoseSource(const CPoseSource&) = delete;
+	CPoseSource& operator=(const CPoseSource&) = delete;
+
+	void start(std::chrono::steady_clock::time_point startTime);
+	void stop();
+
+	CSyntheticDevice* device() const { return _device; }
+	double rate() const { return _rate; }
+
+	// Counts are totals, latencies are taken out
+	Sample takeSample();
+
+private:
+	void _run();
+
+	vr::IVRServerDriverHost* _driverHost;
+	CSyntheticDevice* _device;
+	double _rate;
+	std::chrono::steady_clock::time_point _startTime;
+	std::thread _thread;
+	std::atomic<bool> _running = { false };
+	std::mutex _sampleMutex;
+	Sample _sample;
+};
+
+
+} // end namespace host
+} // end namespace vrinputemulator
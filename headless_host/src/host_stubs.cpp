@@ -0,0 +1,304 @@
+#include "host_stubs.h"
+#include <cstring>
+
+
+namespace vrinputemulator {
+namespace host {
+
+
+const char* hostCallName(HostCall call) {
+	switch (call) {
+	case HostCall::PoseUpdated:
+		return "PoseUpdated";
+	case HostCall::ButtonPressed:
+		return "ButtonPressed";
+	case HostCall::ButtonUnpressed:
+		return "ButtonUnpressed";
+	case HostCall::ButtonTouched:
+		return "ButtonTouched";
+	case HostCall::ButtonUntouched:
+		return "ButtonUntouched";
+	case HostCall::AxisUpdated:
+		return "AxisUpdated";
+	case HostCall::ProximitySensorState:
+		return "ProximitySensorState";
+	case HostCall::VendorSpecificEvent:
+		return "VendorSpecificEvent";
+	default:
+		return "Unknown";
+	}
+}
+
+
+CServerDriverHostStub::CServerDriverHostStub() {
+	for (auto& d : _callCounts) {
+		for (auto& c : d) {
+			c.store(0, std::memory_order_relaxed);
+		}
+	}
+	std::memset(_lastPoses, 0, sizeof(_lastPoses));
+	std::memset(_hasPose, 0, sizeof(_hasPose));
+}
+
+
+bool CServerDriverHostStub::TrackedDeviceAdded(const char *pchDeviceSerialNumber, vr::ETrackedDeviceClass eDeviceClass, vr::ITrackedDeviceServerDriver *pDriver) {
+	std::lock_guard<std::mutex> lock(_devicesMutex);
+	if (_devices.size() >= vr::k_unMaxTrackedDeviceCount) {
+		return false;
+	}
+	for (auto& d : _devices) {
+		if (d.serial.compare(pchDeviceSerialNumber) == 0) {
+			return false;
+		}
+	}
+	_devices.push_back({ pchDeviceSerialNumber, eDeviceClass, pDriver, false });
+	return true;
+}
+
+
+void CServerDriverHostStub::TrackedDevicePoseUpdated(uint32_t unWhichDevice, const vr::DriverPose_t & newPose, uint32_t unPoseStructSize) {
+	_countCall(unWhichDevice, HostCall::PoseUpdated);
+	if (unWhichDevice < vr::k_unMaxTrackedDeviceCount && unPoseStructSize == sizeof(vr::DriverPose_t)) {
+		std::lock_guard<std::mutex> lock(_posesMutex);
+		_lastPoses[unWhichDevice] = newPose;
+		_hasPose[unWhichDevice] = true;
+	}
+}
+
+
+void CServerDriverHostStub::TrackedDeviceButtonPressed(uint32_t unWhichDevice, vr::EVRButtonId eButtonId, double eventTimeOffset) {
+	_countCall(unWhichDevice, HostCall::ButtonPressed);
+}
+
+
+void CServerDriverHostStub::TrackedDeviceButtonUnpressed(uint32_t unWhichDevice, vr::EVRButtonId eButtonId, double eventTimeOffset) {
+	_countCall(unWhichDevice, HostCall::ButtonUnpressed);
+}
+
+
+void CServerDriverHostStub::TrackedDeviceButtonTouched(uint32_t unWhichDevice, vr::EVRButtonId eButtonId, double eventTimeOffset) {
+	_countCall(unWhichDevice, HostCall::ButtonTouched);
+}
+
+
+void CServerDriverHostStub::TrackedDeviceButtonUntouched(uint32_t unWhichDevice, vr::EVRButtonId eButtonId, double eventTimeOffset) {
+	_countCall(unWhichDevice, HostCall::ButtonUntouched);
+}
+
+
+void CServerDriverHostStub::TrackedDeviceAxisUpdated(uint32_t unWhichDevice, uint32_t unWhichAxis, const vr::VRControllerAxis_t & axisState) {
+	_countCall(unWhichDevice, HostCall::AxisUpdated);
+}
+
+
+void CServerDriverHostStub::ProximitySensorState(uint32_t unWhichDevice, bool bProximitySensorTriggered) {
+	_countCall(unWhichDevice, HostCall::ProximitySensorState);
+}
+
+
+void CServerDriverHostStub::VendorSpecificEvent(uint32_t unWhichDevice, vr::EVREventType eventType, const vr::VREvent_Data_t & eventData, double eventTimeOffset) {
+	_countCall(unWhichDevice, HostCall::VendorSpecificEvent);
+}
+
+
+void CServerDriverHostStub::GetRawTrackedDevicePoses(float fPredictedSecondsFromNow, vr::TrackedDevicePose_t *pTrackedDevicePoseArray, uint32_t unTrackedDevicePoseArrayCount) {
+	// Nothing in the driver asks for them, report all devices as not tracked
+	std::memset(pTrackedDevicePoseArray, 0, unTrackedDevicePoseArrayCount * sizeof(vr::TrackedDevicePose_t));
+	for (uint32_t i = 0; i < unTrackedDevicePoseArrayCount; ++i) {
+		pTrackedDevicePoseArray[i].eTrackingResult = vr::TrackingResult_Uninitialized;
+	}
+}
+
+
+void CServerDriverHostStub::activatePendingDevices() {
+	std::vector<std::pair<uint32_t, vr::ITrackedDeviceServerDriver*>> pending;
+	{
+		std::lock_guard<std::mutex> lock(_devicesMutex);
+		for (uint32_t i = 0; i < _devices.size(); ++i) {
+			if (!_devices[i].activated) {
+				_devices[i].activated = true;
+				pending.emplace_back(i, _devices[i].driver);
+			}
+		}
+	}
+	// Activate() may add further devices
+	for (auto& p : pending) {
+		p.second->Activate(p.first);
+	}
+}
+
+
+void CServerDriverHostStub::deactivateDevices() {
+	std::vector<vr::ITrackedDeviceServerDriver*> activated;
+	{
+		std::lock_guard<std::mutex> lock(_devicesMutex);
+		for (auto& d : _devices) {
+			if (d.activated) {
+				d.activated = false;
+				activated.push_back(d.driver);
+			}
+		}
+	}
+	for (auto d : activated) {
+		d->Deactivate();
+	}
+}
+
+
+uint32_t CServerDriverHostStub::deviceCount() {
+	std::lock_guard<std::mutex> lock(_devicesMutex);
+	return (uint32_t)_devices.size();
+}
+
+
+std::string CServerDriverHostStub::deviceSerial(uint32_t deviceId) {
+	std::lock_guard<std::mutex> lock(_devicesMutex);
+	return deviceId < _devices.size() ? _devices[deviceId].serial : std::string();
+}
+
+
+vr::ETrackedDeviceClass CServerDriverHostStub::deviceClass(uint32_t deviceId) {
+	std::lock_guard<std::mutex> lock(_devicesMutex);
+	return deviceId < _devices.size() ? _devices[deviceId].deviceClass : vr::TrackedDeviceClass_Invalid;
+}
+
+
+bool CServerDriverHostStub::lastPose(uint32_t deviceId, vr::DriverPose_t& pose) {
+	if (deviceId >= vr::k_unMaxTrackedDeviceCount) {
+		return false;
+	}
+	std::lock_guard<std::mutex> lock(_posesMutex);
+	pose = _lastPoses[deviceId];
+	return _hasPose[deviceId];
+}
+
+
+vr::ETrackedPropertyError CPropertiesStub::ReadPropertyBatch(vr::PropertyContainerHandle_t ulContainerHandle, vr::PropertyRead_t *pBatch, uint32_t unBatchEntryCount) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	_readCount.fetch_add(unBatchEntryCount, std::memory_order_relaxed);
+	auto container = _containers.find(ulContainerHandle);
+	if (container == _containers.end()) {
+		return vr::TrackedProp_InvalidDevice;
+	}
+	for (uint32_t i = 0; i < unBatchEntryCount; ++i) {
+		auto& read = pBatch[i];
+		auto value = container->second.find(read.prop);
+		if (value == container->second.end()) {
+			read.unTag = 0;
+			read.unRequiredBufferSize = 0;
+			read.eError = vr::TrackedProp_UnknownProperty;
+		} else if (value->second.error != vr::TrackedProp_Success) {
+			read.unTag = 0;
+			read.unRequiredBufferSize = 0;
+			read.eError = value->second.error;
+		} else {
+			read.unTag = value->second.tag;
+			read.unRequiredBufferSize = (uint32_t)value->second.data.size();
+			if (read.unBufferSize < read.unRequiredBufferSize) {
+				read.eError = vr::TrackedProp_BufferTooSmall;
+			} else {
+				if (read.unRequiredBufferSize > 0) {
+					std::memcpy(read.pvBuffer, value->second.data.data(), read.unRequiredBufferSize);
+				}
+				read.eError = vr::TrackedProp_Success;
+			}
+		}
+	}
+	return vr::TrackedProp_Success;
+}
+
+
+vr::ETrackedPropertyError CPropertiesStub::WritePropertyBatch(vr::PropertyContainerHandle_t ulContainerHandle, vr::PropertyWrite_t *pBatch, uint32_t unBatchEntryCount) {
+	if (ulContainerHandle == vr::k_ulInvalidPropertyContainer || ulContainerHandle > vr::k_unMaxTrackedDeviceCount) {
+		return vr::TrackedProp_InvalidDevice;
+	}
+	std::lock_guard<std::mutex> lock(_mutex);
+	_writeCount.fetch_add(unBatchEntryCount, std::memory_order_relaxed);
+	auto& container = _containers[ulContainerHandle];
+	for (uint32_t i = 0; i < unBatchEntryCount; ++i) {
+		auto& write = pBatch[i];
+		switch (write.writeType) {
+		case vr::PropertyWrite_Set: {
+			auto& value = container[write.prop];
+			value.tag = write.unTag;
+			value.error = vr::TrackedProp_Success;
+			value.data.assign((const char*)write.pvBuffer, (const char*)write.pvBuffer + write.unBufferSize);
+			write.eError = vr::TrackedProp_Success;
+		} break;
+		case vr::PropertyWrite_Erase:
+			container.erase(write.prop);
+			write.eError = vr::TrackedProp_Success;
+			break;
+		case vr::PropertyWrite_SetError: {
+			auto& value = container[write.prop];
+			value.tag = 0;
+			value.error = write.eSetError;
+			value.data.clear();
+			write.eError = vr::TrackedProp_Success;
+		} break;
+		default:
+			write.eError = vr::TrackedProp_InvalidOperation;
+			break;
+		}
+	}
+	return vr::TrackedProp_Success;
+}
+
+
+const char* CPropertiesStub::GetPropErrorNameFromEnum(vr::ETrackedPropertyError error) {
+	switch (error) {
+	case vr::TrackedProp_Success:
+		return "TrackedProp_Success";
+	case vr::TrackedProp_WrongDataType:
+		return "TrackedProp_WrongDataType";
+	case vr::TrackedProp_BufferTooSmall:
+		return "TrackedProp_BufferTooSmall";
+	case vr::TrackedProp_UnknownProperty:
+		return "TrackedProp_UnknownProperty";
+	case vr::TrackedProp_InvalidDevice:
+		return "TrackedProp_InvalidDevice";
+	case vr::TrackedProp_InvalidOperation:
+		return "TrackedProp_InvalidOperation";
+	default:
+		return "TrackedProp_Unknown";
+	}
+}
+
+
+vr::PropertyContainerHandle_t CPropertiesStub::TrackedDeviceToPropertyContainer(vr::TrackedDeviceIndex_t nDevice) {
+	if (nDevice >= vr::k_unMaxTrackedDeviceCount) {
+		return vr::k_ulInvalidPropertyContainer;
+	}
+	return (vr::PropertyContainerHandle_t)nDevice + 1;
+}
+
+
+void CPropertiesStub::setProperty(vr::TrackedDeviceIndex_t deviceId, vr::ETrackedDeviceProperty prop, const void* data, uint32_t size, vr::PropertyTypeTag_t tag) {
+	vr::PropertyWrite_t write;
+	write.prop = prop;
+	write.writeType = vr::PropertyWrite_Set;
+	write.eSetError = vr::TrackedProp_Success;
+	write.pvBuffer = const_cast<void*>(data);
+	write.unBufferSize = size;
+	write.unTag = tag;
+	write.eError = vr::TrackedProp_Success;
+	WritePropertyBatch(TrackedDeviceToPropertyContainer(deviceId), &write, 1);
+}
+
+
+void* CDriverContextStub::GetGenericInterface(const char *pchInterfaceVersion, vr::EVRInitError *peError) {
+	void* retval = nullptr;
+	if (std::strcmp(pchInterfaceVersion, vr::IVRServerDriverHost_Version) == 0) {
+		retval = static_cast<vr::IVRServerDriverHost*>(_driverHost);
+	} else if (std::strcmp(pchInterfaceVersion, vr::IVRProperties_Version) == 0) {
+		retval = static_cast<vr::IVRProperties*>(_properties);
+	}
+	if (peError) {
+		*peError = retval ? vr::VRInitError_None : vr::VRInitError_Init_InterfaceNotFound;
+	}
+	return retval;
+}
+
+
+} // end namespace host
+} // end namespace vrinputemulator
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <openvr_driver.h>
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <map>
+#include <vector>
+#include <string>
+
+
+// headless host namespace
+namespace vrinputemulator {
+namespace host {
+
+
+enum class HostCall : uint32_t {
+	PoseUpdated,
+	ButtonPressed,
+	ButtonUnpressed,
+	ButtonTouched,
+	ButtonUntouched,
+	AxisUpdated,
+	ProximitySensorState,
+	VendorSpecificEvent,
+	Count
+};
+
+const char* hostCallName(HostCall call);
+
+
+/**
+ * Stands in for vrserver's IVRServerDriverHost. Counts all calls per device and keeps the last pose of each device.
+ *
+ * Added devices get the next free id and are activated on the next call of activatePendingDevices(), which the
+ * host calls from its frame thread like vrserver does.
+ *
+ * The driver hooks the methods of this class with MinHook. Every hooked method therefore needs a body of its own,
+ * identical bodies may be folded into one function by the linker.
+ */
+class CServerDriverHostStub : public vr::IVRServerDriverHost {
+public:
+	CServerDriverHostStub();
+
+	// from IVRServerDriverHost
+
+	virtual bool TrackedDeviceAdded(const char *pchDeviceSerialNumber, vr::ETrackedDeviceClass eDeviceClass, vr::ITrackedDeviceServerDriver *pDriver) override;
+	virtual void TrackedDevicePoseUpdated(uint32_t unWhichDevice, const vr::DriverPose_t & newPose, uint32_t unPoseStructSize) override;
+	virtual void VsyncEvent(double vsyncTimeOffsetSeconds) override {}
+	virtual void TrackedDeviceButtonPressed(uint32_t unWhichDevice, vr::EVRButtonId eButtonId, double eventTimeOffset) override;
+	virtual void TrackedDeviceButtonUnpressed(uint32_t unWhichDevice, vr::EVRButtonId eButtonId, double eventTimeOffset) override;
+	virtual void TrackedDeviceButtonTouched(uint32_t unWhichDevice, vr::EVRButtonId eButtonId, double eventTimeOffset) override;
+	virtual void TrackedDeviceButtonUntouched(uint32_t unWhichDevice, vr::EVRButtonId eButtonId, double eventTimeOffset) override;
+	virtual void TrackedDeviceAxisUpdated(uint32_t unWhichDevice, uint32_t unWhichAxis, const vr::VRControllerAxis_t & axisState) override;
+	virtual void ProximitySensorState(uint32_t unWhichDevice, bool bProximitySensorTriggered) override;
+	virtual void VendorSpecificEvent(uint32_t unWhichDevice, vr::EVREventType eventType, const vr::VREvent_Data_t & eventData, double eventTimeOffset) override;
+	virtual bool IsExiting() override { return _exiting.load(std::memory_order_relaxed); }
+	virtual bool PollNextEvent(vr::VREvent_t *pEvent, uint32_t uncbVREvent) override { return false; }
+	virtual void GetRawTrackedDevicePoses(float fPredictedSecondsFromNow, vr::TrackedDevicePose_t *pTrackedDevicePoseArray, uint32_t unTrackedDevicePoseArrayCount) override;
+
+	// from self
+
+	// Activates the devices added since the last call
+	void activatePendingDevices();
+
+	// Deactivates all activated devices
+	void deactivateDevices();
+
+	void setExiting() { _exiting.store(true, std::memory_order_relaxed); }
+
+	uint32_t deviceCount();
+	std::string deviceSerial(uint32_t deviceId);
+	vr::ETrackedDeviceClass deviceClass(uint32_t deviceId);
+
+	uint64_t callCount(uint32_t deviceId, HostCall call) const {
+		return deviceId < vr::k_unMaxTrackedDeviceCount ? _callCounts[deviceId][(uint32_t)call].load(std::memory_order_relaxed) : 0;
+	}
+
+	// Returns false when the device never got a pose
+	bool lastPose(uint32_t deviceId, vr::DriverPose_t& pose);
+
+private:
+	struct Device {
+		std::string serial;
+		vr::ETrackedDeviceClass deviceClass;
+		vr::ITrackedDeviceServerDriver* driver;
+		bool activated;
+	};
+
+	void _countCall(uint32_t deviceId, HostCall call) {
+		if (deviceId < vr::k_unMaxTrackedDeviceCount) {
+			_callCounts[deviceId][(uint32_t)call].fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	std::mutex _devicesMutex;
+	std::vector<Device> _devices; // index = openvr device id
+	std::atomic<uint64_t> _callCounts[vr::k_unMaxTrackedDeviceCount][(uint32_t)HostCall::Count];
+	std::mutex _posesMutex;
+	vr::DriverPose_t _lastPoses[vr::k_unMaxTrackedDeviceCount];
+	bool _hasPose[vr::k_unMaxTrackedDeviceCount];
+	std::atomic<bool> _exiting = { false };
+};
+
+
+/**
+ * Stands in for vrserver's IVRProperties. Keeps the written properties of every device and counts reads and writes.
+ *
+ * Property containers are the device id + 1, so k_ulInvalidPropertyContainer (0) stays invalid.
+ */
+class CPropertiesStub : public vr::IVRProperties {
+public:
+	// from IVRProperties
+
+	virtual vr::ETrackedPropertyError ReadPropertyBatch(vr::PropertyContainerHandle_t ulContainerHandle, vr::PropertyRead_t *pBatch, uint32_t unBatchEntryCount) override;
+	virtual vr::ETrackedPropertyError WritePropertyBatch(vr::PropertyContainerHandle_t ulContainerHandle, vr::PropertyWrite_t *pBatch, uint32_t unBatchEntryCount) override;
+	virtual const char *GetPropErrorNameFromEnum(vr::ETrackedPropertyError error) override;
+	virtual vr::PropertyContainerHandle_t TrackedDeviceToPropertyContainer(vr::TrackedDeviceIndex_t nDevice) override;
+
+	// from self
+
+	// Used by the host's synthetic devices
+	void setProperty(vr::TrackedDeviceIndex_t deviceId, vr::ETrackedDeviceProperty prop, const void* data, uint32_t size, vr::PropertyTypeTag_t tag);
+
+	uint64_t readCount() const { return _readCount.load(std::memory_order_relaxed); }
+	uint64_t writeCount() const { return _writeCount.load(std::memory_order_relaxed); }
+
+private:
+	struct Value {
+		vr::PropertyTypeTag_t tag = 0;
+		vr::ETrackedPropertyError error = vr::TrackedProp_Success;
+		std::vector<char> data;
+	};
+
+	std::mutex _mutex;
+	std::map<vr::PropertyContainerHandle_t, std::map<vr::ETrackedDeviceProperty, Value>> _containers;
+	std::atomic<uint64_t> _readCount = { 0 };
+	std::atomic<uint64_t> _writeCount = { 0 };
+};
+
+
+/**
+ * Hands the stubs to the driver. All other interfaces (settings, driver log, ...) are reported as not available.
+ */
+class CDriverContextStub : public vr::IVRDriverContext {
+public:
+	CDriverContextStub(CServerDriverHostStub* driverHost, CPropertiesStub* properties) : _driverHost(driverHost), _properties(properties) {}
+
+	// from IVRDriverContext
+
+	virtual void *GetGenericInterface(const char *pchInterfaceVersion, vr::EVRInitError *peError = nullptr) override;
+	virtual vr::DriverHandle_t GetDriverHandle() override { return 1; }
+
+private:
+	CServerDriverHostStub* _driverHost;
+	CPropertiesStub* _properties;
+};
+
+
+} // end namespace host
+} // end namespace vrinputemulator
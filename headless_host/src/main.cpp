@@ -0,0 +1,221 @@
+#include <windows.h>
+#include <mmsystem.h>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <openvr_driver.h>
+#include <vrinputemulator_percentile.h>
+#include "host_stubs.h"
+#include "host_posesource.h"
+
+
+typedef void* (*HmdDriverFactory_t)(const char*, int*);
+
+static std::atomic<bool> stopRequested = { false };
+
+static BOOL WINAPI consoleCtrlHandler(DWORD ctrlType) {
+	if (ctrlType == CTRL_C_EVENT || ctrlType == CTRL_BREAK_EVENT || ctrlType == CTRL_CLOSE_EVENT) {
+		stopRequested.store(true);
+		return TRUE;
+	}
+	return FALSE;
+}
+
+
+void printHelp() {
+	std::cout << "Usage: headless_host.exe [<option> <value>]..." << std::endl << std::endl
+		<< "Loads the VRInputEmulator driver without SteamVR. Stub IVRServerDriverHost and IVRProperties interfaces record" << std::endl
+		<< "the driver's calls, synthetic devices send poses through the driver's hooks, and VRInputEmulator clients can" << std::endl
+		<< "connect over ipc as usual. Don't run it while SteamVR is running, both use the same ipc names." << std::endl << std::endl
+		<< "  --driver <dll>\t\tDriver to load (default: driver_00vrinputemulator.dll, searched like any other dll)" << std::endl
+		<< "  --controllers <n>\t\tNumber of synthetic controllers (default: 2, at most 63; virtual devices need free openvr ids)" << std::endl
+		<< "  --hmd-rate <Hz>\t\tPose rate of the synthetic HMD (default: 1120, 0 = no HMD)" << std::endl
+		<< "  --controller-rate <Hz>\tPose rate of each synthetic controller (default: 369)" << std::endl
+		<< "  --frame-rate <Hz>\t\tRunFrame() rate (default: 90)" << std::endl
+		<< "  --duration <s>\t\tStops after <s> seconds (default: 0 = until Ctrl+C)" << std::endl
+		<< "  --report <ms>\t\tReport interval (default: 1000, 0 = only at the end)" << std::endl;
+}
+
+
+// Pose rates and call latencies of the synthetic devices, then the calls the driver made per device
+static void _printReport(vrinputemulator::host::CServerDriverHostStub& driverHost, vrinputemulator::host::CPropertiesStub& properties,
+		std::vector<std::unique_ptr<vrinputemulator::host::CPoseSource>>& sources, std::vector<uint64_t>& previousPoseCounts,
+		std::vector<uint64_t>& previousCallCounts, double seconds) {
+	using vrinputemulator::host::HostCall;
+	std::cout.setf(std::ios::fixed);
+	std::cout.precision(3);
+	std::cout << "source\t\t\t\tposes/s\t\tlate\t\tcall p50 [us]\tcall p99 [us]\tcall max [us]" << std::endl;
+	for (size_t i = 0; i < sources.size(); ++i) {
+		auto sample = sources[i]->takeSample();
+		std::sort(sample.callLatenciesNs.begin(), sample.callLatenciesNs.end());
+		std::cout << std::left << std::setw(32) << sources[i]->device()->serialNumber() << std::right
+			<< std::setw(10) << (double)(sample.poseCount - previousPoseCounts[i]) / seconds << "\t"
+			<< std::setw(10) << sample.lateCount << "\t"
+			<< std::setw(10) << vrinputemulator::percentileMicros(sample.callLatenciesNs, 0.5) << "\t"
+			<< std::setw(10) << vrinputemulator::percentileMicros(sample.callLatenciesNs, 0.99) << "\t"
+			<< std::setw(10) << (sample.callLatenciesNs.empty() ? 0.0 : (double)sample.callLatenciesNs.back() / 1000.0) << std::endl;
+		previousPoseCounts[i] = sample.poseCount;
+	}
+	std::cout << "device\tserial\t\t\t\tcall\t\t\tcalls/s\t\tcalls" << std::endl;
+	auto deviceCount = driverHost.deviceCount();
+	for (uint32_t d = 0; d < deviceCount; ++d) {
+		for (uint32_t c = 0; c < (uint32_t)HostCall::Count; ++c) {
+			auto count = driverHost.callCount(d, (HostCall)c);
+			auto& previous = previousCallCounts[d * (uint32_t)HostCall::Count + c];
+			if (count > 0) {
+				std::cout << d << "\t" << std::left << std::setw(32) << driverHost.deviceSerial(d) << "\t"
+					<< std::setw(20) << vrinputemulator::host::hostCallName((HostCall)c) << "\t" << std::right
+					<< std::setw(10) << (double)(count - previous) / seconds << "\t" << std::setw(10) << count << std::endl;
+			}
+			previous = count;
+		}
+	}
+	std::cout << "Property reads: " << properties.readCount() << ", writes: " << properties.writeCount() << std::endl << std::endl;
+}
+
+
+int main(int argc, const char* argv[]) {
+	std::string driverPath = "driver_00vrinputemulator.dll";
+	unsigned controllerCount = 2;
+	double hmdRate = 1120.0;
+	double controllerRate = 369.0;
+	double frameRate = 90.0;
+	double duration = 0.0;
+	unsigned reportInterval = 1000;
+	try {
+		for (int i = 1; i < argc; i += 2) {
+			std::string option = argv[i];
+			if (option == "help" || option == "--help") {
+				printHelp();
+				return 0;
+			} else if (i + 1 >= argc) {
+				throw std::runtime_error("Error: Missing value for " + option);
+			}
+			const char* value = argv[i + 1];
+			if (option == "--driver") {
+				driverPath = value;
+			} else if (option == "--controllers") {
+				controllerCount = std::stoul(value);
+			} else if (option == "--hmd-rate") {
+				hmdRate = std::stod(value);
+			} else if (option == "--controller-rate") {
+				controllerRate = std::stod(value);
+			} else if (option == "--frame-rate") {
+				frameRate = std::stod(value);
+			} else if (option == "--duration") {
+				duration = std::stod(value);
+			} else if (option == "--report") {
+				reportInterval = std::stoul(value);
+			} else {
+				throw std::runtime_error("Error: Unknown option " + option);
+			}
+		}
+		if (hmdRate < 0.0 || controllerRate <= 0.0 || frameRate <= 0.0 || duration < 0.0) {
+			throw std::runtime_error("Error: Rates must be greater than 0.");
+		} else if (controllerCount + 1 > vr::k_unMaxTrackedDeviceCount) {
+			throw std::runtime_error("Error: Too many controllers.");
+		}
+	} catch (const std::exception& e) {
+		std::cout << e.what() << std::endl;
+		printHelp();
+		return 1;
+	}
+
+	auto driverModule = LoadLibraryA(driverPath.c_str());
+	if (!driverModule) {
+		std::cout << "Error: Could not load " << driverPath << " (" << GetLastError() << ")" << std::endl;
+		return 2;
+	}
+	auto driverFactory = (HmdDriverFactory_t)GetProcAddress(driverModule, "HmdDriverFactory");
+	if (!driverFactory) {
+		std::cout << "Error: " << driverPath << " does not export HmdDriverFactory" << std::endl;
+		return 2;
+	}
+	int factoryError = vr::VRInitError_None;
+	auto provider = (vr::IServerTrackedDeviceProvider*)driverFactory(vr::IServerTrackedDeviceProvider_Version, &factoryError);
+	if (!provider) {
+		std::cout << "Error: Driver does not provide " << vr::IServerTrackedDeviceProvider_Version << " (" << factoryError << ")" << std::endl;
+		return 2;
+	}
+
+	vrinputemulator::host::CServerDriverHostStub driverHost;
+	vrinputemulator::host::CPropertiesStub properties;
+	vrinputemulator::host::CDriverContextStub driverContext(&driverHost, &properties);
+	auto initError = provider->Init(&driverContext);
+	if (initError != vr::VRInitError_None) {
+		std::cout << "Error: Driver initialization failed (" << (int)initError << ")" << std::endl;
+		return 2;
+	}
+	SetConsoleCtrlHandler(consoleCtrlHandler, TRUE);
+	timeBeginPeriod(1);
+
+	// Added through the interface, so the driver's hooks see them like lighthouse devices
+	vr::IVRServerDriverHost* hostInterface = &driverHost;
+	std::vector<std::unique_ptr<vrinputemulator::host::CSyntheticDevice>> devices;
+	std::vector<std::unique_ptr<vrinputemulator::host::CPoseSource>> sources;
+	if (hmdRate > 0.0) {
+		devices.emplace_back(new vrinputemulator::host::CSyntheticDevice(&properties, "HEADLESS-HMD", vr::TrackedDeviceClass_HMD, 0, 1));
+		sources.emplace_back(new vrinputemulator::host::CPoseSource(hostInterface, devices.back().get(), hmdRate));
+	}
+	for (unsigned i = 0; i < controllerCount; ++i) {
+		devices.emplace_back(new vrinputemulator::host::CSyntheticDevice(&properties, "HEADLESS-CONTROLLER-" + std::to_string(i),
+			vr::TrackedDeviceClass_Controller, i, controllerCount));
+		sources.emplace_back(new vrinputemulator::host::CPoseSource(hostInterface, devices.back().get(), controllerRate));
+	}
+	for (auto& d : devices) {
+		hostInterface->TrackedDeviceAdded(d->serialNumber().c_str(), d->deviceClass(), d.get());
+	}
+	driverHost.activatePendingDevices();
+
+	std::cout << "Driver loaded, " << devices.size() << " synthetic devices" << std::endl;
+	auto startTime = std::chrono::steady_clock::now();
+	for (auto& s : sources) {
+		s->start(startTime);
+	}
+	std::vector<uint64_t> previousPoseCounts(sources.size(), 0);
+	std::vector<uint64_t> previousCallCounts(vr::k_unMaxTrackedDeviceCount * (uint32_t)vrinputemulator::host::HostCall::Count, 0);
+	auto framePeriod = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / frameRate));
+	auto nextFrameTime = startTime;
+	auto reportTime = startTime;
+	while (!stopRequested.load()) {
+		auto now = std::chrono::steady_clock::now();
+		if (duration > 0.0 && std::chrono::duration<double>(now - startTime).count() >= duration) {
+			break;
+		}
+		if (now >= nextFrameTime) {
+			// Devices published by clients in the meantime are activated on the frame thread, like in vrserver
+			driverHost.activatePendingDevices();
+			provider->RunFrame();
+			nextFrameTime += framePeriod;
+			if (nextFrameTime < now) {
+				nextFrameTime = now + framePeriod;
+			}
+		}
+		if (reportInterval > 0 && now - reportTime >= std::chrono::milliseconds(reportInterval)) {
+			_printReport(driverHost, properties, sources, previousPoseCounts, previousCallCounts, std::chrono::duration<double>(now - reportTime).count());
+			reportTime = now;
+		}
+		std::this_thread::sleep_until(std::min(nextFrameTime, reportTime + std::chrono::milliseconds(reportInterval > 0 ? reportInterval : 1000)));
+	}
+
+	for (auto& s : sources) {
+		s->stop();
+	}
+	auto stopTime = std::chrono::steady_clock::now();
+	if (reportInterval == 0) {
+		_printReport(driverHost, properties, sources, previousPoseCounts, previousCallCounts, std::chrono::duration<double>(stopTime - startTime).count());
+	}
+	driverHost.setExiting();
+	driverHost.deactivateDevices();
+	provider->Cleanup();
+	timeEndPeriod(1);
+	std::cout << "Stopped after " << std::chrono::duration<double>(stopTime - startTime).count() << " s" << std::endl;
+	return 0;
+}
@@ -1,15 +1,45 @@
 #pragma once
 
 #include "vrinputemulator_types.h"
+#include "vrinputemulator_trace.h"
 #include <utility>
+#include <cstddef>
+#include <atomic>
+#include <chrono>
 
 
-#define IPC_PROTOCOL_VERSION 1
+#define IPC_PROTOCOL_VERSION 13 // sizeof(ipc::Reply) must stay at most 304 bytes across versions, see the static_assert below struct Reply
 
 namespace vrinputemulator {
 namespace ipc {
 
 
+/*
+ * Clock domain of all ipc timestamps: nanoseconds of the driver's steady clock. Clients estimate the offset of their
+ * own steady clock at connect (IPC_ClockSync), so a timestamp means the same on both sides and wall clock
+ * adjustments cannot shift it.
+ */
+inline int64_t steadyClockNs() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Driver clock minus the steady clock of this process (always 0 in the driver)
+inline std::atomic<int64_t>& clockOffsetNs() {
+	static std::atomic<int64_t> offset = { 0 };
+	return offset;
+}
+
+inline int64_t clockNs() {
+	return steadyClockNs() + clockOffsetNs().load(std::memory_order_relaxed);
+}
+
+// Age of an ipc timestamp in seconds with microsecond resolution (0 for timestamps from the future)
+inline double timestampAge(int64_t timestamp) {
+	auto age = clockNs() - timestamp;
+	return age > 0 ? (double)(age / 1000) / 1.0E6 : 0.0;
+}
+
+
 enum class RequestType : uint32_t {
 	None,
 
@@ -17,15 +47,21 @@ enum class RequestType : uint32_t {
 	IPC_ClientConnect,
 	IPC_ClientDisconnect,
 	IPC_Ping,
+	IPC_Wakeup, // Empty message, only used to wake up a blocking receive loop (e.g. on shutdown)
+	IPC_ClientStatus,
 
 	// These are indented to inject events into OpenVR and require an OpenVR device id.
-	// These are "fire and forget".
+	// These are "fire and forget" and may also be sent over the client's data ring.
 	OpenVR_PoseUpdate,
 	OpenVR_ButtonEvent,
 	OpenVR_AxisEvent,
 	OpenVR_ProximitySensorEvent,
 	OpenVR_VendorSpecificEvent,
 
+	// Several "fire and forget" requests that are applied together (see VRInputEmulator::beginBatch()).
+	// Large batches are split into several parts, the driver applies the batch when the last part arrives.
+	Batch,
+
 	// These are indented to manage virtual devices and require the internal device id.
 	// The Reply is send to the client's message queue.
 	VirtualDevices_AddDevice,
@@ -49,7 +85,20 @@ enum class RequestType : uint32_t {
 	DeviceManipulation_MotionCompensationMode,
 	DeviceManipulation_FakeDisconnectedMode,
 	DeviceManipulation_TriggerHapticPulse,
-	DeviceManipulation_SetMotionCompensationProperties
+	DeviceManipulation_SetMotionCompensationProperties,
+
+	// Writes the driver's hook trace into a file (see vrinputemulator_trace.h)
+	Debug_DumpTrace,
+	// Returns the driver's per-hook call counts and latency percentiles, one page per request
+	Debug_GetHookStats,
+
+	// Returns the driver's clock, answered directly by the receiving thread to keep the round trip short
+	IPC_ClockSync,
+
+	// Switches the recording of stage latencies (see trace::LatencyStage) for all requests of a client
+	Debug_SetLatencyTracing,
+	// Returns the recorded stage latencies, one page per request
+	Debug_GetLatencyStats
 };
 
 
@@ -58,6 +107,8 @@ enum class ReplyType : uint32_t {
 	
 	IPC_ClientConnect,
 	IPC_Ping,
+	IPC_Wakeup, // Empty message, only used to wake up a blocking receive loop (e.g. on shutdown)
+	IPC_ClientStatus,
 
 	GenericReply,
 
@@ -68,7 +119,13 @@ enum class ReplyType : uint32_t {
 	VirtualDevices_AddDevice,
 
 	DeviceManipulation_GetDeviceInfo,
-	DeviceManipulation_GetDeviceOffsets
+	DeviceManipulation_GetDeviceOffsets,
+
+	Debug_DumpTrace,
+	Debug_GetHookStats,
+
+	IPC_ClockSync,
+	Debug_GetLatencyStats
 };
 
 
@@ -83,7 +140,8 @@ enum class ReplyStatus : uint32_t {
 	TooManyDevices,
 	InvalidVersion,
 	MissingProperty,
-	InvalidOperation
+	InvalidOperation,
+	QueueFull // the driver is backlogged and did not accept the request, retry later
 };
 
 
@@ -91,6 +149,10 @@ struct Request_IPC_ClientConnect {
 	uint32_t messageId;
 	uint32_t ipcProcotolVersion;
 	char queueName[128];
+	char dataRingName[128]; // optional shared memory ring for fire-and-forget requests (empty string when not used)
+	ReplyOverflowPolicy replyOverflowPolicy;
+	uint32_t processId; // the driver drops the client when this process dies (0 when unknown)
+	uint32_t dataLaneWeight; // share of the driver's data plane relative to other clients (1 - 16)
 };
 
 
@@ -107,7 +169,21 @@ struct Request_IPC_Ping {
 };
 
 
+struct Request_IPC_ClockSync {
+	uint32_t clientId;
+	uint32_t messageId;
+};
+
+
+struct Request_IPC_ClientStatus {
+	uint32_t clientId;
+	uint32_t messageId;
+};
+
+
+// The clientId of fire-and-forget requests selects the client's lane in the driver's data plane
 struct Request_OpenVR_PoseUpdate {
+	uint32_t clientId;
 	uint32_t deviceId;
 	vr::DriverPose_t pose;
 };
@@ -116,6 +192,7 @@ struct Request_OpenVR_PoseUpdate {
 #define REQUEST_OPENVR_BUTTONEVENT_MAXCOUNT 12
 
 struct Request_OpenVR_ButtonEvent {
+	uint32_t clientId;
 	unsigned eventCount;
 	struct {
 		ButtonEventType eventType;
@@ -129,6 +206,7 @@ struct Request_OpenVR_ButtonEvent {
 #define REQUEST_OPENVR_AXISEVENT_MAXCOUNT 12
 
 struct Request_OpenVR_AxisEvent {
+	uint32_t clientId;
 	unsigned eventCount;
 	struct {
 		uint32_t deviceId;
@@ -139,12 +217,14 @@ struct Request_OpenVR_AxisEvent {
 
 
 struct Request_OpenVR_ProximitySensorEvent {
+	uint32_t clientId;
 	uint32_t deviceId;
 	bool sensorTriggered;
 };
 
 
 struct Request_OpenVR_VendorSpecificEvent {
+	uint32_t clientId;
 	uint32_t deviceId;
 	vr::EVREventType eventType;
 	vr::VREvent_Data_t eventData;
@@ -152,6 +232,25 @@ struct Request_OpenVR_VendorSpecificEvent {
 };
 
 
+#define REQUEST_BATCH_DATASIZE 256
+
+// Batch data is a byte stream of operations, each consisting of a Request_BatchOpHeader followed by the
+// request payload (padded to a multiple of 8 bytes). Operations may span several parts.
+struct Request_BatchOpHeader {
+	RequestType type;
+	uint32_t length; // payload length in bytes (without padding)
+};
+
+struct Request_Batch {
+	uint32_t clientId;
+	uint32_t messageId; // Used to associate with Reply (only evaluated in the last part, 0 .. no reply)
+	uint32_t batchId; // All parts of a batch have the same id
+	uint32_t lastPart; // 1 .. this part completes the batch
+	uint32_t dataSize; // used bytes in data
+	uint8_t data[REQUEST_BATCH_DATASIZE];
+};
+
+
 struct Request_VirtualDevices_GenericClientMessage {
 	uint32_t clientId;
 	uint32_t messageId; // Used to associate with Reply
@@ -276,35 +375,122 @@ struct Request_DeviceManipulation_TriggerHapticPulse {
 	bool directMode;
 };
 
+// Only the properties flagged as valid are changed
 struct Request_DeviceManipulation_SetMotionCompensationProperties {
 	uint32_t clientId;
 	uint32_t messageId; // Used to associate with Reply
+	bool velAccCompensationModeValid;
 	uint32_t velAccCompensationMode;
+	bool kalmanFilterNoiseValid;
+	double kalmanFilterProcessNoise;
+	double kalmanFilterObservationNoise;
+};
+
+
+struct Request_Debug_DumpTrace {
+	uint32_t clientId;
+	uint32_t messageId;
+	char fileName[256]; // bare file name, the driver writes it into its trace directory
 };
 
+struct Request_Debug_GetHookStats {
+	uint32_t clientId;
+	uint32_t messageId;
+	uint32_t firstEntry;
+};
 
+struct Request_Debug_SetLatencyTracing {
+	uint32_t clientId;
+	uint32_t messageId;
+	uint32_t enable;
+};
+
+struct Request_Debug_GetLatencyStats {
+	uint32_t clientId;
+	uint32_t messageId;
+	uint32_t firstEntry;
+};
+
+
+/*
+ * Wire format: Requests and replies are sent as frames consisting of the fixed header (type, length, timestamp, ...)
+ * followed by the first "length" bytes of the message union. Only IPC_ClientConnect is always sent at full size,
+ * so that clients and drivers speaking different protocol versions can still negotiate the version.
+ */
 struct Request {
 	Request() {}
-	Request(RequestType type) : type(type) {
-		timestamp = std::chrono::duration_cast <std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	Request(RequestType type) : type(type), length(payloadSize(type)) {
+		timestamp = clockNs();
 	}
-	Request(RequestType type, uint64_t timestamp) : type(type), timestamp(timestamp) {}
+	Request(RequestType type, int64_t timestamp) : type(type), length(payloadSize(type)), timestamp(timestamp) {}
 
 	void refreshTimestamp() {
-		timestamp = std::chrono::duration_cast <std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+		timestamp = clockNs();
+	}
+
+	static uint32_t headerSize() {
+		return offsetof(Request, msg);
+	}
+
+	// Max. payload size of the given request type
+	static uint32_t payloadSize(RequestType type);
+
+	// Payload size needed by this request (event lists only count the used events)
+	uint32_t payloadSize() const {
+		switch (type) {
+		case RequestType::OpenVR_ButtonEvent:
+			return offsetof(Request_OpenVR_ButtonEvent, events) + (msg.ipc_ButtonEvent.eventCount <= REQUEST_OPENVR_BUTTONEVENT_MAXCOUNT ? msg.ipc_ButtonEvent.eventCount : REQUEST_OPENVR_BUTTONEVENT_MAXCOUNT)
+				* (uint32_t)((sizeof(Request_OpenVR_ButtonEvent) - offsetof(Request_OpenVR_ButtonEvent, events)) / REQUEST_OPENVR_BUTTONEVENT_MAXCOUNT);
+		case RequestType::OpenVR_AxisEvent:
+			return offsetof(Request_OpenVR_AxisEvent, events) + (msg.ipc_AxisEvent.eventCount <= REQUEST_OPENVR_AXISEVENT_MAXCOUNT ? msg.ipc_AxisEvent.eventCount : REQUEST_OPENVR_AXISEVENT_MAXCOUNT)
+				* (uint32_t)((sizeof(Request_OpenVR_AxisEvent) - offsetof(Request_OpenVR_AxisEvent, events)) / REQUEST_OPENVR_AXISEVENT_MAXCOUNT);
+		case RequestType::Batch:
+			return offsetof(Request_Batch, data) + (msg.batch.dataSize <= REQUEST_BATCH_DATASIZE ? msg.batch.dataSize : REQUEST_BATCH_DATASIZE);
+		default:
+			return payloadSize(type);
+		}
+	}
+
+	// Sets the length field according to type and content, and returns the number of bytes to send
+	uint32_t updateFrameLength() {
+		length = payloadSize();
+		return frameSize();
+	}
+
+	uint32_t frameSize() const {
+		return headerSize() + length;
+	}
+
+	// Checks a received frame
+	bool isValidFrame(uint64_t recvSize) const {
+		if (recvSize < headerSize() || recvSize - headerSize() != length || length > sizeof(msg)) {
+			return false;
+		}
+		if (type == RequestType::OpenVR_ButtonEvent && (length < offsetof(Request_OpenVR_ButtonEvent, events) || msg.ipc_ButtonEvent.eventCount > REQUEST_OPENVR_BUTTONEVENT_MAXCOUNT)) {
+			return false;
+		} else if (type == RequestType::OpenVR_AxisEvent && (length < offsetof(Request_OpenVR_AxisEvent, events) || msg.ipc_AxisEvent.eventCount > REQUEST_OPENVR_AXISEVENT_MAXCOUNT)) {
+			return false;
+		} else if (type == RequestType::Batch && (length < offsetof(Request_Batch, data) || msg.batch.dataSize > REQUEST_BATCH_DATASIZE)) {
+			return false;
+		}
+		return length >= payloadSize();
 	}
 
 	RequestType type = RequestType::None;
-	int64_t timestamp = 0; // milliseconds since epoch
+	uint32_t length = 0; // payload length in bytes
+	int64_t timestamp = 0; // see clockNs()
 	union {
 		Request_IPC_ClientConnect ipc_ClientConnect;
 		Request_IPC_ClientDisconnect ipc_ClientDisconnect;
 		Request_IPC_Ping ipc_Ping;
+		Request_IPC_ClockSync ipc_ClockSync;
+		Request_IPC_ClientStatus ipc_ClientStatus;
 		Request_OpenVR_PoseUpdate ipc_PoseUpdate;
 		Request_OpenVR_ButtonEvent ipc_ButtonEvent;
 		Request_OpenVR_AxisEvent ipc_AxisEvent;
 		Request_OpenVR_ProximitySensorEvent ovr_ProximitySensorEvent;
 		Request_OpenVR_VendorSpecificEvent ovr_VendorSpecificEvent;
+		Request_Batch batch;
 		Request_VirtualDevices_GenericClientMessage vd_GenericClientMessage;
 		Request_VirtualDevices_GenericDeviceIdMessage vd_GenericDeviceIdMessage;
 		Request_VirtualDevices_AddDevice vd_AddDevice;
@@ -319,20 +505,108 @@ struct Request {
 		Request_DeviceManipulation_MotionCompensationMode dm_MotionCompensationMode;
 		Request_DeviceManipulation_TriggerHapticPulse dm_triggerHapticPulse;
 		Request_DeviceManipulation_SetMotionCompensationProperties dm_SetMotionCompensationProperties;
+		Request_Debug_DumpTrace dbg_DumpTrace;
+		Request_Debug_GetHookStats dbg_GetHookStats;
+		Request_Debug_SetLatencyTracing dbg_SetLatencyTracing;
+		Request_Debug_GetLatencyStats dbg_GetLatencyStats;
 	} msg;
 };
 
+inline uint32_t Request::payloadSize(RequestType type) {
+	switch (type) {
+	case RequestType::IPC_ClientConnect:
+		return sizeof(Request::msg); // see comment above
+	case RequestType::IPC_ClientDisconnect:
+		return sizeof(Request_IPC_ClientDisconnect);
+	case RequestType::IPC_Ping:
+		return sizeof(Request_IPC_Ping);
+	case RequestType::IPC_ClientStatus:
+		return sizeof(Request_IPC_ClientStatus);
+	case RequestType::OpenVR_PoseUpdate:
+		return sizeof(Request_OpenVR_PoseUpdate);
+	case RequestType::OpenVR_ButtonEvent:
+		return sizeof(Request_OpenVR_ButtonEvent);
+	case RequestType::OpenVR_AxisEvent:
+		return sizeof(Request_OpenVR_AxisEvent);
+	case RequestType::OpenVR_ProximitySensorEvent:
+		return sizeof(Request_OpenVR_ProximitySensorEvent);
+	case RequestType::OpenVR_VendorSpecificEvent:
+		return sizeof(Request_OpenVR_VendorSpecificEvent);
+	case RequestType::Batch:
+		return sizeof(Request_Batch);
+	case RequestType::VirtualDevices_GetDeviceCount:
+		return sizeof(Request_VirtualDevices_GenericClientMessage);
+	case RequestType::VirtualDevices_PublishDevice:
+	case RequestType::VirtualDevices_GetDeviceInfo:
+	case RequestType::VirtualDevices_GetDevicePose:
+	case RequestType::VirtualDevices_GetControllerState:
+	case RequestType::DeviceManipulation_GetDeviceInfo:
+	case RequestType::DeviceManipulation_GetDeviceOffsets:
+	case RequestType::DeviceManipulation_DefaultMode:
+	case RequestType::DeviceManipulation_FakeDisconnectedMode:
+		return sizeof(Request_VirtualDevices_GenericDeviceIdMessage);
+	case RequestType::VirtualDevices_AddDevice:
+		return sizeof(Request_VirtualDevices_AddDevice);
+	case RequestType::VirtualDevices_SetDeviceProperty:
+		return sizeof(Request_VirtualDevices_SetDeviceProperty);
+	case RequestType::VirtualDevices_RemoveDeviceProperty:
+		return sizeof(Request_VirtualDevices_RemoveDeviceProperty);
+	case RequestType::VirtualDevices_SetDevicePose:
+		return sizeof(Request_VirtualDevices_SetDevicePose);
+	case RequestType::VirtualDevices_SetControllerState:
+		return sizeof(Request_VirtualDevices_SetControllerState);
+	case RequestType::DeviceManipulation_ButtonMapping:
+		return sizeof(Request_DeviceManipulation_ButtonMapping);
+	case RequestType::DeviceManipulation_SetDeviceOffsets:
+		return sizeof(Request_DeviceManipulation_SetDeviceOffsets);
+	case RequestType::DeviceManipulation_RedirectMode:
+		return sizeof(Request_DeviceManipulation_RedirectMode);
+	case RequestType::DeviceManipulation_SwapMode:
+		return sizeof(Request_DeviceManipulation_SwapMode);
+	case RequestType::DeviceManipulation_MotionCompensationMode:
+		return sizeof(Request_DeviceManipulation_MotionCompensationMode);
+	case RequestType::DeviceManipulation_TriggerHapticPulse:
+		return sizeof(Request_DeviceManipulation_TriggerHapticPulse);
+	case RequestType::DeviceManipulation_SetMotionCompensationProperties:
+		return sizeof(Request_DeviceManipulation_SetMotionCompensationProperties);
+	case RequestType::Debug_DumpTrace:
+		return sizeof(Request_Debug_DumpTrace);
+	case RequestType::Debug_GetHookStats:
+		return sizeof(Request_Debug_GetHookStats);
+	case RequestType::IPC_ClockSync:
+		return sizeof(Request_IPC_ClockSync);
+	case RequestType::Debug_SetLatencyTracing:
+		return sizeof(Request_Debug_SetLatencyTracing);
+	case RequestType::Debug_GetLatencyStats:
+		return sizeof(Request_Debug_GetLatencyStats);
+	default:
+		return 0;
+	}
+}
+
 
 
 struct Reply_IPC_ClientConnect {
 	uint32_t clientId;
 	uint32_t ipcProcotolVersion;
+	bool dataRingEnabled;
 };
 
 struct Reply_IPC_Ping {
 	uint64_t nonce;
 };
 
+struct Reply_IPC_ClockSync {
+	int64_t driverTimeNs; // clockNs() of the driver
+};
+
+struct Reply_IPC_ClientStatus {
+	ReplyOverflowPolicy replyOverflowPolicy;
+	uint32_t pendingReplies;
+	uint64_t repliesSent;
+	uint64_t repliesDropped;
+};
+
 struct Reply_VirtualDevices_GetDeviceCount {
 	uint32_t deviceCount;
 };
@@ -380,20 +654,66 @@ struct Reply_DeviceManipulation_GetDeviceOffsets {
 };
 
 
+struct Reply_Debug_DumpTrace {
+	uint64_t recordCount;
+	uint32_t threadCount;
+	char path[256]; // where the driver wrote the file
+};
+
+// Kept small since every reply queue slot is as large as the largest reply (24 + 6 * 40 bytes, below Reply_VirtualDevices_GetDevicePose)
+#define HOOKSTATS_ENTRIES_PER_REPLY 6
+
+struct Reply_Debug_GetHookStats {
+	uint64_t sampleTimeNs;
+	uint32_t totalEntries; // entries never disappear and keep their index, so clients can page through them
+	uint32_t firstEntry;
+	uint32_t entryCount;
+	trace::HookStatsEntry entries[HOOKSTATS_ENTRIES_PER_REPLY];
+};
+
+#define LATENCYSTATS_ENTRIES_PER_REPLY 5 // keeps the reply below the largest one (24 + 5 * 48 bytes)
+
+struct Reply_Debug_GetLatencyStats {
+	uint64_t sampleTimeNs;
+	uint32_t totalEntries; // like Reply_Debug_GetHookStats
+	uint32_t firstEntry;
+	uint32_t entryCount;
+	trace::LatencyStatsEntry entries[LATENCYSTATS_ENTRIES_PER_REPLY];
+};
+
+
 struct Reply {
 	Reply() {}
-	Reply(ReplyType type) : type(type) {
-		timestamp = std::chrono::duration_cast <std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	Reply(ReplyType type) : type(type), length(payloadSize(type)) {
+		timestamp = clockNs();
+	}
+	Reply(ReplyType type, int64_t timestamp) : type(type), length(payloadSize(type)), timestamp(timestamp) {}
+
+	static uint32_t headerSize() {
+		return offsetof(Reply, msg);
+	}
+
+	static uint32_t payloadSize(ReplyType type);
+
+	uint32_t frameSize() const {
+		return headerSize() + length;
+	}
+
+	// Checks a received frame
+	bool isValidFrame(uint64_t recvSize) const {
+		return recvSize >= headerSize() && recvSize - headerSize() == length && length <= sizeof(msg) && length >= payloadSize(type);
 	}
-	Reply(ReplyType type, uint64_t timestamp) : type(type), timestamp(timestamp) {}
 
 	ReplyType type = ReplyType::None;
-	uint64_t timestamp = 0; // milliseconds since epoch
+	uint32_t length = 0; // payload length in bytes
+	int64_t timestamp = 0; // see clockNs()
 	uint32_t messageId;
 	ReplyStatus status;
 	union {
 		Reply_IPC_ClientConnect ipc_ClientConnect;
 		Reply_IPC_Ping ipc_Ping;
+		Reply_IPC_ClockSync ipc_ClockSync;
+		Reply_IPC_ClientStatus ipc_ClientStatus;
 		Reply_VirtualDevices_GetDeviceCount vd_GetDeviceCount;
 		Reply_VirtualDevices_GetDeviceInfo vd_GetDeviceInfo;
 		Reply_VirtualDevices_GetDevicePose vd_GetDevicePose;
@@ -401,9 +721,51 @@ struct Reply {
 		Reply_VirtualDevices_AddDevice vd_AddDevice;
 		Reply_DeviceManipulation_GetDeviceInfo dm_deviceInfo;
 		Reply_DeviceManipulation_GetDeviceOffsets dm_deviceOffsets;
+		Reply_Debug_DumpTrace dbg_DumpTrace;
+		Reply_Debug_GetHookStats dbg_GetHookStats;
+		Reply_Debug_GetLatencyStats dbg_GetLatencyStats;
 	} msg;
 };
 
+// Older clients size their reply queue with sizeof(Reply), and the IPC_ClientConnect reply is always sent at the
+// full payload size. A larger Reply would not fit into their queue and they would never see ReplyStatus::InvalidVersion.
+static_assert(sizeof(Reply) <= 304, "Reply must not grow, older clients could no longer negotiate the protocol version");
+
+inline uint32_t Reply::payloadSize(ReplyType type) {
+	switch (type) {
+	case ReplyType::IPC_ClientConnect:
+		return sizeof(Reply::msg); // see comment above struct Request
+	case ReplyType::IPC_Ping:
+		return sizeof(Reply_IPC_Ping);
+	case ReplyType::IPC_ClientStatus:
+		return sizeof(Reply_IPC_ClientStatus);
+	case ReplyType::VirtualDevices_GetDeviceCount:
+		return sizeof(Reply_VirtualDevices_GetDeviceCount);
+	case ReplyType::VirtualDevices_GetDeviceInfo:
+		return sizeof(Reply_VirtualDevices_GetDeviceInfo);
+	case ReplyType::VirtualDevices_GetDevicePose:
+		return sizeof(Reply_VirtualDevices_GetDevicePose);
+	case ReplyType::VirtualDevices_GetControllerState:
+		return sizeof(Reply_VirtualDevices_GetControllerState);
+	case ReplyType::VirtualDevices_AddDevice:
+		return sizeof(Reply_VirtualDevices_AddDevice);
+	case ReplyType::DeviceManipulation_GetDeviceInfo:
+		return sizeof(Reply_DeviceManipulation_GetDeviceInfo);
+	case ReplyType::DeviceManipulation_GetDeviceOffsets:
+		return sizeof(Reply_DeviceManipulation_GetDeviceOffsets);
+	case ReplyType::Debug_DumpTrace:
+		return sizeof(Reply_Debug_DumpTrace);
+	case ReplyType::Debug_GetHookStats:
+		return sizeof(Reply_Debug_GetHookStats);
+	case ReplyType::IPC_ClockSync:
+		return sizeof(Reply_IPC_ClockSync);
+	case ReplyType::Debug_GetLatencyStats:
+		return sizeof(Reply_Debug_GetLatencyStats);
+	default:
+		return 0;
+	}
+}
+
 
 } // end namespace ipc
 } // end namespace vrinputemulator
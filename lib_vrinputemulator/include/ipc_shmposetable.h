@@ -0,0 +1,214 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+
+namespace vrinputemulator {
+namespace ipc {
+
+
+/**
+ * Table of virtual device poses in shared memory, one slot per virtual device.
+ *
+ * Each slot is guarded by a seqlock: writers (clients) overwrite the slot, the reader (driver)
+ * only ever sees the newest complete pose and skips all intermediate ones. So when the driver
+ * falls behind, stale poses are dropped instead of piling up in a queue.
+ *
+ * The driver creates the table, clients open it. Writers may live in different processes,
+ * concurrent writes to the same slot are serialized by the sequence counter itself. The counter
+ * shares one atomic word with the client id of the last writer, so when a writer dies in the
+ * middle of a write the driver knows whose write it has to abandon (see abandonWrites()).
+ */
+class ShmPoseTable {
+public:
+	static const uint32_t slotCount = vr::k_unMaxTrackedDeviceCount;
+
+	// Creates and initializes the shared memory segment (driver side)
+	ShmPoseTable(boost::interprocess::create_only_t, const std::string& name) : _name(name), _owner(true) {
+		boost::interprocess::shared_memory_object::remove(name.c_str());
+		boost::interprocess::shared_memory_object shm(boost::interprocess::create_only, name.c_str(), boost::interprocess::read_write);
+		shm.truncate(sizeof(Table));
+		_region = boost::interprocess::mapped_region(shm, boost::interprocess::read_write);
+		_table = new (_region.get_address()) Table();
+		_table->magic = tableMagic;
+		_table->tableSlotCount = slotCount;
+		_table->poseSize = sizeof(vr::DriverPose_t);
+	}
+
+	// Opens an existing segment (client side)
+	ShmPoseTable(boost::interprocess::open_only_t, const std::string& name) : _name(name), _owner(false) {
+		boost::interprocess::shared_memory_object shm(boost::interprocess::open_only, name.c_str(), boost::interprocess::read_write);
+		_region = boost::interprocess::mapped_region(shm, boost::interprocess::read_write);
+		_table = (Table*)_region.get_address();
+		if (_region.get_size() < sizeof(Table) || _table->magic != tableMagic || _table->tableSlotCount != slotCount || _table->poseSize != sizeof(vr::DriverPose_t)) {
+			throw std::runtime_error("Incompatible shared memory pose table layout");
+		}
+	}
+
+	~ShmPoseTable() {
+		if (_owner) {
+			boost::interprocess::shared_memory_object::remove(_name.c_str());
+		}
+	}
+
+	ShmPoseTable(const ShmPoseTable&) = delete;
+	ShmPoseTable& operator=(const ShmPoseTable&) = delete;
+
+
+	/* Writer side */
+
+	// timestamp: ipc clock, like ipc::Request::timestamp (see ipc::clockNs())
+	// Returns false when the slot stays locked by another writer for too long, the caller then has to
+	// send the pose another way.
+	bool writePose(uint32_t index, const vr::DriverPose_t& pose, int64_t timestamp, uint32_t clientId) {
+		if (index >= slotCount) {
+			return false;
+		}
+		auto& slot = _table->slots[index];
+		uint64_t state = slot.state.load(std::memory_order_relaxed);
+		std::chrono::steady_clock::time_point deadline;
+		unsigned attempts = 0;
+		// An odd sequence number means that somebody else is currently writing
+		while ((state & 1) || !slot.state.compare_exchange_weak(state, _makeState(_sequence(state) + 1, clientId), std::memory_order_relaxed)) {
+			if (state & 1) {
+				if (attempts++ == 0) {
+					deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(2); // a write takes well below a microsecond
+				} else if (std::chrono::steady_clock::now() >= deadline) {
+					return false;
+				}
+				std::this_thread::yield();
+				state = slot.state.load(std::memory_order_relaxed);
+			}
+		}
+		std::atomic_thread_fence(std::memory_order_release);
+		std::memcpy(&slot.pose, &pose, sizeof(vr::DriverPose_t));
+		slot.timestamp = timestamp;
+		slot.state.store(_makeState(_sequence(state) + 2, clientId), std::memory_order_release);
+		_table->dirty.store(1, std::memory_order_release);
+		return true;
+	}
+
+	// Call after writePose(). Returns true when the reader announced that it is going to sleep
+	// and therefore needs to be woken up.
+	bool needsWakeup() {
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (_table->readerWaiting.load(std::memory_order_relaxed)) {
+			return _table->readerWaiting.exchange(0) != 0;
+		}
+		return false;
+	}
+
+
+	/* Reader side */
+
+	// Returns true when at least one slot has been written since the last call
+	bool fetchDirty() {
+		if (!_table->dirty.load(std::memory_order_relaxed)) {
+			return false;
+		}
+		return _table->dirty.exchange(0, std::memory_order_acquire) != 0;
+	}
+
+	// Marks the table as written to, so the next fetchDirty() returns true
+	void markDirty() {
+		_table->dirty.store(1, std::memory_order_release);
+	}
+
+	// Returns true when the slot contains a pose newer than lastSequence, and updates lastSequence.
+	// Never waits for writers: when a write is in progress the slot is skipped, the writer marks
+	// the table dirty again when it is done.
+	bool readPose(uint32_t index, uint32_t& lastSequence, vr::DriverPose_t& pose, int64_t& timestamp, uint32_t& clientId) {
+		if (index >= slotCount) {
+			return false;
+		}
+		auto& slot = _table->slots[index];
+		uint64_t state1 = slot.state.load(std::memory_order_acquire);
+		if (_sequence(state1) == lastSequence || (state1 & 1)) {
+			return false;
+		}
+		std::memcpy(&pose, &slot.pose, sizeof(vr::DriverPose_t));
+		timestamp = slot.timestamp;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.state.load(std::memory_order_relaxed) != state1) {
+			return false;
+		}
+		clientId = _writer(state1);
+		lastSequence = _sequence(state1);
+		return true;
+	}
+
+	// Unlocks the slots a (dead) writer left in the middle of a write. Their poses may be torn, so lastSequences
+	// (indexed like the slots, see readPose()) are advanced past them. Returns the number of unlocked slots.
+	uint32_t abandonWrites(uint32_t clientId, uint32_t* lastSequences) {
+		uint32_t abandoned = 0;
+		for (uint32_t i = 0; i < slotCount; ++i) {
+			auto& slot = _table->slots[i];
+			uint64_t state = slot.state.load(std::memory_order_acquire);
+			if ((state & 1) && _writer(state) == clientId) {
+				auto next = _makeState(_sequence(state) + 1, clientId);
+				if (slot.state.compare_exchange_strong(state, next, std::memory_order_release)) {
+					lastSequences[i] = _sequence(next);
+					abandoned++;
+				}
+			}
+		}
+		return abandoned;
+	}
+
+	// Announces that the reader is about to sleep. Afterwards the reader needs to check the table one last time.
+	void prepareWait() {
+		_table->readerWaiting.store(1, std::memory_order_seq_cst);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+	}
+
+	void cancelWait() {
+		_table->readerWaiting.store(0, std::memory_order_relaxed);
+	}
+
+private:
+	static const uint32_t tableMagic = 0x50544233; // "PTB3"
+
+	struct Slot {
+		alignas(64) std::atomic<uint64_t> state = { 0 }; // sequence number (odd while a write is in progress) | client id of the writer << 32
+		int64_t timestamp = 0;
+		vr::DriverPose_t pose;
+	};
+
+	static uint64_t _makeState(uint32_t sequence, uint32_t clientId) {
+		return ((uint64_t)clientId << 32) | sequence;
+	}
+
+	static uint32_t _sequence(uint64_t state) {
+		return (uint32_t)state;
+	}
+
+	static uint32_t _writer(uint64_t state) {
+		return (uint32_t)(state >> 32);
+	}
+
+	struct Table {
+		uint32_t magic = 0;
+		uint32_t tableSlotCount = 0;
+		uint32_t poseSize = 0;
+		alignas(64) std::atomic<uint32_t> dirty = { 0 };
+		alignas(64) std::atomic<uint32_t> readerWaiting = { 0 };
+		Slot slots[ShmPoseTable::slotCount];
+	};
+
+	std::string _name;
+	bool _owner;
+	boost::interprocess::mapped_region _region;
+	Table* _table = nullptr;
+};
+
+
+} // end namespace ipc
+} // end namespace vrinputemulator
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+
+namespace vrinputemulator {
+namespace ipc {
+
+
+/**
+ * Single-producer/single-consumer ring buffer in shared memory.
+ *
+ * Used as a per-client data-plane transport: the client (producer) pushes fire-and-forget
+ * requests, the driver (consumer) pops them. No mutex or condition variable is involved,
+ * head and tail are plain atomics that are each written by exactly one side.
+ *
+ * Messages are stored as variable-length records ([size][padding][message], 8-byte aligned),
+ * so small messages only take up as much space as they need.
+ *
+ * The ring itself never blocks. To let the consumer sleep when all rings are empty it
+ * provides an eventcount-style handshake (prepareWait/needsWakeup) that is meant to be
+ * combined with a named semaphore ("doorbell").
+ *
+ * The consumer does not trust the shared memory: capacity, message size limit and its own tail
+ * are kept in the process, and every record is bounds checked before it is read. A record that
+ * fails the check marks the ring as corrupted, after which pop() returns nothing anymore.
+ */
+class ShmRing {
+public:
+	static const uint32_t defaultCapacity = 64 * 1024;
+
+	// Creates and initializes the shared memory segment (producer side)
+	ShmRing(boost::interprocess::create_only_t, const std::string& name, uint32_t capacity, uint32_t maxMessageSize)
+			: _name(name), _owner(true) {
+		if (capacity == 0 || (capacity & (capacity - 1)) != 0 || _recordSize(maxMessageSize) > capacity / 2) {
+			throw std::invalid_argument("Capacity must be a power of two and large enough for two messages");
+		}
+		boost::interprocess::shared_memory_object::remove(name.c_str());
+		boost::interprocess::shared_memory_object shm(boost::interprocess::create_only, name.c_str(), boost::interprocess::read_write);
+		shm.truncate(sizeof(Header) + capacity);
+		_region = boost::interprocess::mapped_region(shm, boost::interprocess::read_write);
+		_header = new (_region.get_address()) Header();
+		_header->magic = headerMagic;
+		_header->capacity = capacity;
+		_header->maxMessageSize = maxMessageSize;
+		_data = (uint8_t*)_region.get_address() + sizeof(Header);
+		_capacity = capacity;
+		_maxMessageSize = maxMessageSize;
+	}
+
+	// Opens an existing segment (consumer side)
+	ShmRing(boost::interprocess::open_only_t, const std::string& name, uint32_t maxMessageSize) : _name(name), _owner(false) {
+		boost::interprocess::shared_memory_object shm(boost::interprocess::open_only, name.c_str(), boost::interprocess::read_write);
+		_region = boost::interprocess::mapped_region(shm, boost::interprocess::read_write);
+		if (_region.get_size() < sizeof(Header)) {
+			throw std::runtime_error("Incompatible shared memory ring layout");
+		}
+		_header = (Header*)_region.get_address();
+		// Read every field only once, the other side may change them at any time
+		uint32_t magic = _header->magic;
+		_capacity = _header->capacity;
+		_maxMessageSize = _header->maxMessageSize;
+		_tail = _header->tail.load(std::memory_order_relaxed);
+		if (magic != headerMagic || _maxMessageSize > maxMessageSize || _capacity == 0 || (_capacity & (_capacity - 1)) != 0
+				|| _recordSize(_maxMessageSize) > _capacity / 2 || _region.get_size() < sizeof(Header) + _capacity || (_tail & 7) != 0) {
+			throw std::runtime_error("Incompatible shared memory ring layout");
+		}
+		_data = (uint8_t*)_region.get_address() + sizeof(Header);
+		_cachedHead = _tail;
+	}
+
+	~ShmRing() {
+		if (_owner) {
+			boost::interprocess::shared_memory_object::remove(_name.c_str());
+		}
+	}
+
+	ShmRing(const ShmRing&) = delete;
+	ShmRing& operator=(const ShmRing&) = delete;
+
+	const std::string& name() const { return _name; }
+	uint32_t capacity() const { return _capacity; }
+	uint32_t maxMessageSize() const { return _maxMessageSize; }
+
+
+	/* Producer side */
+
+	// Returns false when the ring is full or the message is too large
+	bool push(const void* data, uint32_t size) {
+		if (size > _maxMessageSize) {
+			return false;
+		}
+		uint32_t capacity = _capacity;
+		uint32_t head = _header->head.load(std::memory_order_relaxed);
+		uint32_t offset = head & (capacity - 1);
+		uint32_t recordSize = _recordSize(size);
+		// Records never wrap around, the remaining space at the end is skipped instead
+		uint32_t skip = capacity - offset < recordSize ? capacity - offset : 0;
+		if (capacity - (head - _cachedTail) < skip + recordSize) {
+			_cachedTail = _header->tail.load(std::memory_order_acquire);
+			if (capacity - (head - _cachedTail) < skip + recordSize) {
+				return false;
+			}
+		}
+		if (skip) {
+			*(uint32_t*)(_data + offset) = wrapMarker;
+			head += skip;
+			offset = 0;
+		}
+		*(uint32_t*)(_data + offset) = size;
+		std::memcpy(_data + offset + recordHeaderSize, data, size);
+		_header->head.store(head + recordSize, std::memory_order_release);
+		return true;
+	}
+
+	// Call after push(). Returns true when the consumer announced that it is going to sleep
+	// and therefore needs to be woken up.
+	bool needsWakeup() {
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (_header->consumerWaiting.load(std::memory_order_relaxed)) {
+			return _header->consumerWaiting.exchange(0) != 0;
+		}
+		return false;
+	}
+
+
+	/* Consumer side */
+
+	// Returns false when the ring is empty or corrupted. Messages larger than bufferSize are skipped (size is set to 0).
+	bool pop(void* buffer, uint32_t bufferSize, uint32_t& size) {
+		if (_corrupted) {
+			return false;
+		}
+		uint32_t capacity = _capacity;
+		uint32_t tail = _tail;
+		if (tail == _cachedHead) {
+			_cachedHead = _header->head.load(std::memory_order_acquire);
+			if (tail == _cachedHead) {
+				return false;
+			}
+			if (_cachedHead - tail > capacity || (_cachedHead & 7) != 0) {
+				return _markCorrupted();
+			}
+		}
+		uint32_t offset = tail & (capacity - 1);
+		size = *(volatile uint32_t*)(_data + offset);
+		if (size == wrapMarker) {
+			if (offset == 0 || _cachedHead - tail < capacity - offset + recordHeaderSize) {
+				return _markCorrupted();
+			}
+			tail += capacity - offset;
+			offset = 0;
+			size = *(volatile uint32_t*)(_data + offset);
+		}
+		if (size > _maxMessageSize || offset + recordHeaderSize + size > capacity || _cachedHead - tail < _recordSize(size)) {
+			return _markCorrupted();
+		}
+		if (size <= bufferSize) {
+			std::memcpy(buffer, _data + offset + recordHeaderSize, size);
+		}
+		_tail = tail + _recordSize(size);
+		_header->tail.store(_tail, std::memory_order_release);
+		if (size > bufferSize) {
+			size = 0;
+		}
+		return true;
+	}
+
+	// Consumer side: a record failed the bounds check, the ring should be closed
+	bool corrupted() const {
+		return _corrupted;
+	}
+
+	bool empty() const {
+		return _header->tail.load(std::memory_order_relaxed) == _header->head.load(std::memory_order_acquire);
+	}
+
+	// Announces that the consumer is about to sleep. Returns true when the ring is still empty
+	// afterwards, i.e. when it is safe to sleep as far as this ring is concerned.
+	bool prepareWait() {
+		_header->consumerWaiting.store(1, std::memory_order_seq_cst);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		return _corrupted || _tail == _header->head.load(std::memory_order_acquire);
+	}
+
+	void cancelWait() {
+		_header->consumerWaiting.store(0, std::memory_order_relaxed);
+	}
+
+private:
+	static const uint32_t headerMagic = 0x52475232; // "RGR2"
+	static const uint32_t wrapMarker = 0xFFFFFFFF;
+	static const uint32_t recordHeaderSize = 8;
+
+	struct Header {
+		uint32_t magic = 0;
+		uint32_t capacity = 0; // in bytes
+		uint32_t maxMessageSize = 0;
+		// head and tail are free-running byte counters, each on its own cache line
+		alignas(64) std::atomic<uint32_t> head = { 0 }; // written by the producer
+		alignas(64) std::atomic<uint32_t> tail = { 0 }; // written by the consumer
+		alignas(64) std::atomic<uint32_t> consumerWaiting = { 0 };
+	};
+
+	static uint32_t _recordSize(uint32_t messageSize) {
+		return (recordHeaderSize + messageSize + 7) & ~7u;
+	}
+
+	bool _markCorrupted() {
+		_corrupted = true;
+		return false;
+	}
+
+	std::string _name;
+	bool _owner;
+	boost::interprocess::mapped_region _region;
+	Header* _header = nullptr;
+	uint8_t* _data = nullptr;
+	uint32_t _capacity = 0; // copied from the header when the ring is created or opened
+	uint32_t _maxMessageSize = 0;
+	uint32_t _cachedTail = 0; // producer-local copy of tail
+	uint32_t _cachedHead = 0; // consumer-local copy of head
+	uint32_t _tail = 0; // consumer side, the one in the header is only written
+	bool _corrupted = false; // consumer side
+};
+
+
+} // end namespace ipc
+} // end namespace vrinputemulator
@@ -3,7 +3,7 @@
 #include <cmath>
 
 
-inline vr::HmdQuaternion_t operator+(const vr::HmdQuaternion_t& lhs, const vr::HmdQuaternion_t& rhs) {
+inline constexpr vr::HmdQuaternion_t operator+(const vr::HmdQuaternion_t& lhs, const vr::HmdQuaternion_t& rhs) {
 	return {
 		lhs.w + rhs.w,
 		lhs.x + rhs.x,
@@ -13,7 +13,7 @@ inline vr::HmdQuaternion_t operator+(const vr::HmdQuaternion_t& lhs, const vr::H
 }
 
 
-inline vr::HmdQuaternion_t operator-(const vr::HmdQuaternion_t& lhs, const vr::HmdQuaternion_t& rhs) {
+inline constexpr vr::HmdQuaternion_t operator-(const vr::HmdQuaternion_t& lhs, const vr::HmdQuaternion_t& rhs) {
 	return{
 		lhs.w - rhs.w,
 		lhs.x - rhs.x,
@@ -23,7 +23,7 @@ inline vr::HmdQuaternion_t operator-(const vr::HmdQuaternion_t& lhs, const vr::H
 }
 
 
-inline vr::HmdQuaternion_t operator*(const vr::HmdQuaternion_t& lhs, const vr::HmdQuaternion_t& rhs) {
+inline constexpr vr::HmdQuaternion_t operator*(const vr::HmdQuaternion_t& lhs, const vr::HmdQuaternion_t& rhs) {
 	return {
 		(lhs.w * rhs.w) - (lhs.x * rhs.x) - (lhs.y * rhs.y) - (lhs.z * rhs.z),
 		(lhs.w * rhs.x) + (lhs.x * rhs.w) + (lhs.y * rhs.z) - (lhs.z * rhs.y),
@@ -33,7 +33,7 @@ inline vr::HmdQuaternion_t operator*(const vr::HmdQuaternion_t& lhs, const vr::H
 }
 
 
-inline vr::HmdVector3d_t operator+(const vr::HmdVector3d_t& lhs, const vr::HmdVector3d_t& rhs) {
+inline constexpr vr::HmdVector3d_t operator+(const vr::HmdVector3d_t& lhs, const vr::HmdVector3d_t& rhs) {
 	return {
 		lhs.v[0] + rhs.v[0],
 		lhs.v[1] + rhs.v[1],
@@ -41,7 +41,7 @@ inline vr::HmdVector3d_t operator+(const vr::HmdVector3d_t& lhs, const vr::HmdVe
 	};
 }
 
-inline vr::HmdVector3d_t operator+(const vr::HmdVector3d_t& lhs, const double(&rhs)[3]) {
+inline constexpr vr::HmdVector3d_t operator+(const vr::HmdVector3d_t& lhs, const double(&rhs)[3]) {
 	return{
 		lhs.v[0] + rhs[0],
 		lhs.v[1] + rhs[1],
@@ -49,7 +49,7 @@ inline vr::HmdVector3d_t operator+(const vr::HmdVector3d_t& lhs, const double(&r
 	};
 }
 
-inline vr::HmdVector3d_t operator-(const vr::HmdVector3d_t& lhs, const vr::HmdVector3d_t& rhs) {
+inline constexpr vr::HmdVector3d_t operator-(const vr::HmdVector3d_t& lhs, const vr::HmdVector3d_t& rhs) {
 	return{
 		lhs.v[0] - rhs.v[0],
 		lhs.v[1] - rhs.v[1],
@@ -57,7 +57,7 @@ inline vr::HmdVector3d_t operator-(const vr::HmdVector3d_t& lhs, const vr::HmdVe
 	};
 }
 
-inline vr::HmdVector3d_t operator-(const vr::HmdVector3d_t& lhs, const double (&rhs)[3]) {
+inline constexpr vr::HmdVector3d_t operator-(const vr::HmdVector3d_t& lhs, const double (&rhs)[3]) {
 	return{
 		lhs.v[0] - rhs[0],
 		lhs.v[1] - rhs[1],
@@ -68,6 +68,14 @@ inline vr::HmdVector3d_t operator-(const vr::HmdVector3d_t& lhs, const double (&
 
 namespace vrmath {
 
+	inline constexpr vr::HmdQuaternion_t quaternionIdentity() {
+		return { 1.0, 0.0, 0.0, 0.0 };
+	}
+
+	inline constexpr vr::HmdVector3d_t vector3d(double x, double y, double z) {
+		return { x, y, z };
+	}
+
 	inline vr::HmdQuaternion_t quaternionFromRotationAxis(double rot, double ux, double uy, double uz) {
 		auto ha = rot / 2;
 		return{
@@ -149,7 +157,7 @@ namespace vrmath {
 		return q;
 	}
 
-	inline vr::HmdQuaternion_t quaternionConjugate(const vr::HmdQuaternion_t& quat) {
+	inline constexpr vr::HmdQuaternion_t quaternionConjugate(const vr::HmdQuaternion_t& quat) {
 		return {
 			quat.w,
 			-quat.x,
@@ -158,52 +166,92 @@ namespace vrmath {
 		};
 	}
 
-	inline vr::HmdVector3d_t quaternionRotateVector(const vr::HmdQuaternion_t& quat, const vr::HmdVector3d_t& vector, bool reverse = false) {
-		if (reverse) {
-			vr::HmdQuaternion_t pin = { 0.0, vector.v[0], vector.v[1] , vector.v[2] };
-			auto pout = vrmath::quaternionConjugate(quat) * pin * quat;
-			return {pout.x, pout.y, pout.z};
+	// Spherical linear interpolation between two unit quaternions along the shorter arc (t = 0 .. a, t = 1 .. b).
+	// Falls back to a normalized linear interpolation when both are nearly equal.
+	inline vr::HmdQuaternion_t quaternionSlerp(const vr::HmdQuaternion_t& a, const vr::HmdQuaternion_t& b, double t) {
+		double cosTheta = a.w * b.w + a.x * b.x + a.y * b.y + a.z * b.z;
+		double sign = 1.0;
+		if (cosTheta < 0.0) {
+			cosTheta = -cosTheta;
+			sign = -1.0;
+		}
+		double wa, wb;
+		if (cosTheta > 0.9995) {
+			wa = 1.0 - t;
+			wb = t;
 		} else {
-			vr::HmdQuaternion_t pin = { 0.0, vector.v[0], vector.v[1] , vector.v[2] };
-			auto pout = quat * pin * vrmath::quaternionConjugate(quat);
-			return { pout.x, pout.y, pout.z };
+			double theta = std::acos(cosTheta);
+			double sinTheta = std::sin(theta);
+			wa = std::sin((1.0 - t) * theta) / sinTheta;
+			wb = std::sin(t * theta) / sinTheta;
 		}
+		wb *= sign;
+		vr::HmdQuaternion_t q = {
+			wa * a.w + wb * b.w,
+			wa * a.x + wb * b.x,
+			wa * a.y + wb * b.y,
+			wa * a.z + wb * b.z
+		};
+		double n = std::sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+		return { q.w / n, q.x / n, q.y / n, q.z / n };
 	}
 
-	inline vr::HmdVector3d_t quaternionRotateVector(const vr::HmdQuaternion_t& quat, const vr::HmdQuaternion_t& quatInv, const vr::HmdVector3d_t& vector, bool reverse = false) {
-		if (reverse) {
-			vr::HmdQuaternion_t pin = { 0.0, vector.v[0], vector.v[1] , vector.v[2] };
-			auto pout = quatInv * pin * quat;
-			return{ pout.x, pout.y, pout.z };
-		} else {
-			vr::HmdQuaternion_t pin = { 0.0, vector.v[0], vector.v[1] , vector.v[2] };
-			auto pout = quat * pin * quatInv;
-			return{ pout.x, pout.y, pout.z };
-		}
+	// quat * (0, x, y, z) * conjugate(quat) (or conjugate(quat) * (0, x, y, z) * quat when reversed), expanded into
+	// (w² - u·u) v + 2 (u·v) u + 2w (u × v). Like the quaternion products it does not need a normalized quat.
+	inline vr::HmdVector3d_t quaternionRotateVector(const vr::HmdQuaternion_t& quat, double x, double y, double z, bool reverse = false) {
+		double ux = reverse ? -quat.x : quat.x;
+		double uy = reverse ? -quat.y : quat.y;
+		double uz = reverse ? -quat.z : quat.z;
+		double a = quat.w * quat.w - (ux * ux + uy * uy + uz * uz);
+		double b = 2.0 * (ux * x + uy * y + uz * z);
+		double c = 2.0 * quat.w;
+		return {
+			a * x + b * ux + c * (uy * z - uz * y),
+			a * y + b * uy + c * (uz * x - ux * z),
+			a * z + b * uz + c * (ux * y - uy * x)
+		};
+	}
+
+	inline vr::HmdVector3d_t quaternionRotateVector(const vr::HmdQuaternion_t& quat, const vr::HmdVector3d_t& vector, bool reverse = false) {
+		return quaternionRotateVector(quat, vector.v[0], vector.v[1], vector.v[2], reverse);
 	}
 
 	inline vr::HmdVector3d_t quaternionRotateVector(const vr::HmdQuaternion_t& quat, const double (&vector)[3], bool reverse = false) {
-		if (reverse) {
-			vr::HmdQuaternion_t pin = { 0.0, vector[0], vector[1] , vector[2] };
-			auto pout = vrmath::quaternionConjugate(quat) * pin * quat;
-			return{ pout.x, pout.y, pout.z };
-		} else {
-			vr::HmdQuaternion_t pin = { 0.0, vector[0], vector[1] , vector[2] };
-			auto pout = quat * pin * vrmath::quaternionConjugate(quat);
-			return{ pout.x, pout.y, pout.z };
-		}
+		return quaternionRotateVector(quat, vector[0], vector[1], vector[2], reverse);
 	}
 
-	inline vr::HmdVector3d_t quaternionRotateVector(const vr::HmdQuaternion_t& quat, const vr::HmdQuaternion_t& quatInv, const double(&vector)[3], bool reverse = false) {
-		if (reverse) {
-			vr::HmdQuaternion_t pin = { 0.0, vector[0], vector[1] , vector[2] };
-			auto pout = quatInv * pin * quat;
-			return{ pout.x, pout.y, pout.z };
-		} else {
-			vr::HmdQuaternion_t pin = { 0.0, vector[0], vector[1] , vector[2] };
-			auto pout = quat * pin * quatInv;
-			return{ pout.x, pout.y, pout.z };
-		}
+
+	// Rotation of a quaternion as 3x3 matrix (m[row][column]), for rotating several vectors by the same quaternion
+	struct RotationMatrix33 {
+		double m[3][3];
+	};
+
+	inline RotationMatrix33 rotationMatrixFromQuaternion(const vr::HmdQuaternion_t& quat, bool reverse = false) {
+		double ux = reverse ? -quat.x : quat.x;
+		double uy = reverse ? -quat.y : quat.y;
+		double uz = reverse ? -quat.z : quat.z;
+		double a = quat.w * quat.w - (ux * ux + uy * uy + uz * uz);
+		double wx = 2.0 * quat.w * ux, wy = 2.0 * quat.w * uy, wz = 2.0 * quat.w * uz;
+		double xx = 2.0 * ux * ux, yy = 2.0 * uy * uy, zz = 2.0 * uz * uz;
+		double xy = 2.0 * ux * uy, xz = 2.0 * ux * uz, yz = 2.0 * uy * uz;
+		return {{
+			{ a + xx, xy - wz, xz + wy },
+			{ xy + wz, a + yy, yz - wx },
+			{ xz - wy, yz + wx, a + zz }
+		}};
+	}
+
+	inline void rotateVector(const RotationMatrix33& mat, const double (&in)[3], double (&out)[3]) {
+		double x = in[0], y = in[1], z = in[2];
+		out[0] = mat.m[0][0] * x + mat.m[0][1] * y + mat.m[0][2] * z;
+		out[1] = mat.m[1][0] * x + mat.m[1][1] * y + mat.m[1][2] * z;
+		out[2] = mat.m[2][0] * x + mat.m[2][1] * y + mat.m[2][2] * z;
+	}
+
+	inline vr::HmdVector3d_t rotateVector(const RotationMatrix33& mat, const vr::HmdVector3d_t& vector) {
+		vr::HmdVector3d_t result;
+		rotateVector(mat, vector.v, result.v);
+		return result;
 	}
 
 	inline vr::HmdMatrix34_t matMul33(const vr::HmdMatrix34_t& a, const vr::HmdMatrix34_t& b) {
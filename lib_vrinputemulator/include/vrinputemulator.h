@@ -3,14 +3,20 @@
 #include <stdint.h>
 #include <string>
 #include <future>
+#include <functional>
 #include <mutex>
+#include <condition_variable>
 #include <thread>
 #include <map>
+#include <atomic>
+#include <chrono>
+#include <vector>
 #include <memory>
 #include <random>
 #include <string>
 #include <openvr.h>
 #include <boost/interprocess/ipc/message_queue.hpp>
+#include <boost/interprocess/sync/named_semaphore.hpp>
 
 
 namespace vr {
@@ -83,6 +89,8 @@ namespace vr {
 
 
 #include <ipc_protocol.h>
+#include <ipc_shmring.h>
+#include <ipc_shmposetable.h>
 
 
 namespace vrinputemulator {
@@ -120,6 +128,13 @@ class vrinputemulator_toomanydevices : public vrinputemulator_exception {
 };
 
 
+struct TraceDumpInfo {
+	uint64_t recordCount;
+	uint32_t threadCount;
+	std::string path; // where the driver wrote the trace
+};
+
+
 struct VirtualDeviceInfo {
 	uint32_t virtualDeviceId;
 	uint32_t openvrDeviceId;
@@ -133,12 +148,60 @@ public:
 	VRInputEmulator(const std::string& driverQueue = "driver_vrinputemulator.server_queue", const std::string& clientQueue = "driver_vrinputemulator.client_queue.");
 	~VRInputEmulator();
 	
-	void connect();
+	// When enableDataRing is true, fire-and-forget requests (pings, pose/button/axis events, non-modal pose and
+	// controller state updates) are sent over a dedicated shared memory ring instead of the driver's message queue.
+	// Non-modal virtual device poses go into the driver's shared pose table instead (latest value wins).
+	// The driver never blocks on a full reply queue, replyOverflowPolicy decides what it does instead.
+	// A blocking call whose reply gets dropped fails with a timeout (see setReplyTimeout()), so DropOldest is only
+	// meant for clients that do not wait for replies.
+	// The driver serves the fire-and-forget requests of all clients round-robin, dataLaneWeight (1 - 16) is the
+	// share this client gets relative to the others when the driver is busy.
+	void connect(bool enableDataRing = false, ReplyOverflowPolicy replyOverflowPolicy = ReplyOverflowPolicy::DropNewest, uint32_t dataLaneWeight = 1);
 	bool isConnected() const;
+	bool isDataRingEnabled() const;
 	void disconnect();
 
+	// How long blocking calls wait for the driver's reply before they throw (default 5000 ms). Asynchronous
+	// requests still unanswered after that time are failed when their slots are needed for new requests.
+	void setReplyTimeout(uint32_t milliseconds);
+	uint32_t replyTimeout() const;
+
 	void ping(bool modal = true, bool enableReply = false);
 
+	// Offset of the driver's clock to this process' steady clock in nanoseconds, measured at connect.
+	// Requests are stamped in the driver's clock domain (see ipc::clockNs()).
+	int64_t clockOffsetNs() const;
+
+	// Reply queue statistics of this client as seen by the driver
+	ClientStatus getClientStatus();
+
+	// Writes the driver's hook trace (see vrinputemulator_trace.h) into a file. fileName must be a bare file name,
+	// the driver puts the file into its trace directory next to its log.
+	TraceDumpInfo dumpTrace(const std::string& fileName);
+
+	// Call counts and latency percentiles of the driver's hooks per device and device mode, since the driver
+	// was started. Fetched in several requests, so entries are not sampled at exactly the same time.
+	trace::HookStats getHookStats();
+
+	// While enabled, the driver records the stage latencies (see trace::LatencyStage) of all requests of this client,
+	// and requests are stamped when they are handed to the transport instead of when they are created.
+	void setLatencyTracing(bool enable);
+
+	// Stage latencies of all traced clients per request type, since the driver was started. Fetched in several
+	// requests like getHookStats().
+	trace::LatencyStats getLatencyStats();
+
+	// Id the driver assigned to this connection (0 when not connected)
+	uint32_t clientId() const;
+
+	// Between beginBatch() and commitBatch() the fire-and-forget calls of the calling thread (openvr* events,
+	// non-modal virtual device poses and controller states) are collected and sent in as few messages as possible
+	// on commit. The driver applies a batch as a whole, so its operations always end up in the same frame.
+	// Consecutive button/axis events are merged into one request. Modal calls are not batched.
+	void beginBatch();
+	void commitBatch(bool modal = false);
+	void discardBatch();
+
 	void openvrUpdatePose(uint32_t deviceId, const vr::DriverPose_t& pose);
 	void openvrButtonEvent(ButtonEventType eventType, uint32_t deviceId, vr::EVRButtonId buttonId, double timeOffset = 0.0);
 	void openvrAxisEvent(uint32_t deviceId, uint32_t axisId, const vr::VRControllerAxis_t& axisState);
@@ -184,11 +247,59 @@ public:
 	void setDeviceMotionCompensationMode(uint32_t deviceId, uint32_t velAccMode = 0, bool modal = true);
 
 	void setMotionVelAccCompensationMode(uint32_t velAccMode, bool modal = true);
+	// Noise parameters of the Kalman filter of vel/acc mode 4 (both > 0). processNoise is the spectral density of the
+	// jerk (m²/s⁵, rad²/s⁵), observationNoise the variance of the tracked positions (m²) and orientations (rad²).
+	void setMotionCompensationKalmanFilterNoise(double processNoise, double observationNoise, bool modal = true);
 
 	void triggerHapticPulse(uint32_t deviceId, uint32_t axisId, uint16_t durationMicroseconds, bool directMode, bool modal = true);
 
+	// Asynchronous variants of the modal calls above. They return as soon as the request is sent, so several
+	// requests can be in flight at once. The future delivers the result or throws the same exception as the
+	// blocking call. Pending futures fail with vrinputemulator_connectionerror on disconnect().
+	std::future<ClientStatus> getClientStatusAsync();
+	std::future<TraceDumpInfo> dumpTraceAsync(const std::string& fileName);
+	std::future<uint32_t> getVirtualDeviceCountAsync();
+	std::future<VirtualDeviceInfo> getVirtualDeviceInfoAsync(uint32_t virtualDeviceId);
+	std::future<vr::DriverPose_t> getVirtualDevicePoseAsync(uint32_t virtualDeviceId);
+	std::future<vr::VRControllerState_t> getVirtualControllerStateAsync(uint32_t virtualDeviceId);
+	std::future<uint32_t> addVirtualDeviceAsync(VirtualDeviceType deviceType, const std::string& deviceSerial, bool softfail = true);
+	std::future<void> publishVirtualDeviceAsync(uint32_t virtualDeviceId);
+	std::future<void> setVirtualDevicePropertyAsync(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty, int32_t value);
+	std::future<void> setVirtualDevicePropertyAsync(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty, uint64_t value);
+	std::future<void> setVirtualDevicePropertyAsync(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty, float value);
+	std::future<void> setVirtualDevicePropertyAsync(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty, bool value);
+	std::future<void> setVirtualDevicePropertyAsync(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty, const std::string& value);
+	std::future<void> setVirtualDevicePropertyAsync(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty, const char* value);
+	std::future<void> setVirtualDevicePropertyAsync(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty, const vr::HmdMatrix34_t& value);
+	std::future<void> removeVirtualDevicePropertyAsync(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty);
+	std::future<void> setVirtualDevicePoseAsync(uint32_t virtualDeviceId, const vr::DriverPose_t& pose);
+	std::future<void> setVirtualControllerStateAsync(uint32_t virtualDeviceId, const vr::VRControllerState_t& state);
+
+	std::future<void> enableDeviceButtonMappingAsync(uint32_t deviceId, bool enable);
+	std::future<void> addDeviceButtonMappingAsync(uint32_t deviceId, vr::EVRButtonId button, vr::EVRButtonId mapped);
+	std::future<void> removeDeviceButtonMappingAsync(uint32_t deviceId, vr::EVRButtonId button);
+	std::future<void> removeAllDeviceButtonMappingsAsync(uint32_t deviceId);
+
+	std::future<DeviceOffsets> getDeviceOffsetsAsync(uint32_t deviceId);
+	std::future<void> enableDeviceOffsetsAsync(uint32_t deviceId, bool enable);
+	std::future<void> setWorldFromDriverRotationOffsetAsync(uint32_t deviceId, const vr::HmdQuaternion_t& value);
+	std::future<void> setWorldFromDriverTranslationOffsetAsync(uint32_t deviceId, const vr::HmdVector3d_t& value);
+	std::future<void> setDriverFromHeadRotationOffsetAsync(uint32_t deviceId, const vr::HmdQuaternion_t& value);
+	std::future<void> setDriverFromHeadTranslationOffsetAsync(uint32_t deviceId, const vr::HmdVector3d_t& value);
+	std::future<void> setDriverRotationOffsetAsync(uint32_t deviceId, const vr::HmdQuaternion_t& value);
+	std::future<void> setDriverTranslationOffsetAsync(uint32_t deviceId, const vr::HmdVector3d_t& value);
+
+	std::future<DeviceInfo> getDeviceInfoAsync(uint32_t deviceId);
+	std::future<void> setDeviceNormalModeAsync(uint32_t deviceId);
+	std::future<void> setDeviceFakeDisconnectedModeAsync(uint32_t deviceId);
+	std::future<void> setDeviceRedictModeAsync(uint32_t deviceId, uint32_t target);
+	std::future<void> setDeviceSwapModeAsync(uint32_t deviceId, uint32_t target);
+	std::future<void> setDeviceMotionCompensationModeAsync(uint32_t deviceId, uint32_t velAccMode = 0);
+	std::future<void> setMotionVelAccCompensationModeAsync(uint32_t velAccMode);
+	std::future<void> setMotionCompensationKalmanFilterNoiseAsync(double processNoise, double observationNoise);
+	std::future<void> triggerHapticPulseAsync(uint32_t deviceId, uint32_t axisId, uint16_t durationMicroseconds, bool directMode);
+
 private:
-	std::recursive_mutex _mutex;
 	uint32_t m_clientId = 0;
 
 	bool _ipcThreadRunning = false;
@@ -198,20 +309,65 @@ private:
 
 	std::random_device _ipcRandomDevice;
 	std::uniform_int_distribution<uint32_t> _ipcRandomDist;
-	struct _ipcPromiseMapEntry {
-		_ipcPromiseMapEntry() : isValid(false) {}
-		_ipcPromiseMapEntry(std::promise<ipc::Reply>&& _promise, bool isValid = true) 
-				: promise(std::move(_promise)), isValid(isValid) {}
-		bool isValid;
-		std::promise<ipc::Reply> promise;
+
+	// Requests that wait for a reply, indexed by messageId % _ipcPendingSlotCount (see _claimPendingSlot())
+	static const uint32_t _ipcPendingSlotCount = 128;
+	struct _ipcPendingSlot {
+		enum State : uint32_t { Free = 0, Claimed, Pending, Completing, Completed, Failed };
+		std::atomic<uint32_t> state = { Free };
+		std::atomic<uint32_t> messageId = { 0 };
+		std::function<void(const ipc::Reply*, bool)> completion; // set for asynchronous requests, called with nullptr when the connection is closed or the request timed out (second argument)
+		std::atomic<bool> asynchronous = { false };
+		std::atomic<int64_t> claimTime = { 0 }; // steady_clock ticks, used to give up asynchronous requests (see _reclaimExpiredSlots())
+		ipc::Reply reply; // set for blocking requests
+		std::mutex waitMutex;
+		std::condition_variable waitCondition;
 	};
-	std::map<uint32_t, _ipcPromiseMapEntry> _ipcPromiseMap;
+	_ipcPendingSlot _ipcPendingSlots[_ipcPendingSlotCount];
+	std::atomic<uint32_t> _ipcMessageIdNext = { 1 };
+	std::atomic<uint32_t> _replyTimeoutMs = { 5000 };
 	std::string _ipcServerQueueName;
 	std::string _ipcClientQueueName;
 	boost::interprocess::message_queue* _ipcServerQueue = nullptr;
 	boost::interprocess::message_queue* _ipcClientQueue = nullptr;
-
+	std::mutex _ipcDataRingMutex; // The ring is single-producer, so threads of this process need to take turns
+	std::string _ipcDataRingName = "driver_vrinputemulator.client_ring.";
+	std::string _ipcDataDoorbellName = "driver_vrinputemulator.data_doorbell";
+	ipc::ShmRing* _ipcDataRing = nullptr;
+	boost::interprocess::named_semaphore* _ipcDataDoorbell = nullptr;
+	std::string _ipcPoseTableName = "driver_vrinputemulator.pose_table";
+	static const unsigned _clockSyncRounds = 8;
+	ipc::ShmPoseTable* _ipcPoseTable = nullptr;
+
+	std::atomic<bool> _latencyTracing = { false };
+
+	std::atomic<bool> _batchActive = { false };
+	std::mutex _batchMutex;
+	std::thread::id _batchThread; // thread that called beginBatch()
+	std::vector<uint8_t> _batchData; // operation records, keeps its capacity between batches
+	size_t _batchLastOpOffset = 0; // offset of the last operation record (used to merge button/axis events)
+	uint32_t _batchIdNext = 1;
+
+	void _stopIpcThread();
+	void _syncClock();
+	bool _addToBatch(const ipc::Request& message);
+	void _sendRequest(ipc::Request& message);
+	void _sendDataRequest(ipc::Request& message);
+	void _closeDataPlane();
+	uint32_t _claimPendingSlot(std::function<void(const ipc::Reply*, bool)> completion = nullptr);
+	void _reclaimExpiredSlots(std::chrono::steady_clock::time_point now);
+	void _releasePendingSlot(uint32_t messageId);
+	void _completePendingSlot(const ipc::Reply& reply);
+	ipc::Reply _waitForReply(uint32_t messageId);
+	void _failPendingRequests();
+	template<typename T> T _sendAndWait(ipc::Request& message, uint32_t& messageId, const std::function<T(const ipc::Reply&)>& replyHandler);
+	template<typename T> std::future<T> _sendAsync(ipc::Request& message, uint32_t& messageId, const std::function<T(const ipc::Reply&)>& replyHandler);
 	void _setVirtualDeviceProperty(uint32_t emulatorDeviceId, vr::ETrackedDeviceProperty deviceProperty, std::function<void(ipc::Request&)>, bool modal);
+	std::future<void> _setVirtualDevicePropertyAsync(uint32_t emulatorDeviceId, vr::ETrackedDeviceProperty deviceProperty, std::function<void(ipc::Request&)>);
+	void _deviceButtonMapping(uint32_t deviceId, std::function<void(ipc::Request&)> dataHandler, bool modal);
+	std::future<void> _deviceButtonMappingAsync(uint32_t deviceId, std::function<void(ipc::Request&)> dataHandler);
+	void _setDeviceOffsets(uint32_t deviceId, std::function<void(ipc::Request&)> dataHandler, bool modal);
+	std::future<void> _setDeviceOffsetsAsync(uint32_t deviceId, std::function<void(ipc::Request&)> dataHandler);
 };
 
 } // end namespace vrinputemulator
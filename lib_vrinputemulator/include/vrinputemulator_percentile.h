@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+#include <cmath>
+#include <vector>
+
+
+namespace vrinputemulator {
+
+
+// Nearest rank on sorted samples, in microseconds
+inline double percentileMicros(const std::vector<uint32_t>& sortedNs, double fraction) {
+	if (sortedNs.empty()) {
+		return 0.0;
+	}
+	auto rank = (size_t)std::ceil(fraction * (double)sortedNs.size());
+	if (rank == 0) {
+		rank = 1;
+	}
+	return (double)sortedNs[rank - 1] / 1000.0;
+}
+
+
+} // end namespace vrinputemulator
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+
+namespace vrinputemulator {
+namespace trace {
+
+
+// Hooks recorded by the driver's trace recorder
+enum class TraceHook : uint16_t {
+	None = 0,
+	PoseUpdated,
+	ButtonPressed,
+	ButtonUnpressed,
+	ButtonTouched,
+	ButtonUntouched,
+	AxisUpdated,
+	TriggerHapticPulse,
+	RunFrame,
+	Count
+};
+
+inline const char* traceHookName(uint16_t hook) {
+	static const char* names[] = { "None", "PoseUpdated", "ButtonPressed", "ButtonUnpressed", "ButtonTouched",
+		"ButtonUntouched", "AxisUpdated", "TriggerHapticPulse", "RunFrame" };
+	return hook < (uint16_t)TraceHook::Count ? names[hook] : "Unknown";
+}
+
+
+// Device mode handler that served a hook call (mirrors the driver's DeviceModeHandler)
+static const uint8_t traceModeNone = 0xFF; // no manipulated device involved
+
+inline const char* traceModeName(uint8_t mode) {
+	static const char* names[] = { "Default", "FakeDisconnected", "RedirectSource", "RedirectTarget",
+		"RedirectSuspended", "Swap", "MotionCompensation" };
+	if (mode == traceModeNone) {
+		return "-";
+	}
+	return mode < sizeof(names) / sizeof(names[0]) ? names[mode] : "Unknown";
+}
+
+
+// One hook call, 32 bytes. The hook took elapsedNs + vrserverNs in total.
+struct TraceRecord {
+	uint64_t timestampNs; // steady clock at hook entry
+	uint32_t elapsedNs; // time spent in the driver's own code
+	uint16_t threadIndex; // trace ring the record was written to (one per thread)
+	uint16_t hook; // TraceHook
+	uint32_t deviceId; // openvr device id
+	uint32_t arg; // button id, axis id or pulse duration
+	uint8_t mode; // traceModeName()
+	uint8_t reserved[3];
+	uint32_t vrserverNs; // time spent in calls into vrserver (e.g. the original TrackedDevicePoseUpdated)
+};
+
+
+// Trace dump file layout: TraceFileHeader followed by recordCount TraceRecords sorted by timestamp
+#define TRACE_FILE_MAGIC "VRIETRC"
+#define TRACE_FILE_VERSION 2
+
+struct TraceFileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t recordSize;
+	uint32_t threadCount;
+	uint32_t reserved;
+	uint64_t recordCount;
+};
+
+
+// Call count and latency of one hook for one device and device mode, as kept by the driver since it was started
+struct HookStatsEntry {
+	uint16_t hook; // TraceHook
+	uint8_t mode; // traceModeName()
+	uint8_t reserved;
+	uint32_t deviceId; // openvr device id, vr::k_unTrackedDeviceIndexInvalid when the hook is not bound to a device
+	uint64_t callCount;
+	uint64_t totalNs; // time spent in the driver's own code (without the calls into vrserver, see TraceRecord)
+	uint32_t p50Ns; // percentiles have a relative error of less than 1/16
+	uint32_t p99Ns;
+	uint32_t p999Ns;
+	uint32_t maxNs;
+};
+
+struct HookStats {
+	uint64_t sampleTimeNs = 0; // driver's steady clock when the stats were taken, use it to turn counts into rates
+	std::vector<HookStatsEntry> entries;
+};
+
+
+// Stages of the ipc requests of clients with latency tracing enabled. Latencies are measured from the request's
+// timestamp (ipc::Request::timestamp), which tracing clients set when they hand the request to the transport.
+enum class LatencyStage : uint8_t {
+	Dequeue, // driver took the request from the message queue, data ring or pose table
+	Apply, // first call into the driver host (e.g. TrackedDevicePoseUpdated) made for the request
+	Reply, // driver sent the reply
+	Count
+};
+
+inline const char* latencyStageName(uint8_t stage) {
+	static const char* names[] = { "Dequeue", "Apply", "Reply" };
+	return stage < (uint8_t)LatencyStage::Count ? names[stage] : "Unknown";
+}
+
+// Latency of one stage for one request type and client, as kept by the driver since it was started
+struct LatencyStatsEntry {
+	uint32_t requestType; // ipc::RequestType
+	uint32_t clientId;
+	uint8_t stage; // LatencyStage
+	uint8_t reserved[7];
+	uint64_t count;
+	uint64_t totalNs;
+	uint32_t p50Ns; // percentiles have a relative error of less than 1/16
+	uint32_t p99Ns;
+	uint32_t p999Ns;
+	uint32_t maxNs;
+};
+
+struct LatencyStats {
+	uint64_t sampleTimeNs = 0; // driver's steady clock when the stats were taken
+	std::vector<LatencyStatsEntry> entries;
+};
+
+
+} // end namespace trace
+} // end namespace vrinputemulator
@@ -20,6 +20,14 @@ namespace vrinputemulator {
 	};
 
 
+	// What the driver does with a reply when the client's reply queue is full
+	enum class ReplyOverflowPolicy : uint32_t {
+		DropOldest = 0, // discard the oldest queued reply to make room
+		DropNewest = 1, // discard the new reply
+		Disconnect = 2 // drop the client
+	};
+
+
 	enum class DevicePropertyValueType : uint32_t {
 		None = 0,
 		FLOAT = 1,
@@ -55,4 +63,11 @@ namespace vrinputemulator {
 		bool redirectSuspended;
 	};
 
+	struct ClientStatus {
+		ReplyOverflowPolicy replyOverflowPolicy;
+		uint32_t pendingReplies; // replies in the reply queue that have not been received yet
+		uint64_t repliesSent;
+		uint64_t repliesDropped;
+	};
+
 } // end namespace vrinputemulator
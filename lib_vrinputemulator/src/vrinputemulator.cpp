@@ -1,5 +1,4 @@
 #include <vrinputemulator.h>
-#include <boost/date_time/posix_time/posix_time_types.hpp>
 #include <cstdlib>
 #include <functional>
 #include <iostream>
@@ -22,25 +21,17 @@ void VRInputEmulator::_ipcThreadFunc(VRInputEmulator * _this) {
 	_this->_ipcThreadRunning = true;
 	while (!_this->_ipcThreadStop) {
 		try {
+			// Block until something arrives, then handle everything that is pending before blocking again
 			ipc::Reply message;
 			uint64_t recv_size;
 			unsigned priority;
-			boost::posix_time::ptime timeout = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(50);
-			if (_this->_ipcClientQueue->timed_receive(&message, sizeof(ipc::Reply), recv_size, priority, timeout)) {
-				if (recv_size == sizeof(ipc::Reply)) {
-					std::lock_guard<std::recursive_mutex> lock(_this->_mutex);
-					auto i = _this->_ipcPromiseMap.find(message.messageId);
-					if (i != _this->_ipcPromiseMap.end()) {
-						if (i->second.isValid) {
-							i->second.promise.set_value(message);
-						} else {
-							_this->_ipcPromiseMap.erase(i); // nobody wants it, so we delete it
-						}
-					}
+			_this->_ipcClientQueue->receive(&message, sizeof(ipc::Reply), recv_size, priority);
+			do {
+				// Replies to IPC_ClientConnect are also accepted from drivers with an older protocol version (so we can report the version mismatch)
+				if (message.type != ipc::ReplyType::IPC_Wakeup && (message.isValidFrame(recv_size) || (message.type == ipc::ReplyType::IPC_ClientConnect && recv_size == sizeof(ipc::Reply)))) {
+					_this->_completePendingSlot(message);
 				}
-			} else {
-				std::this_thread::sleep_for(std::chrono::milliseconds(1));
-			}
+			} while (!_this->_ipcThreadStop && _this->_ipcClientQueue->try_receive(&message, sizeof(ipc::Reply), recv_size, priority));
 		} catch (std::exception& ex) {
 			WRITELOG(ERROR, "Exception in ipc receive loop: " << ex.what() << std::endl);
 		}
@@ -48,6 +39,181 @@ void VRInputEmulator::_ipcThreadFunc(VRInputEmulator * _this) {
 	_this->_ipcThreadRunning = false;
 }
 
+// The ipc thread blocks until a reply arrives, so we send it a wake up message to make it see the stop flag
+void VRInputEmulator::_stopIpcThread() {
+	if (_ipcThread.joinable()) {
+		_ipcThreadStop = true;
+		ipc::Reply message(ipc::ReplyType::IPC_Wakeup);
+		_ipcClientQueue->send(&message, message.frameSize(), 0);
+		_ipcThread.join();
+	}
+}
+
+
+// Reserves a slot in the pending request table and returns the message id to use for the request.
+// The message id is a sequence number, its slot is messageId % _ipcPendingSlotCount. Since the sequence
+// number keeps increasing it also serves as generation counter: a late reply for a previous user of the
+// slot does not match the slot's current message id and is ignored.
+// When all slots are in use for longer than the reply timeout, throws instead of waiting any longer.
+uint32_t VRInputEmulator::_claimPendingSlot(std::function<void(const ipc::Reply*, bool)> completion) {
+	unsigned attempts = 0;
+	std::chrono::steady_clock::time_point deadline;
+	while (true) {
+		uint32_t messageId = _ipcMessageIdNext.fetch_add(1, std::memory_order_relaxed);
+		if (messageId == 0) {
+			continue; // 0 means "no reply wanted"
+		}
+		auto& slot = _ipcPendingSlots[messageId % _ipcPendingSlotCount];
+		uint32_t expected = _ipcPendingSlot::Free;
+		if (slot.state.compare_exchange_strong(expected, _ipcPendingSlot::Claimed, std::memory_order_acquire)) {
+			slot.completion = std::move(completion);
+			slot.asynchronous.store((bool)slot.completion, std::memory_order_relaxed);
+			slot.claimTime.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+			slot.messageId.store(messageId, std::memory_order_relaxed);
+			slot.state.store(_ipcPendingSlot::Pending, std::memory_order_release);
+			return messageId;
+		}
+		if (++attempts % _ipcPendingSlotCount == 0) {
+			// All slots are in use. Blocking callers free their slots when they time out, asynchronous requests
+			// that are still unanswered after the timeout are given up here.
+			auto now = std::chrono::steady_clock::now();
+			if (attempts == _ipcPendingSlotCount) {
+				deadline = now + std::chrono::milliseconds(_replyTimeoutMs.load(std::memory_order_relaxed));
+			} else if (now >= deadline) {
+				throw vrinputemulator_exception("Too many outstanding requests.");
+			}
+			_reclaimExpiredSlots(now);
+			std::this_thread::yield();
+		}
+	}
+}
+
+// Fails asynchronous requests whose reply did not arrive within the reply timeout (e.g. because the driver
+// dropped it) and frees their slots
+void VRInputEmulator::_reclaimExpiredSlots(std::chrono::steady_clock::time_point now) {
+	auto expiry = (now - std::chrono::milliseconds(_replyTimeoutMs.load(std::memory_order_relaxed))).time_since_epoch().count();
+	for (uint32_t i = 0; i < _ipcPendingSlotCount; ++i) {
+		auto& slot = _ipcPendingSlots[i];
+		auto messageId = slot.messageId.load(std::memory_order_relaxed);
+		if (slot.state.load(std::memory_order_acquire) != _ipcPendingSlot::Pending
+				|| !slot.asynchronous.load(std::memory_order_relaxed) || slot.claimTime.load(std::memory_order_relaxed) > expiry) {
+			continue;
+		}
+		uint32_t expected = _ipcPendingSlot::Pending;
+		if (!slot.state.compare_exchange_strong(expected, _ipcPendingSlot::Completing, std::memory_order_acquire)) {
+			continue;
+		}
+		if (slot.messageId.load(std::memory_order_relaxed) != messageId) {
+			slot.state.store(_ipcPendingSlot::Pending, std::memory_order_release); // claimed again in the meantime
+			continue;
+		}
+		auto completion = std::move(slot.completion);
+		_releasePendingSlot(messageId);
+		completion(nullptr, true);
+	}
+}
+
+void VRInputEmulator::_releasePendingSlot(uint32_t messageId) {
+	auto& slot = _ipcPendingSlots[messageId % _ipcPendingSlotCount];
+	slot.completion = nullptr;
+	slot.asynchronous.store(false, std::memory_order_relaxed);
+	slot.messageId.store(0, std::memory_order_relaxed);
+	slot.state.store(_ipcPendingSlot::Free, std::memory_order_release);
+}
+
+// Called by the ipc thread (the only one that completes slots while connected)
+void VRInputEmulator::_completePendingSlot(const ipc::Reply& reply) {
+	if (reply.messageId == 0) {
+		return;
+	}
+	auto& slot = _ipcPendingSlots[reply.messageId % _ipcPendingSlotCount];
+	if (slot.messageId.load(std::memory_order_relaxed) != reply.messageId) {
+		return; // nobody waits for it (anymore)
+	}
+	// Completing keeps a waiter that times out right now from releasing the slot under our feet
+	uint32_t expected = _ipcPendingSlot::Pending;
+	while (!slot.state.compare_exchange_weak(expected, _ipcPendingSlot::Completing, std::memory_order_acquire)) {
+		if (expected != _ipcPendingSlot::Pending && expected != _ipcPendingSlot::Completing) {
+			return;
+		}
+		// Either a spurious failure or _reclaimExpiredSlots() looks at the slot right now
+		expected = _ipcPendingSlot::Pending;
+		std::this_thread::yield();
+	}
+	if (slot.messageId.load(std::memory_order_relaxed) != reply.messageId) {
+		slot.state.store(_ipcPendingSlot::Pending, std::memory_order_release);
+		return;
+	}
+	if (slot.completion) {
+		// Asynchronous request, the slot is not needed anymore. The completion may run arbitrary continuations,
+		// so the slot is released first.
+		auto completion = std::move(slot.completion);
+		_releasePendingSlot(reply.messageId);
+		completion(&reply, false);
+	} else {
+		slot.reply = reply;
+		{
+			std::lock_guard<std::mutex> lock(slot.waitMutex);
+			slot.state.store(_ipcPendingSlot::Completed, std::memory_order_release);
+		}
+		slot.waitCondition.notify_one();
+	}
+}
+
+// Blocks until the reply to the given message id arrives and releases its slot. Gives up after the reply
+// timeout, the driver drops replies when the reply queue is full (see ReplyOverflowPolicy).
+ipc::Reply VRInputEmulator::_waitForReply(uint32_t messageId) {
+	auto& slot = _ipcPendingSlots[messageId % _ipcPendingSlotCount];
+	bool timedOut = false;
+	{
+		std::unique_lock<std::mutex> lock(slot.waitMutex);
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(_replyTimeoutMs.load(std::memory_order_relaxed));
+		while (!slot.waitCondition.wait_until(lock, deadline, [&slot]() {
+			auto state = slot.state.load(std::memory_order_acquire);
+			return state == _ipcPendingSlot::Completed || state == _ipcPendingSlot::Failed;
+		})) {
+			uint32_t expected = _ipcPendingSlot::Pending;
+			if (slot.state.compare_exchange_strong(expected, _ipcPendingSlot::Completing, std::memory_order_acquire)) {
+				timedOut = true;
+				break;
+			}
+			// The reply is being delivered right now
+			deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(1);
+		}
+	}
+	bool failed = slot.state.load(std::memory_order_acquire) == _ipcPendingSlot::Failed;
+	ipc::Reply reply = slot.reply;
+	_releasePendingSlot(messageId);
+	if (timedOut) {
+		throw vrinputemulator_exception("Timed out waiting for the reply.");
+	} else if (failed) {
+		throw vrinputemulator_connectionerror("Connection closed before the reply arrived.");
+	}
+	return reply;
+}
+
+// Completes all outstanding requests with a connection error (the ipc thread must not be running anymore)
+void VRInputEmulator::_failPendingRequests() {
+	for (uint32_t i = 0; i < _ipcPendingSlotCount; ++i) {
+		auto& slot = _ipcPendingSlots[i];
+		uint32_t expected = _ipcPendingSlot::Pending;
+		if (!slot.state.compare_exchange_strong(expected, _ipcPendingSlot::Completing, std::memory_order_acquire)) {
+			continue;
+		}
+		if (slot.completion) {
+			auto completion = std::move(slot.completion);
+			_releasePendingSlot(slot.messageId.load(std::memory_order_relaxed));
+			completion(nullptr, false);
+		} else {
+			{
+				std::lock_guard<std::mutex> lock(slot.waitMutex);
+				slot.state.store(_ipcPendingSlot::Failed, std::memory_order_release);
+			}
+			slot.waitCondition.notify_one();
+		}
+	}
+}
+
 
 VRInputEmulator::VRInputEmulator(const std::string& serverQueue, const std::string& clientQueue) : _ipcServerQueueName(serverQueue), _ipcClientQueueName(clientQueue) {}
 
@@ -59,7 +225,75 @@ bool VRInputEmulator::isConnected() const {
 	return _ipcServerQueue != nullptr;
 }
 
-void VRInputEmulator::connect() {
+bool VRInputEmulator::isDataRingEnabled() const {
+	return _ipcDataRing != nullptr;
+}
+
+// Sends a fire-and-forget request over the data ring when available, otherwise over the server-side message queue
+void VRInputEmulator::_sendDataRequest(ipc::Request& message) {
+	if (!_ipcServerQueue) {
+		throw vrinputemulator_connectionerror("No active connection.");
+	}
+	if (_addToBatch(message)) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(_ipcDataRingMutex);
+		if (_ipcDataRing) {
+			if (_latencyTracing.load(std::memory_order_relaxed)) {
+				message.refreshTimestamp();
+			}
+			auto frameSize = message.updateFrameLength();
+			if (!_ipcDataRing->push(&message, frameSize)) {
+				// Ring is full, make sure the driver is awake and let it catch up
+				auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(_replyTimeoutMs.load(std::memory_order_relaxed));
+				do {
+					if (_ipcDataRing->needsWakeup()) {
+						_ipcDataDoorbell->post();
+					}
+					if (std::chrono::steady_clock::now() >= deadline) {
+						throw vrinputemulator_exception("Data ring is full, the driver does not drain it.");
+					}
+					std::this_thread::yield();
+				} while (!_ipcDataRing->push(&message, frameSize));
+			}
+			if (_ipcDataRing->needsWakeup()) {
+				_ipcDataDoorbell->post();
+			}
+			return;
+		}
+	}
+	_sendRequest(message);
+}
+
+// Sends a request over the server-side message queue (only the used part of the message gets transmitted)
+void VRInputEmulator::_sendRequest(ipc::Request& message) {
+	if (!_ipcServerQueue) {
+		throw vrinputemulator_connectionerror("No active connection.");
+	}
+	if (_latencyTracing.load(std::memory_order_relaxed)) {
+		message.refreshTimestamp();
+	}
+	_ipcServerQueue->send(&message, message.updateFrameLength(), 0);
+}
+
+void VRInputEmulator::_closeDataPlane() {
+	std::lock_guard<std::mutex> lock(_ipcDataRingMutex);
+	if (_ipcDataRing) {
+		delete _ipcDataRing;
+		_ipcDataRing = nullptr;
+	}
+	if (_ipcPoseTable) {
+		delete _ipcPoseTable;
+		_ipcPoseTable = nullptr;
+	}
+	if (_ipcDataDoorbell) {
+		delete _ipcDataDoorbell;
+		_ipcDataDoorbell = nullptr;
+	}
+}
+
+void VRInputEmulator::connect(bool enableDataRing, ReplyOverflowPolicy replyOverflowPolicy, uint32_t dataLaneWeight) {
 	if (!_ipcServerQueue) {
 		// Open server-side message queue
 		try {
@@ -71,7 +305,8 @@ void VRInputEmulator::connect() {
 			throw vrinputemulator_connectionerror(ss.str());
 		}
 		// Append random number to client queue name (and hopefully no other client uses the same random number)
-		_ipcClientQueueName += std::to_string(_ipcRandomDist(_ipcRandomDevice));
+		auto clientSuffix = std::to_string(_ipcRandomDist(_ipcRandomDevice));
+		_ipcClientQueueName += clientSuffix;
 		// Open client-side message queue
 		try {
 			boost::interprocess::message_queue::remove(_ipcClientQueueName.c_str());
@@ -89,31 +324,46 @@ void VRInputEmulator::connect() {
 			ss << "Could not open client-side message queue: " << e.what();
 			throw vrinputemulator_connectionerror(ss.str());
 		}
+		// Create data ring and open pose table (optional, we fall back to the server-side message queue when anything goes wrong)
+		if (enableDataRing) {
+			try {
+				_ipcDataDoorbell = new boost::interprocess::named_semaphore(boost::interprocess::open_only, _ipcDataDoorbellName.c_str());
+				_ipcDataRing = new ipc::ShmRing(boost::interprocess::create_only, _ipcDataRingName + clientSuffix, ipc::ShmRing::defaultCapacity, sizeof(ipc::Request));
+			} catch (std::exception& e) {
+				WRITELOG(WARNING, "Could not create data ring: " << e.what() << std::endl);
+				_closeDataPlane();
+			}
+			if (_ipcDataDoorbell) {
+				try {
+					_ipcPoseTable = new ipc::ShmPoseTable(boost::interprocess::open_only, _ipcPoseTableName);
+				} catch (std::exception& e) {
+					WRITELOG(WARNING, "Could not open pose table: " << e.what() << std::endl);
+					_ipcPoseTable = nullptr;
+				}
+			}
+		}
 		// Start ipc thread
 		_ipcThreadStop = false;
 		_ipcThread = std::thread(_ipcThreadFunc, this);
 		// Send ClientConnect message to server
 		ipc::Request message(ipc::RequestType::IPC_ClientConnect);
-		auto messageId = _ipcRandomDist(_ipcRandomDevice);
-		message.msg.ipc_ClientConnect.messageId = messageId;
 		message.msg.ipc_ClientConnect.ipcProcotolVersion = IPC_PROTOCOL_VERSION;
 		strncpy_s(message.msg.ipc_ClientConnect.queueName, _ipcClientQueueName.c_str(), 127);
 		message.msg.ipc_ClientConnect.queueName[127] = '\0';
-		std::promise<ipc::Reply> respPromise;
-		auto respFuture = respPromise.get_future();
-		{
-			std::lock_guard<std::recursive_mutex> lock(_mutex);
-			_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-		}
-		_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
+		strncpy_s(message.msg.ipc_ClientConnect.dataRingName, _ipcDataRing ? _ipcDataRing->name().c_str() : "", 127);
+		message.msg.ipc_ClientConnect.dataRingName[127] = '\0';
+		message.msg.ipc_ClientConnect.replyOverflowPolicy = replyOverflowPolicy;
+		message.msg.ipc_ClientConnect.processId = (uint32_t)boost::interprocess::ipcdetail::get_current_process_id();
+		message.msg.ipc_ClientConnect.dataLaneWeight = dataLaneWeight;
+		auto messageId = _claimPendingSlot();
+		message.msg.ipc_ClientConnect.messageId = messageId;
+		_sendRequest(message);
 		// Wait for response
-		auto resp = respFuture.get();
+		auto resp = _waitForReply(messageId);
 		m_clientId = resp.msg.ipc_ClientConnect.clientId;
-		{
-			std::lock_guard<std::recursive_mutex> lock(_mutex);
-			_ipcPromiseMap.erase(messageId);
-		}
 		if (resp.status != ipc::ReplyStatus::Ok) {
+			_stopIpcThread();
+			_closeDataPlane();
 			delete _ipcServerQueue;
 			_ipcServerQueue = nullptr;
 			delete _ipcClientQueue;
@@ -127,35 +377,87 @@ void VRInputEmulator::connect() {
 				ss << "Error code " << (int)resp.status;
 				throw vrinputemulator_connectionerror(ss.str());
 			}
+		} else if (_ipcDataRing && !resp.msg.ipc_ClientConnect.dataRingEnabled) {
+			WRITELOG(WARNING, "Server did not accept data ring, falling back to message queue" << std::endl);
+			std::lock_guard<std::mutex> lock(_ipcDataRingMutex);
+			delete _ipcDataRing;
+			_ipcDataRing = nullptr;
 		}
+		_syncClock();
 	}
 }
 
+// Estimates the driver's clock as the midpoint of the round trip, taking the round trip with the lowest latency
+// since it has the least room for asymmetric delays
+void VRInputEmulator::_syncClock() {
+	int64_t bestRoundTrip = INT64_MAX;
+	int64_t bestOffset = 0;
+	for (unsigned i = 0; i < _clockSyncRounds; ++i) {
+		ipc::Request message(ipc::RequestType::IPC_ClockSync);
+		message.msg.ipc_ClockSync.clientId = m_clientId;
+		auto messageId = _claimPendingSlot();
+		message.msg.ipc_ClockSync.messageId = messageId;
+		auto sendTime = ipc::steadyClockNs();
+		_sendRequest(message);
+		auto resp = _waitForReply(messageId);
+		auto recvTime = ipc::steadyClockNs();
+		if (resp.status == ipc::ReplyStatus::Ok && recvTime - sendTime < bestRoundTrip) {
+			bestRoundTrip = recvTime - sendTime;
+			bestOffset = resp.msg.ipc_ClockSync.driverTimeNs - (sendTime + (recvTime - sendTime) / 2);
+		}
+	}
+	if (bestRoundTrip != INT64_MAX) {
+		ipc::clockOffsetNs().store(bestOffset, std::memory_order_relaxed);
+	} else {
+		WRITELOG(WARNING, "Clock sync with driver failed, assuming the same clock" << std::endl);
+	}
+}
+
+int64_t VRInputEmulator::clockOffsetNs() const {
+	return ipc::clockOffsetNs().load(std::memory_order_relaxed);
+}
+
+void VRInputEmulator::setReplyTimeout(uint32_t milliseconds) {
+	if (milliseconds == 0) {
+		throw vrinputemulator_exception("Reply timeout must be greater than 0.");
+	}
+	_replyTimeoutMs.store(milliseconds, std::memory_order_relaxed);
+}
+
+uint32_t VRInputEmulator::replyTimeout() const {
+	return _replyTimeoutMs.load(std::memory_order_relaxed);
+}
+
 void VRInputEmulator::disconnect() {
 	if (_ipcServerQueue) {
-		// Send disconnect message (so the server can free resources)
-		ipc::Request message(ipc::RequestType::IPC_ClientDisconnect);
-		auto messageId = _ipcRandomDist(_ipcRandomDevice);
-		message.msg.ipc_ClientDisconnect.clientId = m_clientId;
-		message.msg.ipc_ClientDisconnect.messageId = messageId;
-		std::promise<ipc::Reply> respPromise;
-		auto respFuture = respPromise.get_future();
-		{
-			std::lock_guard<std::recursive_mutex> lock(_mutex);
-			_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
+		// Give the driver some time to drain the data ring
+		if (_ipcDataRing) {
+			for (unsigned i = 0; i < 100 && !_ipcDataRing->empty(); ++i) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
 		}
-		_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-		auto resp = respFuture.get();
-		m_clientId = resp.msg.ipc_ClientConnect.clientId;
-		{
-			std::lock_guard<std::recursive_mutex> lock(_mutex);
-			_ipcPromiseMap.erase(messageId);
+		// Send disconnect message (so the server can free resources). Also called from the destructor, so a
+		// driver that does not answer must not keep us from cleaning up.
+		try {
+			ipc::Request message(ipc::RequestType::IPC_ClientDisconnect);
+			auto messageId = _claimPendingSlot();
+			message.msg.ipc_ClientDisconnect.clientId = m_clientId;
+			message.msg.ipc_ClientDisconnect.messageId = messageId;
+			try {
+				_sendRequest(message);
+			} catch (...) {
+				_releasePendingSlot(messageId);
+				throw;
+			}
+			_waitForReply(messageId); // header-only reply, carries no client id
+		} catch (std::exception& ex) {
+			WRITELOG(WARNING, "Error while disconnecting: " << ex.what() << std::endl);
 		}
+		m_clientId = 0;
 		// Stop ipc thread
-		if (_ipcThreadRunning) {
-			_ipcThreadStop = true;
-			_ipcThread.join();
-		}
+		_stopIpcThread();
+		_failPendingRequests();
+		_closeDataPlane();
 		// delete message queues
 		if (_ipcServerQueue) {
 			delete _ipcServerQueue;
@@ -170,25 +472,20 @@ void VRInputEmulator::disconnect() {
 
 void VRInputEmulator::ping(bool modal, bool enableReply) {
 	if (_ipcServerQueue) {
-		uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-		uint64_t nonce = _ipcRandomDist(_ipcRandomDevice);
 		ipc::Request message(ipc::RequestType::IPC_Ping);
 		message.msg.ipc_Ping.clientId = m_clientId;
-		message.msg.ipc_Ping.messageId = messageId;
-		message.msg.ipc_Ping.nonce = nonce;
+		message.msg.ipc_Ping.messageId = 0;
+		message.msg.ipc_Ping.nonce = _ipcMessageIdNext.load(std::memory_order_relaxed);
 		if (modal) {
-			std::promise<ipc::Reply> respPromise;
-			auto respFuture = respPromise.get_future();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-			}
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-			auto resp = respFuture.get();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.erase(messageId);
-			}
+			auto messageId = _claimPendingSlot();
+			message.msg.ipc_Ping.messageId = messageId;
+			try {
+				_sendDataRequest(message);
+			} catch (...) {
+				_releasePendingSlot(messageId);
+				throw;
+			}
+			auto resp = _waitForReply(messageId);
 			if (resp.status != ipc::ReplyStatus::Ok) {
 				std::stringstream ss;
 				ss << "Error while pinging server: Error code " << (int)resp.status;
@@ -196,13 +493,10 @@ void VRInputEmulator::ping(bool modal, bool enableReply) {
 			}
 		} else {
 			if (enableReply) {
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				message.msg.ipc_Ping.messageId = messageId;
-				_ipcPromiseMap.insert({ messageId, _ipcPromiseMapEntry() });
-			} else {
-				message.msg.ipc_Ping.messageId = 0;
+				// Nobody waits for the reply, the slot gets released when it arrives
+				message.msg.ipc_Ping.messageId = _claimPendingSlot([](const ipc::Reply*, bool) {});
 			}
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
+			_sendDataRequest(message);
 		}
 	} else {
 		throw vrinputemulator_connectionerror("No active connection.");
@@ -213,8 +507,10 @@ void VRInputEmulator::ping(bool modal, bool enableReply) {
 void VRInputEmulator::openvrUpdatePose(uint32_t deviceId, const vr::DriverPose_t & pose) {
 	if (_ipcServerQueue) {
 		ipc::Request message(ipc::RequestType::OpenVR_PoseUpdate);
+		message.msg.ipc_PoseUpdate.clientId = m_clientId;
 		message.msg.ipc_PoseUpdate.deviceId = deviceId;
 		message.msg.ipc_PoseUpdate.pose = pose;
+		_sendDataRequest(message);
 	} else {
 		throw vrinputemulator_connectionerror("No active connection.");
 	}
@@ -224,12 +520,13 @@ void VRInputEmulator::openvrUpdatePose(uint32_t deviceId, const vr::DriverPose_t
 void VRInputEmulator::openvrButtonEvent(ButtonEventType eventType, uint32_t deviceId, vr::EVRButtonId buttonId, double timeOffset) {
 	if (_ipcServerQueue) {
 		ipc::Request message(ipc::RequestType::OpenVR_ButtonEvent);
+		message.msg.ipc_ButtonEvent.clientId = m_clientId;
 		message.msg.ipc_ButtonEvent.eventCount = 1;
 		message.msg.ipc_ButtonEvent.events[0].eventType = eventType;
 		message.msg.ipc_ButtonEvent.events[0].deviceId = deviceId;
 		message.msg.ipc_ButtonEvent.events[0].buttonId = buttonId;
 		message.msg.ipc_ButtonEvent.events[0].timeOffset = timeOffset;
-		_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
+		_sendDataRequest(message);
 	} else {
 		throw vrinputemulator_connectionerror("No active connection.");
 	}
@@ -239,11 +536,12 @@ void VRInputEmulator::openvrButtonEvent(ButtonEventType eventType, uint32_t devi
 void VRInputEmulator::openvrAxisEvent(uint32_t deviceId, uint32_t axisId, const vr::VRControllerAxis_t & axisState) {
 	if (_ipcServerQueue) {
 		ipc::Request message(ipc::RequestType::OpenVR_AxisEvent);
+		message.msg.ipc_AxisEvent.clientId = m_clientId;
 		message.msg.ipc_AxisEvent.eventCount = 1;
 		message.msg.ipc_AxisEvent.events[0].deviceId = deviceId;
 		message.msg.ipc_AxisEvent.events[0].axisId = axisId;
 		message.msg.ipc_AxisEvent.events[0].axisState = axisState;
-		_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
+		_sendDataRequest(message);
 	} else {
 		throw vrinputemulator_connectionerror("No active connection.");
 	}
@@ -253,9 +551,10 @@ void VRInputEmulator::openvrAxisEvent(uint32_t deviceId, uint32_t axisId, const
 void VRInputEmulator::openvrProximitySensorEvent(uint32_t deviceId, bool sensorTriggered) {
 	if (_ipcServerQueue) {
 		ipc::Request message(ipc::RequestType::OpenVR_ProximitySensorEvent);
+		message.msg.ovr_ProximitySensorEvent.clientId = m_clientId;
 		message.msg.ovr_ProximitySensorEvent.deviceId = deviceId;
 		message.msg.ovr_ProximitySensorEvent.sensorTriggered = sensorTriggered;
-		_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
+		_sendDataRequest(message);
 	} else {
 		throw vrinputemulator_connectionerror("No active connection.");
 	}
@@ -265,190 +564,286 @@ void VRInputEmulator::openvrProximitySensorEvent(uint32_t deviceId, bool sensorT
 void VRInputEmulator::openvrVendorSpecificEvent(uint32_t deviceId, vr::EVREventType eventType, const vr::VREvent_Data_t & eventData, double timeOffset) {
 	if (_ipcServerQueue) {
 		ipc::Request message(ipc::RequestType::OpenVR_VendorSpecificEvent);
+		message.msg.ovr_VendorSpecificEvent.clientId = m_clientId;
 		message.msg.ovr_VendorSpecificEvent.deviceId = deviceId;
 		message.msg.ovr_VendorSpecificEvent.eventType = eventType;
 		message.msg.ovr_VendorSpecificEvent.eventData = eventData;
 		message.msg.ovr_VendorSpecificEvent.timeOffset = timeOffset;
-		_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
+		_sendDataRequest(message);
 	} else {
 		throw vrinputemulator_connectionerror("No active connection.");
 	}
 }
 
 
-uint32_t VRInputEmulator::getVirtualDeviceCount() {
-	if (_ipcServerQueue) {
-		uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-		ipc::Request message(ipc::RequestType::VirtualDevices_GetDeviceCount);
-		message.msg.vd_GenericClientMessage.clientId = m_clientId;
-		message.msg.vd_GenericClientMessage.messageId = messageId;
-		std::promise<ipc::Reply> respPromise;
-		auto respFuture = respPromise.get_future();
-		{
-			std::lock_guard<std::recursive_mutex> lock(_mutex);
-			_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-		}
-		_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-		auto resp = respFuture.get();
-		{
-			std::lock_guard<std::recursive_mutex> lock(_mutex);
-			_ipcPromiseMap.erase(messageId);
-		}
-		if (resp.status != ipc::ReplyStatus::Ok) {
-			std::stringstream ss;
-			ss << "Error while getting device count: Error code " << (int)resp.status;
-			throw vrinputemulator_exception(ss.str());
-		}
-		return resp.msg.vd_GetDeviceCount.deviceCount;
-	} else {
-		throw vrinputemulator_connectionerror("No active connection.");
+void VRInputEmulator::beginBatch() {
+	std::lock_guard<std::mutex> lock(_batchMutex);
+	if (_batchActive) {
+		throw vrinputemulator_exception("Another batch is already active.");
 	}
+	_batchThread = std::this_thread::get_id();
+	_batchData.clear();
+	_batchLastOpOffset = 0;
+	_batchActive = true;
 }
 
 
-VirtualDeviceInfo VRInputEmulator::getVirtualDeviceInfo(uint32_t virtualDeviceId) {
+void VRInputEmulator::commitBatch(bool modal) {
 	if (_ipcServerQueue) {
-		uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-		ipc::Request message(ipc::RequestType::VirtualDevices_GetDeviceInfo);
-		message.msg.vd_GenericDeviceIdMessage.clientId = m_clientId;
-		message.msg.vd_GenericDeviceIdMessage.messageId = messageId;
-		message.msg.vd_GenericDeviceIdMessage.deviceId = virtualDeviceId;
-		std::promise<ipc::Reply> respPromise;
-		auto respFuture = respPromise.get_future();
-		{
-			std::lock_guard<std::recursive_mutex> lock(_mutex);
-			_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-		}
-		_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-		auto resp = respFuture.get();
+		uint32_t messageId = 0;
 		{
-			std::lock_guard<std::recursive_mutex> lock(_mutex);
-			_ipcPromiseMap.erase(messageId);
+			std::lock_guard<std::mutex> lock(_batchMutex);
+			if (!_batchActive || _batchThread != std::this_thread::get_id()) {
+				throw vrinputemulator_exception("No active batch.");
+			}
+			_batchActive = false; // from here on _sendDataRequest() sends again
+			if (_batchData.empty() && !modal) {
+				return;
+			}
+			if (modal) {
+				messageId = _claimPendingSlot();
+			}
+			// Split the operation records into as few parts as possible
+			ipc::Request message(ipc::RequestType::Batch);
+			message.msg.batch.clientId = m_clientId;
+			message.msg.batch.messageId = 0;
+			message.msg.batch.batchId = _batchIdNext++;
+			size_t offset = 0;
+			try {
+				do {
+					size_t partSize = _batchData.size() - offset;
+					if (partSize > REQUEST_BATCH_DATASIZE) {
+						partSize = REQUEST_BATCH_DATASIZE;
+					}
+					std::memcpy(message.msg.batch.data, _batchData.data() + offset, partSize);
+					message.msg.batch.dataSize = (uint32_t)partSize;
+					offset += partSize;
+					if (offset >= _batchData.size()) {
+						message.msg.batch.lastPart = 1;
+						message.msg.batch.messageId = messageId;
+					} else {
+						message.msg.batch.lastPart = 0;
+					}
+					// Modal batches go completely over the message queue, so the parts cannot overtake each other
+					if (modal) {
+						_sendRequest(message);
+					} else {
+						_sendDataRequest(message);
+					}
+				} while (offset < _batchData.size());
+			} catch (...) {
+				if (messageId) {
+					_releasePendingSlot(messageId);
+				}
+				_batchData.clear();
+				throw;
+			}
+			_batchData.clear();
 		}
-		std::stringstream ss;
-		ss << "Error while getting device info: ";
-		if (resp.status == ipc::ReplyStatus::InvalidId) {
-			ss << "Invalid device id";
-			throw vrinputemulator_invalidid(ss.str());
-		} else if (resp.status == ipc::ReplyStatus::NotFound) {
-			ss << "Device not found";
-			throw vrinputemulator_notfound(ss.str());
-		} else if (resp.status != ipc::ReplyStatus::Ok) {
-			ss << "Error code " << (int)resp.status;
-			throw vrinputemulator_exception(ss.str());
+		if (modal) {
+			auto resp = _waitForReply(messageId);
+			if (resp.status != ipc::ReplyStatus::Ok) {
+				std::stringstream ss;
+				ss << "Error while applying batch: Error code " << (int)resp.status;
+				throw vrinputemulator_exception(ss.str());
+			}
 		}
-		VirtualDeviceInfo retval;
-		retval.openvrDeviceId = resp.msg.vd_GetDeviceInfo.openvrDeviceId;
-		retval.virtualDeviceId = resp.msg.vd_GetDeviceInfo.virtualDeviceId;
-		retval.deviceType = resp.msg.vd_GetDeviceInfo.deviceType;
-		retval.deviceSerial = resp.msg.vd_GetDeviceInfo.deviceSerial;
-		return retval;
 	} else {
 		throw vrinputemulator_connectionerror("No active connection.");
 	}
 }
 
 
-vr::DriverPose_t VRInputEmulator::getVirtualDevicePose(uint32_t virtualDeviceId) {
-	if (_ipcServerQueue) {
-		uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-		ipc::Request message(ipc::RequestType::VirtualDevices_GetDevicePose);
-		message.msg.vd_GenericDeviceIdMessage.clientId = m_clientId;
-		message.msg.vd_GenericDeviceIdMessage.messageId = messageId;
-		message.msg.vd_GenericDeviceIdMessage.deviceId = virtualDeviceId;
-		std::promise<ipc::Reply> respPromise;
-		auto respFuture = respPromise.get_future();
-		{
-			std::lock_guard<std::recursive_mutex> lock(_mutex);
-			_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-		}
-		_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-		auto resp = respFuture.get();
-		{
-			std::lock_guard<std::recursive_mutex> lock(_mutex);
-			_ipcPromiseMap.erase(messageId);
-		}
-		std::stringstream ss;
-		ss << "Error while getting device info: ";
-		if (resp.status == ipc::ReplyStatus::InvalidId) {
-			ss << "Invalid device id";
-			throw vrinputemulator_invalidid(ss.str());
-		} else if (resp.status == ipc::ReplyStatus::NotFound) {
-			ss << "Device not found";
-			throw vrinputemulator_notfound(ss.str());
-		} else if (resp.status != ipc::ReplyStatus::Ok) {
-			ss << "Error code " << (int)resp.status;
-			throw vrinputemulator_exception(ss.str());
-		}
-		return resp.msg.vd_GetDevicePose.pose;
-	} else {
-		throw vrinputemulator_connectionerror("No active connection.");
+void VRInputEmulator::discardBatch() {
+	std::lock_guard<std::mutex> lock(_batchMutex);
+	if (_batchActive && _batchThread == std::this_thread::get_id()) {
+		_batchActive = false;
+		_batchData.clear();
 	}
 }
 
 
-vr::VRControllerState_t VRInputEmulator::getVirtualControllerState(uint32_t virtualDeviceId) {
-	if (_ipcServerQueue) {
-		uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-		ipc::Request message(ipc::RequestType::VirtualDevices_GetControllerState);
-		message.msg.vd_GenericDeviceIdMessage.clientId = m_clientId;
-		message.msg.vd_GenericDeviceIdMessage.messageId = messageId;
-		message.msg.vd_GenericDeviceIdMessage.deviceId = virtualDeviceId;
-		std::promise<ipc::Reply> respPromise;
-		auto respFuture = respPromise.get_future();
-		{
-			std::lock_guard<std::recursive_mutex> lock(_mutex);
-			_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-		}
-		_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-		auto resp = respFuture.get();
-		{
-			std::lock_guard<std::recursive_mutex> lock(_mutex);
-			_ipcPromiseMap.erase(messageId);
-		}
-		std::stringstream ss;
-		ss << "Error while getting device info: ";
-		if (resp.status == ipc::ReplyStatus::InvalidId) {
-			ss << "Invalid device id";
-			throw vrinputemulator_invalidid(ss.str());
-		} else if (resp.status == ipc::ReplyStatus::NotFound) {
-			ss << "Device not found";
-			throw vrinputemulator_notfound(ss.str());
-		} else if (resp.status == ipc::ReplyStatus::InvalidType) {
-			ss << "Device type does not support this";
-			throw vrinputemulator_invalidtype(ss.str());
-		} else if (resp.status != ipc::ReplyStatus::Ok) {
-			ss << "Error code " << (int)resp.status;
-			throw vrinputemulator_exception(ss.str());
+// Appends a fire-and-forget request to the batch of the calling thread. Returns false when the calling
+// thread has no active batch or the request cannot be batched.
+bool VRInputEmulator::_addToBatch(const ipc::Request& message) {
+	if (!_batchActive) {
+		return false;
+	}
+	std::lock_guard<std::mutex> lock(_batchMutex);
+	if (!_batchActive || _batchThread != std::this_thread::get_id()) {
+		return false;
+	}
+	switch (message.type) {
+	case ipc::RequestType::OpenVR_PoseUpdate:
+	case ipc::RequestType::OpenVR_ButtonEvent:
+	case ipc::RequestType::OpenVR_AxisEvent:
+	case ipc::RequestType::OpenVR_ProximitySensorEvent:
+	case ipc::RequestType::OpenVR_VendorSpecificEvent:
+	case ipc::RequestType::VirtualDevices_SetDevicePose:
+	case ipc::RequestType::VirtualDevices_SetControllerState:
+		break;
+	default:
+		return false;
+	}
+	const ipc::Request* op = &message;
+	ipc::Request merged;
+	if (_batchData.size() > _batchLastOpOffset) {
+		// Merge consecutive button/axis events into the previous record as long as there is room
+		ipc::Request_BatchOpHeader lastHeader;
+		std::memcpy(&lastHeader, _batchData.data() + _batchLastOpOffset, sizeof(ipc::Request_BatchOpHeader));
+		if (lastHeader.type == message.type && (message.type == ipc::RequestType::OpenVR_ButtonEvent || message.type == ipc::RequestType::OpenVR_AxisEvent)) {
+			merged = ipc::Request(message.type, message.timestamp);
+			std::memcpy(&merged.msg, _batchData.data() + _batchLastOpOffset + sizeof(ipc::Request_BatchOpHeader), lastHeader.length);
+			if (message.type == ipc::RequestType::OpenVR_ButtonEvent) {
+				auto& events = merged.msg.ipc_ButtonEvent;
+				if (events.eventCount + message.msg.ipc_ButtonEvent.eventCount <= REQUEST_OPENVR_BUTTONEVENT_MAXCOUNT) {
+					for (unsigned i = 0; i < message.msg.ipc_ButtonEvent.eventCount; ++i) {
+						events.events[events.eventCount++] = message.msg.ipc_ButtonEvent.events[i];
+					}
+					op = &merged;
+				}
+			} else {
+				auto& events = merged.msg.ipc_AxisEvent;
+				if (events.eventCount + message.msg.ipc_AxisEvent.eventCount <= REQUEST_OPENVR_AXISEVENT_MAXCOUNT) {
+					for (unsigned i = 0; i < message.msg.ipc_AxisEvent.eventCount; ++i) {
+						events.events[events.eventCount++] = message.msg.ipc_AxisEvent.events[i];
+					}
+					op = &merged;
+				}
+			}
+			if (op == &merged) {
+				_batchData.resize(_batchLastOpOffset); // replaced by the merged record
+			}
 		}
-		return resp.msg.vd_GetControllerState.controllerState;
+	}
+	ipc::Request_BatchOpHeader header;
+	header.type = op->type;
+	header.length = op->payloadSize();
+	_batchLastOpOffset = _batchData.size();
+	_batchData.resize(_batchLastOpOffset + sizeof(ipc::Request_BatchOpHeader) + ((header.length + 7) & ~7u), 0);
+	std::memcpy(_batchData.data() + _batchLastOpOffset, &header, sizeof(ipc::Request_BatchOpHeader));
+	std::memcpy(_batchData.data() + _batchLastOpOffset + sizeof(ipc::Request_BatchOpHeader), &op->msg, header.length);
+	return true;
+}
+
+
+// Throws the exception that matches the status of a reply. invalidTypeReason is used for ReplyStatus::InvalidType,
+// when it is nullptr InvalidType is reported like any other error code.
+static void _checkReplyStatus(const ipc::Reply& resp, const char* errorContext, const char* invalidTypeReason = nullptr) {
+	if (resp.status == ipc::ReplyStatus::Ok) {
+		return;
+	}
+	std::stringstream ss;
+	ss << errorContext;
+	if (resp.status == ipc::ReplyStatus::InvalidId) {
+		ss << "Invalid device id";
+		throw vrinputemulator_invalidid(ss.str());
+	} else if (resp.status == ipc::ReplyStatus::NotFound) {
+		ss << "Device not found";
+		throw vrinputemulator_notfound(ss.str());
+	} else if (resp.status == ipc::ReplyStatus::InvalidType && invalidTypeReason) {
+		ss << invalidTypeReason;
+		throw vrinputemulator_invalidtype(ss.str());
+	} else if (resp.status == ipc::ReplyStatus::QueueFull) {
+		ss << "Driver is busy, request has been rejected";
+		throw vrinputemulator_exception(ss.str());
 	} else {
-		throw vrinputemulator_connectionerror("No active connection.");
+		ss << "Error code " << (int)resp.status;
+		throw vrinputemulator_exception(ss.str());
 	}
 }
 
+template<typename T>
+static void _fulfillPromise(std::promise<T>& promise, const std::function<T(const ipc::Reply&)>& replyHandler, const ipc::Reply& reply) {
+	promise.set_value(replyHandler(reply));
+}
 
-uint32_t VRInputEmulator::addVirtualDevice(VirtualDeviceType deviceType, const std::string & deviceSerial, bool softfail) {
-	if (_ipcServerQueue) {
-		uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-		ipc::Request message(ipc::RequestType::VirtualDevices_AddDevice);
-		message.msg.vd_AddDevice.clientId = m_clientId;
-		message.msg.vd_AddDevice.messageId = messageId;
-		message.msg.vd_AddDevice.deviceType = deviceType;
-		strncpy_s(message.msg.vd_AddDevice.deviceSerial, deviceSerial.c_str(), 127);
-		message.msg.vd_AddDevice.deviceSerial[127] = '\0';
-		std::promise<ipc::Reply> respPromise;
-		auto respFuture = respPromise.get_future();
-		{
-			std::lock_guard<std::recursive_mutex> lock(_mutex);
-			_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-		}
-		_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-		auto resp = respFuture.get();
-		{
-			std::lock_guard<std::recursive_mutex> lock(_mutex);
-			_ipcPromiseMap.erase(messageId);
+template<>
+void _fulfillPromise<void>(std::promise<void>& promise, const std::function<void(const ipc::Reply&)>& replyHandler, const ipc::Reply& reply) {
+	replyHandler(reply);
+	promise.set_value();
+}
+
+// Sends the request and blocks until the reply arrives. Returns the result of the reply handler.
+template<typename T>
+T VRInputEmulator::_sendAndWait(ipc::Request& message, uint32_t& messageId, const std::function<T(const ipc::Reply&)>& replyHandler) {
+	if (!_ipcServerQueue) {
+		throw vrinputemulator_connectionerror("No active connection.");
+	}
+	messageId = _claimPendingSlot();
+	try {
+		_sendRequest(message);
+	} catch (...) {
+		_releasePendingSlot(messageId);
+		throw;
+	}
+	return replyHandler(_waitForReply(messageId));
+}
+
+// Sends the request and returns immediately. The reply handler is called on the ipc thread
+// when the reply arrives, its result (or exception) is delivered through the returned future.
+template<typename T>
+std::future<T> VRInputEmulator::_sendAsync(ipc::Request& message, uint32_t& messageId, const std::function<T(const ipc::Reply&)>& replyHandler) {
+	if (!_ipcServerQueue) {
+		throw vrinputemulator_connectionerror("No active connection.");
+	}
+	auto promise = std::make_shared<std::promise<T>>();
+	auto future = promise->get_future();
+	messageId = _claimPendingSlot([promise, replyHandler](const ipc::Reply* reply, bool timedOut) {
+		try {
+			if (timedOut) {
+				throw vrinputemulator_exception("Timed out waiting for the reply.");
+			} else if (!reply) {
+				throw vrinputemulator_connectionerror("Connection closed before the reply arrived.");
+			}
+			_fulfillPromise<T>(*promise, replyHandler, *reply);
+		} catch (...) {
+			promise->set_exception(std::current_exception());
 		}
+	});
+	try {
+		_sendRequest(message);
+	} catch (...) {
+		_releasePendingSlot(messageId);
+		throw;
+	}
+	return future;
+}
+
+
+static std::function<void(const ipc::Reply&)> _statusReply(const char* errorContext, const char* invalidTypeReason = nullptr) {
+	return [errorContext, invalidTypeReason](const ipc::Reply& resp) {
+		_checkReplyStatus(resp, errorContext, invalidTypeReason);
+	};
+}
+
+static uint32_t _virtualDeviceCountReply(const ipc::Reply& resp) {
+	_checkReplyStatus(resp, "Error while getting device count: ");
+	return resp.msg.vd_GetDeviceCount.deviceCount;
+}
+
+static VirtualDeviceInfo _virtualDeviceInfoReply(const ipc::Reply& resp) {
+	_checkReplyStatus(resp, "Error while getting device info: ");
+	VirtualDeviceInfo retval;
+	retval.openvrDeviceId = resp.msg.vd_GetDeviceInfo.openvrDeviceId;
+	retval.virtualDeviceId = resp.msg.vd_GetDeviceInfo.virtualDeviceId;
+	retval.deviceType = resp.msg.vd_GetDeviceInfo.deviceType;
+	retval.deviceSerial = resp.msg.vd_GetDeviceInfo.deviceSerial;
+	return retval;
+}
+
+static vr::DriverPose_t _virtualDevicePoseReply(const ipc::Reply& resp) {
+	_checkReplyStatus(resp, "Error while getting device info: ");
+	return resp.msg.vd_GetDevicePose.pose;
+}
+
+static vr::VRControllerState_t _virtualControllerStateReply(const ipc::Reply& resp) {
+	_checkReplyStatus(resp, "Error while getting device info: ", "Device type does not support this");
+	return resp.msg.vd_GetControllerState.controllerState;
+}
+
+static std::function<uint32_t(const ipc::Reply&)> _addVirtualDeviceReply(bool softfail) {
+	return [softfail](const ipc::Reply& resp) {
 		std::stringstream ss;
 		ss << "Error while adding device: ";
 		if (resp.status == ipc::ReplyStatus::TooManyDevices) {
@@ -467,1147 +862,946 @@ uint32_t VRInputEmulator::addVirtualDevice(VirtualDeviceType deviceType, const s
 			throw vrinputemulator_exception(ss.str());
 		}
 		return resp.msg.vd_AddDevice.virtualDeviceId;
-	} else {
-		throw vrinputemulator_connectionerror("No active connection.");
-	}
+	};
 }
 
-
-void VRInputEmulator::publishVirtualDevice(uint32_t virtualDeviceId, bool modal) {
-	if (_ipcServerQueue) {
-		uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-		ipc::Request message(ipc::RequestType::VirtualDevices_PublishDevice);
-		message.msg.vd_GenericDeviceIdMessage.clientId = m_clientId;
-		message.msg.vd_GenericDeviceIdMessage.messageId = messageId;
-		message.msg.vd_GenericDeviceIdMessage.deviceId = virtualDeviceId;
-		std::promise<ipc::Reply> respPromise;
-		auto respFuture = respPromise.get_future();
-		{
-			std::lock_guard<std::recursive_mutex> lock(_mutex);
-			_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-		}
-		_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-		auto resp = respFuture.get();
-		{
-			std::lock_guard<std::recursive_mutex> lock(_mutex);
-			_ipcPromiseMap.erase(messageId);
-		}
-		std::stringstream ss;
-		ss << "Error while publishing device: ";
-		if (resp.status == ipc::ReplyStatus::InvalidId) {
-			ss << "Invalid device id";
-			throw vrinputemulator_invalidid(ss.str());
-		} else if (resp.status == ipc::ReplyStatus::NotFound) {
-			ss << "Device not found";
-			throw vrinputemulator_notfound(ss.str());
-		} else if (resp.status != ipc::ReplyStatus::Ok) {
-			ss << "Error code " << (int)resp.status;
-			throw vrinputemulator_exception(ss.str());
-		}
-	} else {
-		throw vrinputemulator_connectionerror("No active connection.");
-	}
+static DeviceOffsets _deviceOffsetsReply(const ipc::Reply& resp) {
+	_checkReplyStatus(resp, "Error while enabling device offsets: ");
+	DeviceOffsets data;
+	memcpy(&data, &resp.msg.dm_deviceOffsets, sizeof(DeviceOffsets));
+	return data;
 }
 
-void VRInputEmulator::_setVirtualDeviceProperty(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty, std::function<void(ipc::Request&)> dataHandler, bool modal) {
-	if (_ipcServerQueue) {
-		ipc::Request message(ipc::RequestType::VirtualDevices_SetDeviceProperty);
-		message.msg.vd_SetDeviceProperty.clientId = m_clientId;
-		message.msg.vd_SetDeviceProperty.virtualDeviceId = virtualDeviceId;
-		message.msg.vd_SetDeviceProperty.deviceProperty = deviceProperty;
-		dataHandler(message);
-		if (modal) {
-			uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-			message.msg.vd_SetDeviceProperty.messageId = messageId;
-			std::promise<ipc::Reply> respPromise;
-			auto respFuture = respPromise.get_future();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-			}
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-			auto resp = respFuture.get();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.erase(messageId);
-			}
-			std::stringstream ss;
-			ss << "Error while setting device property: ";
-			if (resp.status == ipc::ReplyStatus::InvalidId) {
-				ss << "Invalid device id";
-				throw vrinputemulator_invalidid(ss.str());
-			} else if (resp.status == ipc::ReplyStatus::NotFound) {
-				ss << "Device not found";
-				throw vrinputemulator_notfound(ss.str());
-			} else if (resp.status == ipc::ReplyStatus::InvalidType) {
-				ss << "Invalid value type";
-				throw vrinputemulator_invalidtype(ss.str());
-			} else if (resp.status != ipc::ReplyStatus::Ok) {
-				ss << "Error code " << (int)resp.status;
-				throw vrinputemulator_exception(ss.str());
-			}
-		} else {
-			message.msg.vd_SetDeviceProperty.messageId = 0;
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-		}
-	} else {
-		throw vrinputemulator_connectionerror("No active connection.");
-	}
+static DeviceInfo _deviceInfoReply(const ipc::Reply& resp) {
+	_checkReplyStatus(resp, "Error while getting device info: ");
+	DeviceInfo info;
+	info.deviceId = resp.msg.dm_deviceInfo.deviceId;
+	info.deviceClass = resp.msg.dm_deviceInfo.deviceClass;
+	info.deviceMode = resp.msg.dm_deviceInfo.deviceMode;
+	info.offsetsEnabled = resp.msg.dm_deviceInfo.offsetsEnabled;
+	info.buttonMappingEnabled = resp.msg.dm_deviceInfo.buttonMappingEnabled;
+	info.redirectSuspended = resp.msg.dm_deviceInfo.redirectSuspended;
+	return info;
 }
 
-void VRInputEmulator::setVirtualDeviceProperty(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty, int32_t value, bool modal) {
-	_setVirtualDeviceProperty(virtualDeviceId, deviceProperty, [value](ipc::Request& msg) {
-		msg.msg.vd_SetDeviceProperty.valueType = DevicePropertyValueType::INT32;
-		msg.msg.vd_SetDeviceProperty.value.int32Value = value;
-	}, modal);
+static ClientStatus _clientStatusReply(const ipc::Reply& resp) {
+	_checkReplyStatus(resp, "Error while getting client status: ");
+	ClientStatus status;
+	status.replyOverflowPolicy = resp.msg.ipc_ClientStatus.replyOverflowPolicy;
+	status.pendingReplies = resp.msg.ipc_ClientStatus.pendingReplies;
+	status.repliesSent = resp.msg.ipc_ClientStatus.repliesSent;
+	status.repliesDropped = resp.msg.ipc_ClientStatus.repliesDropped;
+	return status;
 }
 
-void VRInputEmulator::setVirtualDeviceProperty(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty, uint64_t value, bool modal) {
-	_setVirtualDeviceProperty(virtualDeviceId, deviceProperty, [value](ipc::Request& msg) {
-		msg.msg.vd_SetDeviceProperty.valueType = DevicePropertyValueType::UINT64;
-		msg.msg.vd_SetDeviceProperty.value.uint64Value = value;
-	}, modal);
+
+static ipc::Request _getClientStatusRequest(uint32_t clientId) {
+	ipc::Request message(ipc::RequestType::IPC_ClientStatus);
+	message.msg.ipc_ClientStatus.clientId = clientId;
+	message.msg.ipc_ClientStatus.messageId = 0;
+	return message;
 }
 
-void VRInputEmulator::setVirtualDeviceProperty(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty, float value, bool modal) {
-	_setVirtualDeviceProperty(virtualDeviceId, deviceProperty, [value](ipc::Request& msg) {
-		msg.msg.vd_SetDeviceProperty.valueType = DevicePropertyValueType::FLOAT;
-		msg.msg.vd_SetDeviceProperty.value.floatValue = value;
-	}, modal);
+ClientStatus VRInputEmulator::getClientStatus() {
+	auto message = _getClientStatusRequest(m_clientId);
+	return _sendAndWait<ClientStatus>(message, message.msg.ipc_ClientStatus.messageId, _clientStatusReply);
 }
 
-void VRInputEmulator::setVirtualDeviceProperty(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty, bool value, bool modal) {
-	_setVirtualDeviceProperty(virtualDeviceId, deviceProperty, [value](ipc::Request& msg) {
-		msg.msg.vd_SetDeviceProperty.valueType = DevicePropertyValueType::BOOL;
-		msg.msg.vd_SetDeviceProperty.value.boolValue = value;
-	}, modal);
+std::future<ClientStatus> VRInputEmulator::getClientStatusAsync() {
+	auto message = _getClientStatusRequest(m_clientId);
+	return _sendAsync<ClientStatus>(message, message.msg.ipc_ClientStatus.messageId, _clientStatusReply);
 }
 
-void VRInputEmulator::setVirtualDeviceProperty(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty, const vr::HmdMatrix34_t& value, bool modal) {
-	_setVirtualDeviceProperty(virtualDeviceId, deviceProperty, [value](ipc::Request& msg) {
+
+static TraceDumpInfo _dumpTraceReply(const ipc::Reply& resp) {
+	if (resp.status == ipc::ReplyStatus::InvalidOperation) {
+		throw vrinputemulator_exception("Error while dumping hook trace: Not a bare file name");
+	}
+	_checkReplyStatus(resp, "Error while dumping hook trace: ");
+	TraceDumpInfo info;
+	info.recordCount = resp.msg.dbg_DumpTrace.recordCount;
+	info.threadCount = resp.msg.dbg_DumpTrace.threadCount;
+	info.path.assign(resp.msg.dbg_DumpTrace.path, strnlen(resp.msg.dbg_DumpTrace.path, sizeof(resp.msg.dbg_DumpTrace.path)));
+	return info;
+}
+
+static ipc::Request _dumpTraceRequest(uint32_t clientId, const std::string& fileName) {
+	ipc::Request message(ipc::RequestType::Debug_DumpTrace);
+	message.msg.dbg_DumpTrace.clientId = clientId;
+	message.msg.dbg_DumpTrace.messageId = 0;
+	strncpy_s(message.msg.dbg_DumpTrace.fileName, fileName.c_str(), 255);
+	return message;
+}
+
+TraceDumpInfo VRInputEmulator::dumpTrace(const std::string& fileName) {
+	auto message = _dumpTraceRequest(m_clientId, fileName);
+	return _sendAndWait<TraceDumpInfo>(message, message.msg.dbg_DumpTrace.messageId, _dumpTraceReply);
+}
+
+std::future<TraceDumpInfo> VRInputEmulator::dumpTraceAsync(const std::string& fileName) {
+	auto message = _dumpTraceRequest(m_clientId, fileName);
+	return _sendAsync<TraceDumpInfo>(message, message.msg.dbg_DumpTrace.messageId, _dumpTraceReply);
+}
+
+
+static ipc::Reply_Debug_GetHookStats _getHookStatsReply(const ipc::Reply& resp) {
+	_checkReplyStatus(resp, "Error while getting hook stats: ");
+	return resp.msg.dbg_GetHookStats;
+}
+
+trace::HookStats VRInputEmulator::getHookStats() {
+	if (_ipcServerQueue) {
+		trace::HookStats stats;
+		uint32_t firstEntry = 0;
+		while (true) {
+			ipc::Request message(ipc::RequestType::Debug_GetHookStats);
+			message.msg.dbg_GetHookStats.clientId = m_clientId;
+			message.msg.dbg_GetHookStats.firstEntry = firstEntry;
+			auto page = _sendAndWait<ipc::Reply_Debug_GetHookStats>(message, message.msg.dbg_GetHookStats.messageId, _getHookStatsReply);
+			if (firstEntry == 0) {
+				stats.sampleTimeNs = page.sampleTimeNs;
+			}
+			auto entryCount = std::min<uint32_t>(page.entryCount, HOOKSTATS_ENTRIES_PER_REPLY);
+			stats.entries.insert(stats.entries.end(), page.entries, page.entries + entryCount);
+			firstEntry += entryCount;
+			if (entryCount == 0 || firstEntry >= page.totalEntries) {
+				break;
+			}
+		}
+		return stats;
+	} else {
+		throw vrinputemulator_connectionerror("No active connection.");
+	}
+}
+
+
+void VRInputEmulator::setLatencyTracing(bool enable) {
+	if (_ipcServerQueue) {
+		ipc::Request message(ipc::RequestType::Debug_SetLatencyTracing);
+		message.msg.dbg_SetLatencyTracing.clientId = m_clientId;
+		message.msg.dbg_SetLatencyTracing.enable = enable ? 1 : 0;
+		_sendAndWait<void>(message, message.msg.dbg_SetLatencyTracing.messageId, _statusReply("Error while setting latency tracing: "));
+		_latencyTracing = enable;
+	} else {
+		throw vrinputemulator_connectionerror("No active connection.");
+	}
+}
+
+
+static ipc::Reply_Debug_GetLatencyStats _getLatencyStatsReply(const ipc::Reply& resp) {
+	_checkReplyStatus(resp, "Error while getting latency stats: ");
+	return resp.msg.dbg_GetLatencyStats;
+}
+
+trace::LatencyStats VRInputEmulator::getLatencyStats() {
+	if (_ipcServerQueue) {
+		trace::LatencyStats stats;
+		uint32_t firstEntry = 0;
+		while (true) {
+			ipc::Request message(ipc::RequestType::Debug_GetLatencyStats);
+			message.msg.dbg_GetLatencyStats.clientId = m_clientId;
+			message.msg.dbg_GetLatencyStats.firstEntry = firstEntry;
+			auto page = _sendAndWait<ipc::Reply_Debug_GetLatencyStats>(message, message.msg.dbg_GetLatencyStats.messageId, _getLatencyStatsReply);
+			if (firstEntry == 0) {
+				stats.sampleTimeNs = page.sampleTimeNs;
+			}
+			auto entryCount = std::min<uint32_t>(page.entryCount, LATENCYSTATS_ENTRIES_PER_REPLY);
+			stats.entries.insert(stats.entries.end(), page.entries, page.entries + entryCount);
+			firstEntry += entryCount;
+			if (entryCount == 0 || firstEntry >= page.totalEntries) {
+				break;
+			}
+		}
+		return stats;
+	} else {
+		throw vrinputemulator_connectionerror("No active connection.");
+	}
+}
+
+
+uint32_t VRInputEmulator::clientId() const {
+	return m_clientId;
+}
+
+
+static ipc::Request _getVirtualDeviceCountRequest(uint32_t clientId) {
+	ipc::Request message(ipc::RequestType::VirtualDevices_GetDeviceCount);
+	message.msg.vd_GenericClientMessage.clientId = clientId;
+	message.msg.vd_GenericClientMessage.messageId = 0;
+	return message;
+}
+
+uint32_t VRInputEmulator::getVirtualDeviceCount() {
+	auto message = _getVirtualDeviceCountRequest(m_clientId);
+	return _sendAndWait<uint32_t>(message, message.msg.vd_GenericClientMessage.messageId, _virtualDeviceCountReply);
+}
+
+std::future<uint32_t> VRInputEmulator::getVirtualDeviceCountAsync() {
+	auto message = _getVirtualDeviceCountRequest(m_clientId);
+	return _sendAsync<uint32_t>(message, message.msg.vd_GenericClientMessage.messageId, _virtualDeviceCountReply);
+}
+
+
+static ipc::Request _getVirtualDeviceInfoRequest(uint32_t clientId, uint32_t virtualDeviceId) {
+	ipc::Request message(ipc::RequestType::VirtualDevices_GetDeviceInfo);
+	message.msg.vd_GenericDeviceIdMessage.clientId = clientId;
+	message.msg.vd_GenericDeviceIdMessage.messageId = 0;
+	message.msg.vd_GenericDeviceIdMessage.deviceId = virtualDeviceId;
+	return message;
+}
+
+VirtualDeviceInfo VRInputEmulator::getVirtualDeviceInfo(uint32_t virtualDeviceId) {
+	auto message = _getVirtualDeviceInfoRequest(m_clientId, virtualDeviceId);
+	return _sendAndWait<VirtualDeviceInfo>(message, message.msg.vd_GenericDeviceIdMessage.messageId, _virtualDeviceInfoReply);
+}
+
+std::future<VirtualDeviceInfo> VRInputEmulator::getVirtualDeviceInfoAsync(uint32_t virtualDeviceId) {
+	auto message = _getVirtualDeviceInfoRequest(m_clientId, virtualDeviceId);
+	return _sendAsync<VirtualDeviceInfo>(message, message.msg.vd_GenericDeviceIdMessage.messageId, _virtualDeviceInfoReply);
+}
+
+
+static ipc::Request _getVirtualDevicePoseRequest(uint32_t clientId, uint32_t virtualDeviceId) {
+	ipc::Request message(ipc::RequestType::VirtualDevices_GetDevicePose);
+	message.msg.vd_GenericDeviceIdMessage.clientId = clientId;
+	message.msg.vd_GenericDeviceIdMessage.messageId = 0;
+	message.msg.vd_GenericDeviceIdMessage.deviceId = virtualDeviceId;
+	return message;
+}
+
+vr::DriverPose_t VRInputEmulator::getVirtualDevicePose(uint32_t virtualDeviceId) {
+	auto message = _getVirtualDevicePoseRequest(m_clientId, virtualDeviceId);
+	return _sendAndWait<vr::DriverPose_t>(message, message.msg.vd_GenericDeviceIdMessage.messageId, _virtualDevicePoseReply);
+}
+
+std::future<vr::DriverPose_t> VRInputEmulator::getVirtualDevicePoseAsync(uint32_t virtualDeviceId) {
+	auto message = _getVirtualDevicePoseRequest(m_clientId, virtualDeviceId);
+	return _sendAsync<vr::DriverPose_t>(message, message.msg.vd_GenericDeviceIdMessage.messageId, _virtualDevicePoseReply);
+}
+
+
+static ipc::Request _getVirtualControllerStateRequest(uint32_t clientId, uint32_t virtualDeviceId) {
+	ipc::Request message(ipc::RequestType::VirtualDevices_GetControllerState);
+	message.msg.vd_GenericDeviceIdMessage.clientId = clientId;
+	message.msg.vd_GenericDeviceIdMessage.messageId = 0;
+	message.msg.vd_GenericDeviceIdMessage.deviceId = virtualDeviceId;
+	return message;
+}
+
+vr::VRControllerState_t VRInputEmulator::getVirtualControllerState(uint32_t virtualDeviceId) {
+	auto message = _getVirtualControllerStateRequest(m_clientId, virtualDeviceId);
+	return _sendAndWait<vr::VRControllerState_t>(message, message.msg.vd_GenericDeviceIdMessage.messageId, _virtualControllerStateReply);
+}
+
+std::future<vr::VRControllerState_t> VRInputEmulator::getVirtualControllerStateAsync(uint32_t virtualDeviceId) {
+	auto message = _getVirtualControllerStateRequest(m_clientId, virtualDeviceId);
+	return _sendAsync<vr::VRControllerState_t>(message, message.msg.vd_GenericDeviceIdMessage.messageId, _virtualControllerStateReply);
+}
+
+
+static ipc::Request _addVirtualDeviceRequest(uint32_t clientId, VirtualDeviceType deviceType, const std::string & deviceSerial) {
+	ipc::Request message(ipc::RequestType::VirtualDevices_AddDevice);
+	message.msg.vd_AddDevice.clientId = clientId;
+	message.msg.vd_AddDevice.messageId = 0;
+	message.msg.vd_AddDevice.deviceType = deviceType;
+	strncpy_s(message.msg.vd_AddDevice.deviceSerial, deviceSerial.c_str(), 127);
+	message.msg.vd_AddDevice.deviceSerial[127] = '\0';
+	return message;
+}
+
+uint32_t VRInputEmulator::addVirtualDevice(VirtualDeviceType deviceType, const std::string & deviceSerial, bool softfail) {
+	auto message = _addVirtualDeviceRequest(m_clientId, deviceType, deviceSerial);
+	return _sendAndWait<uint32_t>(message, message.msg.vd_AddDevice.messageId, _addVirtualDeviceReply(softfail));
+}
+
+std::future<uint32_t> VRInputEmulator::addVirtualDeviceAsync(VirtualDeviceType deviceType, const std::string & deviceSerial, bool softfail) {
+	auto message = _addVirtualDeviceRequest(m_clientId, deviceType, deviceSerial);
+	return _sendAsync<uint32_t>(message, message.msg.vd_AddDevice.messageId, _addVirtualDeviceReply(softfail));
+}
+
+
+static ipc::Request _publishVirtualDeviceRequest(uint32_t clientId, uint32_t virtualDeviceId) {
+	ipc::Request message(ipc::RequestType::VirtualDevices_PublishDevice);
+	message.msg.vd_GenericDeviceIdMessage.clientId = clientId;
+	message.msg.vd_GenericDeviceIdMessage.messageId = 0;
+	message.msg.vd_GenericDeviceIdMessage.deviceId = virtualDeviceId;
+	return message;
+}
+
+void VRInputEmulator::publishVirtualDevice(uint32_t virtualDeviceId, bool modal) {
+	auto message = _publishVirtualDeviceRequest(m_clientId, virtualDeviceId);
+	_sendAndWait<void>(message, message.msg.vd_GenericDeviceIdMessage.messageId, _statusReply("Error while publishing device: "));
+}
+
+std::future<void> VRInputEmulator::publishVirtualDeviceAsync(uint32_t virtualDeviceId) {
+	auto message = _publishVirtualDeviceRequest(m_clientId, virtualDeviceId);
+	return _sendAsync<void>(message, message.msg.vd_GenericDeviceIdMessage.messageId, _statusReply("Error while publishing device: "));
+}
+
+static ipc::Request _setVirtualDevicePropertyRequest(uint32_t clientId, uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty, const std::function<void(ipc::Request&)>& dataHandler) {
+	ipc::Request message(ipc::RequestType::VirtualDevices_SetDeviceProperty);
+	message.msg.vd_SetDeviceProperty.clientId = clientId;
+	message.msg.vd_SetDeviceProperty.messageId = 0;
+	message.msg.vd_SetDeviceProperty.virtualDeviceId = virtualDeviceId;
+	message.msg.vd_SetDeviceProperty.deviceProperty = deviceProperty;
+	dataHandler(message);
+	return message;
+}
+
+void VRInputEmulator::_setVirtualDeviceProperty(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty, std::function<void(ipc::Request&)> dataHandler, bool modal) {
+	auto message = _setVirtualDevicePropertyRequest(m_clientId, virtualDeviceId, deviceProperty, dataHandler);
+	if (modal) {
+		_sendAndWait<void>(message, message.msg.vd_SetDeviceProperty.messageId, _statusReply("Error while setting device property: ", "Invalid value type"));
+	} else {
+		_sendRequest(message);
+	}
+}
+
+std::future<void> VRInputEmulator::_setVirtualDevicePropertyAsync(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty, std::function<void(ipc::Request&)> dataHandler) {
+	auto message = _setVirtualDevicePropertyRequest(m_clientId, virtualDeviceId, deviceProperty, dataHandler);
+	return _sendAsync<void>(message, message.msg.vd_SetDeviceProperty.messageId, _statusReply("Error while setting device property: ", "Invalid value type"));
+}
+
+static std::function<void(ipc::Request&)> _devicePropertyValue(int32_t value) {
+	return [value](ipc::Request& msg) {
+		msg.msg.vd_SetDeviceProperty.valueType = DevicePropertyValueType::INT32;
+		msg.msg.vd_SetDeviceProperty.value.int32Value = value;
+	};
+}
+
+static std::function<void(ipc::Request&)> _devicePropertyValue(uint64_t value) {
+	return [value](ipc::Request& msg) {
+		msg.msg.vd_SetDeviceProperty.valueType = DevicePropertyValueType::UINT64;
+		msg.msg.vd_SetDeviceProperty.value.uint64Value = value;
+	};
+}
+
+static std::function<void(ipc::Request&)> _devicePropertyValue(float value) {
+	return [value](ipc::Request& msg) {
+		msg.msg.vd_SetDeviceProperty.valueType = DevicePropertyValueType::FLOAT;
+		msg.msg.vd_SetDeviceProperty.value.floatValue = value;
+	};
+}
+
+static std::function<void(ipc::Request&)> _devicePropertyValue(bool value) {
+	return [value](ipc::Request& msg) {
+		msg.msg.vd_SetDeviceProperty.valueType = DevicePropertyValueType::BOOL;
+		msg.msg.vd_SetDeviceProperty.value.boolValue = value;
+	};
+}
+
+static std::function<void(ipc::Request&)> _devicePropertyValue(const vr::HmdMatrix34_t& value) {
+	return [value](ipc::Request& msg) {
 		msg.msg.vd_SetDeviceProperty.valueType = DevicePropertyValueType::MATRIX34;
 		msg.msg.vd_SetDeviceProperty.value.matrix34Value = value;
-	}, modal);
+	};
 }
 
-void VRInputEmulator::setVirtualDeviceProperty(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty, const char* value, bool modal) {
-	_setVirtualDeviceProperty(virtualDeviceId, deviceProperty, [value](ipc::Request& msg) {
+static std::function<void(ipc::Request&)> _devicePropertyValue(const char* value) {
+	return [value](ipc::Request& msg) {
 		msg.msg.vd_SetDeviceProperty.valueType = DevicePropertyValueType::STRING;
 		strncpy_s(msg.msg.vd_SetDeviceProperty.value.stringValue, value, 255);
 		msg.msg.vd_SetDeviceProperty.value.stringValue[255] = '\0';
-	}, modal);
+	};
 }
 
-void VRInputEmulator::setVirtualDeviceProperty(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty, const std::string& value, bool modal) {
-	_setVirtualDeviceProperty(virtualDeviceId, deviceProperty, [value](ipc::Request& msg) {
+static std::function<void(ipc::Request&)> _devicePropertyValue(const std::string& value) {
+	return [value](ipc::Request& msg) {
 		msg.msg.vd_SetDeviceProperty.valueType = DevicePropertyValueType::STRING;
 		strncpy_s(msg.msg.vd_SetDeviceProperty.value.stringValue, value.c_str(), 255);
 		msg.msg.vd_SetDeviceProperty.value.stringValue[255] = '\0';
-	}, modal);
+	};
+}
+
+void VRInputEmulator::setVirtualDeviceProperty(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty, int32_t value, bool modal) {
+	_setVirtualDeviceProperty(virtualDeviceId, deviceProperty, _devicePropertyValue(value), modal);
+}
+
+void VRInputEmulator::setVirtualDeviceProperty(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty, uint64_t value, bool modal) {
+	_setVirtualDeviceProperty(virtualDeviceId, deviceProperty, _devicePropertyValue(value), modal);
+}
+
+void VRInputEmulator::setVirtualDeviceProperty(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty, float value, bool modal) {
+	_setVirtualDeviceProperty(virtualDeviceId, deviceProperty, _devicePropertyValue(value), modal);
+}
+
+void VRInputEmulator::setVirtualDeviceProperty(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty, bool value, bool modal) {
+	_setVirtualDeviceProperty(virtualDeviceId, deviceProperty, _devicePropertyValue(value), modal);
+}
+
+void VRInputEmulator::setVirtualDeviceProperty(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty, const vr::HmdMatrix34_t& value, bool modal) {
+	_setVirtualDeviceProperty(virtualDeviceId, deviceProperty, _devicePropertyValue(value), modal);
+}
+
+void VRInputEmulator::setVirtualDeviceProperty(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty, const char* value, bool modal) {
+	_setVirtualDeviceProperty(virtualDeviceId, deviceProperty, _devicePropertyValue(value), modal);
+}
+
+void VRInputEmulator::setVirtualDeviceProperty(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty, const std::string& value, bool modal) {
+	_setVirtualDeviceProperty(virtualDeviceId, deviceProperty, _devicePropertyValue(value), modal);
+}
+
+std::future<void> VRInputEmulator::setVirtualDevicePropertyAsync(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty, int32_t value) {
+	return _setVirtualDevicePropertyAsync(virtualDeviceId, deviceProperty, _devicePropertyValue(value));
+}
+
+std::future<void> VRInputEmulator::setVirtualDevicePropertyAsync(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty, uint64_t value) {
+	return _setVirtualDevicePropertyAsync(virtualDeviceId, deviceProperty, _devicePropertyValue(value));
+}
+
+std::future<void> VRInputEmulator::setVirtualDevicePropertyAsync(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty, float value) {
+	return _setVirtualDevicePropertyAsync(virtualDeviceId, deviceProperty, _devicePropertyValue(value));
+}
+
+std::future<void> VRInputEmulator::setVirtualDevicePropertyAsync(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty, bool value) {
+	return _setVirtualDevicePropertyAsync(virtualDeviceId, deviceProperty, _devicePropertyValue(value));
+}
+
+std::future<void> VRInputEmulator::setVirtualDevicePropertyAsync(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty, const vr::HmdMatrix34_t& value) {
+	return _setVirtualDevicePropertyAsync(virtualDeviceId, deviceProperty, _devicePropertyValue(value));
+}
+
+std::future<void> VRInputEmulator::setVirtualDevicePropertyAsync(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty, const char* value) {
+	return _setVirtualDevicePropertyAsync(virtualDeviceId, deviceProperty, _devicePropertyValue(std::string(value))); // value may not outlive this call
+}
+
+std::future<void> VRInputEmulator::setVirtualDevicePropertyAsync(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty, const std::string& value) {
+	return _setVirtualDevicePropertyAsync(virtualDeviceId, deviceProperty, _devicePropertyValue(value));
+}
+
+
+static ipc::Request _removeVirtualDevicePropertyRequest(uint32_t clientId, uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty) {
+	ipc::Request message(ipc::RequestType::VirtualDevices_RemoveDeviceProperty);
+	message.msg.vd_RemoveDeviceProperty.clientId = clientId;
+	message.msg.vd_RemoveDeviceProperty.messageId = 0;
+	message.msg.vd_RemoveDeviceProperty.virtualDeviceId = virtualDeviceId;
+	message.msg.vd_RemoveDeviceProperty.deviceProperty = deviceProperty;
+	return message;
 }
 
 void VRInputEmulator::removeVirtualDeviceProperty(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty, bool modal) {
-	if (_ipcServerQueue) {
-		ipc::Request message(ipc::RequestType::VirtualDevices_RemoveDeviceProperty);
-		message.msg.vd_RemoveDeviceProperty.clientId = m_clientId;
-		message.msg.vd_RemoveDeviceProperty.virtualDeviceId = virtualDeviceId;
-		message.msg.vd_RemoveDeviceProperty.deviceProperty = deviceProperty;
-		if (modal) {
-			uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-			message.msg.vd_RemoveDeviceProperty.messageId = messageId;
-			std::promise<ipc::Reply> respPromise;
-			auto respFuture = respPromise.get_future();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-			}
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-			auto resp = respFuture.get();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.erase(messageId);
-			}
-			std::stringstream ss;
-			ss << "Error while removing device property: ";
-			if (resp.status == ipc::ReplyStatus::InvalidId) {
-				ss << "Invalid device id";
-				throw vrinputemulator_invalidid(ss.str());
-			} else if (resp.status == ipc::ReplyStatus::NotFound) {
-				ss << "Device not found";
-				throw vrinputemulator_notfound(ss.str());
-			} else if (resp.status != ipc::ReplyStatus::Ok) {
-				ss << "Error code " << (int)resp.status;
-				throw vrinputemulator_exception(ss.str());
-			}
-		} else {
-			message.msg.vd_RemoveDeviceProperty.messageId = 0;
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-		}
+	auto message = _removeVirtualDevicePropertyRequest(m_clientId, virtualDeviceId, deviceProperty);
+	if (modal) {
+		_sendAndWait<void>(message, message.msg.vd_RemoveDeviceProperty.messageId, _statusReply("Error while removing device property: "));
 	} else {
-		throw vrinputemulator_connectionerror("No active connection.");
+		_sendRequest(message);
 	}
 }
 
+std::future<void> VRInputEmulator::removeVirtualDevicePropertyAsync(uint32_t virtualDeviceId, vr::ETrackedDeviceProperty deviceProperty) {
+	auto message = _removeVirtualDevicePropertyRequest(m_clientId, virtualDeviceId, deviceProperty);
+	return _sendAsync<void>(message, message.msg.vd_RemoveDeviceProperty.messageId, _statusReply("Error while removing device property: "));
+}
+
+static ipc::Request _setVirtualDevicePoseRequest(uint32_t clientId, uint32_t virtualDeviceId, const vr::DriverPose_t & pose) {
+	ipc::Request message(ipc::RequestType::VirtualDevices_SetDevicePose);
+	message.msg.vd_SetDevicePose.clientId = clientId;
+	message.msg.vd_SetDevicePose.messageId = 0;
+	message.msg.vd_SetDevicePose.virtualDeviceId = virtualDeviceId;
+	message.msg.vd_SetDevicePose.pose = pose;
+	return message;
+}
+
 void VRInputEmulator::setVirtualDevicePose(uint32_t virtualDeviceId, const vr::DriverPose_t & pose, bool modal) {
-	if (_ipcServerQueue) {
-		ipc::Request message(ipc::RequestType::VirtualDevices_SetDevicePose);
-		message.msg.vd_SetDevicePose.clientId = m_clientId;
-		message.msg.vd_SetDevicePose.virtualDeviceId = virtualDeviceId;
-		message.msg.vd_SetDevicePose.pose = pose;
-		if (modal) {
-			uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-			message.msg.vd_SetDevicePose.messageId = messageId;
-			std::promise<ipc::Reply> respPromise;
-			auto respFuture = respPromise.get_future();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-			}
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-			auto resp = respFuture.get();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.erase(messageId);
-			}
-			std::stringstream ss;
-			ss << "Error while setting device pose: ";
-			if (resp.status == ipc::ReplyStatus::InvalidId) {
-				ss << "Invalid device id";
-				throw vrinputemulator_invalidid(ss.str());
-			} else if (resp.status == ipc::ReplyStatus::NotFound) {
-				ss << "Device not found";
-				throw vrinputemulator_notfound(ss.str());
-			} else if (resp.status != ipc::ReplyStatus::Ok) {
-				ss << "Error code " << (int)resp.status;
-				throw vrinputemulator_exception(ss.str());
+	if (!_ipcServerQueue) {
+		throw vrinputemulator_connectionerror("No active connection.");
+	}
+	auto message = _setVirtualDevicePoseRequest(m_clientId, virtualDeviceId, pose);
+	if (modal) {
+		_sendAndWait<void>(message, message.msg.vd_SetDevicePose.messageId, _statusReply("Error while setting device pose: "));
+	} else {
+		if (_addToBatch(message)) {
+			// Gets sent on commitBatch()
+		} else if (_ipcPoseTable && _ipcPoseTable->writePose(virtualDeviceId, pose,
+				_latencyTracing.load(std::memory_order_relaxed) ? ipc::clockNs() : message.timestamp, m_clientId)) {
+			// Only the newest pose matters, so overwrite the device's slot instead of queueing the pose
+			if (_ipcPoseTable->needsWakeup()) {
+				_ipcDataDoorbell->post();
 			}
 		} else {
-			message.msg.vd_SetDevicePose.messageId = 0;
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
+			_sendDataRequest(message);
 		}
-	} else {
-		throw vrinputemulator_connectionerror("No active connection.");
 	}
 }
 
+std::future<void> VRInputEmulator::setVirtualDevicePoseAsync(uint32_t virtualDeviceId, const vr::DriverPose_t & pose) {
+	auto message = _setVirtualDevicePoseRequest(m_clientId, virtualDeviceId, pose);
+	return _sendAsync<void>(message, message.msg.vd_SetDevicePose.messageId, _statusReply("Error while setting device pose: "));
+}
+
+static ipc::Request _setVirtualControllerStateRequest(uint32_t clientId, uint32_t virtualDeviceId, const vr::VRControllerState_t & state) {
+	ipc::Request message(ipc::RequestType::VirtualDevices_SetControllerState);
+	message.msg.vd_SetControllerState.clientId = clientId;
+	message.msg.vd_SetControllerState.messageId = 0;
+	message.msg.vd_SetControllerState.virtualDeviceId = virtualDeviceId;
+	message.msg.vd_SetControllerState.controllerState = state;
+	return message;
+}
+
 void VRInputEmulator::setVirtualControllerState(uint32_t virtualDeviceId, const vr::VRControllerState_t & state, bool modal) {
-	if (_ipcServerQueue) {
-		ipc::Request message(ipc::RequestType::VirtualDevices_SetControllerState);
-		message.msg.vd_SetControllerState.clientId = m_clientId;
-		message.msg.vd_SetControllerState.virtualDeviceId = virtualDeviceId;
-		message.msg.vd_SetControllerState.controllerState = state;
-		if (modal) {
-			uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-			message.msg.vd_SetControllerState.messageId = messageId;
-			std::promise<ipc::Reply> respPromise;
-			auto respFuture = respPromise.get_future();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-			}
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-			auto resp = respFuture.get();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.erase(messageId);
-			}
-			std::stringstream ss;
-			ss << "Error while setting controller state: ";
-			if (resp.status == ipc::ReplyStatus::InvalidId) {
-				ss << "Invalid device id";
-				throw vrinputemulator_invalidid(ss.str());
-			} else if (resp.status == ipc::ReplyStatus::NotFound) {
-				ss << "Device not found";
-				throw vrinputemulator_notfound(ss.str());
-			} else if (resp.status == ipc::ReplyStatus::InvalidType) {
-				ss << "Device type does not support this operation";
-				throw vrinputemulator_invalidtype(ss.str());
-			} else if (resp.status != ipc::ReplyStatus::Ok) {
-				ss << "Error code " << (int)resp.status;
-				throw vrinputemulator_exception(ss.str());
-			}
-		} else {
-			message.msg.vd_SetControllerState.messageId = 0;
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-		}
+	auto message = _setVirtualControllerStateRequest(m_clientId, virtualDeviceId, state);
+	if (modal) {
+		_sendAndWait<void>(message, message.msg.vd_SetControllerState.messageId, _statusReply("Error while setting controller state: ", "Device type does not support this operation"));
 	} else {
-		throw vrinputemulator_connectionerror("No active connection.");
+		_sendDataRequest(message);
 	}
 }
 
-void VRInputEmulator::enableDeviceButtonMapping(uint32_t deviceId, bool enable, bool modal) {
-	if (_ipcServerQueue) {
-		ipc::Request message(ipc::RequestType::DeviceManipulation_ButtonMapping);
-		message.msg.dm_ButtonMapping.clientId = m_clientId;
-		message.msg.dm_ButtonMapping.messageId = 0;
-		message.msg.dm_ButtonMapping.deviceId = deviceId;
+std::future<void> VRInputEmulator::setVirtualControllerStateAsync(uint32_t virtualDeviceId, const vr::VRControllerState_t & state) {
+	auto message = _setVirtualControllerStateRequest(m_clientId, virtualDeviceId, state);
+	return _sendAsync<void>(message, message.msg.vd_SetControllerState.messageId, _statusReply("Error while setting controller state: ", "Device type does not support this operation"));
+}
+
+static ipc::Request _deviceButtonMappingRequest(uint32_t clientId, uint32_t deviceId, const std::function<void(ipc::Request&)>& dataHandler) {
+	ipc::Request message(ipc::RequestType::DeviceManipulation_ButtonMapping);
+	message.msg.dm_ButtonMapping.clientId = clientId;
+	message.msg.dm_ButtonMapping.messageId = 0;
+	message.msg.dm_ButtonMapping.deviceId = deviceId;
+	dataHandler(message);
+	return message;
+}
+
+void VRInputEmulator::_deviceButtonMapping(uint32_t deviceId, std::function<void(ipc::Request&)> dataHandler, bool modal) {
+	auto message = _deviceButtonMappingRequest(m_clientId, deviceId, dataHandler);
+	if (modal) {
+		_sendAndWait<void>(message, message.msg.dm_ButtonMapping.messageId, _statusReply("Error while enabling device offsets: "));
+	} else {
+		_sendRequest(message);
+	}
+}
+
+std::future<void> VRInputEmulator::_deviceButtonMappingAsync(uint32_t deviceId, std::function<void(ipc::Request&)> dataHandler) {
+	auto message = _deviceButtonMappingRequest(m_clientId, deviceId, dataHandler);
+	return _sendAsync<void>(message, message.msg.dm_ButtonMapping.messageId, _statusReply("Error while enabling device offsets: "));
+}
+
+static std::function<void(ipc::Request&)> _enableButtonMappingData(bool enable) {
+	return [enable](ipc::Request& message) {
 		message.msg.dm_ButtonMapping.enableMapping = enable ? 1 : 2;
 		message.msg.dm_ButtonMapping.mappingOperation = 0;
 		message.msg.dm_ButtonMapping.mappingCount = 0;
-		if (modal) {
-			uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-			message.msg.dm_ButtonMapping.messageId = messageId;
-			std::promise<ipc::Reply> respPromise;
-			auto respFuture = respPromise.get_future();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-			}
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-			auto resp = respFuture.get();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.erase(messageId);
-			}
-			std::stringstream ss;
-			ss << "Error while enabling device offsets: ";
-			if (resp.status == ipc::ReplyStatus::InvalidId) {
-				ss << "Invalid device id";
-				throw vrinputemulator_invalidid(ss.str());
-			} else if (resp.status == ipc::ReplyStatus::NotFound) {
-				ss << "Device not found";
-				throw vrinputemulator_notfound(ss.str());
-			} else if (resp.status != ipc::ReplyStatus::Ok) {
-				ss << "Error code " << (int)resp.status;
-				throw vrinputemulator_exception(ss.str());
-			}
-		} else {
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-		}
-	} else {
-		throw vrinputemulator_connectionerror("No active connection.");
-	}
+	};
 }
 
-void VRInputEmulator::addDeviceButtonMapping(uint32_t deviceId, vr::EVRButtonId button, vr::EVRButtonId mapped, bool modal) {
-	if (_ipcServerQueue) {
-		ipc::Request message(ipc::RequestType::DeviceManipulation_ButtonMapping);
-		message.msg.dm_ButtonMapping.clientId = m_clientId;
-		message.msg.dm_ButtonMapping.messageId = 0;
-		message.msg.dm_ButtonMapping.deviceId = deviceId;
+static std::function<void(ipc::Request&)> _addButtonMappingData(vr::EVRButtonId button, vr::EVRButtonId mapped) {
+	return [button, mapped](ipc::Request& message) {
 		message.msg.dm_ButtonMapping.enableMapping = 0;
 		message.msg.dm_ButtonMapping.mappingOperation = 1;
 		message.msg.dm_ButtonMapping.mappingCount = 1;
 		message.msg.dm_ButtonMapping.buttonMappings[0] = button;
 		message.msg.dm_ButtonMapping.buttonMappings[1] = mapped;
-		if (modal) {
-			uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-			message.msg.dm_ButtonMapping.messageId = messageId;
-			std::promise<ipc::Reply> respPromise;
-			auto respFuture = respPromise.get_future();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-			}
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-			auto resp = respFuture.get();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.erase(messageId);
-			}
-			std::stringstream ss;
-			ss << "Error while enabling device offsets: ";
-			if (resp.status == ipc::ReplyStatus::InvalidId) {
-				ss << "Invalid device id";
-				throw vrinputemulator_invalidid(ss.str());
-			} else if (resp.status == ipc::ReplyStatus::NotFound) {
-				ss << "Device not found";
-				throw vrinputemulator_notfound(ss.str());
-			} else if (resp.status != ipc::ReplyStatus::Ok) {
-				ss << "Error code " << (int)resp.status;
-				throw vrinputemulator_exception(ss.str());
-			}
-		} else {
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-		}
-	} else {
-		throw vrinputemulator_connectionerror("No active connection.");
-	}
+	};
 }
 
-void VRInputEmulator::removeDeviceButtonMapping(uint32_t deviceId, vr::EVRButtonId button, bool modal) {
-	if (_ipcServerQueue) {
-		ipc::Request message(ipc::RequestType::DeviceManipulation_ButtonMapping);
-		message.msg.dm_ButtonMapping.clientId = m_clientId;
-		message.msg.dm_ButtonMapping.messageId = 0;
-		message.msg.dm_ButtonMapping.deviceId = deviceId;
+static std::function<void(ipc::Request&)> _removeButtonMappingData(vr::EVRButtonId button) {
+	return [button](ipc::Request& message) {
 		message.msg.dm_ButtonMapping.enableMapping = 0;
 		message.msg.dm_ButtonMapping.mappingOperation = 2;
 		message.msg.dm_ButtonMapping.mappingCount = 1;
 		message.msg.dm_ButtonMapping.buttonMappings[0] = button;
-		if (modal) {
-			uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-			message.msg.dm_ButtonMapping.messageId = messageId;
-			std::promise<ipc::Reply> respPromise;
-			auto respFuture = respPromise.get_future();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-			}
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-			auto resp = respFuture.get();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.erase(messageId);
-			}
-			std::stringstream ss;
-			ss << "Error while enabling device offsets: ";
-			if (resp.status == ipc::ReplyStatus::InvalidId) {
-				ss << "Invalid device id";
-				throw vrinputemulator_invalidid(ss.str());
-			} else if (resp.status == ipc::ReplyStatus::NotFound) {
-				ss << "Device not found";
-				throw vrinputemulator_notfound(ss.str());
-			} else if (resp.status != ipc::ReplyStatus::Ok) {
-				ss << "Error code " << (int)resp.status;
-				throw vrinputemulator_exception(ss.str());
-			}
-		} else {
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-		}
-	} else {
-		throw vrinputemulator_connectionerror("No active connection.");
-	}
+	};
+}
+
+static void _removeAllButtonMappingsData(ipc::Request& message) {
+	message.msg.dm_ButtonMapping.enableMapping = 0;
+	message.msg.dm_ButtonMapping.mappingOperation = 3;
+	message.msg.dm_ButtonMapping.mappingCount = 0;
+}
+
+void VRInputEmulator::enableDeviceButtonMapping(uint32_t deviceId, bool enable, bool modal) {
+	_deviceButtonMapping(deviceId, _enableButtonMappingData(enable), modal);
+}
+
+std::future<void> VRInputEmulator::enableDeviceButtonMappingAsync(uint32_t deviceId, bool enable) {
+	return _deviceButtonMappingAsync(deviceId, _enableButtonMappingData(enable));
+}
+
+void VRInputEmulator::addDeviceButtonMapping(uint32_t deviceId, vr::EVRButtonId button, vr::EVRButtonId mapped, bool modal) {
+	_deviceButtonMapping(deviceId, _addButtonMappingData(button, mapped), modal);
+}
+
+std::future<void> VRInputEmulator::addDeviceButtonMappingAsync(uint32_t deviceId, vr::EVRButtonId button, vr::EVRButtonId mapped) {
+	return _deviceButtonMappingAsync(deviceId, _addButtonMappingData(button, mapped));
+}
+
+void VRInputEmulator::removeDeviceButtonMapping(uint32_t deviceId, vr::EVRButtonId button, bool modal) {
+	_deviceButtonMapping(deviceId, _removeButtonMappingData(button), modal);
+}
+
+std::future<void> VRInputEmulator::removeDeviceButtonMappingAsync(uint32_t deviceId, vr::EVRButtonId button) {
+	return _deviceButtonMappingAsync(deviceId, _removeButtonMappingData(button));
 }
 
 void VRInputEmulator::removeAllDeviceButtonMappings(uint32_t deviceId, bool modal) {
-	if (_ipcServerQueue) {
-		ipc::Request message(ipc::RequestType::DeviceManipulation_ButtonMapping);
-		message.msg.dm_ButtonMapping.clientId = m_clientId;
-		message.msg.dm_ButtonMapping.messageId = 0;
-		message.msg.dm_ButtonMapping.deviceId = deviceId;
-		message.msg.dm_ButtonMapping.enableMapping = 0;
-		message.msg.dm_ButtonMapping.mappingOperation = 3;
-		message.msg.dm_ButtonMapping.mappingCount = 0;
-		if (modal) {
-			uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-			message.msg.dm_ButtonMapping.messageId = messageId;
-			std::promise<ipc::Reply> respPromise;
-			auto respFuture = respPromise.get_future();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-			}
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-			auto resp = respFuture.get();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.erase(messageId);
-			}
-			std::stringstream ss;
-			ss << "Error while enabling device offsets: ";
-			if (resp.status == ipc::ReplyStatus::InvalidId) {
-				ss << "Invalid device id";
-				throw vrinputemulator_invalidid(ss.str());
-			} else if (resp.status == ipc::ReplyStatus::NotFound) {
-				ss << "Device not found";
-				throw vrinputemulator_notfound(ss.str());
-			} else if (resp.status != ipc::ReplyStatus::Ok) {
-				ss << "Error code " << (int)resp.status;
-				throw vrinputemulator_exception(ss.str());
-			}
-		} else {
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-		}
-	} else {
-		throw vrinputemulator_connectionerror("No active connection.");
-	}
+	_deviceButtonMapping(deviceId, _removeAllButtonMappingsData, modal);
+}
+
+std::future<void> VRInputEmulator::removeAllDeviceButtonMappingsAsync(uint32_t deviceId) {
+	return _deviceButtonMappingAsync(deviceId, _removeAllButtonMappingsData);
+}
+
+static ipc::Request _getDeviceOffsetsRequest(uint32_t clientId, uint32_t deviceId) {
+	ipc::Request message(ipc::RequestType::DeviceManipulation_GetDeviceOffsets);
+	memset(&message.msg, 0, sizeof(message.msg));
+	message.msg.vd_GenericDeviceIdMessage.clientId = clientId;
+	message.msg.vd_GenericDeviceIdMessage.messageId = 0;
+	message.msg.vd_GenericDeviceIdMessage.deviceId = deviceId;
+	return message;
 }
 
 void VRInputEmulator::getDeviceOffsets(uint32_t deviceId, DeviceOffsets & data) {
-	if (_ipcServerQueue) {
-		ipc::Request message(ipc::RequestType::DeviceManipulation_GetDeviceOffsets);
-		memset(&message.msg, 0, sizeof(message.msg));
-		message.msg.vd_GenericDeviceIdMessage.clientId = m_clientId;
-		message.msg.vd_GenericDeviceIdMessage.deviceId = deviceId;
-		uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-		message.msg.vd_GenericDeviceIdMessage.messageId = messageId;
-		std::promise<ipc::Reply> respPromise;
-		auto respFuture = respPromise.get_future();
-		{
-			std::lock_guard<std::recursive_mutex> lock(_mutex);
-			_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-		}
-		_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-		auto resp = respFuture.get();
-		{
-			std::lock_guard<std::recursive_mutex> lock(_mutex);
-			_ipcPromiseMap.erase(messageId);
-		}
-		std::stringstream ss;
-		ss << "Error while enabling device offsets: ";
-		if (resp.status == ipc::ReplyStatus::Ok) {
-			memcpy(&data, &resp.msg.dm_deviceOffsets, sizeof(DeviceOffsets));
-		} else if (resp.status == ipc::ReplyStatus::InvalidId) {
-			ss << "Invalid device id";
-			throw vrinputemulator_invalidid(ss.str());
-		} else if (resp.status == ipc::ReplyStatus::NotFound) {
-			ss << "Device not found";
-			throw vrinputemulator_notfound(ss.str());
-		} else if (resp.status != ipc::ReplyStatus::Ok) {
-			ss << "Error code " << (int)resp.status;
-			throw vrinputemulator_exception(ss.str());
-		}
+	auto message = _getDeviceOffsetsRequest(m_clientId, deviceId);
+	data = _sendAndWait<DeviceOffsets>(message, message.msg.vd_GenericDeviceIdMessage.messageId, _deviceOffsetsReply);
+}
+
+std::future<DeviceOffsets> VRInputEmulator::getDeviceOffsetsAsync(uint32_t deviceId) {
+	auto message = _getDeviceOffsetsRequest(m_clientId, deviceId);
+	return _sendAsync<DeviceOffsets>(message, message.msg.vd_GenericDeviceIdMessage.messageId, _deviceOffsetsReply);
+}
+
+
+static ipc::Request _setDeviceOffsetsRequest(uint32_t clientId, uint32_t deviceId, const std::function<void(ipc::Request&)>& dataHandler) {
+	ipc::Request message(ipc::RequestType::DeviceManipulation_SetDeviceOffsets);
+	memset(&message.msg, 0, sizeof(message.msg));
+	message.msg.dm_DeviceOffsets.clientId = clientId;
+	message.msg.dm_DeviceOffsets.messageId = 0;
+	message.msg.dm_DeviceOffsets.deviceId = deviceId;
+	dataHandler(message);
+	return message;
+}
+
+void VRInputEmulator::_setDeviceOffsets(uint32_t deviceId, std::function<void(ipc::Request&)> dataHandler, bool modal) {
+	auto message = _setDeviceOffsetsRequest(m_clientId, deviceId, dataHandler);
+	if (modal) {
+		_sendAndWait<void>(message, message.msg.dm_DeviceOffsets.messageId, _statusReply("Error while enabling device offsets: "));
 	} else {
-		throw vrinputemulator_connectionerror("No active connection.");
+		_sendRequest(message);
 	}
 }
 
+std::future<void> VRInputEmulator::_setDeviceOffsetsAsync(uint32_t deviceId, std::function<void(ipc::Request&)> dataHandler) {
+	auto message = _setDeviceOffsetsRequest(m_clientId, deviceId, dataHandler);
+	return _sendAsync<void>(message, message.msg.dm_DeviceOffsets.messageId, _statusReply("Error while enabling device offsets: "));
+}
 
-void VRInputEmulator::enableDeviceOffsets(uint32_t deviceId, bool enable, bool modal) {
-	if (_ipcServerQueue) {
-		ipc::Request message(ipc::RequestType::DeviceManipulation_SetDeviceOffsets);
-		memset(&message.msg, 0, sizeof(message.msg));
-		message.msg.dm_DeviceOffsets.clientId = m_clientId;
-		message.msg.dm_DeviceOffsets.messageId = 0;
-		message.msg.dm_DeviceOffsets.deviceId = deviceId;
+static std::function<void(ipc::Request&)> _enableOffsetsData(bool enable) {
+	return [enable](ipc::Request& message) {
 		message.msg.dm_DeviceOffsets.enableOffsets = enable ? 1 : 2;
-		if (modal) {
-			uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-			message.msg.dm_DeviceOffsets.messageId = messageId;
-			std::promise<ipc::Reply> respPromise;
-			auto respFuture = respPromise.get_future();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-			}
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-			auto resp = respFuture.get();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.erase(messageId);
-			}
-			std::stringstream ss;
-			ss << "Error while enabling device offsets: ";
-			if (resp.status == ipc::ReplyStatus::InvalidId) {
-				ss << "Invalid device id";
-				throw vrinputemulator_invalidid(ss.str());
-			} else if (resp.status == ipc::ReplyStatus::NotFound) {
-				ss << "Device not found";
-				throw vrinputemulator_notfound(ss.str());
-			} else if (resp.status != ipc::ReplyStatus::Ok) {
-				ss << "Error code " << (int)resp.status;
-				throw vrinputemulator_exception(ss.str());
-			}
-		} else {
-			message.msg.dm_DeviceOffsets.messageId = 0;
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-		}
-	} else {
-		throw vrinputemulator_connectionerror("No active connection.");
-	}
+	};
 }
 
-void VRInputEmulator::setWorldFromDriverRotationOffset(uint32_t deviceId, const vr::HmdQuaternion_t & value, bool modal) {
-	if (_ipcServerQueue) {
-		ipc::Request message(ipc::RequestType::DeviceManipulation_SetDeviceOffsets);
-		memset(&message.msg, 0, sizeof(message.msg));
-		message.msg.dm_DeviceOffsets.clientId = m_clientId;
-		message.msg.dm_DeviceOffsets.messageId = 0;
-		message.msg.dm_DeviceOffsets.deviceId = deviceId;
+static std::function<void(ipc::Request&)> _worldFromDriverRotationOffsetData(const vr::HmdQuaternion_t& value) {
+	return [value](ipc::Request& message) {
 		message.msg.dm_DeviceOffsets.worldFromDriverRotationOffsetValid = true;
 		message.msg.dm_DeviceOffsets.worldFromDriverRotationOffset = value;
-		if (modal) {
-			uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-			message.msg.dm_DeviceOffsets.messageId = messageId;
-			std::promise<ipc::Reply> respPromise;
-			auto respFuture = respPromise.get_future();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-			}
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-			auto resp = respFuture.get();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.erase(messageId);
-			}
-			std::stringstream ss;
-			ss << "Error while enabling device offsets: ";
-			if (resp.status == ipc::ReplyStatus::InvalidId) {
-				ss << "Invalid device id";
-				throw vrinputemulator_invalidid(ss.str());
-			} else if (resp.status == ipc::ReplyStatus::NotFound) {
-				ss << "Device not found";
-				throw vrinputemulator_notfound(ss.str());
-			} else if (resp.status != ipc::ReplyStatus::Ok) {
-				ss << "Error code " << (int)resp.status;
-				throw vrinputemulator_exception(ss.str());
-			}
-		} else {
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-		}
-	} else {
-		throw vrinputemulator_connectionerror("No active connection.");
-	}
+	};
 }
 
-void VRInputEmulator::setWorldFromDriverTranslationOffset(uint32_t deviceId, const vr::HmdVector3d_t & value, bool modal) {
-	if (_ipcServerQueue) {
-		ipc::Request message(ipc::RequestType::DeviceManipulation_SetDeviceOffsets);
-		memset(&message.msg, 0, sizeof(message.msg));
-		message.msg.dm_DeviceOffsets.clientId = m_clientId;
-		message.msg.dm_DeviceOffsets.messageId = 0;
-		message.msg.dm_DeviceOffsets.deviceId = deviceId;
-		message.msg.dm_DeviceOffsets.worldFromDriverTranslationOffsetValid = true;
-		message.msg.dm_DeviceOffsets.worldFromDriverTranslationOffset = value;
-		if (modal) {
-			uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-			message.msg.dm_DeviceOffsets.messageId = messageId;
-			std::promise<ipc::Reply> respPromise;
-			auto respFuture = respPromise.get_future();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-			}
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-			auto resp = respFuture.get();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.erase(messageId);
-			}
-			std::stringstream ss;
-			ss << "Error while enabling device offsets: ";
-			if (resp.status == ipc::ReplyStatus::InvalidId) {
-				ss << "Invalid device id";
-				throw vrinputemulator_invalidid(ss.str());
-			} else if (resp.status == ipc::ReplyStatus::NotFound) {
-				ss << "Device not found";
-				throw vrinputemulator_notfound(ss.str());
-			} else if (resp.status != ipc::ReplyStatus::Ok) {
-				ss << "Error code " << (int)resp.status;
-				throw vrinputemulator_exception(ss.str());
-			}
-		} else {
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-		}
-	} else {
-		throw vrinputemulator_connectionerror("No active connection.");
-	}
+static std::function<void(ipc::Request&)> _worldFromDriverTranslationOffsetData(const vr::HmdVector3d_t& value) {
+	return [value](ipc::Request& message) {
+		message.msg.dm_DeviceOffsets.worldFromDriverTranslationOffsetValid = true;
+		message.msg.dm_DeviceOffsets.worldFromDriverTranslationOffset = value;
+	};
 }
 
-void VRInputEmulator::setDriverFromHeadRotationOffset(uint32_t deviceId, const vr::HmdQuaternion_t & value, bool modal) {
-	if (_ipcServerQueue) {
-		ipc::Request message(ipc::RequestType::DeviceManipulation_SetDeviceOffsets);
-		memset(&message.msg, 0, sizeof(message.msg));
-		message.msg.dm_DeviceOffsets.clientId = m_clientId;
-		message.msg.dm_DeviceOffsets.messageId = 0;
-		message.msg.dm_DeviceOffsets.deviceId = deviceId;
+static std::function<void(ipc::Request&)> _driverFromHeadRotationOffsetData(const vr::HmdQuaternion_t& value) {
+	return [value](ipc::Request& message) {
 		message.msg.dm_DeviceOffsets.driverFromHeadRotationOffsetValid = true;
 		message.msg.dm_DeviceOffsets.driverFromHeadRotationOffset = value;
-		if (modal) {
-			uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-			message.msg.dm_DeviceOffsets.messageId = messageId;
-			std::promise<ipc::Reply> respPromise;
-			auto respFuture = respPromise.get_future();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-			}
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-			auto resp = respFuture.get();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.erase(messageId);
-			}
-			std::stringstream ss;
-			ss << "Error while enabling device offsets: ";
-			if (resp.status == ipc::ReplyStatus::InvalidId) {
-				ss << "Invalid device id";
-				throw vrinputemulator_invalidid(ss.str());
-			} else if (resp.status == ipc::ReplyStatus::NotFound) {
-				ss << "Device not found";
-				throw vrinputemulator_notfound(ss.str());
-			} else if (resp.status != ipc::ReplyStatus::Ok) {
-				ss << "Error code " << (int)resp.status;
-				throw vrinputemulator_exception(ss.str());
-			}
-		} else {
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-		}
-	} else {
-		throw vrinputemulator_connectionerror("No active connection.");
-	}
+	};
 }
 
-void VRInputEmulator::setDriverFromHeadTranslationOffset(uint32_t deviceId, const vr::HmdVector3d_t & value, bool modal) {
-	if (_ipcServerQueue) {
-		ipc::Request message(ipc::RequestType::DeviceManipulation_SetDeviceOffsets);
-		memset(&message.msg, 0, sizeof(message.msg));
-		message.msg.dm_DeviceOffsets.clientId = m_clientId;
-		message.msg.dm_DeviceOffsets.messageId = 0;
-		message.msg.dm_DeviceOffsets.deviceId = deviceId;
+static std::function<void(ipc::Request&)> _driverFromHeadTranslationOffsetData(const vr::HmdVector3d_t& value) {
+	return [value](ipc::Request& message) {
 		message.msg.dm_DeviceOffsets.driverFromHeadTranslationOffsetValid = true;
 		message.msg.dm_DeviceOffsets.driverFromHeadTranslationOffset = value;
-		if (modal) {
-			uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-			message.msg.dm_DeviceOffsets.messageId = messageId;
-			std::promise<ipc::Reply> respPromise;
-			auto respFuture = respPromise.get_future();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-			}
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-			auto resp = respFuture.get();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.erase(messageId);
-			}
-			std::stringstream ss;
-			ss << "Error while enabling device offsets: ";
-			if (resp.status == ipc::ReplyStatus::InvalidId) {
-				ss << "Invalid device id";
-				throw vrinputemulator_invalidid(ss.str());
-			} else if (resp.status == ipc::ReplyStatus::NotFound) {
-				ss << "Device not found";
-				throw vrinputemulator_notfound(ss.str());
-			} else if (resp.status != ipc::ReplyStatus::Ok) {
-				ss << "Error code " << (int)resp.status;
-				throw vrinputemulator_exception(ss.str());
-			}
-		} else {
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-		}
-	} else {
-		throw vrinputemulator_connectionerror("No active connection.");
-	}
+	};
 }
 
-void VRInputEmulator::setDriverRotationOffset(uint32_t deviceId, const vr::HmdQuaternion_t & value, bool modal) {
-	if (_ipcServerQueue) {
-		ipc::Request message(ipc::RequestType::DeviceManipulation_SetDeviceOffsets);
-		memset(&message.msg, 0, sizeof(message.msg));
-		message.msg.dm_DeviceOffsets.clientId = m_clientId;
-		message.msg.dm_DeviceOffsets.messageId = 0;
-		message.msg.dm_DeviceOffsets.deviceId = deviceId;
+static std::function<void(ipc::Request&)> _driverRotationOffsetData(const vr::HmdQuaternion_t& value) {
+	return [value](ipc::Request& message) {
 		message.msg.dm_DeviceOffsets.deviceRotationOffsetValid = true;
 		message.msg.dm_DeviceOffsets.deviceRotationOffset = value;
-		if (modal) {
-			uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-			message.msg.dm_DeviceOffsets.messageId = messageId;
-			std::promise<ipc::Reply> respPromise;
-			auto respFuture = respPromise.get_future();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-			}
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-			auto resp = respFuture.get();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.erase(messageId);
-			}
-			std::stringstream ss;
-			ss << "Error while enabling device offsets: ";
-			if (resp.status == ipc::ReplyStatus::InvalidId) {
-				ss << "Invalid device id";
-				throw vrinputemulator_invalidid(ss.str());
-			} else if (resp.status == ipc::ReplyStatus::NotFound) {
-				ss << "Device not found";
-				throw vrinputemulator_notfound(ss.str());
-			} else if (resp.status != ipc::ReplyStatus::Ok) {
-				ss << "Error code " << (int)resp.status;
-				throw vrinputemulator_exception(ss.str());
-			}
-		} else {
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-		}
-	} else {
-		throw vrinputemulator_connectionerror("No active connection.");
-	}
+	};
 }
 
-void VRInputEmulator::setDriverTranslationOffset(uint32_t deviceId, const vr::HmdVector3d_t & value, bool modal) {
-	if (_ipcServerQueue) {
-		ipc::Request message(ipc::RequestType::DeviceManipulation_SetDeviceOffsets);
-		memset(&message.msg, 0, sizeof(message.msg));
-		message.msg.dm_DeviceOffsets.clientId = m_clientId;
-		message.msg.dm_DeviceOffsets.messageId = 0;
-		message.msg.dm_DeviceOffsets.deviceId = deviceId;
+static std::function<void(ipc::Request&)> _driverTranslationOffsetData(const vr::HmdVector3d_t& value) {
+	return [value](ipc::Request& message) {
 		message.msg.dm_DeviceOffsets.deviceTranslationOffsetValid = true;
 		message.msg.dm_DeviceOffsets.deviceTranslationOffset = value;
-		if (modal) {
-			uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-			message.msg.dm_DeviceOffsets.messageId = messageId;
-			std::promise<ipc::Reply> respPromise;
-			auto respFuture = respPromise.get_future();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-			}
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-			auto resp = respFuture.get();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.erase(messageId);
-			}
-			std::stringstream ss;
-			ss << "Error while enabling device offsets: ";
-			if (resp.status == ipc::ReplyStatus::InvalidId) {
-				ss << "Invalid device id";
-				throw vrinputemulator_invalidid(ss.str());
-			} else if (resp.status == ipc::ReplyStatus::NotFound) {
-				ss << "Device not found";
-				throw vrinputemulator_notfound(ss.str());
-			} else if (resp.status != ipc::ReplyStatus::Ok) {
-				ss << "Error code " << (int)resp.status;
-				throw vrinputemulator_exception(ss.str());
-			}
-		} else {
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-		}
-	} else {
-		throw vrinputemulator_connectionerror("No active connection.");
-	}
+	};
+}
+
+void VRInputEmulator::enableDeviceOffsets(uint32_t deviceId, bool enable, bool modal) {
+	_setDeviceOffsets(deviceId, _enableOffsetsData(enable), modal);
+}
+
+std::future<void> VRInputEmulator::enableDeviceOffsetsAsync(uint32_t deviceId, bool enable) {
+	return _setDeviceOffsetsAsync(deviceId, _enableOffsetsData(enable));
+}
+
+void VRInputEmulator::setWorldFromDriverRotationOffset(uint32_t deviceId, const vr::HmdQuaternion_t & value, bool modal) {
+	_setDeviceOffsets(deviceId, _worldFromDriverRotationOffsetData(value), modal);
+}
+
+std::future<void> VRInputEmulator::setWorldFromDriverRotationOffsetAsync(uint32_t deviceId, const vr::HmdQuaternion_t & value) {
+	return _setDeviceOffsetsAsync(deviceId, _worldFromDriverRotationOffsetData(value));
+}
+
+void VRInputEmulator::setWorldFromDriverTranslationOffset(uint32_t deviceId, const vr::HmdVector3d_t & value, bool modal) {
+	_setDeviceOffsets(deviceId, _worldFromDriverTranslationOffsetData(value), modal);
+}
+
+std::future<void> VRInputEmulator::setWorldFromDriverTranslationOffsetAsync(uint32_t deviceId, const vr::HmdVector3d_t & value) {
+	return _setDeviceOffsetsAsync(deviceId, _worldFromDriverTranslationOffsetData(value));
+}
+
+void VRInputEmulator::setDriverFromHeadRotationOffset(uint32_t deviceId, const vr::HmdQuaternion_t & value, bool modal) {
+	_setDeviceOffsets(deviceId, _driverFromHeadRotationOffsetData(value), modal);
+}
+
+std::future<void> VRInputEmulator::setDriverFromHeadRotationOffsetAsync(uint32_t deviceId, const vr::HmdQuaternion_t & value) {
+	return _setDeviceOffsetsAsync(deviceId, _driverFromHeadRotationOffsetData(value));
+}
+
+void VRInputEmulator::setDriverFromHeadTranslationOffset(uint32_t deviceId, const vr::HmdVector3d_t & value, bool modal) {
+	_setDeviceOffsets(deviceId, _driverFromHeadTranslationOffsetData(value), modal);
+}
+
+std::future<void> VRInputEmulator::setDriverFromHeadTranslationOffsetAsync(uint32_t deviceId, const vr::HmdVector3d_t & value) {
+	return _setDeviceOffsetsAsync(deviceId, _driverFromHeadTranslationOffsetData(value));
+}
+
+void VRInputEmulator::setDriverRotationOffset(uint32_t deviceId, const vr::HmdQuaternion_t & value, bool modal) {
+	_setDeviceOffsets(deviceId, _driverRotationOffsetData(value), modal);
+}
+
+std::future<void> VRInputEmulator::setDriverRotationOffsetAsync(uint32_t deviceId, const vr::HmdQuaternion_t & value) {
+	return _setDeviceOffsetsAsync(deviceId, _driverRotationOffsetData(value));
+}
+
+void VRInputEmulator::setDriverTranslationOffset(uint32_t deviceId, const vr::HmdVector3d_t & value, bool modal) {
+	_setDeviceOffsets(deviceId, _driverTranslationOffsetData(value), modal);
+}
+
+std::future<void> VRInputEmulator::setDriverTranslationOffsetAsync(uint32_t deviceId, const vr::HmdVector3d_t & value) {
+	return _setDeviceOffsetsAsync(deviceId, _driverTranslationOffsetData(value));
+}
+
+static ipc::Request _getDeviceInfoRequest(uint32_t clientId, uint32_t deviceId) {
+	ipc::Request message(ipc::RequestType::DeviceManipulation_GetDeviceInfo);
+	memset(&message.msg, 0, sizeof(message.msg));
+	message.msg.vd_GenericDeviceIdMessage.clientId = clientId;
+	message.msg.vd_GenericDeviceIdMessage.messageId = 0;
+	message.msg.vd_GenericDeviceIdMessage.deviceId = deviceId;
+	return message;
 }
 
 void VRInputEmulator::getDeviceInfo(uint32_t deviceId, DeviceInfo & info) {
-	if (_ipcServerQueue) {
-		ipc::Request message(ipc::RequestType::DeviceManipulation_GetDeviceInfo);
-		memset(&message.msg, 0, sizeof(message.msg));
-		message.msg.vd_GenericDeviceIdMessage.clientId = m_clientId;
-		message.msg.vd_GenericDeviceIdMessage.deviceId = deviceId;
-		uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-		message.msg.vd_GenericDeviceIdMessage.messageId = messageId;
-		std::promise<ipc::Reply> respPromise;
-		auto respFuture = respPromise.get_future();
-		{
-			std::lock_guard<std::recursive_mutex> lock(_mutex);
-			_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-		}
-		_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-		auto resp = respFuture.get();
-		{
-			std::lock_guard<std::recursive_mutex> lock(_mutex);
-			_ipcPromiseMap.erase(messageId);
-		}
-		std::stringstream ss;
-		ss << "Error while getting device info: ";
-		if (resp.status == ipc::ReplyStatus::Ok) {
-			info.deviceId = resp.msg.dm_deviceInfo.deviceId;
-			info.deviceClass = resp.msg.dm_deviceInfo.deviceClass;
-			info.deviceMode = resp.msg.dm_deviceInfo.deviceMode;
-			info.offsetsEnabled = resp.msg.dm_deviceInfo.offsetsEnabled;
-			info.buttonMappingEnabled = resp.msg.dm_deviceInfo.buttonMappingEnabled;
-			info.redirectSuspended = resp.msg.dm_deviceInfo.redirectSuspended;
-		} else if (resp.status == ipc::ReplyStatus::InvalidId) {
-			ss << "Invalid device id";
-			throw vrinputemulator_invalidid(ss.str());
-		} else if (resp.status == ipc::ReplyStatus::NotFound) {
-			ss << "Device not found";
-			throw vrinputemulator_notfound(ss.str());
-		} else if (resp.status != ipc::ReplyStatus::Ok) {
-			ss << "Error code " << (int)resp.status;
-			throw vrinputemulator_exception(ss.str());
-		}
-	} else {
-		throw vrinputemulator_connectionerror("No active connection.");
-	}
+	auto message = _getDeviceInfoRequest(m_clientId, deviceId);
+	info = _sendAndWait<DeviceInfo>(message, message.msg.vd_GenericDeviceIdMessage.messageId, _deviceInfoReply);
+}
+
+std::future<DeviceInfo> VRInputEmulator::getDeviceInfoAsync(uint32_t deviceId) {
+	auto message = _getDeviceInfoRequest(m_clientId, deviceId);
+	return _sendAsync<DeviceInfo>(message, message.msg.vd_GenericDeviceIdMessage.messageId, _deviceInfoReply);
+}
+
+static ipc::Request _setDeviceNormalModeRequest(uint32_t clientId, uint32_t deviceId) {
+	ipc::Request message(ipc::RequestType::DeviceManipulation_DefaultMode);
+	memset(&message.msg, 0, sizeof(message.msg));
+	message.msg.vd_GenericDeviceIdMessage.clientId = clientId;
+	message.msg.vd_GenericDeviceIdMessage.messageId = 0;
+	message.msg.vd_GenericDeviceIdMessage.deviceId = deviceId;
+	return message;
 }
 
 void VRInputEmulator::setDeviceNormalMode(uint32_t deviceId, bool modal) {
-	if (_ipcServerQueue) {
-		ipc::Request message(ipc::RequestType::DeviceManipulation_DefaultMode);
-		memset(&message.msg, 0, sizeof(message.msg));
-		message.msg.vd_GenericDeviceIdMessage.clientId = m_clientId;
-		message.msg.vd_GenericDeviceIdMessage.messageId = 0;
-		message.msg.vd_GenericDeviceIdMessage.deviceId = deviceId;
-		if (modal) {
-			uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-			message.msg.dm_DeviceOffsets.messageId = messageId;
-			std::promise<ipc::Reply> respPromise;
-			auto respFuture = respPromise.get_future();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-			}
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-			auto resp = respFuture.get();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.erase(messageId);
-			}
-			std::stringstream ss;
-			ss << "Error while setting normal mode: ";
-			if (resp.status == ipc::ReplyStatus::InvalidId) {
-				ss << "Invalid device id";
-				throw vrinputemulator_invalidid(ss.str());
-			} else if (resp.status == ipc::ReplyStatus::NotFound) {
-				ss << "Device not found";
-				throw vrinputemulator_notfound(ss.str());
-			} else if (resp.status != ipc::ReplyStatus::Ok) {
-				ss << "Error code " << (int)resp.status;
-				throw vrinputemulator_exception(ss.str());
-			}
-		} else {
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-		}
+	auto message = _setDeviceNormalModeRequest(m_clientId, deviceId);
+	if (modal) {
+		_sendAndWait<void>(message, message.msg.vd_GenericDeviceIdMessage.messageId, _statusReply("Error while setting normal mode: "));
 	} else {
-		throw vrinputemulator_connectionerror("No active connection.");
+		_sendRequest(message);
 	}
 }
 
+std::future<void> VRInputEmulator::setDeviceNormalModeAsync(uint32_t deviceId) {
+	auto message = _setDeviceNormalModeRequest(m_clientId, deviceId);
+	return _sendAsync<void>(message, message.msg.vd_GenericDeviceIdMessage.messageId, _statusReply("Error while setting normal mode: "));
+}
+
+static ipc::Request _setDeviceFakeDisconnectedModeRequest(uint32_t clientId, uint32_t deviceId) {
+	ipc::Request message(ipc::RequestType::DeviceManipulation_FakeDisconnectedMode);
+	memset(&message.msg, 0, sizeof(message.msg));
+	message.msg.vd_GenericDeviceIdMessage.clientId = clientId;
+	message.msg.vd_GenericDeviceIdMessage.messageId = 0;
+	message.msg.vd_GenericDeviceIdMessage.deviceId = deviceId;
+	return message;
+}
+
 void VRInputEmulator::setDeviceFakeDisconnectedMode(uint32_t deviceId, bool modal) {
-	if (_ipcServerQueue) {
-		ipc::Request message(ipc::RequestType::DeviceManipulation_FakeDisconnectedMode);
-		memset(&message.msg, 0, sizeof(message.msg));
-		message.msg.vd_GenericDeviceIdMessage.clientId = m_clientId;
-		message.msg.vd_GenericDeviceIdMessage.messageId = 0;
-		message.msg.vd_GenericDeviceIdMessage.deviceId = deviceId;
-		if (modal) {
-			uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-			message.msg.vd_GenericDeviceIdMessage.messageId = messageId;
-			std::promise<ipc::Reply> respPromise;
-			auto respFuture = respPromise.get_future();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-			}
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-			auto resp = respFuture.get();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.erase(messageId);
-			}
-			std::stringstream ss;
-			ss << "Error while setting fake disconnection mode: ";
-			if (resp.status == ipc::ReplyStatus::InvalidId) {
-				ss << "Invalid device id";
-				throw vrinputemulator_invalidid(ss.str());
-			} else if (resp.status == ipc::ReplyStatus::NotFound) {
-				ss << "Device not found";
-				throw vrinputemulator_notfound(ss.str());
-			} else if (resp.status != ipc::ReplyStatus::Ok) {
-				ss << "Error code " << (int)resp.status;
-				throw vrinputemulator_exception(ss.str());
-			}
-		} else {
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-		}
+	auto message = _setDeviceFakeDisconnectedModeRequest(m_clientId, deviceId);
+	if (modal) {
+		_sendAndWait<void>(message, message.msg.vd_GenericDeviceIdMessage.messageId, _statusReply("Error while setting fake disconnection mode: "));
 	} else {
-		throw vrinputemulator_connectionerror("No active connection.");
+		_sendRequest(message);
 	}
 }
 
+std::future<void> VRInputEmulator::setDeviceFakeDisconnectedModeAsync(uint32_t deviceId) {
+	auto message = _setDeviceFakeDisconnectedModeRequest(m_clientId, deviceId);
+	return _sendAsync<void>(message, message.msg.vd_GenericDeviceIdMessage.messageId, _statusReply("Error while setting fake disconnection mode: "));
+}
+
+static ipc::Request _setDeviceRedictModeRequest(uint32_t clientId, uint32_t deviceId, uint32_t target) {
+	ipc::Request message(ipc::RequestType::DeviceManipulation_RedirectMode);
+	memset(&message.msg, 0, sizeof(message.msg));
+	message.msg.dm_RedirectMode.clientId = clientId;
+	message.msg.dm_RedirectMode.messageId = 0;
+	message.msg.dm_RedirectMode.deviceId = deviceId;
+	message.msg.dm_RedirectMode.targetId = target;
+	return message;
+}
+
 void VRInputEmulator::setDeviceRedictMode(uint32_t deviceId, uint32_t target, bool modal) {
-	if (_ipcServerQueue) {
-		ipc::Request message(ipc::RequestType::DeviceManipulation_RedirectMode);
-		memset(&message.msg, 0, sizeof(message.msg));
-		message.msg.dm_RedirectMode.clientId = m_clientId;
-		message.msg.dm_RedirectMode.messageId = 0;
-		message.msg.dm_RedirectMode.deviceId = deviceId;
-		message.msg.dm_RedirectMode.targetId = target;
-		if (modal) {
-			uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-			message.msg.dm_RedirectMode.messageId = messageId;
-			std::promise<ipc::Reply> respPromise;
-			auto respFuture = respPromise.get_future();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-			}
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-			auto resp = respFuture.get();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.erase(messageId);
-			}
-			std::stringstream ss;
-			ss << "Error while setting redirect mode: ";
-			if (resp.status == ipc::ReplyStatus::InvalidId) {
-				ss << "Invalid device id";
-				throw vrinputemulator_invalidid(ss.str());
-			} else if (resp.status == ipc::ReplyStatus::NotFound) {
-				ss << "Device not found";
-				throw vrinputemulator_notfound(ss.str());
-			} else if (resp.status != ipc::ReplyStatus::Ok) {
-				ss << "Error code " << (int)resp.status;
-				throw vrinputemulator_exception(ss.str());
-			}
-		} else {
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-		}
+	auto message = _setDeviceRedictModeRequest(m_clientId, deviceId, target);
+	if (modal) {
+		_sendAndWait<void>(message, message.msg.dm_RedirectMode.messageId, _statusReply("Error while setting redirect mode: "));
 	} else {
-		throw vrinputemulator_connectionerror("No active connection.");
+		_sendRequest(message);
 	}
 }
 
+std::future<void> VRInputEmulator::setDeviceRedictModeAsync(uint32_t deviceId, uint32_t target) {
+	auto message = _setDeviceRedictModeRequest(m_clientId, deviceId, target);
+	return _sendAsync<void>(message, message.msg.dm_RedirectMode.messageId, _statusReply("Error while setting redirect mode: "));
+}
+
+static ipc::Request _setDeviceSwapModeRequest(uint32_t clientId, uint32_t deviceId, uint32_t target) {
+	ipc::Request message(ipc::RequestType::DeviceManipulation_SwapMode);
+	memset(&message.msg, 0, sizeof(message.msg));
+	message.msg.dm_SwapMode.clientId = clientId;
+	message.msg.dm_SwapMode.messageId = 0;
+	message.msg.dm_SwapMode.deviceId = deviceId;
+	message.msg.dm_SwapMode.targetId = target;
+	return message;
+}
+
 void VRInputEmulator::setDeviceSwapMode(uint32_t deviceId, uint32_t target, bool modal) {
-	if (_ipcServerQueue) {
-		ipc::Request message(ipc::RequestType::DeviceManipulation_SwapMode);
-		memset(&message.msg, 0, sizeof(message.msg));
-		message.msg.dm_SwapMode.clientId = m_clientId;
-		message.msg.dm_SwapMode.messageId = 0;
-		message.msg.dm_SwapMode.deviceId = deviceId;
-		message.msg.dm_SwapMode.targetId = target;
-		if (modal) {
-			uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-			message.msg.dm_SwapMode.messageId = messageId;
-			std::promise<ipc::Reply> respPromise;
-			auto respFuture = respPromise.get_future();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-			}
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-			auto resp = respFuture.get();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.erase(messageId);
-			}
-			std::stringstream ss;
-			ss << "Error while setting swap mode: ";
-			if (resp.status == ipc::ReplyStatus::InvalidId) {
-				ss << "Invalid device id";
-				throw vrinputemulator_invalidid(ss.str());
-			} else if (resp.status == ipc::ReplyStatus::NotFound) {
-				ss << "Device not found";
-				throw vrinputemulator_notfound(ss.str());
-			} else if (resp.status != ipc::ReplyStatus::Ok) {
-				ss << "Error code " << (int)resp.status;
-				throw vrinputemulator_exception(ss.str());
-			}
-		} else {
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-		}
+	auto message = _setDeviceSwapModeRequest(m_clientId, deviceId, target);
+	if (modal) {
+		_sendAndWait<void>(message, message.msg.dm_SwapMode.messageId, _statusReply("Error while setting swap mode: "));
 	} else {
-		throw vrinputemulator_connectionerror("No active connection.");
+		_sendRequest(message);
 	}
 }
 
+std::future<void> VRInputEmulator::setDeviceSwapModeAsync(uint32_t deviceId, uint32_t target) {
+	auto message = _setDeviceSwapModeRequest(m_clientId, deviceId, target);
+	return _sendAsync<void>(message, message.msg.dm_SwapMode.messageId, _statusReply("Error while setting swap mode: "));
+}
+
+
+static ipc::Request _setDeviceMotionCompensationModeRequest(uint32_t clientId, uint32_t deviceId, uint32_t velAccMode) {
+	ipc::Request message(ipc::RequestType::DeviceManipulation_MotionCompensationMode);
+	memset(&message.msg, 0, sizeof(message.msg));
+	message.msg.dm_MotionCompensationMode.clientId = clientId;
+	message.msg.dm_MotionCompensationMode.messageId = 0;
+	message.msg.dm_MotionCompensationMode.deviceId = deviceId;
+	message.msg.dm_MotionCompensationMode.velAccCompensationMode = velAccMode;
+	return message;
+}
 
 void VRInputEmulator::setDeviceMotionCompensationMode(uint32_t deviceId, uint32_t velAccMode, bool modal) {
-	if (_ipcServerQueue) {
-		ipc::Request message(ipc::RequestType::DeviceManipulation_MotionCompensationMode);
-		memset(&message.msg, 0, sizeof(message.msg));
-		message.msg.dm_MotionCompensationMode.clientId = m_clientId;
-		message.msg.dm_MotionCompensationMode.messageId = 0;
-		message.msg.dm_MotionCompensationMode.deviceId = deviceId;
-		message.msg.dm_MotionCompensationMode.velAccCompensationMode = velAccMode;
-		if (modal) {
-			uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-			message.msg.dm_MotionCompensationMode.messageId = messageId;
-			std::promise<ipc::Reply> respPromise;
-			auto respFuture = respPromise.get_future();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-			}
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-			auto resp = respFuture.get();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.erase(messageId);
-			}
-			std::stringstream ss;
-			ss << "Error while setting motion compensation mode: ";
-			if (resp.status == ipc::ReplyStatus::InvalidId) {
-				ss << "Invalid device id";
-				throw vrinputemulator_invalidid(ss.str());
-			} else if (resp.status == ipc::ReplyStatus::NotFound) {
-				ss << "Device not found";
-				throw vrinputemulator_notfound(ss.str());
-			} else if (resp.status != ipc::ReplyStatus::Ok) {
-				ss << "Error code " << (int)resp.status;
-				throw vrinputemulator_exception(ss.str());
-			}
-		} else {
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-		}
+	auto message = _setDeviceMotionCompensationModeRequest(m_clientId, deviceId, velAccMode);
+	if (modal) {
+		_sendAndWait<void>(message, message.msg.dm_MotionCompensationMode.messageId, _statusReply("Error while setting motion compensation mode: "));
 	} else {
-		throw vrinputemulator_connectionerror("No active connection.");
+		_sendRequest(message);
 	}
 }
 
+std::future<void> VRInputEmulator::setDeviceMotionCompensationModeAsync(uint32_t deviceId, uint32_t velAccMode) {
+	auto message = _setDeviceMotionCompensationModeRequest(m_clientId, deviceId, velAccMode);
+	return _sendAsync<void>(message, message.msg.dm_MotionCompensationMode.messageId, _statusReply("Error while setting motion compensation mode: "));
+}
+
+
+static ipc::Request _setMotionVelAccCompensationModeRequest(uint32_t clientId, uint32_t velAccMode) {
+	ipc::Request message(ipc::RequestType::DeviceManipulation_SetMotionCompensationProperties);
+	memset(&message.msg, 0, sizeof(message.msg));
+	message.msg.dm_SetMotionCompensationProperties.clientId = clientId;
+	message.msg.dm_SetMotionCompensationProperties.messageId = 0;
+	message.msg.dm_SetMotionCompensationProperties.velAccCompensationModeValid = true;
+	message.msg.dm_SetMotionCompensationProperties.velAccCompensationMode = velAccMode;
+	return message;
+}
 
 void VRInputEmulator::setMotionVelAccCompensationMode(uint32_t velAccMode, bool modal) {
-	if (_ipcServerQueue) {
-		ipc::Request message(ipc::RequestType::DeviceManipulation_SetMotionCompensationProperties);
-		memset(&message.msg, 0, sizeof(message.msg));
-		message.msg.dm_SetMotionCompensationProperties.clientId = m_clientId;
-		message.msg.dm_SetMotionCompensationProperties.messageId = 0;
-		message.msg.dm_SetMotionCompensationProperties.velAccCompensationMode = velAccMode;
-		if (modal) {
-			uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-			message.msg.dm_SetMotionCompensationProperties.messageId = messageId;
-			std::promise<ipc::Reply> respPromise;
-			auto respFuture = respPromise.get_future();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-			}
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-			auto resp = respFuture.get();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.erase(messageId);
-			}
-			std::stringstream ss;
-			ss << "Error while setting motion compensation properties: ";
-			if (resp.status == ipc::ReplyStatus::InvalidId) {
-				ss << "Invalid device id";
-				throw vrinputemulator_invalidid(ss.str());
-			} else if (resp.status == ipc::ReplyStatus::NotFound) {
-				ss << "Device not found";
-				throw vrinputemulator_notfound(ss.str());
-			} else if (resp.status != ipc::ReplyStatus::Ok) {
-				ss << "Error code " << (int)resp.status;
-				throw vrinputemulator_exception(ss.str());
-			}
-		} else {
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-		}
+	auto message = _setMotionVelAccCompensationModeRequest(m_clientId, velAccMode);
+	if (modal) {
+		_sendAndWait<void>(message, message.msg.dm_SetMotionCompensationProperties.messageId, _statusReply("Error while setting motion compensation properties: "));
 	} else {
-		throw vrinputemulator_connectionerror("No active connection.");
+		_sendRequest(message);
+	}
+}
+
+std::future<void> VRInputEmulator::setMotionVelAccCompensationModeAsync(uint32_t velAccMode) {
+	auto message = _setMotionVelAccCompensationModeRequest(m_clientId, velAccMode);
+	return _sendAsync<void>(message, message.msg.dm_SetMotionCompensationProperties.messageId, _statusReply("Error while setting motion compensation properties: "));
+}
+
+static ipc::Request _setMotionCompensationKalmanFilterNoiseRequest(uint32_t clientId, double processNoise, double observationNoise) {
+	ipc::Request message(ipc::RequestType::DeviceManipulation_SetMotionCompensationProperties);
+	memset(&message.msg, 0, sizeof(message.msg));
+	message.msg.dm_SetMotionCompensationProperties.clientId = clientId;
+	message.msg.dm_SetMotionCompensationProperties.messageId = 0;
+	message.msg.dm_SetMotionCompensationProperties.kalmanFilterNoiseValid = true;
+	message.msg.dm_SetMotionCompensationProperties.kalmanFilterProcessNoise = processNoise;
+	message.msg.dm_SetMotionCompensationProperties.kalmanFilterObservationNoise = observationNoise;
+	return message;
+}
+
+void VRInputEmulator::setMotionCompensationKalmanFilterNoise(double processNoise, double observationNoise, bool modal) {
+	auto message = _setMotionCompensationKalmanFilterNoiseRequest(m_clientId, processNoise, observationNoise);
+	if (modal) {
+		_sendAndWait<void>(message, message.msg.dm_SetMotionCompensationProperties.messageId, _statusReply("Error while setting motion compensation properties: "));
+	} else {
+		_sendRequest(message);
 	}
 }
 
+std::future<void> VRInputEmulator::setMotionCompensationKalmanFilterNoiseAsync(double processNoise, double observationNoise) {
+	auto message = _setMotionCompensationKalmanFilterNoiseRequest(m_clientId, processNoise, observationNoise);
+	return _sendAsync<void>(message, message.msg.dm_SetMotionCompensationProperties.messageId, _statusReply("Error while setting motion compensation properties: "));
+}
+
+
+static ipc::Request _triggerHapticPulseRequest(uint32_t clientId, uint32_t deviceId, uint32_t axisId, uint16_t durationMicroseconds, bool directMode) {
+	ipc::Request message(ipc::RequestType::DeviceManipulation_TriggerHapticPulse);
+	memset(&message.msg, 0, sizeof(message.msg));
+	message.msg.dm_triggerHapticPulse.clientId = clientId;
+	message.msg.dm_triggerHapticPulse.messageId = 0;
+	message.msg.dm_triggerHapticPulse.deviceId = deviceId;
+	message.msg.dm_triggerHapticPulse.axisId = axisId;
+	message.msg.dm_triggerHapticPulse.durationMicroseconds = durationMicroseconds;
+	message.msg.dm_triggerHapticPulse.directMode = directMode;
+	return message;
+}
 
 void VRInputEmulator::triggerHapticPulse(uint32_t deviceId, uint32_t axisId, uint16_t durationMicroseconds, bool directMode, bool modal) {
-	if (_ipcServerQueue) {
-		ipc::Request message(ipc::RequestType::DeviceManipulation_TriggerHapticPulse);
-		memset(&message.msg, 0, sizeof(message.msg));
-		message.msg.dm_triggerHapticPulse.clientId = m_clientId;
-		message.msg.dm_triggerHapticPulse.messageId = 0;
-		message.msg.dm_triggerHapticPulse.deviceId = deviceId;
-		message.msg.dm_triggerHapticPulse.axisId = axisId;
-		message.msg.dm_triggerHapticPulse.durationMicroseconds = durationMicroseconds;
-		message.msg.dm_triggerHapticPulse.directMode = directMode;
-		if (modal) {
-			uint32_t messageId = _ipcRandomDist(_ipcRandomDevice);
-			message.msg.dm_triggerHapticPulse.messageId = messageId;
-			std::promise<ipc::Reply> respPromise;
-			auto respFuture = respPromise.get_future();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.insert({ messageId, std::move(respPromise) });
-			}
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-			auto resp = respFuture.get();
-			{
-				std::lock_guard<std::recursive_mutex> lock(_mutex);
-				_ipcPromiseMap.erase(messageId);
-			}
-			std::stringstream ss;
-			ss << "Error while enabling device offsets: ";
-			if (resp.status == ipc::ReplyStatus::InvalidId) {
-				ss << "Invalid device id";
-				throw vrinputemulator_invalidid(ss.str());
-			} else if (resp.status == ipc::ReplyStatus::NotFound) {
-				ss << "Device not found";
-				throw vrinputemulator_notfound(ss.str());
-			} else if (resp.status != ipc::ReplyStatus::Ok) {
-				ss << "Error code " << (int)resp.status;
-				throw vrinputemulator_exception(ss.str());
-			}
-		} else {
-			_ipcServerQueue->send(&message, sizeof(ipc::Request), 0);
-		}
+	auto message = _triggerHapticPulseRequest(m_clientId, deviceId, axisId, durationMicroseconds, directMode);
+	if (modal) {
+		_sendAndWait<void>(message, message.msg.dm_triggerHapticPulse.messageId, _statusReply("Error while enabling device offsets: "));
 	} else {
-		throw vrinputemulator_connectionerror("No active connection.");
+		_sendRequest(message);
 	}
 }
 
+std::future<void> VRInputEmulator::triggerHapticPulseAsync(uint32_t deviceId, uint32_t axisId, uint16_t durationMicroseconds, bool directMode) {
+	auto message = _triggerHapticPulseRequest(m_clientId, deviceId, axisId, durationMicroseconds, directMode);
+	return _sendAsync<void>(message, message.msg.dm_triggerHapticPulse.messageId, _statusReply("Error while enabling device offsets: "));
+}
+
 
 } // end namespace vrinputemulator
@@ -0,0 +1,82 @@
+// Micro-benchmark for the rotation helpers in openvr_math.h: openvr_math_bench [<iterations>]
+#include <openvr.h>
+#include <openvr_math.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+namespace {
+
+// quaternionRotateVector() as it was before, two full quaternion products per vector
+vr::HmdVector3d_t productRotateVector(const vr::HmdQuaternion_t& quat, const vr::HmdVector3d_t& vector) {
+	vr::HmdQuaternion_t pin = { 0.0, vector.v[0], vector.v[1] , vector.v[2] };
+	auto pout = quat * pin * vrmath::quaternionConjugate(quat);
+	return { pout.x, pout.y, pout.z };
+}
+
+volatile double sink;
+
+template<typename F>
+void run(const char* name, size_t iterations, size_t vectorsPerIteration, F func) {
+	auto start = std::chrono::steady_clock::now();
+	double acc = 0.0;
+	for (size_t i = 0; i < iterations; ++i) {
+		acc += func(i);
+	}
+	auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	sink = acc;
+	std::printf("%-32s %8.2f ns/vector\n", name, (double)ns / (double)(iterations * vectorsPerIteration));
+}
+
+}
+
+int main(int argc, const char* argv[]) {
+	size_t iterations = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+	if (iterations == 0) {
+		std::printf("Usage: openvr_math_bench [<iterations>]\n");
+		return 1;
+	}
+	// 13 devices, as in a full-body setup with motion compensation enabled
+	const size_t count = 13;
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<double> unit(-1.0, 1.0);
+	// A different rotation per iteration so the compiler cannot hoist the work out of the loop
+	std::vector<vr::HmdQuaternion_t> quats(64);
+	for (auto& q : quats) {
+		q = vrmath::quaternionFromYawPitchRoll(unit(rng), unit(rng), unit(rng));
+	}
+	std::vector<vr::HmdVector3d_t> vectors(count);
+	for (auto& v : vectors) {
+		v = vrmath::vector3d(unit(rng), unit(rng), unit(rng));
+	}
+	std::vector<double> out(3 * count);
+
+	run("quaternion product (old)", iterations, count, [&](size_t i) {
+		auto& quat = quats[i % quats.size()];
+		for (size_t k = 0; k < count; ++k) {
+			auto v = productRotateVector(quat, vectors[k]);
+			out[3 * k] = v.v[0]; out[3 * k + 1] = v.v[1]; out[3 * k + 2] = v.v[2];
+		}
+		return out[0] + out[3 * count - 1];
+	});
+	run("quaternionRotateVector", iterations, count, [&](size_t i) {
+		auto& quat = quats[i % quats.size()];
+		for (size_t k = 0; k < count; ++k) {
+			auto v = vrmath::quaternionRotateVector(quat, vectors[k]);
+			out[3 * k] = v.v[0]; out[3 * k + 1] = v.v[1]; out[3 * k + 2] = v.v[2];
+		}
+		return out[0] + out[3 * count - 1];
+	});
+	run("rotationMatrix + rotateVector", iterations, count, [&](size_t i) {
+		auto& quat = quats[i % quats.size()];
+		auto mat = vrmath::rotationMatrixFromQuaternion(quat);
+		for (size_t k = 0; k < count; ++k) {
+			auto v = vrmath::rotateVector(mat, vectors[k]);
+			out[3 * k] = v.v[0]; out[3 * k + 1] = v.v[1]; out[3 * k + 2] = v.v[2];
+		}
+		return out[0] + out[3 * count - 1];
+	});
+	return 0;
+}
@@ -0,0 +1,106 @@
+// Unit tests for openvr_math.h. Returns 0 when all checks pass.
+#include <openvr.h>
+#include <openvr_math.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace {
+
+// quaternionRotateVector() as it was before it got expanded into (w² - u·u) v + 2 (u·v) u + 2w (u × v)
+namespace reference {
+
+	vr::HmdVector3d_t quaternionRotateVector(const vr::HmdQuaternion_t& quat, const vr::HmdVector3d_t& vector, bool reverse = false) {
+		vr::HmdQuaternion_t pin = { 0.0, vector.v[0], vector.v[1] , vector.v[2] };
+		auto pout = reverse ? vrmath::quaternionConjugate(quat) * pin * quat : quat * pin * vrmath::quaternionConjugate(quat);
+		return { pout.x, pout.y, pout.z };
+	}
+
+}
+
+const double pi = 3.14159265358979323846;
+unsigned failures = 0;
+
+void check(bool condition, const char* what, double value = 0.0) {
+	if (!condition) {
+		std::printf("FAILED: %s (%g)\n", what, value);
+		failures++;
+	}
+}
+
+double maxDiff(const vr::HmdVector3d_t& a, const vr::HmdVector3d_t& b) {
+	double diff = 0.0;
+	for (int i = 0; i < 3; ++i) {
+		diff = std::max(diff, std::abs(a.v[i] - b.v[i]));
+	}
+	return diff;
+}
+
+// Random rotations, half of them slightly denormalized (quaternions from integration drift), and vectors up to
+// a length of about 17
+struct Samples {
+	std::vector<vr::HmdQuaternion_t> quats;
+	std::vector<vr::HmdVector3d_t> vectors;
+	Samples(size_t count) {
+		std::mt19937 rng(42);
+		std::uniform_real_distribution<double> unit(-1.0, 1.0);
+		for (size_t i = 0; i < count; ++i) {
+			vr::HmdQuaternion_t q = { unit(rng), unit(rng), unit(rng), unit(rng) };
+			double n = std::sqrt(q.w * q.w + q.x * q.x + q.y * q.y + q.z * q.z);
+			double scale = (i & 1) ? 1.0 + 1e-6 * unit(rng) : 1.0;
+			quats.push_back({ q.w / n * scale, q.x / n * scale, q.y / n * scale, q.z / n * scale });
+			vectors.push_back({ 10.0 * unit(rng), 10.0 * unit(rng), 10.0 * unit(rng) });
+		}
+	}
+};
+
+void testRotateVectorMatchesReference(const Samples& samples) {
+	double worst = 0.0;
+	for (size_t i = 0; i < samples.quats.size(); ++i) {
+		auto& q = samples.quats[i];
+		auto& v = samples.vectors[i];
+		for (bool reverse : { false, true }) {
+			auto expected = reference::quaternionRotateVector(q, v, reverse);
+			worst = std::max(worst, maxDiff(vrmath::quaternionRotateVector(q, v, reverse), expected));
+			worst = std::max(worst, maxDiff(vrmath::quaternionRotateVector(q, v.v, reverse), expected));
+			worst = std::max(worst, maxDiff(vrmath::rotateVector(vrmath::rotationMatrixFromQuaternion(q, reverse), v), expected));
+		}
+	}
+	check(worst < 1e-13, "quaternionRotateVector / rotateVector differ from the quaternion product", worst);
+}
+
+void testKnownRotations() {
+	auto v = vrmath::quaternionRotateVector(vrmath::quaternionFromRotationZ(pi / 2.0), vrmath::vector3d(1.0, 0.0, 0.0));
+	check(maxDiff(v, vrmath::vector3d(0.0, 1.0, 0.0)) < 1e-15, "90 degrees around z");
+	v = vrmath::quaternionRotateVector(vrmath::quaternionFromRotationZ(pi / 2.0), vrmath::vector3d(1.0, 0.0, 0.0), true);
+	check(maxDiff(v, vrmath::vector3d(0.0, -1.0, 0.0)) < 1e-15, "reverse 90 degrees around z");
+	v = vrmath::quaternionRotateVector(vrmath::quaternionIdentity(), vrmath::vector3d(1.0, 2.0, 3.0));
+	check(maxDiff(v, vrmath::vector3d(1.0, 2.0, 3.0)) == 0.0, "identity");
+}
+
+void testSlerp() {
+	auto a = vrmath::quaternionFromRotationY(0.2);
+	auto b = vrmath::quaternionFromRotationY(1.0);
+	auto half = vrmath::quaternionSlerp(a, b, 0.5);
+	auto expected = vrmath::quaternionFromRotationY(0.6);
+	double diff = std::abs(half.w - expected.w) + std::abs(half.x - expected.x) + std::abs(half.y - expected.y) + std::abs(half.z - expected.z);
+	check(diff < 1e-12, "slerp halfway", diff);
+	// Takes the shorter arc when the quaternions lie in opposite hemispheres
+	vr::HmdQuaternion_t negB = { -b.w, -b.x, -b.y, -b.z };
+	half = vrmath::quaternionSlerp(a, negB, 0.5);
+	diff = std::abs(std::abs(half.w) - std::abs(expected.w)) + std::abs(std::abs(half.y) - std::abs(expected.y));
+	check(diff < 1e-12, "slerp shorter arc", diff);
+}
+
+}
+
+int main() {
+	Samples samples(4096);
+	testRotateVectorMatchesReference(samples);
+	testKnownRotations();
+	testSlerp();
+	std::printf("%s\n", failures ? "FAILED" : "OK");
+	return failures ? 1 : 0;
+}